@@ -8,39 +8,105 @@
 *
 */
 
-// Extern libs
-#include "ESP8266WebServer.h"
-
 // Internal files
 #include "src/constants/Constants.h"
 #include "src/wifi-interface/WifiInterface.hpp"
 #include "src/user/GDoorUser.hpp"   
 #include "src/networking/HttpInterface.hpp"  
+#include "src/networking/UploadQueue.hpp"
+#include "src/networking/UploadSchedule.hpp"
+#include "src/networking/LocalControl.hpp"
+#include "src/security/RequestAuth.hpp"
+#include "src/settings/GDoorSettings.hpp"
+#include "src/rules/GDoorRules.hpp"
 #include "src/digital-io/GDoorIO.hpp"   
-// #include "src/networking/WebServer.hpp"        
-// --> Web Server class doesn't work, could be that strong reference isn't maintained to server object
+#include "src/logging/GDoorLog.hpp"
+#include "src/clock/GDoorClock.hpp"
+#include "src/diagnostics/Benchmark.hpp"
+#include "src/diagnostics/Supervisor.hpp"
+#include "src/diagnostics/MemoryProfiler.hpp"
+#include "src/diagnostics/TraceRecorder.hpp"
+#include "src/diagnostics/HealthSnapshot.hpp"
+#include "src/networking/WebServer.hpp"
+
+// Uncomment (or pass -DGDOOR_BENCHMARK) to run the hot path benchmarks at boot
+// #define GDOOR_BENCHMARK
+// Uncomment to add the /<uid>/InjectHang?stage=N endpoint for testing the supervisor - never ship it
+// #define GDOOR_FAULT_INJECTION
+// Pass -DGDOOR_CLOUD_INSECURE to skip checking the cloud's certificate (bench TLS stand-ins) - never ship it
 
 // Firmware constants
 const char* firmWVersion = "1.0.0";   // Weird name because of namespace conflicts
-const int portNumber = 6969;
-const char* portNumberStr = "6969";
-const unsigned long healthCheckInterval = 900000; // 15 mins in milliseconds (for health ping)
+const int logDrainPerLoop = 4;                    // Max log lines formatted per loop pass
+const unsigned long snapshotSampleInterval = 1000;  // Millis between RSSI / heap / queue samples for the health snapshot
+const UplinkEncoding uploadEncoding = UPLINK_ENCODING_JSON;   // Binary needs the backend decoder deployed
+
+// Copies one binary record out of a log or trace ring - for the hex dump endpoints
+typedef int (*RecordDumper)(void* source, int index, uint8_t* target);
+
+// Boot stages - timestamped to the log & the trace (tools/decode_trace.py) to track time-to-first-report after a power cut
+typedef enum bootStage {
+  BOOT_STAGE_GPIO,
+  BOOT_STAGE_USER_DATA,
+  BOOT_STAGE_WIFI_BEGIN,
+  BOOT_STAGE_SERVER,
+  BOOT_STAGE_DOOR_SAMPLED,
+  BOOT_STAGE_WIFI_CONNECTED,
+  BOOT_STAGE_FIRST_REPORT,
+  BOOT_STAGE_UPLINK_READY,              // Clock synced (or the fallback time taken) - uploads can verify the server
+  BOOT_STAGE_COUNT
+} BootStage;
+
+const LogMessageId bootStageLogs[BOOT_STAGE_COUNT] = {
+  LOG_BOOT_STAGE_GPIO, LOG_BOOT_STAGE_USER_DATA, LOG_BOOT_STAGE_WIFI_BEGIN, LOG_BOOT_STAGE_SERVER, 
+  LOG_BOOT_STAGE_DOOR_SAMPLED, LOG_BOOT_STAGE_WIFI_CONNECTED, LOG_BOOT_STAGE_FIRST_REPORT, LOG_BOOT_STAGE_UPLINK_READY
+};
 
 // Global vars
 GDoorUser user;
 GDoorIO doorIO;
 GDoorWifi wifiInterface;
-ESP8266WebServer server(portNumber);
-unsigned long currentMillis = 1;        //make sure they don't equate on first check
-unsigned long previousMillis = 0;
+GDoorWebServer webServer;               // Port comes from the settings in serverSetup()
+UploadQueue uploadQueue;
+GDoorUploadSchedule uploadSchedule;
+GDoorLocalControl localControl;
+GDoorRequestAuth requestAuth;
+GDoorSettings settings;
+GDoorRules rules;
+GDoorSupervisor supervisor;
+GDoorMemoryProfiler memoryProfiler;
+GDoorHealthSnapshot healthSnapshot;
+char portNumberStr[6];
+GDoorClock deviceClock;
+uint64_t currentMillis = 0;
+uint64_t nextSnapshotMillis = 0;
+unsigned long bootStageMillis[BOOT_STAGE_COUNT];
+wl_status_t lastWifiStatus = WL_IDLE_STATUS;
+bool firstReportSent = false;
+bool uplinkReadyMarked = false;
+
+/*
+ *                Boot Sequence
+ * 
+ *  Stages are ordered by dependency rather than run back to back:
+ *  the radio associates in the background while the server is 
+ *  registered and the door is debounced, and the boot info and 
+ *  initial door state leave as one upload from the main loop.
+ * 
+ */
 
 void setup() {
   Serial.begin(115200);
-  Serial.println("Firing up Esp!!");
+  GLOG_INFO(LOG_MAIN_BOOT);
+  memoryProfiler.begin();
+
+  // Tunables - the networking ones & the channel count are only read here, at boot
+  settings.load();
+  doorIO.setChannelCount(settings.get(SETTING_DOOR_CHANNELS));
 
   // Set up GPIO pins
   doorIO.setupGPIOPins();
-  delay(3000);
+  markBootStage(BOOT_STAGE_GPIO);
 
   // Attempt to load user data from disk
   bool loadSuccess = user.loadUserData();
@@ -48,148 +114,346 @@ void setup() {
     // Start WiFi setup mode
     wifiInterface.startWifiCredAcquisition(doorIO.wifiLEDPin);
   }
+
+  // Watchdog from here on (credential acquisition waits indefinitely) - boot is one long stage
+  supervisor.begin(&doorIO);
+  gdoorTrace.record(TRACE_BOOT, supervisor.lastReset()->resetReason);
+
+  requestAuth.begin(&user, &deviceClock);
+  uploadSchedule.begin(user.uid);
+  healthSnapshot.begin(firmWVersion, doorIO.channelCount);
+
+  applySettings();
+  user.espStaticOctet = settings.get(SETTING_STATIC_OCTET);
+  sprintf(portNumberStr, "%u", settings.get(SETTING_PORT_NUMBER));
+  markBootStage(BOOT_STAGE_USER_DATA);
+
+#ifdef GDOOR_BENCHMARK
+  runHotPathBenchmarks();
+#endif
  
-  // Connect to wifi
-  user.currentIPAddress = wifiInterface.initialWiFiConnection(user.ssid, user.password, user.gatewayIPArr, user.subnetMaskIpArr, user.espStaticOctet, doorIO.wifiLEDPin);                       
-  delay(500); 
+  // Start connecting to wifi - completes in the background
+  wifiInterface.beginWiFiConnection(user.ssid, user.password, user.gatewayIPArr, user.subnetMaskIpArr, user.espStaticOctet, doorIO.wifiLEDPin);
+  markBootStage(BOOT_STAGE_WIFI_BEGIN);
+
+  // Set up the server (listens on all interfaces, so it needn't wait for the IP)
+  serverSetup();
+  markBootStage(BOOT_STAGE_SERVER);
+
+  // Debounce the initial door state while the radio associates
+  doorIO.settleDoorStates();
+  for (int channel = 0; channel < doorIO.channelCount; channel++){
+    user.doorStates[channel] = doorIO.doorState(channel);
+    healthSnapshot.setDoorState(channel, user.doorStates[channel]);
+  }
 
-  // Write boot updates to DB & initial door state
+  // Rules arm against the settled door states
+  rules.begin(&doorIO, &deviceClock);
+  rules.load();
+  markBootStage(BOOT_STAGE_DOOR_SAMPLED);
+
+  // Wait for the connection to be established - unset if the budget ran out, the loop's reconnect check carries on
+  user.currentIPAddress = wifiInterface.completeWiFiConnection();
   user.createIPStrings();
-  uploadBootInfo(portNumberStr, user.uid, firmWVersion, user.gatewayIPStr, user.assignedIPStr);
-  delay(500);  
-  sendInitialDoorState();
+  uploadSchedule.connected(deviceClock.monotonicMillis());
+  markBootStage(BOOT_STAGE_WIFI_CONNECTED);
 
-  // Set up the server
-  serverSetup();
-  
-  // Take a breath before we enter the loop
-  delay(1000);
+  setUplinkEncoding(uploadEncoding);
+  setUplinkClock(&deviceClock);
+
+  // Wall time syncs in the background - uploads are stamped as it becomes available
+  deviceClock.begin();
+
+  // LAN control channel - needs the IP for mDNS
+  localControl.begin(&user, &doorIO, firmWVersion);
+
+  // Boot info carries the initial door state - sent from the loop
+  uploadQueue.push(UPLOAD_BOOT_INFO, user.doorStates[0], uploadSchedule.connectedAt(), 0, uploadSchedule.holdUntil(UPLOAD_BOOT_INFO, ESP.random()));
 }
 
 void loop() {
-  // put your main code here, to run repeatedly:
+  // Each step is marked for the supervisor & memory profiler - a step overrunning its deadline resets the device
+  enterStage(SUPERVISOR_STAGE_CLOCK);
+  deviceClock.update();
+  enterStage(SUPERVISOR_STAGE_DOOR_SAMPLE);
   assessDoorState();
-  server.handleClient();
+  rules.tick(deviceClock.monotonicMillis());
+  enterStage(SUPERVISOR_STAGE_SERVER);
+  webServer.handle();
+  enterStage(SUPERVISOR_STAGE_LOCAL_CONTROL);
+  localControl.handle();
+  if (localControl.consumeActivity()){
+    rules.notePresence(deviceClock.monotonicMillis());
+  }
+  enterStage(SUPERVISOR_STAGE_HEALTH_CHECK);
   healthCheckTimeQuery();
+  refreshHealthSnapshot();
+  enterStage(SUPERVISOR_STAGE_UPLOAD);
+  processUploadQueue();
+  enterStage(SUPERVISOR_STAGE_LOG_DRAIN);
+  gdoorLog.drain(Serial, logDrainPerLoop);
+
+  // Check connectivity state - transitions go to the trace
+  wl_status_t wifiStatus = WiFi.status();
+  if (wifiStatus != lastWifiStatus){
+    lastWifiStatus = wifiStatus;
+    gdoorTrace.record(TRACE_WIFI_STATUS, wifiStatus);
+  }
 
-  // Check connectivity state
-  if (WiFi.status() != WL_CONNECTED){
+  // Associated isn't enough - a connection that ran out of budget may be sitting on the wrong static address
+  if (wifiStatus != WL_CONNECTED || !wifiInterface.hasAddress()){
+    enterStage(SUPERVISOR_STAGE_WIFI_RECON);
     handleWifiReconProcedure();
   }
 }
 
+void enterStage(SupervisorStage stage){
+  supervisor.setStage(stage);
+  memoryProfiler.enter(stage);
+}
+
+void markBootStage(BootStage stage){
+  bootStageMillis[stage] = millis();
+  GLOG_INFO(bootStageLogs[stage], bootStageMillis[stage]);
+  gdoorTrace.record(TRACE_BOOT_STAGE, stage);
+}
+
 /*
  *                Health Ping Update
  * 
- *  Handler function to assess the current millies period  
- *  - accounting for roll over. If the current period exceeds 
- *  the set interval, a health ping is sent to the server.
+ *  Handler function to assess the current millies period. 
+ *  If the current period exceeds the set interval, a health 
+ *  ping is sent to the server. The phase of the first ping 
+ *  after a (re)connection is set by the upload schedule.
  * 
  */
 
 void healthCheckTimeQuery(){
-  currentMillis = millis();
-  unsigned long millisDiff = currentMillis - previousMillis;
+  currentMillis = deviceClock.monotonicMillis();
 
-  if(millisDiff > healthCheckInterval) {
+  if(uploadSchedule.healthCheckDue(currentMillis)) {
     // Need to do a health update  
-    Serial.println("MAIN: Health check time - hitting API");
+    GLOG_INFO(LOG_MAIN_HEALTH_CHECK_DUE);
 
     // Update server
-    sendHealthCheckUpdate(currentMillis, user.uid);
-
-    // Update the previous time checkpoint
-    previousMillis = currentMillis;
+    uploadQueue.push(UPLOAD_HEALTH_CHECK, user.doorStates[0], currentMillis);
   } 
+}
 
-  else if(currentMillis < previousMillis){
-    // Roll over --> Need to reset
-    Serial.println("MAIN: Millis rollover - resetting counters");
-    previousMillis = 0;
+/*
+ *                Settings
+ * 
+ *  Pushes the live settings out to where they're used. Runs at 
+ *  boot and after every accepted update - the health ping is 
+ *  re-phased so a shorter interval takes effect straight away.
+ * 
+ */
+
+void applySettings(){
+  uploadSchedule.setInterval(settings.get(SETTING_HEALTH_CHECK_INTERVAL), deviceClock.monotonicMillis());
+  uploadSchedule.setSpread(settings.get(SETTING_UPLOAD_SPREAD));
+
+  for (int channel = 0; channel < doorIO.channelCount; channel++){
+    doorIO.channels[channel].pulseLength = settings.get(SETTING_PULSE_LENGTH);
+    doorIO.setDebounce(channel, settings.get(SETTING_DEBOUNCE_SAMPLES), settings.get(SETTING_DEBOUNCE_INTERVAL));
   }
 }
 
 void handleWifiReconProcedure(){
-  user.currentIPAddress = wifiInterface.setWiFiReconnectingState();
+  // Bounded wait - still down means the loop carries on & this runs again next pass
+  IPAddress reconnectedIP = wifiInterface.setWiFiReconnectingState();
+  if (!reconnectedIP.isSet()){
+    return;
+  }
+
+  user.currentIPAddress = reconnectedIP;
   user.createIPStrings();
-  delay(500); 
+  localControl.announceAddress();
 
-  // Reset millis - no need for a health check immediately after recon not
-  previousMillis = millis();
+  // Reset the health schedule - no need for a health check immediately after recon not
+  uploadSchedule.connected(deviceClock.monotonicMillis());
   
-  // Indicate to the server that the sensor is back online
-  sendReconnectionNotification(user.uid, user.assignedIPStr);
-  delay(500); 
+  // Indicate to the server that the sensor is back online (jittered - the whole street reconnects at once)
+  uploadQueue.push(UPLOAD_WIFI_RECON, user.doorStates[0], uploadSchedule.connectedAt(), 0, uploadSchedule.holdUntil(UPLOAD_WIFI_RECON, ESP.random()));
+}
+
+void refreshHealthSnapshot(){
+  // Polled fields - door states are pushed from assessDoorState()
+  if (currentMillis < nextSnapshotMillis){
+    return;
+  }
+
+  nextSnapshotMillis = currentMillis + snapshotSampleInterval;
+  healthSnapshot.setConnection(deviceClock.toEpochMillis(uploadSchedule.connectedAt()), uploadSchedule.connectedAt());
+  healthSnapshot.setRssi(WiFi.RSSI());
+  healthSnapshot.setFreeHeap(ESP.getFreeHeap());
+  healthSnapshot.setQueueDepth(uploadQueue.depth());
 }
 
 /*
- *                GPIO Handling
+ *                Upload Dispatch
  * 
- * This section contains all code related to GPIO 
- * pins and their handling
+ *  Sends at most one queued upload per loop pass so that 
+ *  the server and door sampling are serviced in between.
  * 
  */
 
-void sendInitialDoorState(){
-  // Update the user data
-  DoorState currentState = doorIO.assessDoorState();
-  user.currentDoorState = currentState;
-  
-  if (currentState == DOOR_STATE_OPEN){
-    Serial.println("MAIN: Door status changed to OPEN");
-    sendUpdateForState(DOOR_STATE_OPEN, user.uid);
+void processUploadQueue(){
+  // Events stay queued (& keep their capture time) until the uplink can verify the server
+  if (!uplinkReady()){
+    return;
+  }
+
+  if (!uplinkReadyMarked){
+    uplinkReadyMarked = true;
+    markBootStage(BOOT_STAGE_UPLINK_READY);
+  }
+
+  UploadEvent event;
+  if (!uploadQueue.pop(&event, deviceClock.monotonicMillis())){
+    return;
+  }
+
+  uint64_t capturedAt = deviceClock.toEpochMillis(event.capturedAt);
+  uint64_t sentAt = deviceClock.epochMillis();
+
+  // Boot info & health check responses can carry settings & the device secret
+  char response[UPLINK_RESPONSE_LEN];
+  response[0] = 0;
+  int resCode = UPLINK_NOT_SENT;
+
+  switch (event.type){
+    case UPLOAD_BOOT_INFO:
+      resCode = uploadBootInfo(portNumberStr, user.uid, firmWVersion, user.gatewayIPStr, user.assignedIPStr, wifiInterface.isUsingDHCP(), user.doorStates, doorIO.channelCount, (unsigned long)event.capturedAt, supervisor.lastReset(), capturedAt, sentAt, response);
+      break;
+
+    case UPLOAD_DOOR_STATE:
+      resCode = sendUpdateForState(event.doorState, event.channel, user.uid, capturedAt, sentAt);
+      break;
+
+    case UPLOAD_HEALTH_CHECK: {
+      MemorySnapshot memory;
+      memoryProfiler.snapshot(&memory);
+      resCode = sendHealthCheckUpdate(event.capturedAt, &memory, user.uid, capturedAt, sentAt, response);
+      if (settings.applyJson(response) > 0){
+        applySettings();
+        settings.persist();
+      }
+      break;
+    }
+
+    case UPLOAD_WIFI_RECON:
+      resCode = sendReconnectionNotification(user.uid, user.assignedIPStr, wifiInterface.isUsingDHCP(), capturedAt, sentAt);
+      break;
+  }
+
+#ifndef GDOOR_CLOUD_INSECURE
+  // Only taken from a verified server, and only by a device without a secret
+  if (resCode == 200 && requestAuth.provision(&user, response)){
+    localControl.updateKey();
+    GLOG_INFO(LOG_AUTH_ENROLLED);
+  }
+#endif
+
+  // Saturated to 16 bits - anything over a minute is a timeout anyway
+  const UplinkStats* stats = uplinkStats();
+  gdoorTrace.record(TRACE_UPLOAD_RESPONSE, event.type, (uint16_t)resCode);
+  gdoorTrace.record(TRACE_UPLOAD_LATENCY, event.type, stats->lastLatencyMillis > 0xFFFF ? 0xFFFF : stats->lastLatencyMillis);
+
+  if (resCode < 200 || resCode >= 300){
+    retryUpload(&event, resCode);
+    return;
   }
 
-  else{
-    Serial.println("MAIN: Door status changed to CLOSED");
-    sendUpdateForState(DOOR_STATE_CLOSED, user.uid);
+  if (!firstReportSent){
+    firstReportSent = true;
+    markBootStage(BOOT_STAGE_FIRST_REPORT);
   }
 }
-  
+
+void retryUpload(const UploadEvent* event, int resCode){
+  // Back on the queue with backoff & its original capture time, unless retrying can't help
+  if (!GDoorUploadSchedule::shouldRetry(event->type, resCode, event->attempts)){
+    GLOG_WARN(LOG_UPLOAD_DROPPED, event->type, resCode, event->attempts + 1);
+    return;
+  }
+
+  uint64_t now = deviceClock.monotonicMillis();
+  uint64_t notBefore = GDoorUploadSchedule::retryAt(event->attempts, now, ESP.random());
+  if (uploadQueue.retry(event, notBefore)){
+    GLOG_INFO(LOG_UPLOAD_RETRY, event->type, resCode, (uint32_t)(notBefore - now));
+  }
+}
+
+/*
+ *                GPIO Handling
+ * 
+ * This section contains all code related to GPIO 
+ * pins and their handling
+ * 
+ */
+
 void assessDoorState() {
-  // Only read the pin state if the previous value was high
-  DoorState currentState = doorIO.assessDoorState();
-  if (currentState == user.currentDoorState){
+  // Non-blocking - every channel is sampled in the same pass
+  int changedChannels = doorIO.sampleDoorStates();
+  if (changedChannels == 0){
       // No update required
       return;
   }
 
-  // Update the user data
-  user.currentDoorState = currentState;
+  for (int channel = 0; channel < doorIO.channelCount; channel++){
+    if (!(changedChannels & (1 << channel))){
+      continue;
+    }
+
+    // Update the user data
+    DoorState currentState = doorIO.doorState(channel);
+    user.doorStates[channel] = currentState;
+    healthSnapshot.setDoorState(channel, currentState);
+    rules.onDoorState(channel, currentState, deviceClock.monotonicMillis());
   
-  if (currentState == DOOR_STATE_OPEN){
-    Serial.println("MAIN: Door status changed to OPEN");
-    sendUpdateForState(DOOR_STATE_OPEN, user.uid);
-  }
+    if (currentState == DOOR_STATE_OPEN){
+      GLOG_INFO(LOG_MAIN_DOOR_OPEN, channel);
+    }
 
-  else{
-    Serial.println("MAIN: Door status changed to CLOSED");
-    sendUpdateForState(DOOR_STATE_CLOSED, user.uid);
+    else{
+      GLOG_INFO(LOG_MAIN_DOOR_CLOSED, channel);
+    }
+
+    localControl.broadcastState(channel, currentState);
+    uploadQueue.push(UPLOAD_DOOR_STATE, currentState, deviceClock.monotonicMillis(), channel);
   }
 }
 
 /*
  *                  Server Setup & Handling
  * 
- *    This section contains all code related to creating a server, 
- *    managing it, and responding to requests.
- *    
- *    The code for this was meant to be in a self contained class, 
- *    but that doesn't seem to respond to http GET req.
+ *    Routing, request signing & the response buffer live in 
+ *    GDoorWebServer (src/networking/WebServer.cpp) - this section 
+ *    registers the routes and holds the handlers. Handlers are 
+ *    plain functions with a context pointer, only called for 
+ *    authorized requests, and channel is -1 on the /<uid>/ routes.
  * 
  */
 
 void serverSetup(){
-
-  // Attach listeners for all the endpoints
-  server.on("/", handleRoot);
-  server.on(actuateDoorEndpoint(), actuateDoor);
-  server.on(healthCheckEndpoint(), respondToHealthCheck);
-  server.on(forceDoorStatusCheckEndpoint(), sendDoorStatus);
-  server.on(forceHealthCheckEndpoint(), respondToForcedHealthCheck);
+  // Attach listeners for all the endpoints - channel scoped ones are also /<uid>/<channel>/<endpoint>
+  webServer.on("ActuateDoor", actuateDoor, &doorIO, true);
+  webServer.on("HealthCheck", respondToHealthCheck, &healthSnapshot);
+  webServer.on("ForceDoorStatusCheck", sendDoorStatus, &user, true);
+  webServer.on("ForceHealthCheck", respondToForcedHealthCheck, &healthSnapshot);
+  webServer.on("LogDump", sendLogDump, &gdoorLog);
+  webServer.on("Settings", handleSettings, &settings);
+  webServer.on("Diagnostics", sendDiagnostics, &memoryProfiler);
+  webServer.on("TraceDump", sendTraceDump, &gdoorTrace);
+  webServer.on("Rules", handleRules, &rules);
+  webServer.on("RotateSecret", rotateSecret, &requestAuth);
+#ifdef GDOOR_FAULT_INJECTION
+  webServer.on("InjectHang", injectHang, &supervisor);
+#endif
 
   // Start the server
-  server.begin();
+  webServer.begin(user.uid, settings.get(SETTING_PORT_NUMBER), doorIO.channelCount, &requestAuth);
 }
 
 
@@ -198,141 +462,348 @@ void serverSetup(){
  * 
  */
 
-void handleRoot() {
-  Serial.println("SERVER: Received base API req");
-  server.send(200, "text/plain", "Hello, Garage Door here. How can I help you paranoid human?");
-}
+void actuateDoor(GDoorWebServer* web, void* context, int channel){
+  // Legacy route is the first channel
+  GDoorIO* io = (GDoorIO*)context;
+  channel = (channel < 0) ? 0 : channel;
 
-void actuateDoor(){
-  Serial.println("SERVER: Recieved req to actuate the door. On it.");
-  server.send(200, "text/plain", "Hello, actuating door as per request.");
+  GLOG_INFO(LOG_SERVER_ACTUATE_REQ, channel);
+  web->send(200, "text/plain", "Hello, actuating door as per request.");
 
   // Actuate door
-  doorIO.actuateDoor();
+  io->actuateDoor(channel);
 }
 
-void respondToHealthCheck(){
-  // Respond with connection time here (time stamp)
-  Serial.println("SERVER: Received health inquery");
-  server.send(200, "text/plain", "1522963577");
+void respondToHealthCheck(GDoorWebServer* web, void* context, int channel){
+  // Door states, uptime, link & memory in one response
+  GLOG_INFO(LOG_SERVER_HEALTH_REQ);
+  sendHealthSnapshot(web, (GDoorHealthSnapshot*)context);
 }
 
-void sendDoorStatus(){
-  Serial.println("SERVER: Queried about door status");
-  const char* doorStateStr = user.currentDoorState == DOOR_STATE_OPEN ? "00" : "01";
-  server.send(200, "text/plain", doorStateStr);
+void sendDoorStatus(GDoorWebServer* web, void* context, int channel){
+  GDoorUser* deviceUser = (GDoorUser*)context;
+  channel = (channel < 0) ? 0 : channel;
+
+  GLOG_INFO(LOG_SERVER_DOOR_STATUS_REQ, channel);
+  const char* doorStateStr = deviceUser->doorStates[channel] == DOOR_STATE_OPEN ? "00" : "01";
+  web->send(200, "text/plain", doorStateStr);
 }
 
-void respondToForcedHealthCheck(){
+void respondToForcedHealthCheck(GDoorWebServer* web, void* context, int channel){
   // Nothing for now
-  Serial.println("SERVER: Received http req to update health (forced check)");
-  server.send(200, "text/plain", "1522963577");
+  GLOG_INFO(LOG_SERVER_FORCED_HEALTH_REQ);
+  sendHealthSnapshot(web, (GDoorHealthSnapshot*)context);
+}
+
+void sendHealthSnapshot(GDoorWebServer* web, GDoorHealthSnapshot* snapshot){
+  // Served from the snapshot's cache - connectedAt is 0 until the clock syncs
+  char* body = web->responseBuffer();
+  snapshot->toJson(deviceClock.monotonicMillis(), body);
+  web->send(200, "application/json", body);
+}
+
+void sendLogDump(GDoorWebServer* web, void* context, int channel){
+  // Hex encoded binary records, oldest first - decode with tools/decode_log.py
+  GDoorLog* log = (GDoorLog*)context;
+  int records = log->bufferedRecords();
+  GLOG_INFO(LOG_SERVER_LOG_DUMP_REQ, records);
+
+  uint8_t record[LOG_RECORD_WIRE_LEN];
+  sendHexRecords(web, records, LOG_RECORD_WIRE_LEN, [](void* source, int index, uint8_t* target) {
+    return ((GDoorLog*)source)->dumpRecords(index, target, 1);
+  }, log, record);
 }
 
+void sendTraceDump(GDoorWebServer* web, void* context, int channel){
+  // Hex encoded trace records, oldest first - decode & compare with tools/decode_trace.py
+  GDoorTrace* trace = (GDoorTrace*)context;
+  int records = trace->bufferedRecords();
+  GLOG_INFO(LOG_SERVER_TRACE_DUMP_REQ, records);
 
+  uint8_t record[TRACE_RECORD_WIRE_LEN];
+  sendHexRecords(web, records, TRACE_RECORD_WIRE_LEN, [](void* source, int index, uint8_t* target) {
+    return ((GDoorTrace*)source)->dumpRecords(index, target, 1);
+  }, trace, record);
+}
 
+void handleSettings(GDoorWebServer* web, void* context, int channel){
+  // GET lists the settings, args (?pulseLength=1200&...) update them - all or nothing on validation
+  GDoorSettings* deviceSettings = (GDoorSettings*)context;
+  ESP8266WebServer* request = web->request();
 
+  GLOG_INFO(LOG_SERVER_SETTINGS_REQ, request->args());
+  for (int i = 0; i < request->args(); i++){
+    SettingResult result = deviceSettings->validate(request->argName(i).c_str(), request->arg(i).toInt());
+    if (result != SETTING_OK){
+      web->send(400, "text/plain", result == SETTING_UNKNOWN_KEY ? "Unknown setting" : "Setting out of range");
+      return;
+    }
+  }
 
+  for (int i = 0; i < request->args(); i++){
+    deviceSettings->setByKey(request->argName(i).c_str(), request->arg(i).toInt());
+  }
 
+  applySettings();
+  deviceSettings->persist();
 
+  char* settingsJson = web->responseBuffer();
+  deviceSettings->toJson(settingsJson);
+  web->send(200, "application/json", settingsJson);
+}
 
+void sendDiagnostics(GDoorWebServer* web, void* context, int channel){
+  // Heap, fragmentation, loop stack & per subsystem retained bytes
+  GLOG_INFO(LOG_SERVER_DIAGNOSTICS_REQ);
+  char* report = web->responseBuffer();
+  ((GDoorMemoryProfiler*)context)->toJson(report);
+  web->send(200, "application/json", report);
+}
 
+void handleRules(GDoorWebServer* web, void* context, int channel){
+  // GET lists the compiled rules, ?program=<hex> replaces them - compile with tools/compile_rules.py
+  GDoorRules* deviceRules = (GDoorRules*)context;
+  ESP8266WebServer* request = web->request();
 
+  if (request->hasArg("program")){
+    GLOG_INFO(LOG_SERVER_RULES_REQ, request->arg("program").length());
+    RulesResult result = deviceRules->loadProgram(request->arg("program").c_str());
+    if (result != RULES_OK){
+      web->send(400, "text/plain", result == RULES_TOO_MANY ? "Too many rules" : "Invalid rule program");
+      return;
+    }
+
+    deviceRules->persist();
+  }
+
+  char* rulesJson = web->responseBuffer();
+  deviceRules->toJson(rulesJson);
+  web->send(200, "application/json", rulesJson);
+}
+
+void rotateSecret(GDoorWebServer* web, void* context, int channel){
+  // ?secret=<64 hex>, the new secret wrapped with the current one - see RequestAuth.cpp
+  GDoorRequestAuth* auth = (GDoorRequestAuth*)context;
+  ESP8266WebServer* request = web->request();
+  if (web->authResult() != AUTH_OK || !auth->rotate(&user, request->header(AUTH_HEADER_NONCE).c_str(), request->arg("secret").c_str())){
+    GLOG_WARN(LOG_AUTH_ROTATE_REFUSED, web->authResult());
+    web->send(403, "text/plain", "Rotation refused");
+    return;
+  }
+
+  localControl.updateKey();
+  GLOG_INFO(LOG_AUTH_ROTATED);
+  web->send(200, "text/plain", "Rotated");
+}
+
+#ifdef GDOOR_FAULT_INJECTION
+void injectHang(GDoorWebServer* web, void* context, int channel){
+  // Hangs in the given stage until the supervisor resets the device
+  int stage = web->request()->arg("stage").toInt();
+  if (stage < 0 || stage >= SUPERVISOR_STAGE_COUNT){
+    web->send(400, "text/plain", "Unknown stage");
+    return;
+  }
+
+  web->send(200, "text/plain", "Hanging");
+  ((GDoorSupervisor*)context)->injectHang((SupervisorStage)stage);
+}
+#endif
 
 /*
  *            * Utility methods *
  * 
  */
 
-char*  actuateDoorEndpoint(){
-  // All endpoints have the form: ~/localIP/XXXXXXXXXXXXXXXXXXXXXXXXXXXX/EndPointName 
-  // Where XXX..XXX = user UID, and EndPoint name is as expected
-  // Actuate Door end point
-  char *actuateDoorStr = "/XXXXXXXXXXXXXXXXXXXXXXXXXXXX/ActuateDoor";
-  for (int i = 0; i < strlen(actuateDoorStr); i++){
-    if (i < 28){
-      actuateDoorStr[i+1] = user.uid[i];
+void sendHexRecords(GDoorWebServer* web, int records, int recordLength, RecordDumper dump, void* source, uint8_t* record){
+  // Chunked - one hex line per record, so the dump never has to fit in RAM
+  ESP8266WebServer* request = web->request();
+  request->setContentLength(CONTENT_LENGTH_UNKNOWN);
+  request->send(200, "text/plain", "");
+
+  char* hexLine = web->responseBuffer();
+  for (int i = 0; i < records; i++){
+    if (dump(source, i, record) == 0){
+      break;
     }
 
-    else{
-      actuateDoorStr[i+1] = actuateDoorStr[i+1];
+    for (int b = 0; b < recordLength; b++){
+      sprintf(&hexLine[b * 2], "%02x", record[b]);
     }
 
-    // Serial.println(i);
+    hexLine[recordLength * 2] = '\n';
+    hexLine[(recordLength * 2) + 1] = 0;
+    request->sendContent(hexLine);
   }
 
-  Serial.print("SERVER: Registering endpoint = ");
-  Serial.println(actuateDoorStr);
-  return actuateDoorStr;
+  request->sendContent("");
 }
 
-char* healthCheckEndpoint(){
-  // Health Check
-  char* healthCheckStr = "/XXXXXXXXXXXXXXXXXXXXXXXXXXXX/HealthCheck";
-  for (int i = 0; i<29; i++){
-    if (i < 28){
-      healthCheckStr[i+1] = user.uid[i];
-    }
 
-    else{
-      healthCheckStr[i+1] = healthCheckStr[i+1];
-    }
+/*
+ *                  Hot Path Benchmarks
+ * 
+ *    Built with GDOOR_BENCHMARK only. Times the paths that run on 
+ *    every loop pass or every upload and prints JSON lines - compare 
+ *    two captures with tools/compare_bench.py. The same suite, plus 
+ *    route lookup & the request paths, runs on the host with make 
+ *    bench in test/host - keep the two in step.
+ * 
+ */
+
+#ifdef GDOOR_BENCHMARK
+void runHotPathBenchmarks(){
+  GDoorBenchmark bench(Serial);
+  bench.begin("hotpath", firmWVersion);
+  bench.run("sampleDoorStates", benchSampleDoorStates, NULL, 2000);
+  bench.run("createHttpJson", benchCreateHttpJson, NULL, 2000);
+  bench.run("createTimestampEntries", benchCreateTimestampEntries, NULL, 2000);
+  bench.run("createBootInfoJson", benchCreateBootInfoJson, NULL, 500);
+  bench.run("encodeDoorStateBinary", benchEncodeDoorStateBinary, NULL, 2000);
+  bench.run("encodeBootInfoBinary", benchEncodeBootInfoBinary, NULL, 500);
+  reportPayloadSizes(bench);
+  bench.run("createIPStrings", benchCreateIPStrings, NULL, 2000);
+  bench.run("enterStage", benchEnterStage, NULL, 2000);
+  bench.run("healthSnapshotCached", benchHealthSnapshotCached, &healthSnapshot, 2000);
+  bench.run("healthSnapshotRender", benchHealthSnapshotRender, &healthSnapshot, 2000);
+
+  // Full table (3 auto-close, 5 schedules) - nothing comes due during the run. Schedules 
+  // wait for the clock sync at this point, so rulesTick includes the sync check
+  GDoorRules benchRules;
+  benchRules.begin(&doorIO, &deviceClock);
+  benchRules.loadProgram("01000000580200000100040f0807000002000100603501000200051e784a0100020001006054000002000100100e000002000100302a000001000000201c0000");
+  bench.run("rulesTick", benchRulesTick, &benchRules, 2000);
+  bench.run("rulesOnDoorState", benchRulesOnDoorState, &benchRules, 2000);
+  bench.run("loadUserData", benchLoadUserData, NULL, 50);
+  bench.run("persistUserDataToDisk", benchPersistUserData, NULL, 4);      // Unchanged data - no flash erase
+
+  // Signature check on its own - the clock hasn't synced yet so verify() would bail early
+  GDoorUser benchUser = user;
+  strcpy(benchUser.deviceSecret, "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f");
+  benchUser.hasDeviceSecret = true;
+  GDoorRequestAuth benchAuth;
+  benchAuth.begin(&benchUser, &deviceClock);
+  bench.run("verifySignature", benchVerifySignature, &benchAuth, 500);
+  bench.end();
+}
+
+void benchSampleDoorStates(void* context){
+  // Force every channel due so the pin read & debounce run
+  for (int channel = 0; channel < doorIO.channelCount; channel++){
+    doorIO.channels[channel].lastSampleMillis = 0;
   }
 
-  Serial.print("SERVER: Registering endpoint = ");
-  Serial.println(healthCheckStr);
-  return healthCheckStr;
+  doorIO.sampleDoorStates();
 }
 
-char* forceDoorStatusCheckEndpoint(){
-  
-  char *forceDoorStatusCheckStr = "/XXXXXXXXXXXXXXXXXXXXXXXXXXXX/ForceDoorStatusCheck";
-  for (int i = 0; i<29; i++){
-    if (i < 28){
-      forceDoorStatusCheckStr[i+1] = user.uid[i];
-    }
+void benchCreateHttpJson(void* context){
+  char timestamps[TIMESTAMP_ENTRIES_LEN] = "\"capturedAt\":\"0\",\"sentAt\":\"0\"";
+  char payload[150];
+  createHttpJson("00", 0, user.uid, timestamps, payload);
+}
 
-    else{
-      forceDoorStatusCheckStr[i+1] = forceDoorStatusCheckStr[i+1];
-    }
-  }
+void benchCreateTimestampEntries(void* context){
+  char timestamps[TIMESTAMP_ENTRIES_LEN];
+  createTimestampEntries(1522963577000ULL, 1522963577250ULL, timestamps);
+}
 
-  Serial.print("SERVER: Registering endpoint = ");
-  Serial.println(forceDoorStatusCheckStr);
-  return forceDoorStatusCheckStr;
+void benchCreateBootInfoJson(void* context){
+  char timestamps[TIMESTAMP_ENTRIES_LEN] = "\"capturedAt\":\"0\",\"sentAt\":\"0\"";
+  char payload[BOOT_INFO_JSON_LEN];
+  createBootInfoJson(portNumberStr, user.uid, firmWVersion, "192.168.1.250", "192.168.1.250", false, user.doorStates, doorIO.channelCount, 0, supervisor.lastReset(), timestamps, payload);
 }
 
-char* forceHealthCheckEndpoint(){
-  // Health Check
-  char *forceHealthCheckStr = "/XXXXXXXXXXXXXXXXXXXXXXXXXXXX/ForceHealthCheck";
-  for (int i = 0; i< strlen(forceHealthCheckStr); i++){
-    if (i < 28){
-      forceHealthCheckStr[i+1] = user.uid[i];
-    }
+void benchEncodeDoorStateBinary(void* context){
+  uint8_t payload[BINARY_UPLINK_MAX_LEN];
+  encodeDoorStateBinary(1, user.uid, DOOR_STATE_OPEN, 0, 1522963577000ULL, 1522963577250ULL, payload);
+}
 
-    else{
-      forceHealthCheckStr[i+1] = forceHealthCheckStr[i+1];
-    }
-  }
+void benchEncodeBootInfoBinary(void* context){
+  uint8_t payload[BINARY_UPLINK_MAX_LEN];
+  encodeBootInfoBinary(user.uid, portNumberStr, firmWVersion, "192.168.1.250", "192.168.1.250", false, user.doorStates, doorIO.channelCount, 0, supervisor.lastReset(), 1522963577000ULL, 1522963577250ULL, payload);
+}
+
+void reportPayloadSizes(GDoorBenchmark& bench){
+  // Same events both ways - the JSON path costs createTimestampEntries + createHttpJson
+  char timestamps[TIMESTAMP_ENTRIES_LEN];
+  createTimestampEntries(1522963577000ULL, 1522963577250ULL, timestamps);
+  char json[BOOT_INFO_JSON_LEN];
+  uint8_t binary[BINARY_UPLINK_MAX_LEN];
+
+  bench.size("doorStateJson", createHttpJson("00", 0, user.uid, timestamps, json));
+  bench.size("doorStateBinary", encodeDoorStateBinary(1, user.uid, DOOR_STATE_OPEN, 0, 1522963577000ULL, 1522963577250ULL, binary));
+  bench.size("bootInfoJson", createBootInfoJson(portNumberStr, user.uid, firmWVersion, "192.168.1.250", "192.168.1.250", false, user.doorStates, doorIO.channelCount, 0, supervisor.lastReset(), timestamps, json));
+  bench.size("bootInfoBinary", encodeBootInfoBinary(user.uid, portNumberStr, firmWVersion, "192.168.1.250", "192.168.1.250", false, user.doorStates, doorIO.channelCount, 0, supervisor.lastReset(), 1522963577000ULL, 1522963577250ULL, binary));
+}
+
+void benchEnterStage(void* context){
+  // Runs 7-8 times per loop pass
+  enterStage(SUPERVISOR_STAGE_BOOT);
+}
+
+void benchHealthSnapshotCached(void* context){
+  // Poll with nothing changed - the common case
+  char body[HEALTH_SNAPSHOT_JSON_LEN];
+  ((GDoorHealthSnapshot*)context)->toJson(86400000ULL, body);
+}
 
-  Serial.print("SERVER: Registering endpoint = ");
-  Serial.println(forceHealthCheckStr);
-  return forceHealthCheckStr;
+void benchHealthSnapshotRender(void* context){
+  // A field changes before every poll - worst case, forces the re-render
+  static int rssi = -60;
+  char body[HEALTH_SNAPSHOT_JSON_LEN];
+  GDoorHealthSnapshot* snapshot = (GDoorHealthSnapshot*)context;
+  rssi = (rssi == -60) ? -61 : -60;
+  snapshot->setRssi(rssi);
+  snapshot->toJson(86400000ULL, body);
 }
 
+void benchRulesTick(void* context){
+  // Every loop pass - nothing due
+  ((GDoorRules*)context)->tick(deviceClock.monotonicMillis());
+}
+
+void benchRulesOnDoorState(void* context){
+  // Door transition - re-arms the channel's auto-close rules
+  ((GDoorRules*)context)->onDoorState(0, DOOR_STATE_OPEN, deviceClock.monotonicMillis());
+}
+
+void benchCreateIPStrings(void* context){
+  user.createIPStrings();
+}
+
+void benchLoadUserData(void* context){
+  user.loadUserData();
+}
+
+void benchPersistUserData(void* context){
+  user.persistUserDataToDisk();
+}
+
+void benchVerifySignature(void* context){
+  // Wrong signature - comparison is constant time so the cost is the same as a pass
+  GDoorRequestAuth* auth = (GDoorRequestAuth*)context;
+  auth->verifySignature("GET", "/0000000000000000000000000000/0/ActuateDoor", "", "0123456789abcdef", "1522963577", 
+    "00112233445566778899aabbccddeeff00112233445566778899aabbccddeeff");
+}
+#endif
+
 
 /*      Testing Endpoints
  *  
  *  Remote test: {Remote IP}:6969/endpoint
- *  1. 192.143.147.232:6969/k4ozP54JHab6NrK8UU8HbskopPH3/ActuateDoor
- *  - 192.143.10.217:6969/k4ozP54JHab6NrK8UU8HbskopPH3/ActuateDoor
+ *  1. {Remote IP}:6969/<uid>/ActuateDoor
+ *  
+ *  1. 10.0.1.41/<uid>/ActuateDoor
+ *  2. 10.0.1.41/<uid>/HealthCheck
+ *  3. 10.0.1.41/<uid>/ForceDoorStatusCheck
+ *  4. 10.0.1.41/<uid>/ForceHealthCheck
+ *  5. 10.0.1.41/<uid>/0/ActuateDoor
  *  
- *  1. 10.0.1.41/k4ozP54JHab6NrK8UU8HbskopPH3/ActuateDoor                 || 
- *  2. 10.0.1.41/2XsXatJ4DgdltTMcIcrC146aUNZ2/HealthCheck
- *  3. 10.0.1.41/2XsXatJ4DgdltTMcIcrC146aUNZ2/ForceDoorStatusCheck
- *  4. 10.0.1.41/2XsXatJ4DgdltTMcIcrC146aUNZ2/ForceHealthCheck
+ *  6. 10.0.1.41/<uid>/RotateSecret?secret=<64 hex, wrapped> (sign_request.py --rotate)
  *  
- *  Error: 10.0.1.41/XsXatJ4DgdltTMcIcrC146aUNZ2    http://hailmary.local
+ *  Provisioned devices also need the X-GDoor-Nonce, X-GDoor-Timestamp 
+ *  & X-GDoor-Signature headers - see src/security/RequestAuth.cpp 
+ *  and tools/sign_request.py
  *  
  */
 
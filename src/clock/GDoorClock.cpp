@@ -0,0 +1,190 @@
+/*
+*	Device clock - 64 bit monotonic millis and SNTP wall time
+*	Source file	
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+// Includes
+#include "GDoorClock.hpp"
+
+// SNTP sync callbacks are plain function pointers
+static GDoorClock* syncedClock = NULL;
+
+GDoorClock::GDoorClock(){
+  lastMillis = 0;
+  millisWraps = 0;
+  synced = false;
+  epochOffset = 0;
+  syncMonotonic = 0;
+  driftPpm = 0;
+  syncCount = 0;
+}
+
+/*
+ *                        Time Sync
+ *
+ *  SNTP runs inside lwIP - configTime() only starts it, so nothing 
+ *  here blocks. Every completed sync calls back with the new wall 
+ *  time, which is pinned against the monotonic clock. Events are 
+ *  stamped with monotonic millis when they happen and converted at 
+ *  send time, so events captured before the first sync still get 
+ *  a wall clock time once one is known.
+ *
+*/
+
+void GDoorClock::begin(){
+  syncedClock = this;
+  settimeofday_cb(timeSyncCallback);
+  configTime(0, 0, "pool.ntp.org", "time.google.com");
+}
+
+void GDoorClock::update(){
+  // Called every loop pass - keeps the wrap count current
+  monotonicMillis();
+}
+
+uint64_t GDoorClock::monotonicMillis(){
+  uint32_t now = millis();
+  if (now < lastMillis){
+    millisWraps += 1;
+  }
+
+  lastMillis = now;
+  return ((uint64_t)millisWraps << 32) | now;
+}
+
+bool GDoorClock::isSynced(){
+  return synced;
+}
+
+uint64_t GDoorClock::epochMillis(){
+  return toEpochMillis(monotonicMillis());
+}
+
+uint64_t GDoorClock::toEpochMillis(uint64_t monotonicStamp){
+  if (!synced){
+    return 0;
+  }
+
+  // Correct for the crystal drift measured between syncs
+  int64_t sinceSync = (int64_t)monotonicStamp - (int64_t)syncMonotonic;
+  int64_t driftCorrection = (sinceSync * driftPpm) / 1000000;
+  return (uint64_t)((int64_t)monotonicStamp + epochOffset + driftCorrection);
+}
+
+int GDoorClock::formatMillis(uint64_t value, char* target){
+  // Not every libc build handles %llu
+  char digits[CLOCK_MILLIS_STR_LEN];
+  int length = 0;
+  do {
+    digits[length++] = '0' + (value % 10);
+    value /= 10;
+  } while (value > 0);
+
+  for (int i = 0; i < length; i++){
+    target[i] = digits[length - 1 - i];
+  }
+
+  target[length] = 0;
+  return length;
+}
+
+/*
+ *                     Fallback Wall Time
+ *
+ *  Before SNTP has synced, the uplink still needs a rough date to 
+ *  check certificate validity against. Two sources, both only ever 
+ *  used for that: the build stamp (__DATE__ & __TIME__, a floor - 
+ *  the device can't be running before it was built) and the Date 
+ *  header of an HTTP response, e.g. "Sun, 06 Nov 1994 08:49:37 GMT".
+ *
+*/
+
+bool GDoorClock::parseHttpDate(const char* date, uint32_t* epochSecs){
+  // The weekday is skipped - the date itself says which day it was
+  const char* comma = strchr(date, ',');
+  char monthName[4];
+  char zone[4];
+  int day, year, hour, minute, second;
+  if (comma == NULL || sscanf(comma + 1, " %2d %3s %4d %2d:%2d:%2d %3s", &day, monthName, &year, &hour, &minute, &second, zone) != 7
+      || strcmp(zone, "GMT") != 0){
+    return false;
+  }
+
+  return toEpochSecs(year, monthName, day, hour, minute, second, epochSecs);
+}
+
+bool GDoorClock::parseBuildStamp(const char* date, const char* time, uint32_t* epochSecs){
+  // "Apr  5 2018" & "21:46:17" - the builder's local time, so up to a day out
+  char monthName[4];
+  int day, year, hour, minute, second;
+  if (sscanf(date, "%3s %2d %4d", monthName, &day, &year) != 3 || sscanf(time, "%2d:%2d:%2d", &hour, &minute, &second) != 3){
+    return false;
+  }
+
+  return toEpochSecs(year, monthName, day, hour, minute, second, epochSecs);
+}
+
+// Private methods
+
+bool GDoorClock::toEpochSecs(int year, const char* monthName, int day, int hour, int minute, int second, uint32_t* epochSecs){
+  static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+  static const uint16_t daysBeforeMonth[] = { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334 };
+
+  const char* found = (strlen(monthName) == 3) ? strstr(months, monthName) : NULL;
+  if (found == NULL || (found - months) % 3 != 0 || year < 1970 || year > 2105 || day < 1 || day > 31
+      || hour < 0 || hour > 23 || minute < 0 || minute > 59 || second < 0 || second > 60){
+    return false;
+  }
+
+  int month = (found - months) / 3;
+  bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+
+  // Whole years since 1970, counting the leap days before this one
+  uint32_t days = (year - 1970) * 365 + ((year - 1969) / 4) - ((year - 1901) / 100) + ((year - 1601) / 400);
+  days += daysBeforeMonth[month] + ((leap && month > 1) ? 1 : 0) + (day - 1);
+  *epochSecs = (days * 86400) + (hour * 3600) + (minute * 60) + second;
+  return true;
+}
+
+
+void GDoorClock::timeSyncCallback(){
+  if (syncedClock != NULL){
+    syncedClock->handleTimeSync();
+  }
+}
+
+void GDoorClock::handleTimeSync(){
+  struct timeval now;
+  gettimeofday(&now, NULL);
+
+  uint64_t monotonicNow = monotonicMillis();
+  uint64_t epochNow = ((uint64_t)now.tv_sec * 1000) + (now.tv_usec / 1000);
+  int64_t newOffset = (int64_t)epochNow - (int64_t)monotonicNow;
+
+  if (synced){
+    // Offset change over the window is how far millis() drifted from real time
+    uint64_t window = monotonicNow - syncMonotonic;
+    int64_t error = (int64_t)epochNow - (int64_t)toEpochMillis(monotonicNow);
+    if (window >= CLOCK_MIN_DRIFT_WINDOW){
+      int64_t measuredPpm = ((newOffset - epochOffset) * 1000000) / (int64_t)window;
+      if (measuredPpm > CLOCK_MAX_DRIFT_PPM) measuredPpm = CLOCK_MAX_DRIFT_PPM;
+      if (measuredPpm < -CLOCK_MAX_DRIFT_PPM) measuredPpm = -CLOCK_MAX_DRIFT_PPM;
+      driftPpm = (int32_t)measuredPpm;
+    }
+
+    GLOG_INFO(LOG_CLOCK_RESYNC, (uint32_t)(int32_t)error, driftPpm);
+  }
+
+  else{
+    GLOG_INFO(LOG_CLOCK_SYNCED, (uint32_t)(epochNow / 1000));
+  }
+
+  epochOffset = newOffset;
+  syncMonotonic = monotonicNow;
+  synced = true;
+  syncCount += 1;
+}
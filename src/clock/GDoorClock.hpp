@@ -0,0 +1,59 @@
+/*
+*	Device clock - 64 bit monotonic millis and SNTP wall time
+*	Header file	
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#ifndef GDoorClock_h
+#define GDoorClock_h
+
+// Includes
+#include <Arduino.h>
+#include <time.h>
+#include <sys/time.h>
+#include <coredecls.h>
+#include "../logging/GDoorLog.hpp"
+
+#define CLOCK_MAX_DRIFT_PPM 500                 // Crystal spec is well inside this
+#define CLOCK_MIN_DRIFT_WINDOW 600000ULL        // 10 mins between syncs before drift is estimated
+#define CLOCK_MILLIS_STR_LEN 21                 // Max decimal digits of a uint64 + terminator
+
+class GDoorClock {
+  public:
+    GDoorClock();
+
+    void begin();
+    void update();
+
+    // Never wraps - millis() extended to 64 bits
+    uint64_t monotonicMillis();
+
+    // Wall time in Unix millis, 0 until the first SNTP sync
+    bool isSynced();
+    uint64_t epochMillis();
+    uint64_t toEpochMillis(uint64_t monotonicStamp);
+
+    static int formatMillis(uint64_t value, char* target);
+
+    // Rough wall time before SNTP - Unix seconds, false when the text doesn't parse
+    static bool parseHttpDate(const char* date, uint32_t* epochSecs);
+    static bool parseBuildStamp(const char* date, const char* time, uint32_t* epochSecs);
+
+  private:
+    uint32_t lastMillis;
+    uint32_t millisWraps;
+    bool synced;
+    int64_t epochOffset;              // Epoch millis - monotonic millis at the last sync
+    uint64_t syncMonotonic;
+    int32_t driftPpm;
+    uint32_t syncCount;
+
+    static void timeSyncCallback();
+    static bool toEpochSecs(int year, const char* monthName, int day, int hour, int minute, int second, uint32_t* epochSecs);
+    void handleTimeSync();
+};
+
+#endif
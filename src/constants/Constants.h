@@ -16,6 +16,14 @@ typedef enum doorState {
   DOOR_STATE_CLOSED
 } DoorState;
 
+// Door channels (sensor + relay pairs) - 2 for double garage units
+#define MAX_DOOR_CHANNELS 2
+
+// RTC user memory slots (4 byte blocks) - survive resets but not power cuts
+#define RTC_SLOT_WIFI_LEASE 0
+#define RTC_SLOT_SUPERVISOR 8
+#define RTC_SLOT_SUPERVISOR_STACK 16
+
 // ASCII lookups
 // const char leftCurlyBracket = 
 
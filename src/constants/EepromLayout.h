@@ -0,0 +1,39 @@
+/*
+*	EEPROM layout - every module's region of the one 
+*   emulated EEPROM sector
+*	Header file	
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*	Each region is reserved with room to grow and never moves. A 
+*	module that outgrows its reservation fails its static_assert 
+*	at build time rather than writing over the next region.
+*
+*/
+
+#ifndef EepromLayout_h
+#define EepromLayout_h
+
+#define EEPROM_LAYOUT_SIZE 512
+
+// CRLF delimited WiFi credentials & device secret - see GDoorUser.cpp
+#define USER_DATA_EEPROM_ADDR 0
+#define USER_DATA_EEPROM_LEN 256
+
+// Compiled rule table - see GDoorRules.cpp
+#define RULES_EEPROM_ADDR 256
+#define RULES_EEPROM_LEN 96
+#define RULES_LEGACY_EEPROM_ADDR 432        // Where tables lived before this layout - moved on load
+
+// 352 - 400 unreserved
+
+// Settings registry, 4 bytes per setting - see GDoorSettings.cpp
+#define SETTINGS_EEPROM_ADDR 400
+#define SETTINGS_EEPROM_LEN 112
+
+static_assert(USER_DATA_EEPROM_ADDR + USER_DATA_EEPROM_LEN <= RULES_EEPROM_ADDR, "EEPROM: user data overlaps the rules");
+static_assert(RULES_EEPROM_ADDR + RULES_EEPROM_LEN <= SETTINGS_EEPROM_ADDR, "EEPROM: rules overlap the settings");
+static_assert(SETTINGS_EEPROM_ADDR + SETTINGS_EEPROM_LEN <= EEPROM_LAYOUT_SIZE, "EEPROM: settings run past the sector");
+
+#endif
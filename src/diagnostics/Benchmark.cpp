@@ -0,0 +1,80 @@
+/*
+*	Hot path micro benchmarks - run on the device, 
+*   results as JSON lines over serial
+*	Source file	
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+// Includes
+#include "Benchmark.hpp"
+
+/*
+ *                        Output Format
+ *
+ *  One JSON object per line, so the results can be picked out of 
+ *  a serial capture and compared with tools/compare_bench.py:
+ *
+ *    {"suite":"hotpath","fw":"1.0.0","cpuMHz":80}
+ *    {"bench":"createHttpJson","iterations":2000,"cyclesPerOp":5123,"nsPerOp":64037,"heapDelta":0}
+ *    {"suiteEnd":"hotpath","benchmarks":9}
+ *
+ *  Cycles come from the CPU cycle counter and only cover the calls 
+ *  themselves - the yields between batches aren't counted. 
+ *  heapDelta is free heap lost across the run (leaks show as > 0).
+ *
+*/
+
+GDoorBenchmark::GDoorBenchmark(Stream& outputStream) : output(outputStream){
+  suiteName = "";
+  benchmarksRun = 0;
+}
+
+void GDoorBenchmark::begin(const char* suite, const char* firmwareVersion){
+  suiteName = suite;
+  benchmarksRun = 0;
+  output.printf("{\"suite\":\"%s\",\"fw\":\"%s\",\"cpuMHz\":%u}\n", suite, firmwareVersion, ESP.getCpuFreqMHz());
+}
+
+void GDoorBenchmark::run(const char* name, BenchmarkFunction function, void* context, int iterations){
+  // Warm up - first call pays for cache misses from flash
+  function(context);
+
+  uint32_t freeHeapBefore = ESP.getFreeHeap();
+  uint64_t totalCycles = 0;
+  int completed = 0;
+
+  while (completed < iterations){
+    int batch = iterations - completed;
+    if (batch > BENCHMARK_BATCH){
+      batch = BENCHMARK_BATCH;
+    }
+
+    uint32_t startCycles = ESP.getCycleCount();
+    for (int i = 0; i < batch; i++){
+      function(context);
+    }
+
+    totalCycles += ESP.getCycleCount() - startCycles;
+    completed += batch;
+    yield();
+  }
+
+  int32_t heapDelta = (int32_t)freeHeapBefore - (int32_t)ESP.getFreeHeap();
+  uint32_t cyclesPerOp = totalCycles / iterations;
+  uint32_t nsPerOp = (uint32_t)((totalCycles * 1000) / ((uint64_t)iterations * ESP.getCpuFreqMHz()));
+
+  output.printf("{\"bench\":\"%s\",\"iterations\":%d,\"cyclesPerOp\":%u,\"nsPerOp\":%u,\"heapDelta\":%d}\n", name, iterations, cyclesPerOp, nsPerOp, heapDelta);
+  benchmarksRun += 1;
+}
+
+void GDoorBenchmark::size(const char* name, int bytes){
+  // Payload sizes next to the timings - not compared, just reported
+  output.printf("{\"size\":\"%s\",\"bytes\":%d}\n", name, bytes);
+}
+
+void GDoorBenchmark::end(){
+  output.printf("{\"suiteEnd\":\"%s\",\"benchmarks\":%d}\n", suiteName, benchmarksRun);
+}
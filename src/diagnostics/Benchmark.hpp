@@ -0,0 +1,36 @@
+/*
+*	Hot path micro benchmarks - run on the device, 
+*   results as JSON lines over serial
+*	Header file	
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#ifndef Benchmark_h
+#define Benchmark_h
+
+// Includes
+#include <Arduino.h>
+
+#define BENCHMARK_BATCH 64                // Calls between yields (keeps the soft WDT fed)
+
+typedef void (*BenchmarkFunction)(void* context);
+
+class GDoorBenchmark {
+  public:
+    GDoorBenchmark(Stream& output);
+
+    void begin(const char* suite, const char* firmwareVersion);
+    void run(const char* name, BenchmarkFunction function, void* context, int iterations);
+    void size(const char* name, int bytes);
+    void end();
+
+  private:
+    Stream& output;
+    const char* suiteName;
+    int benchmarksRun;
+};
+
+#endif
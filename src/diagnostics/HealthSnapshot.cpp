@@ -0,0 +1,126 @@
+/*
+*	Live device state for the health check endpoints - 
+*   kept current field by field, rendered on demand
+*	Source file	
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+// Includes
+#include "HealthSnapshot.hpp"
+
+/*
+ *                        Snapshot Format
+ *
+ *  One poll answers what used to take a health check plus a door 
+ *  status request per channel:
+ *
+ *    {"uptime":"86400000","fw":"1.0.0","doorStates":["00","01"],
+ *     "connectedAt":"1522963577000","connectedUptime":"4210",
+ *     "rssi":-61,"freeHeap":30464,"queueDepth":0}
+ *
+ *  Door states use the upload encoding (00 open, 01 closed). The 
+ *  64 bit values are strings, as in the uploads.
+ *
+ *  Fields are pushed in as they change and the body after uptime is 
+ *  only re-rendered when one of them did, so serving a poll is a 
+ *  uint64 format and a copy. Free heap moves by a few bytes between 
+ *  samples, so it's rounded down to HEALTH_SNAPSHOT_HEAP_QUANTUM - 
+ *  otherwise every once a second sample would throw the cache away.
+ *
+*/
+
+GDoorHealthSnapshot::GDoorHealthSnapshot(){
+  firmware = "";
+  channelCount = 0;
+  for (int i = 0; i < MAX_DOOR_CHANNELS; i++){
+    doorStates[i] = DOOR_STATE_CLOSED;
+  }
+
+  connectedAtMillis = 0;
+  connectedUptimeMillis = 0;
+  rssiDbm = 0;
+  freeHeapBytes = 0;
+  queueDepth = 0;
+  cachedLength = 0;
+  stale = true;
+}
+
+void GDoorHealthSnapshot::begin(const char* firmwareVersion, int doorChannels){
+  firmware = firmwareVersion;
+  channelCount = doorChannels;
+  stale = true;
+}
+
+void GDoorHealthSnapshot::setDoorState(int channel, DoorState state){
+  if (doorStates[channel] != state){
+    doorStates[channel] = state;
+    stale = true;
+  }
+}
+
+void GDoorHealthSnapshot::setConnection(uint64_t connectedAt, uint64_t connectedUptime){
+  if (connectedAtMillis != connectedAt || connectedUptimeMillis != connectedUptime){
+    connectedAtMillis = connectedAt;
+    connectedUptimeMillis = connectedUptime;
+    stale = true;
+  }
+}
+
+void GDoorHealthSnapshot::setRssi(int rssi){
+  if (rssiDbm != rssi){
+    rssiDbm = rssi;
+    stale = true;
+  }
+}
+
+void GDoorHealthSnapshot::setFreeHeap(uint32_t freeHeap){
+  freeHeap &= ~(uint32_t)(HEALTH_SNAPSHOT_HEAP_QUANTUM - 1);
+  if (freeHeapBytes != freeHeap){
+    freeHeapBytes = freeHeap;
+    stale = true;
+  }
+}
+
+void GDoorHealthSnapshot::setQueueDepth(int depth){
+  if (queueDepth != depth){
+    queueDepth = depth;
+    stale = true;
+  }
+}
+
+int GDoorHealthSnapshot::toJson(uint64_t uptimeMillis, char* target){
+  if (stale){
+    render();
+  }
+
+  char uptimeStr[CLOCK_MILLIS_STR_LEN];
+  GDoorClock::formatMillis(uptimeMillis, uptimeStr);
+  int length = sprintf(target, "{\"uptime\":\"%s\",", uptimeStr);
+
+  // Cached body carries its own closing brace & terminator
+  memcpy(&target[length], cached, cachedLength + 1);
+  return length + cachedLength;
+}
+
+// Private methods
+
+void GDoorHealthSnapshot::render(){
+  char connectedAtStr[CLOCK_MILLIS_STR_LEN];
+  char connectedUptimeStr[CLOCK_MILLIS_STR_LEN];
+  GDoorClock::formatMillis(connectedAtMillis, connectedAtStr);
+  GDoorClock::formatMillis(connectedUptimeMillis, connectedUptimeStr);
+
+  char doorStatesStr[(MAX_DOOR_CHANNELS * 5) + 1];
+  int index = 0;
+  doorStatesStr[0] = 0;
+  for (int i = 0; i < channelCount; i++){
+    index += sprintf(&doorStatesStr[index], "%s\"%s\"", (i > 0) ? "," : "", (doorStates[i] == DOOR_STATE_OPEN) ? "00" : "01");
+  }
+
+  cachedLength = sprintf(cached, "\"fw\":\"%s\",\"doorStates\":[%s],\"connectedAt\":\"%s\",\"connectedUptime\":\"%s\",\"rssi\":%d,\"freeHeap\":%u,\"queueDepth\":%d}", 
+    firmware, doorStatesStr, connectedAtStr, connectedUptimeStr, rssiDbm, freeHeapBytes, queueDepth);
+  stale = false;
+}
@@ -0,0 +1,55 @@
+/*
+*	Live device state for the health check endpoints - 
+*   kept current field by field, rendered on demand
+*	Header file	
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#ifndef HealthSnapshot_h
+#define HealthSnapshot_h
+
+// Includes
+#include <Arduino.h>
+#include "../constants/Constants.h"
+#include "../clock/GDoorClock.hpp"
+
+#define HEALTH_SNAPSHOT_JSON_LEN 256
+#define HEALTH_SNAPSHOT_HEAP_QUANTUM 256  // Power of 2 - free heap is reported rounded down to it
+
+class GDoorHealthSnapshot {
+  public:
+    GDoorHealthSnapshot();
+
+    void begin(const char* firmwareVersion, int doorChannels);
+
+    // Setters only invalidate the cached render when the value actually changed
+    void setDoorState(int channel, DoorState state);
+    void setConnection(uint64_t connectedAt, uint64_t connectedUptime);
+    void setRssi(int rssi);
+    void setFreeHeap(uint32_t freeHeap);
+    void setQueueDepth(int depth);
+
+    // Uptime is spliced in per call - everything else comes from the cache
+    int toJson(uint64_t uptimeMillis, char* target);
+
+  private:
+    const char* firmware;
+    int channelCount;
+    DoorState doorStates[MAX_DOOR_CHANNELS];
+    uint64_t connectedAtMillis;           // Epoch millis, 0 until the clock syncs
+    uint64_t connectedUptimeMillis;       // Monotonic millis when the link came up
+    int rssiDbm;
+    uint32_t freeHeapBytes;
+    int queueDepth;
+
+    char cached[HEALTH_SNAPSHOT_JSON_LEN];
+    int cachedLength;
+    bool stale;
+
+    void render();
+};
+
+#endif
@@ -0,0 +1,91 @@
+/*
+*	Heap & stack profiler - per subsystem heap deltas, 
+*   low water marks and fragmentation
+*	Source file	
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+// Includes
+#include "MemoryProfiler.hpp"
+
+/*
+ *                        Heap Attribution
+ *
+ *  Every loop step runs between two enter() calls, so the change in 
+ *  free heap across a step is what that subsystem kept - Strings it 
+ *  didn't release, an HTTPClient that grew a buffer. Summed since boot 
+ *  that's the site's live bytes; a site whose total keeps climbing 
+ *  over days is the leak. Ticker callbacks only run while the loop 
+ *  yields, so their allocations land on whichever site yielded.
+ *
+ *  enter() only reads the free heap counter. Largest free block and 
+ *  fragmentation walk the heap and are left to snapshot(), which runs 
+ *  on the health ping and the diagnostics endpoint.
+ *
+*/
+
+const char* const memorySiteNames[MEMORY_SITE_COUNT] = {
+  "boot", "clock", "doorSample", "server", "localControl", "healthCheck", "upload", "logDrain", "wifiRecon"
+};
+
+GDoorMemoryProfiler::GDoorMemoryProfiler(){
+  memset(sites, 0, sizeof(sites));
+  currentSite = SUPERVISOR_STAGE_BOOT;
+  siteStartFree = 0;
+  bootFreeHeap = 0;
+  minFreeHeap = 0;
+}
+
+void GDoorMemoryProfiler::begin(){
+  bootFreeHeap = ESP.getFreeHeap();
+  minFreeHeap = bootFreeHeap;
+  siteStartFree = bootFreeHeap;
+  currentSite = SUPERVISOR_STAGE_BOOT;
+  ESP.resetFreeContStack();
+}
+
+void GDoorMemoryProfiler::enter(int site){
+  // Close out the previous site
+  uint32_t freeHeap = ESP.getFreeHeap();
+  int32_t retained = (int32_t)siteStartFree - (int32_t)freeHeap;
+  MemorySite* previous = &sites[currentSite];
+  previous->calls += 1;
+  previous->retainedBytes += retained;
+  if (retained > previous->worstRetain){
+    previous->worstRetain = retained;
+  }
+
+  if (freeHeap < minFreeHeap){
+    minFreeHeap = freeHeap;
+  }
+
+  currentSite = site;
+  siteStartFree = freeHeap;
+}
+
+void GDoorMemoryProfiler::snapshot(MemorySnapshot* target){
+  target->freeHeap = ESP.getFreeHeap();
+  target->minFreeHeap = (target->freeHeap < minFreeHeap) ? target->freeHeap : minFreeHeap;
+  target->maxFreeBlock = ESP.getMaxFreeBlockSize();
+  target->fragmentation = ESP.getHeapFragmentation();
+  target->freeContStack = ESP.getFreeContStack();
+}
+
+int GDoorMemoryProfiler::toJson(char* target){
+  MemorySnapshot current;
+  snapshot(&current);
+
+  int index = sprintf(target, "{\"bootFreeHeap\":%u,\"freeHeap\":%u,\"minFreeHeap\":%u,\"maxFreeBlock\":%u,\"heapFragmentation\":%u,\"freeContStack\":%u,\"sites\":{", 
+    bootFreeHeap, current.freeHeap, current.minFreeHeap, current.maxFreeBlock, current.fragmentation, current.freeContStack);
+
+  for (int i = 0; i < MEMORY_SITE_COUNT; i++){
+    index += sprintf(&target[index], "%s\"%s\":{\"calls\":%u,\"retained\":%d,\"worst\":%d}", 
+      (i > 0) ? "," : "", memorySiteNames[i], sites[i].calls, sites[i].retainedBytes, sites[i].worstRetain);
+  }
+
+  index += sprintf(&target[index], "}}");
+  return index;
+}
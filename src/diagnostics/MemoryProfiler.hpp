@@ -0,0 +1,56 @@
+/*
+*	Heap & stack profiler - per subsystem heap deltas, 
+*   low water marks and fragmentation
+*	Header file	
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#ifndef MemoryProfiler_h
+#define MemoryProfiler_h
+
+// Includes
+#include <Arduino.h>
+#include "../logging/GDoorLog.hpp"
+#include "Supervisor.hpp"
+
+#define MEMORY_REPORT_JSON_LEN 1024
+
+// Sites are the supervisor's loop stages - every loop step is already marked
+#define MEMORY_SITE_COUNT SUPERVISOR_STAGE_COUNT
+
+typedef struct memorySite {
+  uint32_t calls;
+  int32_t retainedBytes;          // Net heap taken by the site since boot (negative = released)
+  int32_t worstRetain;            // Largest single pass retain
+} MemorySite;
+
+// Point in time view - the heap walk makes this too slow for every loop pass
+typedef struct memorySnapshot {
+  uint32_t freeHeap;
+  uint32_t minFreeHeap;           // Low water mark, sampled at every site change
+  uint32_t maxFreeBlock;
+  uint32_t fragmentation;         // Percent
+  uint32_t freeContStack;         // Loop stack high water mark (bytes never touched)
+} MemorySnapshot;
+
+class GDoorMemoryProfiler {
+  public:
+    GDoorMemoryProfiler();
+
+    void begin();
+    void enter(int site);
+    void snapshot(MemorySnapshot* target);
+    int toJson(char* target);
+
+  private:
+    MemorySite sites[MEMORY_SITE_COUNT];
+    int currentSite;
+    uint32_t siteStartFree;
+    uint32_t bootFreeHeap;
+    uint32_t minFreeHeap;
+};
+
+#endif
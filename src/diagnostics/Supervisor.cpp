@@ -0,0 +1,226 @@
+/*
+*	Software watchdog - per stage deadlines on the main 
+*   loop, fault capture in RTC memory & self reset
+*	Source file	
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+// Includes
+#include "Supervisor.hpp"
+
+// The loop's continuation - defined by the core
+extern cont_t* g_pcont;
+
+/*
+ *                        Stage Deadlines
+ *
+ *  The loop marks the stage it's in before each step. A 1s ticker 
+ *  compares the time spent in the current stage to its deadline and 
+ *  resets the device when it's overrun - a hung POST or an endless 
+ *  WiFi wait now costs seconds to minutes instead of a power cycle.
+ *
+ *  Tickers run in the SDK context, i.e. whenever the loop yields 
+ *  (delay, network waits). A loop that stops yielding altogether is 
+ *  caught by the SDK's own soft WDT instead - the record written on 
+ *  the last tick still tells us which stage it was in.
+ *
+ *  The relay pulse has its own backstop: a relay still held 1s past 
+ *  its pulse length is released from the tick.
+ *
+ *  The tick can't unwind the loop's stack - it runs on the SDK's own 
+ *  stack, so its registers say nothing about the loop. But the tick 
+ *  only runs while the loop is suspended at a yield, and the core 
+ *  keeps that yield point's sp in g_pcont. An overrun copies the 
+ *  words from there into RTC memory and the next boot logs them: 
+ *  the 0x40xxxxxx ones are return addresses into the hung wait, for 
+ *  the exception decoder (addr2line) with the matching .elf.
+ *
+*/
+
+const uint32_t supervisorDeadlines[SUPERVISOR_STAGE_COUNT] = {
+  300000,     // Boot - includes waiting for the AP
+  10000,      // Clock
+  10000,      // Door sample
+  10000,      // Server - client timeouts are 5s
+  10000,      // Local control
+  10000,      // Health check
+  30000,      // Upload - TLS handshake plus the HTTP timeout, with margin
+  10000,      // Log drain
+  120000      // WiFi recon - bounded waits plus a DHCP fallback
+};
+
+GDoorSupervisor::GDoorSupervisor(){
+  io = NULL;
+  currentStage = SUPERVISOR_STAGE_BOOT;
+  stageStartedMillis = 0;
+  stageTrail = SUPERVISOR_STAGE_BOOT;
+  resetting = false;
+  hangInjected = false;
+  memset(&report, 0, sizeof(report));
+  memset(&stack, 0, sizeof(stack));
+}
+
+void GDoorSupervisor::begin(GDoorIO* doorIO){
+  io = doorIO;
+  readPreviousReset();
+  GLOG_INFO(LOG_SUPERVISOR_RESET_REASON, report.resetReason, report.exceptionCause, report.exceptionAddress);
+  if (report.fault != SUPERVISOR_FAULT_NONE){
+    GLOG_WARN(LOG_SUPERVISOR_PREVIOUS_FAULT, report.fault, report.stage, report.stageMillis);
+    logPreviousStack();
+  }
+
+  setStage(SUPERVISOR_STAGE_BOOT);
+  tickTimer.attach_ms(SUPERVISOR_TICK_MS, tick, this);
+}
+
+void GDoorSupervisor::setStage(SupervisorStage stage){
+  // Hot path - a few stores per loop step
+  stageStartedMillis = millis();
+  if (stage != currentStage){
+    stageTrail = (stageTrail << 8) | stage;
+    currentStage = stage;
+  }
+}
+
+const ResetReport* GDoorSupervisor::lastReset(){
+  return &report;
+}
+
+const SupervisorStack* GDoorSupervisor::lastStack(){
+  return (stack.magic == SUPERVISOR_STACK_MAGIC) ? &stack : NULL;
+}
+
+#ifdef GDOOR_FAULT_INJECTION
+void GDoorSupervisor::injectHang(SupervisorStage stage){
+  // Yielding hang - exactly what a stuck network wait looks like
+  GLOG_WARN(LOG_SUPERVISOR_INJECT, stage);
+  hangInjected = true;
+  setStage(stage);
+  while (true){
+    delay(100);
+  }
+}
+#endif
+
+// Tick
+
+void GDoorSupervisor::tick(GDoorSupervisor* supervisor){
+  supervisor->check();
+}
+
+void GDoorSupervisor::check(){
+  if (resetting){
+    return;
+  }
+
+  if (io != NULL && io->releaseOverduePulses(SUPERVISOR_RELAY_GRACE) > 0){
+    GLOG_ERROR(LOG_SUPERVISOR_RELAY_RELEASED);
+  }
+
+  uint32_t stageMillis = millis() - stageStartedMillis;
+  if (stageMillis <= supervisorDeadlines[currentStage]){
+    writeRecord(SUPERVISOR_FAULT_NONE, stageMillis);
+    return;
+  }
+
+  // Deadline overrun - record why, then reset (system_restart is safe from the SDK context)
+  resetting = true;
+  writeRecord(hangInjected ? SUPERVISOR_FAULT_INJECTED : SUPERVISOR_FAULT_DEADLINE, stageMillis);
+  writeStack();
+  GLOG_ERROR(LOG_SUPERVISOR_DEADLINE, currentStage, stageMillis);
+  gdoorLog.drain(Serial, LOG_RING_CAPACITY);
+  system_restart();
+}
+
+// RTC record
+
+void GDoorSupervisor::writeRecord(SupervisorFault fault, uint32_t stageMillis){
+  SupervisorRecord record;
+  record.magic = SUPERVISOR_MAGIC;
+  record.fault = fault;
+  record.stage = currentStage;
+  record.stageMillis = stageMillis;
+  record.uptimeMillis = millis();
+  record.freeContStack = ESP.getFreeContStack();
+  record.stageTrail = stageTrail;
+  record.checksum = recordChecksum((const uint32_t*)&record, sizeof(record) / 4);
+  ESP.rtcUserMemoryWrite(RTC_SLOT_SUPERVISOR, (uint32_t*)&record, sizeof(record));
+}
+
+void GDoorSupervisor::writeStack(){
+  SupervisorStack snapshot;
+  memset(&snapshot, 0, sizeof(snapshot));
+  snapshot.magic = SUPERVISOR_STACK_MAGIC;
+
+  // sp outside the loop's stack - no yield recorded yet, nothing to copy
+  const unsigned* sp = g_pcont->sp_yield;
+  if (sp >= g_pcont->stack && sp < g_pcont->stack_end){
+    snapshot.stackPointer = (uint32_t)(uintptr_t)sp;
+    snapshot.wordCount = g_pcont->stack_end - sp;
+    if (snapshot.wordCount > SUPERVISOR_STACK_WORDS){
+      snapshot.wordCount = SUPERVISOR_STACK_WORDS;
+    }
+
+    for (uint32_t i = 0; i < snapshot.wordCount; i++){
+      snapshot.words[i] = sp[i];
+    }
+  }
+
+  snapshot.checksum = recordChecksum((const uint32_t*)&snapshot, sizeof(snapshot) / 4);
+  ESP.rtcUserMemoryWrite(RTC_SLOT_SUPERVISOR_STACK, (uint32_t*)&snapshot, sizeof(snapshot));
+}
+
+void GDoorSupervisor::readPreviousReset(){
+  rst_info* resetInfo = ESP.getResetInfoPtr();
+  report.resetReason = resetInfo->reason;
+  report.exceptionCause = resetInfo->exccause;
+  report.exceptionAddress = resetInfo->epc1;
+
+  SupervisorRecord record;
+  bool readOK = ESP.rtcUserMemoryRead(RTC_SLOT_SUPERVISOR, (uint32_t*)&record, sizeof(record));
+  if (!readOK || record.magic != SUPERVISOR_MAGIC || record.checksum != recordChecksum((const uint32_t*)&record, sizeof(record) / 4)){
+    return;
+  }
+
+  report.fault = record.fault;
+  report.stage = record.stage;
+  report.stageMillis = record.stageMillis;
+  report.freeContStack = record.freeContStack;
+  report.stageTrail = record.stageTrail;
+
+  // Only written at an overrun - an older snapshot doesn't belong to a clean run's reset
+  if (record.fault == SUPERVISOR_FAULT_NONE){
+    return;
+  }
+
+  SupervisorStack snapshot;
+  readOK = ESP.rtcUserMemoryRead(RTC_SLOT_SUPERVISOR_STACK, (uint32_t*)&snapshot, sizeof(snapshot));
+  if (readOK && snapshot.magic == SUPERVISOR_STACK_MAGIC && snapshot.checksum == recordChecksum((const uint32_t*)&snapshot, sizeof(snapshot) / 4)
+    && snapshot.wordCount <= SUPERVISOR_STACK_WORDS){
+    stack = snapshot;
+  }
+}
+
+void GDoorSupervisor::logPreviousStack(){
+  if (lastStack() == NULL){
+    return;
+  }
+
+  GLOG_WARN(LOG_SUPERVISOR_STACK, stack.stackPointer, stack.wordCount);
+  for (uint32_t i = 0; i < stack.wordCount; i += 3){
+    GLOG_WARN(LOG_SUPERVISOR_STACK_WORDS, i * 4, stack.words[i], stack.words[i + 1], stack.words[i + 2]);
+  }
+}
+
+// Over every word but the trailing checksum
+uint32_t GDoorSupervisor::recordChecksum(const uint32_t* words, int count){
+  uint32_t sum = 0x5A5A5A5A;
+  for (int i = 0; i < count - 1; i++){
+    sum = (sum ^ words[i]) * 16777619UL;
+  }
+
+  return sum;
+}
@@ -0,0 +1,118 @@
+/*
+*	Software watchdog - per stage deadlines on the main 
+*   loop, fault capture in RTC memory & self reset
+*	Header file	
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#ifndef Supervisor_h
+#define Supervisor_h
+
+// Includes
+#include <Arduino.h>
+#include <Ticker.h>
+#include "../constants/Constants.h"
+#include "../logging/GDoorLog.hpp"
+#include "../digital-io/GDoorIO.hpp"
+
+extern "C" {
+#include <user_interface.h>
+}
+#include <cont.h>
+
+#define SUPERVISOR_TICK_MS 1000
+#define SUPERVISOR_RELAY_GRACE 1000           // Millis a relay may overrun its pulse
+#define SUPERVISOR_MAGIC 0x47445331           // "GDS1"
+#define SUPERVISOR_STACK_MAGIC 0x47444B31     // "GDK1"
+#define SUPERVISOR_STACK_WORDS 12             // Loop stack words kept from the overrun - 3 per log line
+
+// Loop stages - each has its own deadline in Supervisor.cpp
+typedef enum supervisorStage {
+  SUPERVISOR_STAGE_BOOT,
+  SUPERVISOR_STAGE_CLOCK,
+  SUPERVISOR_STAGE_DOOR_SAMPLE,
+  SUPERVISOR_STAGE_SERVER,
+  SUPERVISOR_STAGE_LOCAL_CONTROL,
+  SUPERVISOR_STAGE_HEALTH_CHECK,
+  SUPERVISOR_STAGE_UPLOAD,
+  SUPERVISOR_STAGE_LOG_DRAIN,
+  SUPERVISOR_STAGE_WIFI_RECON,
+  SUPERVISOR_STAGE_COUNT
+} SupervisorStage;
+
+typedef enum supervisorFault {
+  SUPERVISOR_FAULT_NONE,
+  SUPERVISOR_FAULT_DEADLINE,            // A stage overran - the supervisor reset the device
+  SUPERVISOR_FAULT_INJECTED
+} SupervisorFault;
+
+// Written to RTC memory every tick - what the loop was doing when the device went down
+typedef struct supervisorRecord {
+  uint32_t magic;
+  uint32_t fault;
+  uint32_t stage;
+  uint32_t stageMillis;                 // Time spent in the stage so far
+  uint32_t uptimeMillis;
+  uint32_t freeContStack;               // Loop stack high water mark
+  uint32_t stageTrail;                  // Last 4 distinct stages, newest in the low byte
+  uint32_t checksum;
+} SupervisorRecord;
+
+// Written once, at an overrun - the loop's stack from where it last yielded
+typedef struct supervisorStack {
+  uint32_t magic;
+  uint32_t stackPointer;                // Loop sp at its last yield
+  uint32_t wordCount;
+  uint32_t words[SUPERVISOR_STACK_WORDS];
+  uint32_t checksum;
+} SupervisorStack;
+
+// Reported in the next boot info upload
+typedef struct resetReport {
+  uint32_t resetReason;                 // rst_info reason - 0 power on, 1 HW WDT, 2 exception, 3 soft WDT, 4 restart
+  uint32_t exceptionCause;
+  uint32_t exceptionAddress;            // epc1
+  uint32_t fault;
+  uint32_t stage;
+  uint32_t stageMillis;
+  uint32_t freeContStack;
+  uint32_t stageTrail;
+} ResetReport;
+
+class GDoorSupervisor {
+  public:
+    GDoorSupervisor();
+
+    void begin(GDoorIO* io);
+    void setStage(SupervisorStage stage);
+    const ResetReport* lastReset();
+    const SupervisorStack* lastStack();   // NULL unless the last reset was an overrun with a snapshot
+
+#ifdef GDOOR_FAULT_INJECTION
+    void injectHang(SupervisorStage stage);
+#endif
+
+  private:
+    GDoorIO* io;
+    Ticker tickTimer;
+    ResetReport report;
+    SupervisorStack stack;
+    volatile uint32_t currentStage;
+    volatile uint32_t stageStartedMillis;
+    volatile uint32_t stageTrail;
+    bool resetting;
+    bool hangInjected;
+
+    static void tick(GDoorSupervisor* supervisor);
+    void check();
+    void writeRecord(SupervisorFault fault, uint32_t stageMillis);
+    void writeStack();
+    void readPreviousReset();
+    void logPreviousStack();
+    static uint32_t recordChecksum(const uint32_t* words, int count);
+};
+
+#endif
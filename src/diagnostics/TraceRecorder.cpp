@@ -0,0 +1,79 @@
+/*
+*	Input trace recorder - timestamped binary ring of 
+*   everything that drives the firmware from outside
+*	Source file	
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+// Includes
+#include "TraceRecorder.hpp"
+
+GDoorTrace gdoorTrace;
+
+/*
+ *                        Trace Format
+ *
+ *  Field problems (missed transitions, slow actuations, reconnect 
+ *  storms) come down to what the sensor saw and when. Every input is 
+ *  recorded as it arrives - raw sensor pin edges, WiFi status changes, 
+ *  HTTP & LAN requests, upload results - alongside the outputs they 
+ *  cause (debounced states, relay pulses), so latency between the two 
+ *  can be measured from a dump.
+ *
+ *  The door path can be replayed: sensor edges plus the debounce 
+ *  config in force are enough to drive GDoorIO again, which 
+ *  test/host/replay_trace does on the host. Requests, WiFi and 
+ *  uploads are recorded by outcome only (route, auth result, status), 
+ *  not payload - they're observations for latency, not replay input.
+ *
+ *  Wire format per record, little endian:
+ *    0-3   millis
+ *    4     type
+ *    5     arg
+ *    6-7   value
+ *
+ *  Served as hex by /<uid>/TraceDump - tools/decode_trace.py prints 
+ *  the timeline and compares two captures.
+ *
+*/
+
+int GDoorTrace::dumpRecords(int startRecord, uint8_t* target, int maxRecords){
+  int written = 0;
+
+  for (int i = startRecord; i < (int)count && written < maxRecords; i++){
+    const TraceRecord* entry = &records[(head - count + i) & (TRACE_RING_CAPACITY - 1)];
+    uint8_t* out = &target[written * TRACE_RECORD_WIRE_LEN];
+
+    for (int b = 0; b < 4; b++){
+      out[b] = (entry->millis >> (8 * b)) & 0xFF;
+    }
+
+    out[4] = entry->type;
+    out[5] = entry->arg;
+    out[6] = entry->value & 0xFF;
+    out[7] = (entry->value >> 8) & 0xFF;
+    written += 1;
+  }
+
+  return written;
+}
+
+int GDoorTrace::bufferedRecords(){
+  return count;
+}
+
+uint16_t GDoorTrace::routeHash(const char* uri){
+  const char* segment = strrchr(uri, '/');
+  segment = (segment == NULL) ? uri : segment + 1;
+
+  uint32_t hash = 2166136261UL;
+  for (int i = 0; segment[i] != 0; i++){
+    hash ^= (uint8_t)segment[i];
+    hash *= 16777619UL;
+  }
+
+  return (hash >> 16) ^ (hash & 0xFFFF);
+}
@@ -0,0 +1,75 @@
+/*
+*	Input trace recorder - timestamped binary ring of 
+*   everything that drives the firmware from outside
+*	Header file	
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#ifndef TraceRecorder_h
+#define TraceRecorder_h
+
+// Includes
+#include <Arduino.h>
+
+#define TRACE_RING_CAPACITY 128       // Power of 2 - 1k of RAM
+#define TRACE_RECORD_WIRE_LEN 8
+
+// Append only - tools/decode_trace.py keys off these values
+typedef enum traceType {
+  TRACE_BOOT,                   // arg: reset reason
+  TRACE_GPIO_EDGE,              // arg: channel, value: pin level
+  TRACE_DOOR_STATE,             // arg: channel, value: debounced state
+  TRACE_WIFI_STATUS,            // arg: wl_status_t
+  TRACE_HTTP_REQUEST,           // arg: auth result, value: route hash
+  TRACE_LOCAL_COMMAND,          // arg: command, value: result
+  TRACE_ACTUATE,                // arg: channel
+  TRACE_UPLOAD_RESPONSE,        // arg: upload type, value: HTTP status (int16)
+  TRACE_UPLOAD_LATENCY,         // arg: upload type, value: millis (saturating)
+  TRACE_RULE_FIRED,             // arg: rule index, value: channel
+  TRACE_CHANNEL_CONFIG,         // arg: channel, value: debounce samples << 10 | interval
+  TRACE_LOCAL_LATENCY,          // arg: command, value: millis waited + handled (upper bound, saturating)
+  TRACE_BOOT_STAGE              // arg: boot stage (gdoor_esp.ino) - millis since reset
+} TraceType;
+
+typedef struct traceRecord {
+  uint32_t millis;
+  uint8_t type;
+  uint8_t arg;
+  uint16_t value;
+} TraceRecord;
+
+class GDoorTrace {
+  public:
+    // Hot path - a handful of stores
+    inline void record(uint8_t type, uint8_t arg = 0, uint16_t value = 0){
+      TraceRecord* entry = &records[head & (TRACE_RING_CAPACITY - 1)];
+      entry->millis = millis();
+      entry->type = type;
+      entry->arg = arg;
+      entry->value = value;
+      head += 1;
+
+      if (count < TRACE_RING_CAPACITY){
+        count += 1;
+      }
+    }
+
+    int dumpRecords(int startRecord, uint8_t* target, int maxRecords);
+    int bufferedRecords();
+
+    // Route id for HTTP records - FNV-1a of the last path segment, folded to 16 bits
+    static uint16_t routeHash(const char* uri);
+
+  private:
+    // Zero initialised as a static, same as the log ring
+    TraceRecord records[TRACE_RING_CAPACITY];
+    uint32_t head;
+    uint32_t count;
+};
+
+extern GDoorTrace gdoorTrace;
+
+#endif
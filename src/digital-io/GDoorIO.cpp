@@ -9,67 +9,219 @@
 
 #include "GDoorIO.hpp"
 
+// Channel table - sensor pin, relay pin, pulse length, debounce samples & interval
+static const int channelTable[][5] = {
+	{ 14, 4,  1500, 10, 100 },
+	{ 12, 13, 1500, 10, 100 }				// uPin12 & uPin13
+};
+
+static_assert(sizeof(channelTable) / sizeof(channelTable[0]) == MAX_DOOR_CHANNELS, "Every door channel needs a row in the channel table");
+
 // Implementation
 GDoorIO::GDoorIO(){
-	// Fill the constructor with something
+	for (int i = 0; i < MAX_DOOR_CHANNELS; i++){
+		configureChannel(i, channelTable[i][0], channelTable[i][1], channelTable[i][2], channelTable[i][3], channelTable[i][4]);
+	}
 }
 
 void GDoorIO::setupGPIOPins(){
-  Serial.println("Setting GPIO Pins to correct IO state");
+  GLOG_INFO(LOG_IO_SETUP);
   
-  pinMode(doorSensorPin, INPUT);
-  pinMode(relayPin, OUTPUT);
-  digitalWrite(relayPin, LOW);
+  for (int i = 0; i < channelCount; i++){
+    pinMode(channels[i].sensorPin, INPUT);
+    pinMode(channels[i].relayPin, OUTPUT);
+    digitalWrite(channels[i].relayPin, LOW);
+  }
+
   pinMode(hardResetPin, INPUT);
   pinMode(wifiLEDPin, OUTPUT);
 
   // Set the unused pins as inputs (High Z)
   pinMode(uPin16, INPUT);
-  pinMode(uPin12, INPUT);
-  pinMode(uPin13, INPUT);
   pinMode(uPin2,  INPUT);
+  if (channelCount < 2){
+    pinMode(uPin12, INPUT);
+    pinMode(uPin13, INPUT);
+  }
+}
+
+/*
+*							Channel Count
+*
+*	 How many rows of the channel table are wired - set before 
+*    setupGPIOPins(), the pins of the others are left as inputs. 
+*    A count the table can't back is refused and the current 
+*    one kept.
+*
+*/
+
+bool GDoorIO::setChannelCount(int count){
+	if (count < 1 || count > MAX_DOOR_CHANNELS){
+		GLOG_WARN(LOG_IO_CHANNELS_REFUSED, count, MAX_DOOR_CHANNELS);
+		return false;
+	}
+
+	channelCount = count;
+	return true;
 }
 
-void GDoorIO::actuateDoor(){
-	Serial.println("DOOR IO: Actuating door");
-	digitalWrite(relayPin, HIGH);
+/*
+*							Door Actuation
+*
+*	 Starts the relay pulse and returns - a timer releases the 
+*    relay after the channel's pulse length, so the pulse stays 
+*    accurate even while the loop is busy with an upload.
+*
+*/
 
-	// Wait for 1.5 seconds to properly pulse
-	delay(pulseLength);
+void GDoorIO::actuateDoor(int channel){
+	if (channel < 0 || channel >= channelCount || channels[channel].pulseActive){
+		return;
+	}
 
-	// Set pin low again
-	digitalWrite(relayPin, LOW);
-	Serial.println("DOOR IO: Completed door pulse");
+	GLOG_INFO(LOG_IO_ACTUATING, channel);
+	gdoorTrace.record(TRACE_ACTUATE, channel);
+	DoorChannel* doorChannel = &channels[channel];
+	doorChannel->pulseActive = true;
+	doorChannel->pulseStartedMillis = millis();
+	digitalWrite(doorChannel->relayPin, HIGH);
+	doorChannel->pulseTimer.once_ms(doorChannel->pulseLength, releaseRelay, doorChannel);
 }
 
 /*
 *							Door State
 *
-*	 Returns the door state as according to the pins - need to 
-*    check the pin staying high for 1 fulle second (to filter 
-*    noice and stray capacitance)
+*	 Door state per channel as according to the pins. A HIGH 
+*    sample means open straight away, closed needs the pin LOW 
+*    for a full debounce window (10 x 100ms by default) to filter 
+*    noise and stray capacitance.
+*
+*	 sampleDoorStates() never waits - every channel is checked in 
+*    the same pass and only read when its sample interval is due. 
+*    Returns a bit mask of the channels whose state changed.
 *
 */
 
-DoorState GDoorIO::assessDoorState(){
-	// Coming
-	int count = 0;
-	for (int i = 0; i < 10; i++) {
-		if(digitalRead(doorSensorPin) == HIGH){
-			return DOOR_STATE_OPEN;
+int GDoorIO::sampleDoorStates(){
+	unsigned long now = millis();
+	int changedChannels = 0;
+
+	for (int i = 0; i < channelCount; i++){
+		if (sampleChannel(&channels[i], now)){
+			changedChannels |= (1 << i);
 		}
+	}
 
-		delay(100);
+	return changedChannels;
+}
+
+void GDoorIO::settleDoorStates(){
+	// Blocking - boot only. Runs the sampler over one full debounce window
+	unsigned long longestWindow = 0;
+	for (int i = 0; i < channelCount; i++){
+		unsigned long window = (unsigned long)channels[i].debounceSamples * channels[i].debounceInterval;
+		if (window > longestWindow){
+			longestWindow = window;
+		}
 	}
 
-	return DOOR_STATE_CLOSED;
+	unsigned long start = millis();
+	while (millis() - start <= longestWindow){
+		sampleDoorStates();
+		delay(10);
+	}
+}
+
+DoorState GDoorIO::doorState(int channel){
+	return channels[channel].state;
 }
 
+void GDoorIO::setDebounce(int channel, int debounceSamples, int debounceInterval){
+	// Live - a count already past a lowered window trips on the next LOW sample
+	DoorChannel* doorChannel = &channels[channel];
+	doorChannel->debounceSamples = debounceSamples;
+	doorChannel->debounceInterval = debounceInterval;
+	if (doorChannel->lowSamples > debounceSamples){
+		doorChannel->lowSamples = debounceSamples;
+	}
 
+	// Replay input - settings bound samples to 6 bits & the interval to 10
+	gdoorTrace.record(TRACE_CHANNEL_CONFIG, channel, (debounceSamples << 10) | (debounceInterval & 0x3FF));
+}
 
+// Private methods
+
+void GDoorIO::configureChannel(int channel, int sensorPin, int relayPin, int pulseLength, int debounceSamples, int debounceInterval){
+	DoorChannel* doorChannel = &channels[channel];
+	doorChannel->sensorPin = sensorPin;
+	doorChannel->relayPin = relayPin;
+	doorChannel->pulseLength = pulseLength;
+	doorChannel->debounceSamples = debounceSamples;
+	doorChannel->debounceInterval = debounceInterval;
+
+	doorChannel->state = DOOR_STATE_CLOSED;
+	doorChannel->lowSamples = 0;
+	doorChannel->lastLevel = LOW;
+	doorChannel->lastSampleMillis = 0;
+	doorChannel->pulseActive = false;
+}
 
+bool GDoorIO::sampleChannel(DoorChannel* channel, unsigned long now){
+	if (now - channel->lastSampleMillis < (unsigned long)channel->debounceInterval){
+		return false;
+	}
 
+	channel->lastSampleMillis = now;
+	DoorState previousState = channel->state;
+	int level = digitalRead(channel->sensorPin);
 
+	if (level != channel->lastLevel){
+		channel->lastLevel = level;
+		gdoorTrace.record(TRACE_GPIO_EDGE, channel - channels, level);
+	}
 
+	if (level == HIGH){
+		channel->lowSamples = 0;
+		channel->state = DOOR_STATE_OPEN;
+	}
 
+	else{
+		if (channel->lowSamples < channel->debounceSamples){
+			channel->lowSamples += 1;
+		}
 
+		if (channel->lowSamples >= channel->debounceSamples){
+			channel->state = DOOR_STATE_CLOSED;
+		}
+	}
+
+	if (channel->state == previousState){
+		return false;
+	}
+
+	gdoorTrace.record(TRACE_DOOR_STATE, channel - channels, channel->state);
+	return true;
+}
+
+int GDoorIO::releaseOverduePulses(unsigned long grace){
+	// Supervisor backstop - a relay held past its pulse (timer lost) is forced open
+	int released = 0;
+	unsigned long now = millis();
+	for (int i = 0; i < channelCount; i++){
+		DoorChannel* doorChannel = &channels[i];
+		if (doorChannel->pulseActive && now - doorChannel->pulseStartedMillis > (unsigned long)doorChannel->pulseLength + grace){
+			doorChannel->pulseTimer.detach();
+			releaseRelay(doorChannel);
+			released += 1;
+		}
+	}
+
+	return released;
+}
+
+void GDoorIO::releaseRelay(DoorChannel* channel){
+	// Timer context - keep it short
+	digitalWrite(channel->relayPin, LOW);
+	channel->pulseActive = false;
+	GLOG_INFO(LOG_IO_PULSE_DONE, channel->relayPin);
+}
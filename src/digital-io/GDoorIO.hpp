@@ -8,34 +8,66 @@
 */
 
 #ifndef GDoorIO_h
-#define DGoorIO_h
+#define GDoorIO_h
 
 // Includes
 #include <Arduino.h>
+#include <Ticker.h>
 #include "../constants/Constants.h" 
+#include "../logging/GDoorLog.hpp"
+#include "../diagnostics/TraceRecorder.hpp"
+
+// A door sensor & relay pair, with its own pulse profile and debounce config
+typedef struct doorChannel {
+	int sensorPin;
+	int relayPin;
+	int pulseLength;				// Milis
+	int debounceSamples;			// Consecutive LOW samples before the door counts as closed
+	int debounceInterval;			// Milis between samples
+
+	// Channel state
+	DoorState state;
+	int lowSamples;
+	int lastLevel;					// Raw pin level at the last sample - edges go to the trace
+	unsigned long lastSampleMillis;
+	volatile bool pulseActive;
+	unsigned long pulseStartedMillis;
+	Ticker pulseTimer;
+} DoorChannel;
 
 // Class declaration
 
 class GDoorIO{
 	public:
-		int doorSensorPin = 14;
-		int relayPin 	  = 4;
 		int wifiLEDPin 	  = 5;
 		int hardResetPin  = 15;
-		int pulseLength   = 1500;		// Milis
 
-		// Unused exposed pins
+		// Unused exposed pins (12 & 13 drive the second channel when enabled)
 		int uPin16 = 16;
 		int uPin12 = 12;
 		int uPin13 = 13;
 		int uPin2  = 2;
 
+		// Channel table - the first channelCount are wired (doorChannels setting)
+		DoorChannel channels[MAX_DOOR_CHANNELS];
+		int channelCount  = 1;
+
 		// Public methods
 		GDoorIO();
 
 		void setupGPIOPins();
-		void actuateDoor();
-		DoorState assessDoorState();
+		bool setChannelCount(int count);
+		void actuateDoor(int channel = 0);
+		void settleDoorStates();
+		int sampleDoorStates();
+		DoorState doorState(int channel);
+		void setDebounce(int channel, int debounceSamples, int debounceInterval);
+		int releaseOverduePulses(unsigned long grace);
+
+	private:
+		void configureChannel(int channel, int sensorPin, int relayPin, int pulseLength, int debounceSamples, int debounceInterval);
+		bool sampleChannel(DoorChannel* channel, unsigned long now);
+		static void releaseRelay(DoorChannel* channel);
 };
 
 
@@ -0,0 +1,126 @@
+/*
+*	Binary log ring buffer - replaces synchronous Serial tracing
+*	Source file	
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+// Includes
+#include "GDoorLog.hpp"
+
+// Format strings live in flash, indexed by LogMessageId
+#define LOG_FORMAT_STRING(id, format) static const char id##_format[] PROGMEM = format;
+#define LOG_FORMAT_ENTRY(id, format) id##_format,
+
+GDOOR_LOG_MESSAGES(LOG_FORMAT_STRING)
+
+static const char* const logFormats[LOG_MESSAGE_COUNT] PROGMEM = {
+  GDOOR_LOG_MESSAGES(LOG_FORMAT_ENTRY)
+};
+
+static const char logLevelChars[] = "DIWE";
+
+GDoorLog gdoorLog;
+
+/*
+ *                        Log Drain
+ *
+ *  Called once per loop pass. Records are only formatted here and 
+ *  only written while the UART TX FIFO has room for the whole line, 
+ *  so tracing never stalls the loop waiting on the serial port.
+ *
+*/
+
+void GDoorLog::drain(Stream& output, int maxRecords){
+  char line[160];
+
+  if (dropped > 0){
+    LogRecord notice = {millis(), LOG_LOG_DROPPED, LOG_LEVEL_WARN, 0, {dropped, 0, 0, 0}};
+    int length = formatRecord(&notice, line, sizeof(line));
+    if (output.availableForWrite() < length){
+      return;
+    }
+
+    output.write((const uint8_t*)line, length);
+    dropped = 0;
+  }
+
+  for (int i = 0; i < maxRecords && count > 0; i++){
+    const LogRecord* record = &records[(head - count) & (LOG_RING_CAPACITY - 1)];
+    int length = formatRecord(record, line, sizeof(line));
+    if (output.availableForWrite() < length){
+      return;
+    }
+
+    output.write((const uint8_t*)line, length);
+    count -= 1;
+  }
+}
+
+/*
+ *                        Binary Dump
+ *
+ *  Wire format per record, little endian, LOG_RECORD_WIRE_LEN bytes:
+ *    millis (4) | id (2) | level (1) | reserved (1) | args (4 x 4)
+ *
+ *  Decode on the host with tools/decode_log.py.
+ *
+*/
+
+int GDoorLog::dumpRecords(int startRecord, uint8_t* target, int maxRecords){
+  int written = 0;
+
+  for (int i = startRecord; i < (int)count && written < maxRecords; i++){
+    const LogRecord* record = &records[(head - count + i) & (LOG_RING_CAPACITY - 1)];
+    uint8_t* out = &target[written * LOG_RECORD_WIRE_LEN];
+
+    for (int b = 0; b < 4; b++){
+      out[b] = (record->millis >> (8 * b)) & 0xFF;
+    }
+
+    out[4] = record->id & 0xFF;
+    out[5] = (record->id >> 8) & 0xFF;
+    out[6] = record->level;
+    out[7] = 0;
+
+    for (int a = 0; a < LOG_RECORD_ARGS; a++){
+      for (int b = 0; b < 4; b++){
+        out[8 + (a * 4) + b] = (record->args[a] >> (8 * b)) & 0xFF;
+      }
+    }
+
+    written += 1;
+  }
+
+  return written;
+}
+
+int GDoorLog::bufferedRecords(){
+  return count;
+}
+
+int GDoorLog::formatRecord(const LogRecord* record, char* target, int maxLength){
+  char level = logLevelChars[record->level & 0x03];
+  int length = snprintf(target, maxLength, "%lu %c ", (unsigned long)record->millis, level);
+
+  if (record->id < LOG_MESSAGE_COUNT){
+    PGM_P format = (PGM_P)pgm_read_ptr(&logFormats[record->id]);
+    length += snprintf_P(&target[length], maxLength - length - 2, format, record->args[0], record->args[1], record->args[2], record->args[3]);
+  }
+
+  else{
+    length += snprintf(&target[length], maxLength - length - 2, "Unknown log message %u", record->id);
+  }
+
+  // snprintf reports the untruncated length
+  if (length > maxLength - 3){
+    length = maxLength - 3;
+  }
+
+  target[length++] = '\r';
+  target[length++] = '\n';
+  target[length] = 0;
+  return length;
+}
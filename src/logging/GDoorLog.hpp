@@ -0,0 +1,97 @@
+/*
+*	Binary log ring buffer - replaces synchronous Serial tracing
+*	Header file	
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#ifndef GDoorLog_h
+#define GDoorLog_h
+
+// Includes
+#include <Arduino.h>
+#include "LogMessages.h"
+
+typedef enum logLevel {
+  LOG_LEVEL_DEBUG,
+  LOG_LEVEL_INFO,
+  LOG_LEVEL_WARN,
+  LOG_LEVEL_ERROR
+} LogLevel;
+
+// Records below this level compile away entirely
+#ifndef GDOOR_LOG_MIN_LEVEL
+#define GDOOR_LOG_MIN_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_RING_CAPACITY 64          // Power of 2
+#define LOG_RECORD_ARGS 4
+#define LOG_RECORD_WIRE_LEN 24        // Serialized record length for dumps
+
+#define LOG_ID_ENUM(id, format) id,
+
+typedef enum logMessageId {
+  GDOOR_LOG_MESSAGES(LOG_ID_ENUM)
+  LOG_MESSAGE_COUNT
+} LogMessageId;
+
+typedef struct logRecord {
+  uint32_t millis;
+  uint16_t id;
+  uint8_t level;
+  uint8_t reserved;
+  uint32_t args[LOG_RECORD_ARGS];
+} LogRecord;
+
+class GDoorLog {
+  public:
+    // Hot path - stores the record, no formatting or IO
+    inline void write(uint8_t level, uint16_t id, uint32_t arg0 = 0, uint32_t arg1 = 0, uint32_t arg2 = 0, uint32_t arg3 = 0){
+      LogRecord* record = &records[head & (LOG_RING_CAPACITY - 1)];
+      record->millis = millis();
+      record->id = id;
+      record->level = level;
+      record->args[0] = arg0;
+      record->args[1] = arg1;
+      record->args[2] = arg2;
+      record->args[3] = arg3;
+      head += 1;
+
+      if (count < LOG_RING_CAPACITY){
+        count += 1;
+      }
+
+      else{
+        dropped += 1;
+      }
+    }
+
+    // Background - formats & writes as much as the stream accepts without blocking
+    void drain(Stream& output, int maxRecords);
+
+    // Serialize the buffered records (oldest first) without consuming them
+    int dumpRecords(int startRecord, uint8_t* target, int maxRecords);
+    int bufferedRecords();
+
+  private:
+    // Zero initialised as a static - no constructor so that logging 
+    // from other global constructors is safe
+    LogRecord records[LOG_RING_CAPACITY];
+    uint32_t head;
+    uint32_t count;
+    uint32_t dropped;
+
+    int formatRecord(const LogRecord* record, char* target, int maxLength);
+};
+
+extern GDoorLog gdoorLog;
+
+#define GLOG(level, ...) do { if ((level) >= GDOOR_LOG_MIN_LEVEL) gdoorLog.write((level), __VA_ARGS__); } while (0)
+#define GLOG_DEBUG(...) GLOG(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define GLOG_INFO(...)  GLOG(LOG_LEVEL_INFO, __VA_ARGS__)
+#define GLOG_WARN(...)  GLOG(LOG_LEVEL_WARN, __VA_ARGS__)
+#define GLOG_ERROR(...) GLOG(LOG_LEVEL_ERROR, __VA_ARGS__)
+
+#endif
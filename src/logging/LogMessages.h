@@ -0,0 +1,136 @@
+/*
+*	Interned log message catalogue
+*	Header file	
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*	Each entry becomes a LogMessageId and a PROGMEM format string. 
+*	Records only carry the ID and up to 4 integer args, so the text 
+*	never has to be formatted on the hot path. tools/decode_log.py 
+*	parses this file to decode dumps on the host - append new 
+*	entries at the end of the list, never reorder or remove.
+*
+*/
+
+#ifndef LogMessages_h
+#define LogMessages_h
+
+#define GDOOR_LOG_MESSAGES(X) \
+  X(LOG_MAIN_BOOT,                "MAIN: Firing up Esp!!") \
+  X(LOG_BOOT_STAGE_GPIO,          "BOOT: GPIO at %u ms") \
+  X(LOG_BOOT_STAGE_USER_DATA,     "BOOT: USER DATA at %u ms") \
+  X(LOG_BOOT_STAGE_WIFI_BEGIN,    "BOOT: WIFI BEGIN at %u ms") \
+  X(LOG_BOOT_STAGE_SERVER,        "BOOT: SERVER at %u ms") \
+  X(LOG_BOOT_STAGE_DOOR_SAMPLED,  "BOOT: DOOR SAMPLED at %u ms") \
+  X(LOG_BOOT_STAGE_WIFI_CONNECTED,"BOOT: WIFI CONNECTED at %u ms") \
+  X(LOG_BOOT_STAGE_FIRST_REPORT,  "BOOT: FIRST REPORT at %u ms") \
+  X(LOG_MAIN_HEALTH_CHECK_DUE,    "MAIN: Health check time - hitting API") \
+  X(LOG_MAIN_MILLIS_ROLLOVER,     "MAIN: Millis rollover - resetting counters") \
+  X(LOG_MAIN_DOOR_OPEN,           "MAIN: Door %u status changed to OPEN") \
+  X(LOG_MAIN_DOOR_CLOSED,         "MAIN: Door %u status changed to CLOSED") \
+  X(LOG_SERVER_ROOT_REQ,          "SERVER: Received base API req") \
+  X(LOG_SERVER_ACTUATE_REQ,       "SERVER: Recieved req to actuate door %u. On it.") \
+  X(LOG_SERVER_HEALTH_REQ,        "SERVER: Received health inquery") \
+  X(LOG_SERVER_DOOR_STATUS_REQ,   "SERVER: Queried about door %u status") \
+  X(LOG_SERVER_FORCED_HEALTH_REQ, "SERVER: Received http req to update health (forced check)") \
+  X(LOG_SERVER_ENDPOINTS,         "SERVER: Registered %u UID endpoints") \
+  X(LOG_SERVER_LOG_DUMP_REQ,      "SERVER: Log dump requested - %u records") \
+  X(LOG_HTTP_BOOT_INFO,           "HTTP INTERFACE: Sending boot info to server (%u bytes)") \
+  X(LOG_HTTP_DOOR_STATE,          "HTTP INTERFACE: Sending door %u state %02u to server") \
+  X(LOG_HTTP_HEALTH,              "HTTP INTERFACE: Sending health update to server (%u bytes)") \
+  X(LOG_HTTP_RECON,               "HTTP INTERFACE: Sending WiFi recon note to server (%u bytes)") \
+  X(LOG_HTTP_RESPONSE,            "HTTP INTERFACE: Received response to HTTP POST %d (%u bytes)") \
+  X(LOG_UPLOAD_QUEUE_FULL,        "UPLOAD QUEUE: Queue full - dropping event of type %u") \
+  X(LOG_LOCAL_MDNS_STARTED,       "LOCAL CONTROL: Advertising mDNS service on gdoor-%06x") \
+  X(LOG_LOCAL_MDNS_FAILED,        "LOCAL CONTROL: Failed to start mDNS responder") \
+  X(LOG_LOCAL_BAD_TAG,            "LOCAL CONTROL: Rejected datagram with bad tag") \
+  X(LOG_LOCAL_REPLAY,             "LOCAL CONTROL: Rejected replayed datagram (counter %u, last %u)") \
+  X(LOG_LOCAL_ACTUATE_REQ,        "LOCAL CONTROL: Received req to actuate door %u") \
+  X(LOG_USER_INSTANTIATED,        "GDOOR USER: Instantiating user object") \
+  X(LOG_USER_READING,             "GDOOR USER: Reading user data from disk") \
+  X(LOG_USER_DATA_FOUND,          "GDOOR USER: Successfully found data in memory. Loading data.") \
+  X(LOG_USER_NO_DATA,             "GDOOR USER: Persisted data does not exist. Read memory address data => %u %u") \
+  X(LOG_USER_READ_LENGTHS,        "GDOOR USER: Read UID (%u), SSID (%u), password (%u) lengths") \
+  X(LOG_USER_READ_GATEWAY,        "GDOOR USER: Read gateway IP => %u.%u.%u.%u") \
+  X(LOG_USER_READ_SUBNET,         "GDOOR USER: Read subnet mask => %u.%u.%u.%u") \
+  X(LOG_USER_READ_BYTES,          "GDOOR USER: Read %u bytes from disk") \
+  X(LOG_USER_READ_ERROR,          "GDOOR USER: Read error - isolated delimitor at address %u") \
+  X(LOG_USER_WRITING,             "GDOOR USER: Writing user data to disk") \
+  X(LOG_USER_WROTE_FIELD,         "GDOOR USER: Wrote %u byte field, address pointer = %u") \
+  X(LOG_USER_WROTE_BYTES,         "GDOOR USER: Wrote %u bytes to disk") \
+  X(LOG_IO_SETUP,                 "DOOR IO: Setting GPIO Pins to correct IO state") \
+  X(LOG_IO_ACTUATING,             "DOOR IO: Actuating door %u") \
+  X(LOG_IO_PULSE_DONE,            "DOOR IO: Completed door pulse on relay pin %u") \
+  X(LOG_WIFI_CRED_ACQUISITION,    "WIFI INTERFACE: Initiating WiFi set up") \
+  X(LOG_WIFI_STATIC_OK,           "WIFI INTERFACE: Successfully connected to correct static IP") \
+  X(LOG_WIFI_STATIC_RETRY,        "WIFI INTERFACE: Re-attempting connection, incorrectly assigned static IP => %u.%u.%u.%u") \
+  X(LOG_WIFI_CONNECTING,          "WIFI INTERFACE: Attempting to connect to WiFi") \
+  X(LOG_WIFI_CONNECTED,           "WIFI INTERFACE: Connected after %u ms") \
+  X(LOG_WIFI_ASSIGNED_IP,         "WIFI INTERFACE: Assigned IP address = %u.%u.%u.%u") \
+  X(LOG_WIFI_GATEWAY_IP,          "WIFI INTERFACE: Gateway IP = %u.%u.%u.%u") \
+  X(LOG_WIFI_SUBNET_MASK,         "WIFI INTERFACE: Subnet mask = %u.%u.%u.%u") \
+  X(LOG_WIFI_CONFIG_STATIC,       "WIFI INTERFACE: Configuring static IP address => %u.%u.%u.%u") \
+  X(LOG_WIFI_DROPPED,             "WIFI INTERFACE: WiFi connection dropped, attempting to reconnect") \
+  X(LOG_WIFI_RECONNECTED,         "WIFI INTERFACE: Successfully reconnected after %u ms") \
+  X(LOG_LOG_DROPPED,              "LOG: Ring buffer overflowed - %u records dropped") \
+  X(LOG_CLOCK_SYNCED,             "CLOCK: SNTP synced, epoch = %u s") \
+  X(LOG_CLOCK_RESYNC,             "CLOCK: SNTP resync, error %d ms, drift %d ppm") \
+  X(LOG_USER_NO_SECRET,           "GDOOR USER: No device secret provisioned - signed requests disabled") \
+  X(LOG_AUTH_REJECTED,            "AUTH: Rejected request, reason %u") \
+  X(LOG_AUTH_LEGACY,              "AUTH: No device secret, accepting unsigned request") \
+  X(LOG_HTTP_TLS_BUFFERS,         "HTTP INTERFACE: TLS record buffers rx = %u, tx = %u bytes") \
+  X(LOG_HTTP_TLS_INSECURE,        "HTTP INTERFACE: GDOOR_CLOUD_INSECURE build - server certificate not verified") \
+  X(LOG_HTTP_TLS_ERROR,           "HTTP INTERFACE: Upload failed, code %d, TLS error %d") \
+  X(LOG_HTTP_UPLOAD_TIMING,       "HTTP INTERFACE: Upload took %u ms, new connection = %u, handshakes %u / uploads %u") \
+  X(LOG_HTTP_ENCODING,            "HTTP INTERFACE: Upload encoding set to %u (0 = JSON, 1 = binary)") \
+  X(LOG_HTTP_SESSION,             "HTTP INTERFACE: Cloud session id %u") \
+  X(LOG_SETTINGS_DEFAULTS,        "SETTINGS: No stored settings, using defaults") \
+  X(LOG_SETTINGS_CORRUPT,         "SETTINGS: Stored settings failed checksum, using defaults") \
+  X(LOG_SETTINGS_LOADED,          "SETTINGS: Loaded %u settings from disk") \
+  X(LOG_SETTINGS_SAVED,           "SETTINGS: Saved settings to disk") \
+  X(LOG_SETTINGS_CHANGED,         "SETTINGS: Setting %u changed to %u") \
+  X(LOG_SETTINGS_REJECTED,        "SETTINGS: Rejected out of range value %u for setting %u") \
+  X(LOG_SETTINGS_REBOOT,          "SETTINGS: Setting %u applies after the next reboot") \
+  X(LOG_SERVER_SETTINGS_REQ,      "SERVER: Settings requested with %u updates") \
+  X(LOG_WIFI_CONNECT_TIMEOUT,     "WIFI INTERFACE: No connection after %u ms (addressing mode %u)") \
+  X(LOG_WIFI_DHCP_FALLBACK,       "WIFI INTERFACE: Static IP refused %u times, falling back to DHCP") \
+  X(LOG_WIFI_LEASE_CACHED,        "WIFI INTERFACE: Cached address %u.%u.%u.%u") \
+  X(LOG_WIFI_LEASE_RESTORED,      "WIFI INTERFACE: Restored addressing mode %u, gateway %u.%u.%u.x") \
+  X(LOG_WIFI_RECON_TIMEOUT,       "WIFI INTERFACE: Still disconnected after %u ms") \
+  X(LOG_SUPERVISOR_RESET_REASON,  "SUPERVISOR: Reset reason %u, exception cause %u at 0x%08x") \
+  X(LOG_SUPERVISOR_PREVIOUS_FAULT, "SUPERVISOR: Previous reset was fault %u in stage %u after %u ms") \
+  X(LOG_SUPERVISOR_DEADLINE,      "SUPERVISOR: Stage %u overran its deadline (%u ms) - resetting") \
+  X(LOG_SUPERVISOR_RELAY_RELEASED, "SUPERVISOR: Relay held past its pulse - released") \
+  X(LOG_SUPERVISOR_INJECT,        "SUPERVISOR: Injecting hang in stage %u") \
+  X(LOG_SERVER_DIAGNOSTICS_REQ,   "SERVER: Diagnostics requested") \
+  X(LOG_SERVER_TRACE_DUMP_REQ,    "SERVER: Trace dump requested, %u records buffered") \
+  X(LOG_SERVER_ROUTES_FULL,       "SERVER: Route table full (%u routes), route dropped") \
+  X(LOG_SERVER_NOT_FOUND,         "SERVER: No route for request") \
+  X(LOG_RULES_NONE,               "RULES: No stored rules") \
+  X(LOG_RULES_CORRUPT,            "RULES: Stored rules failed checksum, ignoring") \
+  X(LOG_RULES_LOADED,             "RULES: Loaded %u rules") \
+  X(LOG_RULES_SAVED,              "RULES: Saved %u rules to disk") \
+  X(LOG_RULES_REJECTED,           "RULES: Rejected rule %u (result %u)") \
+  X(LOG_RULES_DEFERRED,           "RULES: Rule %u deferred %u s - presence") \
+  X(LOG_RULES_FIRED,              "RULES: Rule %u actuating channel %u") \
+  X(LOG_SERVER_RULES_REQ,         "SERVER: Rules requested, program %u chars") \
+  X(LOG_AUTH_ENROLLED,            "AUTH: Device secret enrolled - signed requests required") \
+  X(LOG_AUTH_ENROL_REFUSED,       "AUTH: Enrolment refused (auth result %u, enforcing %u)") \
+  X(LOG_LOCAL_NO_SECRET,          "LOCAL CONTROL: Command %u refused - no device secret enrolled") \
+  X(LOG_HTTP_TLS_WAIT_CLOCK,      "HTTP INTERFACE: Uploads held until the clock syncs - needed to check the server certificate") \
+  X(LOG_HTTP_PAYLOAD_TRUNCATED,   "HTTP INTERFACE: Health payload is %d chars, buffer holds %u - not sent") \
+  X(LOG_AUTH_ROTATED,             "AUTH: Device secret rotated") \
+  X(LOG_AUTH_ROTATE_REFUSED,      "AUTH: Secret rotation refused (auth result %u)") \
+  X(LOG_SERVER_BAD_METHOD,        "SERVER: Method %u not allowed") \
+  X(LOG_HTTP_TLS_FALLBACK_TIME,   "HTTP INTERFACE: No clock sync after %u ms - checking certificates against %u") \
+  X(LOG_RULES_MIGRATED,           "RULES: Moved the stored table from %u to %u") \
+  X(LOG_UPLOAD_RETRY,             "UPLOAD QUEUE: Upload of type %u failed (%d) - retrying in %u ms") \
+  X(LOG_UPLOAD_DROPPED,           "UPLOAD QUEUE: Upload of type %u failed (%d) after %u attempts - dropped") \
+  X(LOG_BOOT_STAGE_UPLINK_READY,  "BOOT: UPLINK READY at %u ms") \
+  X(LOG_IO_CHANNELS_REFUSED,      "DOOR IO: %d door channels refused - the channel table has %u") \
+  X(LOG_WIFI_CONNECT_GAVE_UP,     "WIFI INTERFACE: No address within the %u ms budget (addressing mode %u) - retrying from the loop") \
+  X(LOG_SUPERVISOR_STACK,         "SUPERVISOR: Loop stack at the overrun - sp 0x%08x, %u words") \
+  X(LOG_SUPERVISOR_STACK_WORDS,   "SUPERVISOR: sp+%u: %08x %08x %08x")
+
+#endif
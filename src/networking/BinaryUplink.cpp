@@ -0,0 +1,187 @@
+/*
+*	Compact binary upload encoding - the alternative to 
+*   the JSON text payloads
+*	Source file	
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+// Includes
+#include "BinaryUplink.hpp"
+
+// Function prototypes
+int writeBinaryHeader(BinaryMessageType type, uint8_t flags, uint32_t sessionId, const char* uid, uint64_t capturedAt, uint64_t sentAt, uint8_t* target);
+int putU16(uint16_t value, uint8_t* target);
+int putU32(uint32_t value, uint8_t* target);
+int putU64(uint64_t value, uint8_t* target);
+int putString(const char* value, uint8_t* target);
+int putIP(const char* ipStr, uint8_t* target);
+
+/*
+ *                      Schema Version 3
+ *
+ *    Sent as application/octet-stream to the same endpoints as the 
+ *    JSON. All integers little endian, strings are a length byte 
+ *    followed by the characters (no terminator).
+ *
+ *      0       Magic 'G'
+ *      1       Schema version
+ *      2       Message type
+ *      3       Flags - bit 0: identified by UID rather than session, 
+ *                      bit 1: address came from DHCP (boot info & recon)
+ *      4-      Session id (u32) or UID (string)
+ *      +0      capturedAt (u64 Unix millis, 0 = clock not synced)
+ *      +8      sentAt (u64)
+ *      +16     Body:
+ *                Boot info   port u16, firmware string, target static IP[4], 
+ *                            assigned IP[4], channel count u8, door state u8 
+ *                            per channel, connectedMillis u32, then (v2) 
+ *                            reset reason u8, supervisor fault u8, stage u8, 
+ *                            exception cause u8, epc1 u32, stage millis u32, 
+ *                            free stack u32, stage trail u32
+ *                Door state  channel u8, state u8
+ *                Health      uptime millis u64, then (v3) free heap u32, 
+ *                            min free heap u32, max free block u32, 
+ *                            fragmentation % u8, free loop stack u32
+ *                Recon       assigned IP[4]
+ *
+ *    Boot info always carries the UID - its response hands back the 
+ *    session id ({"sessionId":N}) the other messages use. Until one 
+ *    arrives they fall back to the UID. Decoder: tools/decode_uplink.py
+ *  
+*/
+
+int encodeBootInfoBinary(const char* uid, const char* portNum, const char* firmwareVersion, const char* targetStaticIP, const char* assignedLocalIP, bool dhcpAddressing, const DoorState* doorStates, int channelCount, unsigned long connectedMillis, const ResetReport* resetReport, uint64_t capturedAt, uint64_t sentAt, uint8_t* target){
+  int index = writeBinaryHeader(BINARY_MSG_BOOT_INFO, dhcpAddressing ? BINARY_UPLINK_FLAG_DHCP : 0, 0, uid, capturedAt, sentAt, target);
+  index += putU16(atoi(portNum), &target[index]);
+  index += putString(firmwareVersion, &target[index]);
+  index += putIP(targetStaticIP, &target[index]);
+  index += putIP(assignedLocalIP, &target[index]);
+
+  target[index++] = (uint8_t)channelCount;
+  for (int i = 0; i < channelCount; i++){
+    target[index++] = (uint8_t)doorStates[i];
+  }
+
+  index += putU32(connectedMillis, &target[index]);
+
+  // Schema 2 - reset report
+  target[index++] = (uint8_t)resetReport->resetReason;
+  target[index++] = (uint8_t)resetReport->fault;
+  target[index++] = (uint8_t)resetReport->stage;
+  target[index++] = (uint8_t)resetReport->exceptionCause;
+  index += putU32(resetReport->exceptionAddress, &target[index]);
+  index += putU32(resetReport->stageMillis, &target[index]);
+  index += putU32(resetReport->freeContStack, &target[index]);
+  index += putU32(resetReport->stageTrail, &target[index]);
+  return index;
+}
+
+int encodeDoorStateBinary(uint32_t sessionId, const char* uid, DoorState state, int channel, uint64_t capturedAt, uint64_t sentAt, uint8_t* target){
+  int index = writeBinaryHeader(BINARY_MSG_DOOR_STATE, 0, sessionId, uid, capturedAt, sentAt, target);
+  target[index++] = (uint8_t)channel;
+  target[index++] = (uint8_t)state;
+  return index;
+}
+
+int encodeHealthBinary(uint32_t sessionId, const char* uid, uint64_t uptimeMillis, const MemorySnapshot* memory, uint64_t capturedAt, uint64_t sentAt, uint8_t* target){
+  int index = writeBinaryHeader(BINARY_MSG_HEALTH, 0, sessionId, uid, capturedAt, sentAt, target);
+  index += putU64(uptimeMillis, &target[index]);
+
+  // Schema 3 - memory profile
+  index += putU32(memory->freeHeap, &target[index]);
+  index += putU32(memory->minFreeHeap, &target[index]);
+  index += putU32(memory->maxFreeBlock, &target[index]);
+  target[index++] = (uint8_t)memory->fragmentation;
+  index += putU32(memory->freeContStack, &target[index]);
+  return index;
+}
+
+int encodeReconBinary(uint32_t sessionId, const char* uid, const char* assignedLocalIP, bool dhcpAddressing, uint64_t capturedAt, uint64_t sentAt, uint8_t* target){
+  int index = writeBinaryHeader(BINARY_MSG_RECON, dhcpAddressing ? BINARY_UPLINK_FLAG_DHCP : 0, sessionId, uid, capturedAt, sentAt, target);
+  index += putIP(assignedLocalIP, &target[index]);
+  return index;
+}
+
+uint32_t parseSessionId(const char* response){
+  const char* key = strstr(response, "\"sessionId\":");
+  if (key == NULL){
+    return 0;
+  }
+
+  // Accept the number quoted or bare
+  const char* digits = key + strlen("\"sessionId\":");
+  if (*digits == '"'){
+    digits += 1;
+  }
+
+  return strtoul(digits, NULL, 10);
+}
+
+// Utility functions
+
+int writeBinaryHeader(BinaryMessageType type, uint8_t flags, uint32_t sessionId, const char* uid, uint64_t capturedAt, uint64_t sentAt, uint8_t* target){
+  int index = 0;
+  target[index++] = BINARY_UPLINK_MAGIC;
+  target[index++] = BINARY_UPLINK_SCHEMA;
+  target[index++] = (uint8_t)type;
+
+  if (sessionId == 0){
+    target[index++] = flags | BINARY_UPLINK_FLAG_UID;
+    index += putString(uid, &target[index]);
+  }
+
+  else{
+    target[index++] = flags;
+    index += putU32(sessionId, &target[index]);
+  }
+
+  index += putU64(capturedAt, &target[index]);
+  index += putU64(sentAt, &target[index]);
+  return index;
+}
+
+int putU16(uint16_t value, uint8_t* target){
+  target[0] = value & 0xFF;
+  target[1] = (value >> 8) & 0xFF;
+  return 2;
+}
+
+int putU32(uint32_t value, uint8_t* target){
+  for (int i = 0; i < 4; i++){
+    target[i] = (value >> (8 * i)) & 0xFF;
+  }
+
+  return 4;
+}
+
+int putU64(uint64_t value, uint8_t* target){
+  for (int i = 0; i < 8; i++){
+    target[i] = (value >> (8 * i)) & 0xFF;
+  }
+
+  return 8;
+}
+
+int putString(const char* value, uint8_t* target){
+  int length = strlen(value);
+  if (length > 255){
+    length = 255;
+  }
+
+  target[0] = (uint8_t)length;
+  memcpy(&target[1], value, length);
+  return length + 1;
+}
+
+int putIP(const char* ipStr, uint8_t* target){
+  IPAddress ip;
+  ip.fromString(ipStr);
+  for (int i = 0; i < 4; i++){
+    target[i] = ip[i];
+  }
+
+  return 4;
+}
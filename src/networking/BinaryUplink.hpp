@@ -0,0 +1,43 @@
+/*
+*	Compact binary upload encoding - the alternative to 
+*   the JSON text payloads
+*	Header file	
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#ifndef BinaryUplink_h
+#define BinaryUplink_h
+
+// Includes
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include "../constants/Constants.h"
+#include "../diagnostics/Supervisor.hpp"
+#include "../diagnostics/MemoryProfiler.hpp"
+
+#define BINARY_UPLINK_MAGIC 'G'
+#define BINARY_UPLINK_SCHEMA 3
+#define BINARY_UPLINK_MAX_LEN 128
+#define BINARY_UPLINK_FLAG_UID 0x01       // Full UID follows instead of the session id
+#define BINARY_UPLINK_FLAG_DHCP 0x02      // Boot info & recon - address came from DHCP, not the static octet
+
+typedef enum binaryMessageType {
+  BINARY_MSG_BOOT_INFO    = 0x01,
+  BINARY_MSG_DOOR_STATE   = 0x02,
+  BINARY_MSG_HEALTH       = 0x03,
+  BINARY_MSG_RECON        = 0x04
+} BinaryMessageType;
+
+// Encoders - return the payload length. A zero session id sends the full UID instead.
+int encodeBootInfoBinary(const char* uid, const char* portNum, const char* firmwareVersion, const char* targetStaticIP, const char* assignedLocalIP, bool dhcpAddressing, const DoorState* doorStates, int channelCount, unsigned long connectedMillis, const ResetReport* resetReport, uint64_t capturedAt, uint64_t sentAt, uint8_t* target);
+int encodeDoorStateBinary(uint32_t sessionId, const char* uid, DoorState state, int channel, uint64_t capturedAt, uint64_t sentAt, uint8_t* target);
+int encodeHealthBinary(uint32_t sessionId, const char* uid, uint64_t uptimeMillis, const MemorySnapshot* memory, uint64_t capturedAt, uint64_t sentAt, uint8_t* target);
+int encodeReconBinary(uint32_t sessionId, const char* uid, const char* assignedLocalIP, bool dhcpAddressing, uint64_t capturedAt, uint64_t sentAt, uint8_t* target);
+
+// Session id handed out in the boot info response - 0 if there isn't one
+uint32_t parseSessionId(const char* response);
+
+#endif
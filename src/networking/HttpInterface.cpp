@@ -11,8 +11,240 @@
 #include "HTTPInterface.hpp"
 
 // Function prototypes
-const char* createHttpJson(const char* stateStr, const char* uid);
 void addKeyValueJSONStringEntry(const char* key, const char* value, char* target, int* index);
+void configureCloudClient();
+int postJson(const char* path, const char* payload, char* response);
+int postBinary(const char* path, const uint8_t* payload, int length, char* response);
+void raiseFallbackTime(uint32_t epochSecs);
+void probeHttpDate();
+
+// Persistent uplink - one TLS connection & session reused by every upload
+BearSSL::WiFiClientSecure cloudClient;
+BearSSL::Session cloudSession;
+HTTPClient cloudHttp;
+UplinkStats cloudStats;
+bool cloudClientConfigured = false;
+GDoorClock* uplinkClock = NULL;
+bool uplinkClockWaitLogged = false;
+
+// Certificate time without SNTP - raised by the build stamp & Date headers, advanced by millis()
+unsigned long uplinkClockWaitStart = 0;
+uint32_t fallbackEpochSecs = 0;
+unsigned long fallbackMillis = 0;
+bool fallbackProbed = false;
+const char* dateHeader[] = { "Date" };
+
+// Encoding state - the session id comes back in the boot info response
+UplinkEncoding uplinkEncoding = UPLINK_ENCODING_JSON;
+uint32_t uplinkSessionId = 0;
+
+#ifndef GDOOR_CLOUD_INSECURE
+static const char cloudRootCA[] PROGMEM = GDOOR_CLOUD_ROOT_CA;
+BearSSL::X509List cloudTrustAnchor(cloudRootCA);
+#endif
+
+/*
+ *                          Cloud Uplink
+ *
+ *    Every upload goes over HTTPS to GDOOR_CLOUD_HOST through a single 
+ *    client. Keep-alive means most uploads reuse the open connection 
+ *    with no handshake at all, and when the server does close it the 
+ *    cached session lets the reconnect resume instead of doing the full 
+ *    RSA exchange (seconds of CPU on the ESP8266).
+ *
+ *    The record buffers are allocated once, on the first upload. The 
+ *    transmit side only ever carries our own payloads, so it's sized to 
+ *    the boot info plus headers. The receive side needs a full 16k TLS 
+ *    record unless the server agrees to a smaller max fragment length.
+ *
+ *    The server certificate is checked against the roots in 
+ *    CloudTrustAnchors.h, which needs wall time for the validity 
+ *    dates. uplinkReady() holds uploads (they stay queued) while 
+ *    SNTP syncs, but only for UPLINK_CLOCK_WAIT_MILLIS - networks 
+ *    that block NTP would otherwise never report. After that the 
+ *    certificates are checked against a fallback time: the Date 
+ *    header of a plain HTTP HEAD to the cloud host, never earlier 
+ *    than the firmware build stamp, then kept current by millis() 
+ *    and the Date header of every verified response. A forged Date 
+ *    can only make an expired certificate look current - the chain 
+ *    & host name are still checked. GDOOR_CLOUD_INSECURE turns the 
+ *    check off for bench rigs.
+ *
+ *    Point GDOOR_CLOUD_HOST/PORT at tools/tls_standin.py to compare 
+ *    handshake counts and upload latency against the logged stats, 
+ *    with GDOOR_CLOUD_ROOT_CA set to the CA it prints.
+ *  
+*/
+
+int postToCloud(const char* path, const char* contentType, const uint8_t* payload, int length, char* response){
+  if (!cloudClientConfigured){
+    configureCloudClient();
+  }
+
+#ifndef GDOOR_CLOUD_INSECURE
+  cloudClient.setX509Time((time_t)uplinkCertificateTime());
+#endif
+
+  // A closed socket means this upload pays for a (resumed) handshake
+  bool newConnection = !cloudClient.connected();
+  unsigned long startMillis = millis();
+
+  cloudHttp.begin(cloudClient, GDOOR_CLOUD_HOST, GDOOR_CLOUD_PORT, path, true);
+  cloudHttp.collectHeaders(dateHeader, 1);
+  cloudHttp.addHeader("Content-Type", contentType);
+  int resCode = cloudHttp.POST(payload, length);
+
+  // Came over the verified connection - keeps the fallback time current
+  uint32_t dateSecs;
+  if (resCode > 0 && GDoorClock::parseHttpDate(cloudHttp.header("Date").c_str(), &dateSecs)){
+    raiseFallbackTime(dateSecs);
+  }
+
+  // Look for the response & examine - the body has to be read for the connection to be reused
+  String resString = cloudHttp.getString();
+  cloudHttp.end();
+
+  if (response != NULL){
+    strncpy(response, resString.c_str(), UPLINK_RESPONSE_LEN - 1);
+    response[UPLINK_RESPONSE_LEN - 1] = 0;
+  }
+
+  unsigned long latency = millis() - startMillis;
+  cloudStats.uploads += 1;
+  cloudStats.lastResCode = resCode;
+  cloudStats.lastLatencyMillis = latency;
+  cloudStats.totalLatencyMillis += latency;
+  if (latency > cloudStats.maxLatencyMillis){
+    cloudStats.maxLatencyMillis = latency;
+  }
+
+  if (newConnection){
+    cloudStats.handshakes += 1;
+  }
+
+  if (resCode <= 0){
+    cloudStats.failures += 1;
+    GLOG_WARN(LOG_HTTP_TLS_ERROR, resCode, cloudClient.getLastSSLError());
+  }
+
+  GLOG_INFO(LOG_HTTP_RESPONSE, resCode, resString.length());
+  GLOG_INFO(LOG_HTTP_UPLOAD_TIMING, latency, newConnection, cloudStats.handshakes, cloudStats.uploads);
+  return resCode;
+}
+
+const UplinkStats* uplinkStats(){
+  return &cloudStats;
+}
+
+void setUplinkClock(GDoorClock* clock){
+  uplinkClock = clock;
+  uplinkClockWaitStart = millis();
+
+  uint32_t buildSecs;
+  if (GDoorClock::parseBuildStamp(__DATE__, __TIME__, &buildSecs)){
+    raiseFallbackTime(buildSecs - UPLINK_BUILD_STAMP_SLACK);
+  }
+}
+
+bool uplinkReady(){
+#ifdef GDOOR_CLOUD_INSECURE
+  return true;
+#else
+  if (uplinkClock != NULL && uplinkClock->isSynced()){
+    return true;
+  }
+
+  if (millis() - uplinkClockWaitStart < UPLINK_CLOCK_WAIT_MILLIS){
+    if (!uplinkClockWaitLogged){
+      uplinkClockWaitLogged = true;
+      GLOG_INFO(LOG_HTTP_TLS_WAIT_CLOCK);
+    }
+
+    return false;
+  }
+
+  // Once per boot - verified responses keep it current from here
+  if (!fallbackProbed){
+    fallbackProbed = true;
+    probeHttpDate();
+    GLOG_WARN(LOG_HTTP_TLS_FALLBACK_TIME, UPLINK_CLOCK_WAIT_MILLIS, uplinkCertificateTime());
+  }
+
+  return true;
+#endif
+}
+
+uint32_t uplinkCertificateTime(){
+  if (uplinkClock != NULL && uplinkClock->isSynced()){
+    return (uint32_t)(uplinkClock->epochMillis() / 1000);
+  }
+
+  return fallbackEpochSecs + ((millis() - fallbackMillis) / 1000);
+}
+
+void raiseFallbackTime(uint32_t epochSecs){
+  // Only ever forwards - nothing can wind it back before the build
+  if (epochSecs > uplinkCertificateTime()){
+    fallbackEpochSecs = epochSecs;
+    fallbackMillis = millis();
+  }
+}
+
+void probeHttpDate(){
+  // Plain HTTP, so unauthenticated - raiseFallbackTime() keeps the build stamp as a floor
+  WiFiClient plainClient;
+  HTTPClient probe;
+  probe.begin(plainClient, GDOOR_CLOUD_HOST, 80, "/", false);
+  probe.collectHeaders(dateHeader, 1);
+  probe.setTimeout(UPLINK_TIMEOUT_MILLIS);
+
+  uint32_t dateSecs;
+  if (probe.sendRequest("HEAD") > 0 && GDoorClock::parseHttpDate(probe.header("Date").c_str(), &dateSecs)){
+    raiseFallbackTime(dateSecs);
+  }
+
+  probe.end();
+}
+
+void setUplinkEncoding(UplinkEncoding encoding){
+  uplinkEncoding = encoding;
+  GLOG_INFO(LOG_HTTP_ENCODING, encoding);
+}
+
+UplinkEncoding currentUplinkEncoding(){
+  return uplinkEncoding;
+}
+
+int postJson(const char* path, const char* payload, char* response){
+  return postToCloud(path, "text/plain", (const uint8_t*)payload, strlen(payload), response);
+}
+
+int postBinary(const char* path, const uint8_t* payload, int length, char* response){
+  return postToCloud(path, "application/octet-stream", payload, length, response);
+}
+
+void configureCloudClient(){
+  // Shrink the receive buffer when the server supports max fragment length
+  int rxBufferLen = UPLINK_RX_BUFFER_LEN;
+  if (BearSSL::WiFiClientSecure::probeMaxFragmentLength(GDOOR_CLOUD_HOST, GDOOR_CLOUD_PORT, UPLINK_MFL_LEN)){
+    rxBufferLen = UPLINK_MFL_LEN;
+  }
+
+  cloudClient.setBufferSizes(rxBufferLen, UPLINK_TX_BUFFER_LEN);
+  cloudClient.setSession(&cloudSession);
+  GLOG_INFO(LOG_HTTP_TLS_BUFFERS, rxBufferLen, UPLINK_TX_BUFFER_LEN);
+
+#ifdef GDOOR_CLOUD_INSECURE
+  cloudClient.setInsecure();
+  GLOG_WARN(LOG_HTTP_TLS_INSECURE);
+#else
+  cloudClient.setTrustAnchors(&cloudTrustAnchor);
+#endif
+
+  cloudHttp.setReuse(true);
+  cloudHttp.setTimeout(UPLINK_TIMEOUT_MILLIS);
+  cloudClientConfigured = true;
+}
 
 /*
  *                            Upload Boot Info
@@ -25,37 +257,47 @@ void addKeyValueJSONStringEntry(const char* key, const char* value, char* target
  *      1) Server port number
  *      2) Sensor recorderd UID
  *      3) Sensor firmware version
+ *      4) Target static IP & assigned local IP, and whether the 
+ *         static address was achieved or DHCP picked it
+ *      5) Initial door states (replaces the separate first door status updates) - 
+ *         doorState is channel 0, doorStates lists every channel
+ *      6) Millis at which the WiFi connection was established
+ *      7) Why the last reset happened - SDK reset info plus the 
+ *         supervisor's record of the stage the loop was stuck in
+ *
+ *    All uploads carry capturedAt (when the event happened) and sentAt, 
+ *    both Unix millis - 0 if the clock hadn't synced yet.
  *  
 */
 
-void uploadBootInfo(const char* portNum, const char* recordedUID, const char* firmwareVersion, const char* targetStaticIP, const char* assignedLocalIP){
-  // Create the POST request
-  Serial.print("HTTP INTERFACE: Sending boot info to server.");
-
-  // Create the JSON string
-  char payload[250];
-  sprintf(payload, "{\"serverPort\":\"%s\",\"uid\":\"%s\",\"firmwareVersion\":\"%s\",\"targetStaticIP\":\"%s\",\"assignedLocalIP\":\"%s\"}", portNum, recordedUID, firmwareVersion, targetStaticIP, assignedLocalIP);
-
-  // Have a look at the end product
-  Serial.print("HTTP INTERFACE: JSON payload = ");
-  Serial.println(payload);
+int uploadBootInfo(const char* portNum, const char* recordedUID, const char* firmwareVersion, const char* targetStaticIP, const char* assignedLocalIP, bool dhcpAddressing, const DoorState* doorStates, int channelCount, unsigned long connectedMillis, const ResetReport* resetReport, uint64_t capturedAt, uint64_t sentAt, char* response){
+  int resCode;
+  if (uplinkEncoding == UPLINK_ENCODING_BINARY){
+    uint8_t binaryPayload[BINARY_UPLINK_MAX_LEN];
+    int binaryLength = encodeBootInfoBinary(recordedUID, portNum, firmwareVersion, targetStaticIP, assignedLocalIP, dhcpAddressing, doorStates, channelCount, connectedMillis, resetReport, capturedAt, sentAt, binaryPayload);
+    GLOG_INFO(LOG_HTTP_BOOT_INFO, binaryLength);
+    resCode = postBinary("/sensorBootData", binaryPayload, binaryLength, response);
+  }
 
-  // Create the HTTP post req
-  HTTPClient httpReq;
-  httpReq.begin("http://us-central1-iot-za.cloudfunctions.net/sensorBootData");  
-  httpReq.addHeader("Content-Type", "text/plain");
+  else{
+    // Create the JSON string
+    char timestamps[TIMESTAMP_ENTRIES_LEN];
+    createTimestampEntries(capturedAt, sentAt, timestamps);
+    char payload[BOOT_INFO_JSON_LEN];
+    int payloadLength = createBootInfoJson(portNum, recordedUID, firmwareVersion, targetStaticIP, assignedLocalIP, dhcpAddressing, doorStates, channelCount, connectedMillis, resetReport, timestamps, payload);
 
-  int resCode = httpReq.POST(payload);
+    GLOG_INFO(LOG_HTTP_BOOT_INFO, payloadLength);
+    resCode = postJson("/sensorBootData", payload, response);
+  }
 
-  // Look for the response & examine 
-   String resString = httpReq.getString();
-   Serial.println();
-   Serial.print("Receieved response to HTTP POST:  ");
-   Serial.println(resCode);
-   Serial.println(resString);
+  // Later binary uploads identify by session id rather than the full UID
+  uint32_t sessionId = parseSessionId(response);
+  if (sessionId != 0){
+    uplinkSessionId = sessionId;
+    GLOG_INFO(LOG_HTTP_SESSION, sessionId);
+  }
 
-   // Close connection
-   httpReq.end();
+  return resCode;
 }
 
 
@@ -65,71 +307,60 @@ void uploadBootInfo(const char* portNum, const char* recordedUID, const char* fi
  *  for the cloud functions API endpoint & logs the response
 */
 
-void sendUpdateForState(DoorState newState, const char* senderUID){
+int sendUpdateForState(DoorState newState, int channel, const char* senderUID, uint64_t capturedAt, uint64_t sentAt){
    // Set the string to send with the http
    const char* statusStr = (newState == DOOR_STATE_OPEN) ? "00" : "01";
-   Serial.print("Creating http request to change door state to: ");
-   Serial.println(statusStr);
+   GLOG_INFO(LOG_HTTP_DOOR_STATE, channel, newState);
    
-   // Create the HTTP client class
-   HTTPClient httpReq;
+   if (uplinkEncoding == UPLINK_ENCODING_BINARY){
+     uint8_t binaryPayload[BINARY_UPLINK_MAX_LEN];
+     int binaryLength = encodeDoorStateBinary(uplinkSessionId, senderUID, newState, channel, capturedAt, sentAt, binaryPayload);
+     return postBinary("/doorStatusUpdate", binaryPayload, binaryLength, NULL);
+   }
 
    // Payload creation
-   String payload = createHttpJson(statusStr, senderUID);                                                                           // "{\"uid\":\"2XsXatJ4DgdltTMcIcrC146aUNZ2\",\"statusUpdate\":\"open\"}";
-
-   httpReq.begin("http://us-central1-iot-za.cloudfunctions.net/doorStatusUpdate");                  // "https://us-central1-iot-za.cloudfunctions.net/doorStatusUpdate"
-   httpReq.addHeader("Content-Type", "text/plain");
-   
-   // Send the post
-   int resCode = httpReq.POST(payload);      // {'uid':'2XsXatJ4DgdltTMcIcrC146aUNZ2','statusUpdate':'open'}
-
-   // Look for the response & examine 
-   String resString = httpReq.getString();
-   Serial.println();
-   Serial.print("Receieved response to HTTP POST:  ");
-   Serial.println(resCode);
-   Serial.println(resString);
+   char timestamps[TIMESTAMP_ENTRIES_LEN];
+   createTimestampEntries(capturedAt, sentAt, timestamps);
+   char payload[150];
+   createHttpJson(statusStr, channel, senderUID, timestamps, payload);
 
-   // Close connection
-   httpReq.end();
+   return postJson("/doorStatusUpdate", payload, NULL);
 }
 
 /*
  *                      Update Door Health
  *
  *  Function sends an http post to the server health check API 
- *  endpoint. The payload the current millis count. 
+ *  endpoint. The payload the current (64 bit, never wrapping) 
+ *  millis count, plus the heap & stack figures from the memory 
+ *  profiler. The response body is handed back - it can carry 
+ *  settings updates.
  * 
 */
 
-void sendHealthCheckUpdate(unsigned long currentMillis, const char* senderUID){
-  // Create the POST request
-  Serial.print("HTTP INTERFACE: Sending health update to server.");
+int sendHealthCheckUpdate(uint64_t uptimeMillis, const MemorySnapshot* memory, const char* senderUID, uint64_t capturedAt, uint64_t sentAt, char* response){
+  if (uplinkEncoding == UPLINK_ENCODING_BINARY){
+    uint8_t binaryPayload[BINARY_UPLINK_MAX_LEN];
+    int binaryLength = encodeHealthBinary(uplinkSessionId, senderUID, uptimeMillis, memory, capturedAt, sentAt, binaryPayload);
+    GLOG_INFO(LOG_HTTP_HEALTH, binaryLength);
+    return postBinary("/sensorHealthUpdate", binaryPayload, binaryLength, response);
+  }
 
   // Create the JSON string
-  char payload[150];
-  sprintf(payload, "{\"uid\":\"%s\",\"millis\":\"%lu\"}", senderUID, currentMillis);
-
-  // Have a look at the end product
-  Serial.print("HTTP INTERFACE: JSON payload = ");
-  Serial.println(payload);
-
-  // Create the HTTP post req
-  HTTPClient httpReq;
-  httpReq.begin("http://us-central1-iot-za.cloudfunctions.net/sensorHealthUpdate");  
-  httpReq.addHeader("Content-Type", "text/plain");
-
-  int resCode = httpReq.POST(payload);
+  char timestamps[TIMESTAMP_ENTRIES_LEN];
+  createTimestampEntries(capturedAt, sentAt, timestamps);
+  char payload[HEALTH_JSON_LEN];
+  int payloadLength = createHealthJson(uptimeMillis, memory, senderUID, timestamps, payload);
+
+  // Truncated JSON would only be rejected by the backend
+  if (payloadLength < 0 || payloadLength >= HEALTH_JSON_LEN){
+    GLOG_ERROR(LOG_HTTP_PAYLOAD_TRUNCATED, payloadLength, HEALTH_JSON_LEN);
+    return UPLINK_NOT_SENT;
+  }
 
-  // Look for the response & examine 
-   String resString = httpReq.getString();
-   Serial.println();
-   Serial.print("Receieved response to HTTP POST:  ");
-   Serial.println(resCode);
-   Serial.println(resString);
+  GLOG_INFO(LOG_HTTP_HEALTH, payloadLength);
 
-   // Close connection
-   httpReq.end();
+  return postJson("/sensorHealthUpdate", payload, response);
 }
 
 /*
@@ -140,33 +371,23 @@ void sendHealthCheckUpdate(unsigned long currentMillis, const char* senderUID){
  * 
 */
 
-void sendReconnectionNotification(const char* senderUID, const char* assignedLocalIP){
-  Serial.println("HTTP INTERFACE: Sending WiFi recon note to server.");
+int sendReconnectionNotification(const char* senderUID, const char* assignedLocalIP, bool dhcpAddressing, uint64_t capturedAt, uint64_t sentAt){
+  if (uplinkEncoding == UPLINK_ENCODING_BINARY){
+    uint8_t binaryPayload[BINARY_UPLINK_MAX_LEN];
+    int binaryLength = encodeReconBinary(uplinkSessionId, senderUID, assignedLocalIP, dhcpAddressing, capturedAt, sentAt, binaryPayload);
+    GLOG_INFO(LOG_HTTP_RECON, binaryLength);
+    return postBinary("/wifiReconNotification", binaryPayload, binaryLength, NULL);
+  }
 
   // Create the JSON string
-  char payload[100];
-  sprintf(payload, "{\"uid\":\"%s\",\"assignedLocalIP\":\"%s\"}", senderUID, assignedLocalIP);
-
-  // Have a look at the end product
-  Serial.print("HTTP INTERFACE: JSON payload = ");
-  Serial.println(payload);
+  char timestamps[TIMESTAMP_ENTRIES_LEN];
+  createTimestampEntries(capturedAt, sentAt, timestamps);
+  char payload[RECON_JSON_LEN];
+  int payloadLength = createReconJson(senderUID, assignedLocalIP, dhcpAddressing, timestamps, payload);
 
-  // Create the HTTP post req
-  HTTPClient httpReq;
-  httpReq.begin("http://us-central1-iot-za.cloudfunctions.net/wifiReconNotification");  
-  httpReq.addHeader("Content-Type", "text/plain");
+  GLOG_INFO(LOG_HTTP_RECON, payloadLength);
 
-  int resCode = httpReq.POST(payload);
-
-  // Look for the response & examine 
-   String resString = httpReq.getString();
-   Serial.println();
-   Serial.print("Receieved response to HTTP POST:  ");
-   Serial.println(resCode);
-   Serial.println(resString);
-
-   // Close connection
-   httpReq.end();
+  return postJson("/wifiReconNotification", payload, NULL);
 }
 
 /*
@@ -184,28 +405,6 @@ void sendReconnectionNotification(const char* senderUID, const char* assignedLoc
 
 // Utility functions
 
-const char* createHttpJson(const char* stateStr, const char* uid){
-  // Multiple concats to achieve;
-  // Target with backslashes: "{\"uid\":\"XXXXXXXXXXXXXXXXXXXXXXXXXXXX\",\"statusUpdate\":\"00\"}" Length = 58
-  Serial.print("Creating payload string for user with uid:");
-  Serial.println(uid);
-
-  // Create dummy array to mutate
-  char *payload = "{\"uid\":\"XXXXXXXXXXXXXXXXXXXXXXXXXXXX\",\"statusUpdate\":\"00\"}";
-  for (int i = 0; i < strlen(uid); i++){
-    // Need to overwrite UID placeholder:
-    payload[i + 8] = uid[i];
-  }
-
-  // Overwrite status bits
-  payload[54] = stateStr[0]; 
-  payload[55] = stateStr[1]; 
-
-  Serial.print("Sending json payload:");
-  Serial.println(payload);
-  return payload;
-}
-
 void addKeyValueJSONStringEntry(const char* key, const char* value, char* target, int* index){
     // Add the key first
     target[*index] = *"\"";
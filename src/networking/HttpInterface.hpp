@@ -13,15 +13,75 @@
 // Includes
 #include <Arduino.h>
 #include <ESP8266HTTPClient.h>
+#include <WiFiClientSecureBearSSL.h>
 #include "../constants/Constants.h"                    // ../constants/
+#include "../logging/GDoorLog.hpp"
+#include "../clock/GDoorClock.hpp"
+#include "../diagnostics/Supervisor.hpp"
+#include "../diagnostics/MemoryProfiler.hpp"
+#include "BinaryUplink.hpp"
+#include "UplinkJson.hpp"
 
 // Global constants
 // const char* remoteIPQuery = "checkip.dyndns.org";
 
-// Function declarations
-void sendUpdateForState(DoorState newState, const char* senderUID);
-void uploadBootInfo(const char* portNum, const char* recordedUID, const char* firmwareVersion, const char* targetStaticIP, const char* assignedLocalIP);
-void sendHealthCheckUpdate(unsigned long currentMillis, const char* senderUID);
-void sendReconnectionNotification(const char* senderUID, const char* assignedLocalIP);
+// Cloud endpoint - override to point the uplink at a local TLS stand-in
+#ifndef GDOOR_CLOUD_HOST
+#define GDOOR_CLOUD_HOST "us-central1-iot-za.cloudfunctions.net"
+#endif
+#ifndef GDOOR_CLOUD_PORT
+#define GDOOR_CLOUD_PORT 443
+#endif
+
+// The server is verified against CloudTrustAnchors.h, or GDOOR_CLOUD_ROOT_CA (PEM) when defined first
+// GDOOR_CLOUD_INSECURE skips verification - bench builds only, never ship it
+#if !defined(GDOOR_CLOUD_ROOT_CA) && !defined(GDOOR_CLOUD_INSECURE)
+#include "CloudTrustAnchors.h"
+#endif
+
+#define UPLINK_TX_BUFFER_LEN 1024         // Largest payload (boot info) plus request headers
+#define UPLINK_RX_BUFFER_LEN 16384        // Full TLS record - servers without max fragment length
+#define UPLINK_MFL_LEN 1024               // Requested max fragment length
+#define UPLINK_TIMEOUT_MILLIS 5000
+#define UPLINK_RESPONSE_LEN 256           // Response body kept for parsing - the rest is discarded
+#define UPLINK_CLOCK_WAIT_MILLIS 30000    // Longest uploads wait for SNTP before using the fallback time
+#define UPLINK_BUILD_STAMP_SLACK 86400    // __TIME__ is the builder's local time - a day back is never ahead of UTC
+
+typedef enum uplinkEncoding {
+  UPLINK_ENCODING_JSON,
+  UPLINK_ENCODING_BINARY
+} UplinkEncoding;
+
+typedef struct uplinkStats {
+  uint32_t uploads;
+  uint32_t handshakes;                    // Uploads that had to open a connection
+  uint32_t failures;
+  int lastResCode;
+  uint32_t lastLatencyMillis;
+  uint32_t maxLatencyMillis;
+  uint32_t totalLatencyMillis;
+} UplinkStats;
+
+#define UPLINK_NOT_SENT 0                 // Upload status when the payload never left the device
+
+// Function declarations - uploads return the HTTP status, negative on transport errors
+int sendUpdateForState(DoorState newState, int channel, const char* senderUID, uint64_t capturedAt, uint64_t sentAt);
+int uploadBootInfo(const char* portNum, const char* recordedUID, const char* firmwareVersion, const char* targetStaticIP, const char* assignedLocalIP, bool dhcpAddressing, const DoorState* doorStates, int channelCount, unsigned long connectedMillis, const ResetReport* resetReport, uint64_t capturedAt, uint64_t sentAt, char* response);
+int sendHealthCheckUpdate(uint64_t uptimeMillis, const MemorySnapshot* memory, const char* senderUID, uint64_t capturedAt, uint64_t sentAt, char* response);
+int sendReconnectionNotification(const char* senderUID, const char* assignedLocalIP, bool dhcpAddressing, uint64_t capturedAt, uint64_t sentAt);
+
+// Shared POST over the persistent TLS connection - returns the HTTP status (negative on transport errors)
+int postToCloud(const char* path, const char* contentType, const uint8_t* payload, int length, char* response);
+const UplinkStats* uplinkStats();
+
+// Certificates are checked against wall time - uploads hold until the clock has synced, 
+// or UPLINK_CLOCK_WAIT_MILLIS has passed and the fallback time is used instead
+void setUplinkClock(GDoorClock* clock);
+bool uplinkReady();
+uint32_t uplinkCertificateTime();
+
+// Payload format for every upload type - switchable at runtime
+void setUplinkEncoding(UplinkEncoding encoding);
+UplinkEncoding currentUplinkEncoding();
 
 #endif
@@ -0,0 +1,321 @@
+/*
+*	LAN control channel - mDNS advertised UDP protocol 
+*   for local actuation and status without the cloud
+*	Source file	
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+// Includes
+#include "LocalControl.hpp"
+
+// State change multicast group
+const IPAddress localControlMulticastIP(239, 255, 69, 70);
+
+static uint32_t read32(const uint8_t* source){
+  return (uint32_t)source[0] | ((uint32_t)source[1] << 8) | ((uint32_t)source[2] << 16) | ((uint32_t)source[3] << 24);
+}
+
+/*
+ *                        Datagram Layout
+ *
+ *  Phones on the LAN talk to the sensor directly on UDP port 6970, 
+ *  found through the mDNS service "_gdoor._udp". Every datagram is:
+ *
+ *    0-1    Magic "GD"
+ *    2      Protocol version
+ *    3      Command (bit 7 set on replies)
+ *    4-7    Counter (little endian)
+ *    8-11   Boot nonce (little endian)
+ *    12-15  Client id (little endian) - echoed in replies, 0 on events
+ *    16     Door channel
+ *    17-    Replies & events: door state, result
+ *    last 8 Truncated HMAC-SHA256 over everything before it
+ *
+ *  HELLO is the only unsigned request - the signed reply carries the 
+ *  boot nonce and the client's last accepted counter. Every other 
+ *  request must echo the nonce and use a counter above that one, so 
+ *  captured datagrams can't be replayed, not even after a reboot.
+ *
+ *  Counters are kept per client id, so the phones in a household 
+ *  don't race each other for one sequence. The id is under the tag - 
+ *  a replay can't claim a fresh one. When the table is full the 
+ *  least recently seen client is evicted and its counter raises the 
+ *  floor every unknown id has to clear, so its old datagrams stay 
+ *  dead; it learns the floor from its next HELLO.
+ *
+ *  Tags are keyed with the device secret. Until one is provisioned 
+ *  there is no key at all, so signed commands are refused with 
+ *  NO_SECRET - HELLO still answers (with that result) so the app 
+ *  can tell the user.
+ *
+ *  Each datagram is traced with the time it could have waited in 
+ *  the socket (the loop pass since the last poll - an upload in 
+ *  flight holds the loop for its whole round trip) plus the time 
+ *  to handle it. tools/decode_trace.py summarises the bound.
+ *
+*/
+
+GDoorLocalControl::GDoorLocalControl(){
+  running = false;
+  clientCount = 0;
+  counterFloor = 0;
+  eventCounter = 0;
+  bootNonce = 0;
+  activity = false;
+  lastPollMillis = 0;
+}
+
+void GDoorLocalControl::begin(GDoorUser* gdoorUser, GDoorIO* doorIO, const char* firmwareVersion){
+  user = gdoorUser;
+  io = doorIO;
+  bootNonce = ESP.random();
+  updateKey();
+
+  // Advertise the service - the UID routes requests so it stays out of the TXT record
+  char hostname[20];
+  sprintf(hostname, "gdoor-%06x", ESP.getChipId());
+  if (MDNS.begin(hostname)){
+    MDNS.addService("gdoor", "udp", LOCAL_CONTROL_PORT);
+    MDNS.addServiceTxt("gdoor", "udp", "fw", firmwareVersion);
+    GLOG_INFO(LOG_LOCAL_MDNS_STARTED, ESP.getChipId());
+  }
+
+  else{
+    GLOG_ERROR(LOG_LOCAL_MDNS_FAILED);
+  }
+
+  udp.begin(LOCAL_CONTROL_PORT);
+  running = true;
+}
+
+void GDoorLocalControl::handle(){
+  if (!running){
+    return;
+  }
+
+  MDNS.update();
+
+  uint32_t polledAt = millis();
+  uint32_t sinceLastPoll = polledAt - lastPollMillis;
+  lastPollMillis = polledAt;
+
+  int length = udp.parsePacket();
+  if (length <= 0){
+    return;
+  }
+
+  if (length > LOCAL_CONTROL_MAX_PACKET){
+    // Not one of ours - drain it
+    udp.read(packet, LOCAL_CONTROL_MAX_PACKET);
+    return;
+  }
+
+  udp.read(packet, length);
+  handlePacket(length);
+
+  // Upper bound - the datagram arrived at some point during the last loop pass
+  uint32_t latency = sinceLastPoll + (millis() - polledAt);
+  gdoorTrace.record(TRACE_LOCAL_LATENCY, length >= 4 ? packet[3] : 0, latency > 0xFFFF ? 0xFFFF : latency);
+}
+
+void GDoorLocalControl::broadcastState(int channel, DoorState state){
+  if (!running){
+    return;
+  }
+
+  uint8_t event[LOCAL_CONTROL_MAX_PACKET];
+  eventCounter += 1;
+  int length = writeHeader(event, LOCAL_EVT_STATE, eventCounter, 0);
+  event[length++] = (uint8_t)channel;
+  event[length++] = (uint8_t)state;
+  event[length++] = LOCAL_RESULT_OK;
+  length = signPacket(event, length);
+
+  udp.beginPacketMulticast(localControlMulticastIP, LOCAL_CONTROL_PORT, WiFi.localIP());
+  udp.write(event, length);
+  udp.endPacket();
+}
+
+void GDoorLocalControl::announceAddress(){
+  // Address may have changed (DHCP fallback) - re-announce so phones re-resolve the host
+  if (!running){
+    return;
+  }
+
+  MDNS.notifyAPChange();
+}
+
+void GDoorLocalControl::updateKey(){
+  // At boot, and again whenever the secret is provisioned or rotated
+  uint8_t key[AUTH_KEY_LEN];
+  int keyLength = GDoorRequestAuth::deviceKey(user, key);
+  br_hmac_key_init(&keyContext, &br_sha256_vtable, key, keyLength);
+  memset(key, 0, sizeof(key));
+}
+
+bool GDoorLocalControl::consumeActivity(){
+  // Authenticated traffic since the last call - presence for the rule engine
+  bool seen = activity;
+  activity = false;
+  return seen;
+}
+
+void GDoorLocalControl::handlePacket(int length){
+  IPAddress remoteIP = udp.remoteIP();
+  uint16_t remotePort = udp.remotePort();
+
+  if (length < 4 || packet[0] != 'G' || packet[1] != 'D' || packet[2] != LOCAL_CONTROL_VERSION){
+    return;
+  }
+
+  // A HELLO too short to carry an id gets the floor - what an unknown client has to clear
+  uint8_t command = packet[3];
+  uint32_t clientId = length >= LOCAL_CONTROL_HEADER_LEN ? read32(&packet[12]) : 0;
+  if (command == LOCAL_CMD_HELLO){
+    sendReply(command, lastCounter(clientId), clientId, 0, user->hasDeviceSecret ? LOCAL_RESULT_OK : LOCAL_RESULT_NO_SECRET, remoteIP, remotePort);
+    return;
+  }
+
+  if (!user->hasDeviceSecret){
+    GLOG_WARN(LOG_LOCAL_NO_SECRET, command);
+    sendReply(command, 0, clientId, 0, LOCAL_RESULT_NO_SECRET, remoteIP, remotePort);
+    return;
+  }
+
+  if (length != LOCAL_CONTROL_REQUEST_LEN || !verifyPacket(packet, length)){
+    GLOG_WARN(LOG_LOCAL_BAD_TAG);
+    sendReply(command, 0, clientId, 0, LOCAL_RESULT_BAD_TAG, remoteIP, remotePort);
+    return;
+  }
+
+  uint32_t counter = read32(&packet[4]);
+  uint32_t nonce = read32(&packet[8]);
+  uint32_t accepted = lastCounter(clientId);
+  if (nonce != bootNonce || counter <= accepted){
+    GLOG_WARN(LOG_LOCAL_REPLAY, counter, accepted);
+    sendReply(command, accepted, clientId, 0, LOCAL_RESULT_REPLAY, remoteIP, remotePort);
+    return;
+  }
+
+  acceptCounter(clientId, counter);
+  activity = true;
+
+  int channel = packet[LOCAL_CONTROL_HEADER_LEN];
+  if (channel >= io->channelCount){
+    sendReply(command, counter, clientId, 0, LOCAL_RESULT_UNKNOWN_CHANNEL, remoteIP, remotePort);
+    return;
+  }
+
+  switch (command){
+    case LOCAL_CMD_STATUS:
+      sendReply(command, counter, clientId, channel, LOCAL_RESULT_OK, remoteIP, remotePort);
+      break;
+
+    case LOCAL_CMD_ACTUATE:
+      GLOG_INFO(LOG_LOCAL_ACTUATE_REQ, channel);
+      io->actuateDoor(channel);
+      sendReply(command, counter, clientId, channel, LOCAL_RESULT_OK, remoteIP, remotePort);
+      break;
+
+    default:
+      sendReply(command, counter, clientId, channel, LOCAL_RESULT_UNKNOWN_COMMAND, remoteIP, remotePort);
+      break;
+  }
+}
+
+void GDoorLocalControl::sendReply(uint8_t command, uint32_t counter, uint32_t clientId, int channel, uint8_t result, IPAddress remoteIP, uint16_t remotePort){
+  // Every packet that gets past the framing check ends here - one trace record each
+  gdoorTrace.record(TRACE_LOCAL_COMMAND, command, result | (channel << 8));
+
+  uint8_t reply[LOCAL_CONTROL_MAX_PACKET];
+  int length = writeHeader(reply, command | LOCAL_RESPONSE, counter, clientId);
+  reply[length++] = (uint8_t)channel;
+  reply[length++] = (uint8_t)user->doorStates[channel];
+  reply[length++] = result;
+  length = signPacket(reply, length);
+
+  udp.beginPacket(remoteIP, remotePort);
+  udp.write(reply, length);
+  udp.endPacket();
+}
+
+// Client counters
+
+LocalClient* GDoorLocalControl::findClient(uint32_t clientId){
+  for (int i = 0; i < clientCount; i++){
+    if (clients[i].id == clientId){
+      return &clients[i];
+    }
+  }
+
+  return NULL;
+}
+
+uint32_t GDoorLocalControl::lastCounter(uint32_t clientId){
+  LocalClient* client = findClient(clientId);
+  return client != NULL ? client->lastCounter : counterFloor;
+}
+
+void GDoorLocalControl::acceptCounter(uint32_t clientId, uint32_t counter){
+  uint32_t now = millis();
+  LocalClient* client = findClient(clientId);
+  if (client == NULL && clientCount < LOCAL_CONTROL_CLIENTS){
+    client = &clients[clientCount++];
+  }
+
+  else if (client == NULL){
+    // Evict the least recently seen - its counter becomes the floor for every unknown id
+    client = &clients[0];
+    for (int i = 1; i < clientCount; i++){
+      if (now - clients[i].lastSeenMillis > now - client->lastSeenMillis){
+        client = &clients[i];
+      }
+    }
+
+    if (client->lastCounter > counterFloor){
+      counterFloor = client->lastCounter;
+    }
+  }
+
+  client->id = clientId;
+  client->lastCounter = counter;
+  client->lastSeenMillis = now;
+}
+
+// Utility methods
+
+int GDoorLocalControl::writeHeader(uint8_t* target, uint8_t command, uint32_t counter, uint32_t clientId){
+  target[0] = 'G';
+  target[1] = 'D';
+  target[2] = LOCAL_CONTROL_VERSION;
+  target[3] = command;
+  for (int i = 0; i < 4; i++){
+    target[4 + i] = (counter >> (8 * i)) & 0xFF;
+    target[8 + i] = (bootNonce >> (8 * i)) & 0xFF;
+    target[12 + i] = (clientId >> (8 * i)) & 0xFF;
+  }
+
+  return LOCAL_CONTROL_HEADER_LEN;
+}
+
+int GDoorLocalControl::signPacket(uint8_t* target, int length){
+  computeTag(target, length, &target[length]);
+  return length + LOCAL_CONTROL_TAG_LEN;
+}
+
+bool GDoorLocalControl::verifyPacket(const uint8_t* data, int length){
+  uint8_t expected[LOCAL_CONTROL_TAG_LEN];
+  int bodyLength = length - LOCAL_CONTROL_TAG_LEN;
+  computeTag(data, bodyLength, expected);
+  return GDoorRequestAuth::constantTimeEquals(expected, &data[bodyLength], LOCAL_CONTROL_TAG_LEN);
+}
+
+void GDoorLocalControl::computeTag(const uint8_t* data, int length, uint8_t* tag){
+  br_hmac_context context;
+  br_hmac_init(&context, &keyContext, LOCAL_CONTROL_TAG_LEN);
+  br_hmac_update(&context, data, length);
+  br_hmac_out(&context, tag);
+}
@@ -0,0 +1,96 @@
+/*
+*	LAN control channel - mDNS advertised UDP protocol 
+*   for local actuation and status without the cloud
+*	Header file	
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#ifndef LocalControl_h
+#define LocalControl_h
+
+// Includes
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <ESP8266mDNS.h>
+#include <WiFiUdp.h>
+#include <bearssl/bearssl.h>
+#include "../constants/Constants.h"
+#include "../logging/GDoorLog.hpp"
+#include "../diagnostics/TraceRecorder.hpp"
+#include "../digital-io/GDoorIO.hpp"
+#include "../user/GDoorUser.hpp"
+#include "../security/RequestAuth.hpp"
+
+// Protocol constants
+#define LOCAL_CONTROL_PORT 6970
+#define LOCAL_CONTROL_VERSION 2
+#define LOCAL_CONTROL_HEADER_LEN 16
+#define LOCAL_CONTROL_TAG_LEN 8
+#define LOCAL_CONTROL_REQUEST_LEN (LOCAL_CONTROL_HEADER_LEN + 1 + LOCAL_CONTROL_TAG_LEN)
+#define LOCAL_CONTROL_MAX_PACKET 32
+#define LOCAL_CONTROL_CLIENTS 8               // Apps with a counter of their own - the least recently seen is evicted
+
+typedef enum localCommand {
+  LOCAL_CMD_HELLO   = 0x01,
+  LOCAL_CMD_STATUS  = 0x02,
+  LOCAL_CMD_ACTUATE = 0x03,
+  LOCAL_EVT_STATE   = 0x10,
+  LOCAL_RESPONSE    = 0x80
+} LocalCommand;
+
+typedef enum localResult {
+  LOCAL_RESULT_OK,
+  LOCAL_RESULT_BAD_TAG,
+  LOCAL_RESULT_REPLAY,
+  LOCAL_RESULT_UNKNOWN_COMMAND,
+  LOCAL_RESULT_UNKNOWN_CHANNEL,
+  LOCAL_RESULT_NO_SECRET
+} LocalResult;
+
+typedef struct localClient {
+  uint32_t id;                                // Random per app install
+  uint32_t lastCounter;
+  uint32_t lastSeenMillis;
+} LocalClient;
+
+class GDoorLocalControl {
+  public:
+    GDoorLocalControl();
+
+    void begin(GDoorUser* user, GDoorIO* io, const char* firmwareVersion);
+    void handle();
+    void broadcastState(int channel, DoorState state);
+    void announceAddress();
+    void updateKey();
+    bool consumeActivity();
+
+  private:
+    GDoorUser* user;
+    GDoorIO* io;
+    WiFiUDP udp;
+    bool running;
+    uint32_t bootNonce;
+    LocalClient clients[LOCAL_CONTROL_CLIENTS];
+    int clientCount;
+    uint32_t counterFloor;                    // Highest counter of an evicted client
+    uint32_t eventCounter;
+    bool activity;
+    uint32_t lastPollMillis;
+    uint8_t packet[LOCAL_CONTROL_MAX_PACKET];
+    br_hmac_key_context keyContext;
+
+    void handlePacket(int length);
+    void sendReply(uint8_t command, uint32_t counter, uint32_t clientId, int channel, uint8_t result, IPAddress remoteIP, uint16_t remotePort);
+    LocalClient* findClient(uint32_t clientId);
+    uint32_t lastCounter(uint32_t clientId);
+    void acceptCounter(uint32_t clientId, uint32_t counter);
+    int writeHeader(uint8_t* target, uint8_t command, uint32_t counter, uint32_t clientId);
+    int signPacket(uint8_t* target, int length);
+    bool verifyPacket(const uint8_t* data, int length);
+    void computeTag(const uint8_t* data, int length, uint8_t* tag);
+};
+
+#endif
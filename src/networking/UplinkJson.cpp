@@ -0,0 +1,53 @@
+/*
+*	JSON upload payloads - the text encoding the cloud 
+*   functions have always taken
+*	Source file	
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+// Includes
+#include "UplinkJson.hpp"
+
+int createBootInfoJson(const char* portNum, const char* recordedUID, const char* firmwareVersion, const char* targetStaticIP, const char* assignedLocalIP, bool dhcpAddressing, const DoorState* doorStates, int channelCount, unsigned long connectedMillis, const ResetReport* resetReport, const char* timestamps, char* target){
+  const char* doorStateStr = (doorStates[0] == DOOR_STATE_OPEN) ? "00" : "01";
+  char doorStatesStr[(MAX_DOOR_CHANNELS * 5) + 1];
+  int index = 0;
+  for (int i = 0; i < channelCount; i++){
+    index += sprintf(&doorStatesStr[index], "%s\"%s\"", (i > 0) ? "," : "", (doorStates[i] == DOOR_STATE_OPEN) ? "00" : "01");
+  }
+
+  char resetStr[RESET_REPORT_JSON_LEN];
+  sprintf(resetStr, "\"reset\":{\"reason\":%u,\"excCause\":%u,\"epc1\":%u,\"fault\":%u,\"stage\":%u,\"stageMillis\":%u,\"freeStack\":%u,\"trail\":%u}", 
+    resetReport->resetReason, resetReport->exceptionCause, resetReport->exceptionAddress, resetReport->fault, resetReport->stage, resetReport->stageMillis, resetReport->freeContStack, resetReport->stageTrail);
+
+  return sprintf(target, "{\"serverPort\":\"%s\",\"uid\":\"%s\",\"firmwareVersion\":\"%s\",\"targetStaticIP\":\"%s\",\"assignedLocalIP\":\"%s\",\"addressing\":\"%s\",\"doorState\":\"%s\",\"doorStates\":[%s],\"connectedMillis\":\"%lu\",%s,%s}", portNum, recordedUID, firmwareVersion, targetStaticIP, assignedLocalIP, dhcpAddressing ? "dhcp" : "static", doorStateStr, doorStatesStr, connectedMillis, resetStr, timestamps);
+}
+
+int createHttpJson(const char* stateStr, int channel, const char* uid, const char* timestamps, char* target){
+  // Target with backslashes: "{\"uid\":\"XXXXXXXXXXXXXXXXXXXXXXXXXXXX\",\"statusUpdate\":\"00\",\"channel\":\"0\",<timestamps>}"
+  return sprintf(target, "{\"uid\":\"%s\",\"statusUpdate\":\"%s\",\"channel\":\"%d\",%s}", uid, stateStr, channel, timestamps);
+}
+
+int createReconJson(const char* uid, const char* assignedLocalIP, bool dhcpAddressing, const char* timestamps, char* target){
+  return sprintf(target, "{\"uid\":\"%s\",\"assignedLocalIP\":\"%s\",\"addressing\":\"%s\",%s}", uid, assignedLocalIP, dhcpAddressing ? "dhcp" : "static", timestamps);
+}
+
+int createHealthJson(uint64_t uptimeMillis, const MemorySnapshot* memory, const char* uid, const char* timestamps, char* target){
+  // Bounded - the caller checks the length rather than sending truncated JSON
+  char uptimeStr[CLOCK_MILLIS_STR_LEN];
+  GDoorClock::formatMillis(uptimeMillis, uptimeStr);
+  return snprintf(target, HEALTH_JSON_LEN, "{\"uid\":\"%s\",\"millis\":\"%s\",\"freeHeap\":%u,\"minFreeHeap\":%u,\"maxFreeBlock\":%u,\"heapFragmentation\":%u,\"freeContStack\":%u,%s}", 
+    uid, uptimeStr, memory->freeHeap, memory->minFreeHeap, memory->maxFreeBlock, memory->fragmentation, memory->freeContStack, timestamps);
+}
+
+void createTimestampEntries(uint64_t capturedAt, uint64_t sentAt, char* target){
+  // "capturedAt":"<millis>","sentAt":"<millis>"
+  char capturedStr[CLOCK_MILLIS_STR_LEN];
+  char sentStr[CLOCK_MILLIS_STR_LEN];
+  GDoorClock::formatMillis(capturedAt, capturedStr);
+  GDoorClock::formatMillis(sentAt, sentStr);
+  sprintf(target, "\"capturedAt\":\"%s\",\"sentAt\":\"%s\"", capturedStr, sentStr);
+}
@@ -0,0 +1,37 @@
+/*
+*	JSON upload payloads - the text encoding the cloud 
+*   functions have always taken
+*	Header file	
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#ifndef UplinkJson_h
+#define UplinkJson_h
+
+// Includes
+#include <Arduino.h>
+#include "../constants/Constants.h"
+#include "../clock/GDoorClock.hpp"
+#include "../diagnostics/Supervisor.hpp"
+#include "../diagnostics/MemoryProfiler.hpp"
+
+#define TIMESTAMP_ENTRIES_LEN 80
+#define BOOT_INFO_JSON_LEN 512
+#define RESET_REPORT_JSON_LEN 160
+// Worst case - names & punctuation, 28 char UID, uint64 uptime, five uint32 memory fields, timestamps
+#define HEALTH_JSON_FIXED_LEN 104
+#define HEALTH_JSON_LEN (HEALTH_JSON_FIXED_LEN + 28 + (CLOCK_MILLIS_STR_LEN - 1) + (5 * 10) + (TIMESTAMP_ENTRIES_LEN - 1) + 1)
+#define RECON_JSON_LEN 150
+
+// Builders - return the payload length. No network code, so the host benchmarks & tests link them too.
+int createBootInfoJson(const char* portNum, const char* recordedUID, const char* firmwareVersion, const char* targetStaticIP, const char* assignedLocalIP, bool dhcpAddressing, const DoorState* doorStates, int channelCount, unsigned long connectedMillis, const ResetReport* resetReport, const char* timestamps, char* target);
+int createHttpJson(const char* stateStr, int channel, const char* uid, const char* timestamps, char* target);
+int createReconJson(const char* uid, const char* assignedLocalIP, bool dhcpAddressing, const char* timestamps, char* target);
+// Bounded by HEALTH_JSON_LEN - returns the length it needed, so HEALTH_JSON_LEN or more means truncated
+int createHealthJson(uint64_t uptimeMillis, const MemorySnapshot* memory, const char* uid, const char* timestamps, char* target);
+void createTimestampEntries(uint64_t capturedAt, uint64_t sentAt, char* target);
+
+#endif
@@ -0,0 +1,86 @@
+/*
+*	Fixed size queue of pending cloud uploads
+*	Source file	
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+// Includes
+#include "UploadQueue.hpp"
+
+/*
+ *                        Upload Queue
+ *
+ *  Events are captured where they happen (door transitions, 
+ *  health timer, reconnects) and sent from the main loop one 
+ *  at a time, so a slow POST never delays sampling or the 
+ *  next server request by more than a single upload.
+ *
+ *  Events can be held back until a given time. Boot and reconnect 
+ *  notes are jittered so a regional power cut doesn't become a 
+ *  synchronized burst across the fleet - pop() hands out the 
+ *  oldest event that is due, so a held event never delays a 
+ *  door update queued behind it. A failed upload goes back on 
+ *  the queue the same way, held until its backoff runs out & 
+ *  still carrying the time it was captured.
+ *
+*/
+
+UploadQueue::UploadQueue(){
+  head = 0;
+  count = 0;
+}
+
+bool UploadQueue::push(UploadType type, DoorState doorState, uint64_t capturedAt, int channel, uint64_t notBefore){
+  if (count == UPLOAD_QUEUE_CAPACITY){
+    GLOG_WARN(LOG_UPLOAD_QUEUE_FULL, type);
+    return false;
+  }
+
+  UploadEvent* event = &events[(head + count) % UPLOAD_QUEUE_CAPACITY];
+  event->type = type;
+  event->doorState = doorState;
+  event->channel = channel;
+  event->attempts = 0;
+  event->capturedAt = capturedAt;
+  event->notBefore = notBefore;
+  count += 1;
+  return true;
+}
+
+bool UploadQueue::pop(UploadEvent* event, uint64_t now){
+  for (int i = 0; i < count; i++){
+    int index = (head + i) % UPLOAD_QUEUE_CAPACITY;
+    if (events[index].notBefore > now){
+      continue;
+    }
+
+    *event = events[index];
+
+    // Close the gap - shift the events ahead of it back by one
+    for (int j = i; j > 0; j--){
+      events[(head + j) % UPLOAD_QUEUE_CAPACITY] = events[(head + j - 1) % UPLOAD_QUEUE_CAPACITY];
+    }
+
+    head = (head + 1) % UPLOAD_QUEUE_CAPACITY;
+    count -= 1;
+    return true;
+  }
+
+  return false;
+}
+
+bool UploadQueue::retry(const UploadEvent* event, uint64_t notBefore){
+  if (!push(event->type, event->doorState, event->capturedAt, event->channel, notBefore)){
+    return false;
+  }
+
+  events[(head + count - 1) % UPLOAD_QUEUE_CAPACITY].attempts = event->attempts + 1;
+  return true;
+}
+
+int UploadQueue::depth(){
+  return count;
+}
@@ -0,0 +1,51 @@
+/*
+*	Fixed size queue of pending cloud uploads
+*	Header file	
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#ifndef UploadQueue_h
+#define UploadQueue_h
+
+// Includes
+#include <Arduino.h>
+#include "../constants/Constants.h"
+#include "../logging/GDoorLog.hpp"
+
+#define UPLOAD_QUEUE_CAPACITY 8
+
+typedef enum uploadType {
+  UPLOAD_BOOT_INFO,
+  UPLOAD_DOOR_STATE,
+  UPLOAD_HEALTH_CHECK,
+  UPLOAD_WIFI_RECON
+} UploadType;
+
+typedef struct uploadEvent {
+  UploadType type;
+  DoorState doorState;
+  uint8_t channel;
+  uint8_t attempts;                     // Failed sends so far
+  uint64_t capturedAt;                  // Monotonic millis at capture
+  uint64_t notBefore;                   // Monotonic millis - spreads fleet wide bursts
+} UploadEvent;
+
+class UploadQueue {
+  public:
+    UploadQueue();
+
+    bool push(UploadType type, DoorState doorState, uint64_t capturedAt, int channel = 0, uint64_t notBefore = 0);
+    bool pop(UploadEvent* event, uint64_t now);
+    bool retry(const UploadEvent* event, uint64_t notBefore);
+    int depth();
+
+  private:
+    UploadEvent events[UPLOAD_QUEUE_CAPACITY];
+    int head;
+    int count;
+};
+
+#endif
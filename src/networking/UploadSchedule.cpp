@@ -0,0 +1,133 @@
+/*
+*	When the periodic & connection uploads leave - 
+*   health ping phase & fleet wide burst spreading
+*	Source file	
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+// Includes
+#include "UploadSchedule.hpp"
+
+/*
+ *                        Upload Schedule
+ *
+ *  Sensors that come up together after a regional power cut or 
+ *  ISP outage would otherwise hit the backend in lock step: the 
+ *  boot notes within a second of each other and the health pings 
+ *  on the same 15 minute beat from then on.
+ *
+ *  The first health ping after a (re)connection lands at a per 
+ *  device phase derived from the UID rather than a full interval 
+ *  later, and the boot & reconnect notes are held back a random 
+ *  amount within the spread window. The random value is passed in 
+ *  so the host fleet simulator (test/host/fleet_sim.cpp) runs this 
+ *  exact code.
+ *
+ *  The same goes for retries: an upload that failed in a way that 
+ *  may clear up (no connection, 408, 429, 5xx) is re-queued after 
+ *  a backoff that doubles per attempt, with the upper half of it 
+ *  random so an outage's worth of retries doesn't come back in step.
+ *
+*/
+
+GDoorUploadSchedule::GDoorUploadSchedule(){
+  uid = "";
+  healthInterval = 0;
+  spreadWindow = UPLOAD_SPREAD_DEFAULT;
+  healthPhase = 0;
+  connectionEstablishedAt = 0;
+  nextHealthCheckMillis = 0;
+  isConnected = false;
+}
+
+void GDoorUploadSchedule::begin(const char* deviceUID){
+  uid = deviceUID;
+}
+
+void GDoorUploadSchedule::setInterval(unsigned long interval, uint64_t now){
+  if (interval == healthInterval || interval == 0){
+    return;
+  }
+
+  healthInterval = interval;
+  healthPhase = phaseOffset(healthInterval);
+
+  // A shorter interval takes effect straight away rather than after the old one runs out
+  if (isConnected && nextHealthCheckMillis > now + healthInterval){
+    nextHealthCheckMillis = now + healthPhase;
+  }
+}
+
+void GDoorUploadSchedule::connected(uint64_t now){
+  // No need for a health check straight after the boot / recon note
+  isConnected = true;
+  connectionEstablishedAt = now;
+  nextHealthCheckMillis = now + healthPhase;
+}
+
+bool GDoorUploadSchedule::healthCheckDue(uint64_t now){
+  // The 64 bit monotonic clock doesn't roll over, so no special handling is needed
+  if (!isConnected || now < nextHealthCheckMillis){
+    return false;
+  }
+
+  nextHealthCheckMillis = now + healthInterval;
+  return true;
+}
+
+void GDoorUploadSchedule::setSpread(unsigned long window){
+  // Applies to the next (re)connection - a note already held keeps its time
+  spreadWindow = window;
+}
+
+uint64_t GDoorUploadSchedule::holdUntil(UploadType type, uint32_t random){
+  // Door states & health pings are already spread out
+  if ((type != UPLOAD_BOOT_INFO && type != UPLOAD_WIFI_RECON) || spreadWindow == 0){
+    return 0;
+  }
+
+  return connectionEstablishedAt + (random % spreadWindow);
+}
+
+bool GDoorUploadSchedule::shouldRetry(UploadType type, int resCode, uint8_t attempts){
+  // The next health ping supersedes a failed one
+  if (type == UPLOAD_HEALTH_CHECK || attempts >= UPLOAD_RETRY_ATTEMPTS){
+    return false;
+  }
+
+  // Other 4xx won't go through however often they're sent, 0 never left the device
+  return resCode < 0 || resCode == 408 || resCode == 429 || resCode >= 500;
+}
+
+uint64_t GDoorUploadSchedule::retryAt(uint8_t attempts, uint64_t now, uint32_t random){
+  uint64_t backoff = UPLOAD_RETRY_CAP;
+  if (attempts < 16 && ((uint64_t)UPLOAD_RETRY_BASE << attempts) < UPLOAD_RETRY_CAP){
+    backoff = (uint64_t)UPLOAD_RETRY_BASE << attempts;
+  }
+
+  return now + (backoff / 2) + (random % ((backoff / 2) + 1));
+}
+
+uint64_t GDoorUploadSchedule::connectedAt(){
+  return connectionEstablishedAt;
+}
+
+uint64_t GDoorUploadSchedule::nextHealthCheck(){
+  return nextHealthCheckMillis;
+}
+
+// Private methods
+
+uint64_t GDoorUploadSchedule::phaseOffset(unsigned long window){
+  // FNV-1a - stable per device, evenly spread across the fleet
+  uint32_t hash = 2166136261UL;
+  for (int i = 0; uid[i] != 0; i++){
+    hash ^= (uint8_t)uid[i];
+    hash *= 16777619UL;
+  }
+
+  return hash % window;
+}
@@ -0,0 +1,67 @@
+/*
+*	When the periodic & connection uploads leave - 
+*   health ping phase & fleet wide burst spreading
+*	Header file	
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#ifndef UploadSchedule_h
+#define UploadSchedule_h
+
+// Includes
+#include <Arduino.h>
+#include "UploadQueue.hpp"
+
+// Boot & recon notes from a fleet that reconnects together are spread over a window the 
+// backend drains with headroom to spare - fleet size / capacity x headroom, 100 s by default. 
+// The uploadSpread setting overrides it once the cloud knows better (see fleet_sim.cpp)
+#ifndef GDOOR_FLEET_SIZE
+#define GDOOR_FLEET_SIZE 5000
+#endif
+#ifndef GDOOR_BACKEND_RATE
+#define GDOOR_BACKEND_RATE 100            // Requests per second the cloud functions absorb
+#endif
+#define UPLOAD_SPREAD_HEADROOM 2
+#define UPLOAD_SPREAD_DEFAULT ((GDOOR_FLEET_SIZE * 1000UL / GDOOR_BACKEND_RATE) * UPLOAD_SPREAD_HEADROOM)
+#define UPLOAD_SPREAD_MAX 600000
+
+// Failed uploads are re-queued with jittered exponential backoff - the attempts span about 10 minutes
+#define UPLOAD_RETRY_BASE 2000            // Backoff before the first retry (millis)
+#define UPLOAD_RETRY_CAP 60000            // Longest backoff between attempts
+#define UPLOAD_RETRY_ATTEMPTS 20          // Attempts before the event is dropped
+
+class GDoorUploadSchedule {
+  public:
+    GDoorUploadSchedule();
+
+    // Times are monotonic millis - the caller owns the clock & the random source
+    void begin(const char* deviceUID);
+    void setInterval(unsigned long interval, uint64_t now);
+    void connected(uint64_t now);
+    bool healthCheckDue(uint64_t now);
+    void setSpread(unsigned long window);
+    uint64_t holdUntil(UploadType type, uint32_t random);
+
+    // resCode is the upload's HTTP status (negative on transport errors) - false when the event should be dropped
+    static bool shouldRetry(UploadType type, int resCode, uint8_t attempts);
+    static uint64_t retryAt(uint8_t attempts, uint64_t now, uint32_t random);
+
+    uint64_t connectedAt();
+    uint64_t nextHealthCheck();
+
+  private:
+    const char* uid;
+    unsigned long healthInterval;
+    unsigned long spreadWindow;
+    uint64_t healthPhase;                 // Per device offset into the health interval
+    uint64_t connectionEstablishedAt;
+    uint64_t nextHealthCheckMillis;
+    bool isConnected;
+
+    uint64_t phaseOffset(unsigned long window);
+};
+
+#endif
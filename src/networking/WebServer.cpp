@@ -1,7 +1,7 @@
 /*
-*	Class to handle Web Server creation 
+*	Class to handle Web Server creation
 *   and maintenance on ESP8266 chip
-*	Source file	
+*	Source file
 *
 *	Author: Josh Perry
 *	Copyright 2018
@@ -10,41 +10,251 @@
 // Include
 #include "WebServer.hpp"
 
-// Implementation
-WebServer::WebServer() {
-	// Empty constructure - ntohing to do here
+/*
+ *                        Routing
+ *
+ *  The listener is a member, so it lives as long as the component
+ *  rather than the function that set it up, and each instance can
+ *  listen on its own port.
+ *
+ *  Nothing is registered with ESP8266WebServer::on() - every request
+ *  lands in dispatch() (the not-found hook, whose only capture is
+ *  this, held inline by std::function) and is matched against the
+ *  route table here:
+ *
+ *    /                             greeting, unsigned
+ *    /<uid>/<name>                 channel = -1
+ *    /<uid>/<channel>/<name>       channel scoped routes only
+ *
+ *  Every /<uid>/ route is signature checked before its handler runs,
+ *  so handlers only deal with authorized requests. The method is part 
+ *  of the signed string, so only GET, POST, PUT & DELETE are served - 
+ *  anything else is a 405.
+ *
+*/
+
+GDoorWebServer::GDoorWebServer(){
+  auth = NULL;
+  lastAuth = AUTH_MISSING_HEADERS;
+  uid = "";
+  uidLength = 0;
+  channelCount = 0;
+  routeCount = 0;
+  response[0] = 0;
+}
+
+bool GDoorWebServer::on(const char* name, WebRouteHandler handler, void* context, bool channelScoped){
+  if (routeCount >= WEB_SERVER_MAX_ROUTES){
+    GLOG_ERROR(LOG_SERVER_ROUTES_FULL, WEB_SERVER_MAX_ROUTES);
+    return false;
+  }
+
+  WebRoute* route = &routes[routeCount];
+  route->name = name;
+  route->handler = handler;
+  route->context = context;
+  route->channelScoped = channelScoped;
+  routeCount += 1;
+  return true;
+}
+
+void GDoorWebServer::begin(const char* deviceUID, uint16_t port, int doorChannels, GDoorRequestAuth* requestAuth){
+  uid = deviceUID;
+  uidLength = strlen(deviceUID);
+  channelCount = doorChannels;
+  auth = requestAuth;
+
+  // Signature headers have to be collected up front to be readable in the handlers
+  const char* authHeaders[] = { AUTH_HEADER_NONCE, AUTH_HEADER_TIMESTAMP, AUTH_HEADER_SIGNATURE };
+  server.collectHeaders(authHeaders, 3);
+  server.onNotFound([this]() { dispatch(); });
+
+  GLOG_INFO(LOG_SERVER_ENDPOINTS, servedEndpoints());
+  server.begin(port);
+}
+
+void GDoorWebServer::handle(){
+  server.handleClient();
 }
 
+int GDoorWebServer::servedEndpoints(){
+  // Every /<uid>/ route, channel scoped ones once per channel as well
+  int endpoints = routeCount;
+  for (int i = 0; i < routeCount; i++){
+    if (routes[i].channelScoped){
+      endpoints += channelCount;
+    }
+  }
 
-void WebServer::startHttpServer(const char* uid, IPAddress assignedIP){
-	// Instantiate the server
-	ESP8266WebServer server(80);
+  return endpoints;
+}
+
+ESP8266WebServer* GDoorWebServer::request(){
+  return &server;
+}
 
-	// Constructor
-	localIP = assignedIP;
-	Serial.print("WEB SERVER: Listening on port 80 with IP:");
-	Serial.println(localIP);
+AuthResult GDoorWebServer::authResult(){
+  return lastAuth;
+}
 
-	// Setup up the callback functions
-	char* targetURL = "/XXXXXXXXXXXXXXXXXXXXXXXXXXXX";	
-	for (int i = 1; i < 29; i++){
-	 	targetURL[i] = uid[i];
-	} 
+char* GDoorWebServer::responseBuffer(){
+  return response;
+}
 
-	// Configure the URL to listen for
-	server.on("/", [&server]() {   //Define the handling function for the path
-    	Serial.println("WEB SERVER: Received http req");
-    	server.send(200, "text / plain", "Garage door listening loud and clear!");
-  	});
-	
-	// Spin up the bugger!
-	server.begin();
+void GDoorWebServer::send(int code, const char* contentType, const char* body){
+  server.send(code, contentType, body);
 }
 
+const WebRoute* GDoorWebServer::findRoute(const char* path, int* channel){
+  // Expects /<uid>/[<channel>/]<name>
+  if (path[0] != '/' || strncmp(&path[1], uid, uidLength) != 0 || path[uidLength + 1] != '/'){
+    return NULL;
+  }
+
+  const char* name = &path[uidLength + 2];
+  if (isdigit(name[0])){
+    // Capped so a long digit run can't overflow parsed
+    int parsed = 0;
+    int digits = 0;
+    while (isdigit(*name)){
+      if (digits == WEB_SERVER_CHANNEL_DIGITS){
+        return NULL;
+      }
 
-void WebServer::initiateDoorAction() {
-	// Handler function triggered for incoming http req
-	// Testing: 80/192.168.8.101
+      parsed = (parsed * 10) + (*name - '0');
+      digits += 1;
+      name += 1;
+    }
 
-	Serial.println("WEB SERVER: Received http req");
-}
\ No newline at end of file
+    if (*name != '/' || parsed >= channelCount){
+      return NULL;
+    }
+
+    *channel = parsed;
+    name += 1;
+  }
+
+  for (int i = 0; i < routeCount; i++){
+    if (strcmp(routes[i].name, name) != 0){
+      continue;
+    }
+
+    if (*channel >= 0 && !routes[i].channelScoped){
+      return NULL;
+    }
+
+    return &routes[i];
+  }
+
+  return NULL;
+}
+
+// Private methods
+
+void GDoorWebServer::dispatch(){
+  // Held by reference - older cores return the uri by value
+  const String& uri = server.uri();
+  const char* path = uri.c_str();
+
+  if (strcmp(path, "/") == 0){
+    GLOG_INFO(LOG_SERVER_ROOT_REQ);
+    server.send(200, "text/plain", "Hello, Garage Door here. How can I help you paranoid human?");
+    return;
+  }
+
+  int channel = -1;
+  const WebRoute* route = findRoute(path, &channel);
+  if (route == NULL){
+    GLOG_WARN(LOG_SERVER_NOT_FOUND);
+    server.send(404, "text/plain", "Not found");
+    return;
+  }
+
+  // Unknown methods are refused rather than signed as something else
+  const char* method = methodName(server.method());
+  if (method == NULL){
+    GLOG_WARN(LOG_SERVER_BAD_METHOD, server.method());
+    server.send(405, "text/plain", "Method not allowed");
+    return;
+  }
+
+  if (!authorize(path, method)){
+    return;
+  }
+
+  route->handler(this, route->context, channel);
+}
+
+
+bool GDoorWebServer::authorize(const char* path, const char* method){
+  // Sends the 401 itself - handlers are never called for rejected requests
+  // The response buffer is free until the handler runs, so it holds the canonical query
+  char* query = canonicalQuery(response, AUTH_QUERY_MAX_LEN) ? response : NULL;
+  AuthResult result = auth->verify(method, path, query,
+    server.header(AUTH_HEADER_NONCE).c_str(), server.header(AUTH_HEADER_TIMESTAMP).c_str(), server.header(AUTH_HEADER_SIGNATURE).c_str());
+  gdoorTrace.record(TRACE_HTTP_REQUEST, result, GDoorTrace::routeHash(path));
+  lastAuth = result;
+
+  if (result == AUTH_OK){
+    return true;
+  }
+
+  if (result == AUTH_LEGACY){
+    GLOG_DEBUG(LOG_AUTH_LEGACY);
+    return true;
+  }
+
+  GLOG_WARN(LOG_AUTH_REJECTED, result);
+  if (result == AUTH_BUSY){
+    server.send(503, "text/plain", "Busy");
+    return false;
+  }
+
+  server.send(401, "text/plain", "Unauthorized");
+  return false;
+}
+
+bool GDoorWebServer::canonicalQuery(char* target, int capacity){
+  // Arguments in name order - see RequestAuth.cpp for the encoding
+  int count = server.args();
+  if (count > WEB_SERVER_MAX_ARGS){
+    return false;
+  }
+
+  int order[WEB_SERVER_MAX_ARGS];
+  for (int i = 0; i < count; i++){
+    int j = i;
+    while (j > 0 && strcmp(server.argName(order[j - 1]).c_str(), server.argName(i).c_str()) > 0){
+      order[j] = order[j - 1];
+      j -= 1;
+    }
+
+    order[j] = i;
+  }
+
+  int length = 0;
+  target[0] = 0;
+  for (int i = 0; i < count; i++){
+    if (!GDoorRequestAuth::appendQueryParam(target, &length, capacity, server.argName(order[i]).c_str(), server.arg(order[i]).c_str())){
+      return false;
+    }
+  }
+
+  return true;
+}
+
+const char* GDoorWebServer::methodName(HTTPMethod method){
+  // The methods the routes serve - NULL for the rest
+  switch (method){
+    case HTTP_GET:
+      return "GET";
+    case HTTP_POST:
+      return "POST";
+    case HTTP_PUT:
+      return "PUT";
+    case HTTP_DELETE:
+      return "DELETE";
+    default:
+      return NULL;
+  }
+}
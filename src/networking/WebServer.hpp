@@ -1,7 +1,7 @@
 /*
-*	Class to handle Web Server creation 
+*	Class to handle Web Server creation
 *   and maintenance on ESP8266 chip
-*	Header file	
+*	Header file
 *
 *	Author: Josh Perry
 *	Copyright 2018
@@ -13,22 +13,62 @@
 // Includes
 #include <ESP8266WebServer.h>
 #include <Arduino.h>
+#include "../logging/GDoorLog.hpp"
+#include "../security/RequestAuth.hpp"
+#include "../diagnostics/TraceRecorder.hpp"
 
-class WebServer {
-	// Class interface
-	public:
-		// Instance variables
-		ESP8266WebServer server;
-		IPAddress localIP;
+#define WEB_SERVER_MAX_ROUTES 12
+#define WEB_SERVER_RESPONSE_LEN 1024      // Shared by every handler - sized for the diagnostics report
+#define WEB_SERVER_MAX_ARGS 16            // Arguments covered by a request signature
+#define WEB_SERVER_CHANNEL_DIGITS 2       // Longest /<uid>/<channel>/ segment - anything longer is a 404
 
-		// constructor 
-		WebServer();
+class GDoorWebServer;
 
-		// General functions
-		void startHttpServer(const char* uid, IPAddress assignedIP);
+// Route callback - channel is the /<uid>/<channel>/ segment, -1 on the plain /<uid>/ route
+typedef void (*WebRouteHandler)(GDoorWebServer* web, void* context, int channel);
 
-	private:
-		void initiateDoorAction();
+typedef struct webRoute {
+  const char* name;                       // Endpoint name - not copied, use literals
+  WebRouteHandler handler;
+  void* context;
+  bool channelScoped;                     // Also served as /<uid>/<channel>/<name>
+} WebRoute;
+
+class GDoorWebServer {
+  public:
+    GDoorWebServer();
+
+    // Routes are registered before begin() - the table is fixed size
+    bool on(const char* name, WebRouteHandler handler, void* context, bool channelScoped = false);
+    void begin(const char* deviceUID, uint16_t port, int doorChannels, GDoorRequestAuth* requestAuth);
+    void handle();
+    int servedEndpoints();
+
+    // For handlers - the request being served & the shared response buffer
+    ESP8266WebServer* request();
+    AuthResult authResult();                // AUTH_OK when signed, AUTH_LEGACY when not
+    char* responseBuffer();
+    void send(int code, const char* contentType, const char* body);
+
+    // Route lookup on its own - exposed for the hot path benchmarks
+    const WebRoute* findRoute(const char* path, int* channel);
+
+  private:
+    ESP8266WebServer server;
+    GDoorRequestAuth* auth;
+    AuthResult lastAuth;
+    const char* uid;
+    int uidLength;
+    int channelCount;
+
+    WebRoute routes[WEB_SERVER_MAX_ROUTES];
+    int routeCount;
+    char response[WEB_SERVER_RESPONSE_LEN];
+
+    void dispatch();
+    bool authorize(const char* path, const char* method);
+    bool canonicalQuery(char* target, int capacity);
+    static const char* methodName(HTTPMethod method);
 };
 
 
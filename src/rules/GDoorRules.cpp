@@ -0,0 +1,385 @@
+/*
+*	On-device rule engine - auto-close & scheduled actuation, 
+*   run from a compiled rule table kept in EEPROM
+*	Source file	
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+// Includes
+#include "GDoorRules.hpp"
+
+/*
+ *                        Rule Table
+ *
+ *  Rules are compiled off the device (tools/compile_rules.py) into 
+ *  8 byte records, little endian:
+ *    0     opcode            auto-close / schedule
+ *    1     channel
+ *    2     condition flags   if-open, if-closed, unless-present
+ *    3     presence window   minutes
+ *    4-7   param             seconds open / second of the day (UTC)
+ *
+ *  and loaded as hex through the signed /<uid>/Rules endpoint.
+ *
+ *  Nothing is scanned per loop pass: every rule keeps its own 
+ *  deadline, armed by the event it depends on - a door opening arms 
+ *  that channel's auto-close, a clock sync or a firing arms the 
+ *  schedule for its next occurrence - and tick() compares the 
+ *  earliest deadline against now. Rules are only walked when one 
+ *  is due or an event re-arms them.
+ *
+ *  Presence is recent authenticated LAN control traffic (someone's 
+ *  phone is home). Rules flagged unless-present are pushed back to 
+ *  the end of the presence window instead of firing.
+ *
+ *  An auto-close fires once per opening - if the door doesn't close 
+ *  (blocked beam, manual hold), the relay isn't pulsed again.
+ *
+ *  EEPROM layout from RULES_EEPROM_ADDR (see EepromLayout.h):
+ *    'G' 'R' schema count, count x rule, checksum
+ *  Tables from before the shared layout are read from 
+ *  RULES_LEGACY_EEPROM_ADDR once and written back to the new region.
+ *
+*/
+
+GDoorRules::GDoorRules(){
+  io = NULL;
+  clock = NULL;
+  count = 0;
+  nextDeadline = RULE_NEVER;
+  lastPresence = 0;
+  awaitingClock = false;
+  dirty = false;
+
+  for (int i = 0; i < RULES_MAX; i++){
+    deadlines[i] = RULE_DISARMED;
+  }
+}
+
+void GDoorRules::begin(GDoorIO* doorIO, GDoorClock* deviceClock){
+  io = doorIO;
+  clock = deviceClock;
+}
+
+void GDoorRules::load(){
+  EEPROM.begin(EEPROM_LAYOUT_SIZE);
+  bool corrupt = false;
+  bool found = readTable(RULES_EEPROM_ADDR, &corrupt);
+
+  // Saved before the shared layout - the settings region grows over the old spot
+  bool legacyCorrupt = false;
+  bool migrated = !found && !corrupt && readTable(RULES_LEGACY_EEPROM_ADDR, &legacyCorrupt);
+  EEPROM.end();
+
+  if (corrupt){
+    GLOG_WARN(LOG_RULES_CORRUPT);
+    return;
+  }
+
+  if (!found && !migrated){
+    GLOG_INFO(LOG_RULES_NONE);
+    return;
+  }
+
+  GLOG_INFO(LOG_RULES_LOADED, count);
+  if (migrated){
+    GLOG_INFO(LOG_RULES_MIGRATED, RULES_LEGACY_EEPROM_ADDR, RULES_EEPROM_ADDR);
+    dirty = true;
+    persist();
+  }
+
+  armAll(clock->monotonicMillis());
+}
+
+void GDoorRules::persist(){
+  if (!dirty){
+    return;
+  }
+
+  EEPROM.begin(EEPROM_LAYOUT_SIZE);
+  int address = RULES_EEPROM_ADDR;
+  uint8_t sum = 0;
+  uint8_t header[RULES_HEADER_LEN] = { 'G', 'R', RULES_SCHEMA, (uint8_t)count };
+  for (int b = 0; b < RULES_HEADER_LEN; b++){
+    EEPROM.write(address++, header[b]);
+    sum += header[b];
+  }
+
+  for (int i = 0; i < count; i++){
+    uint8_t bytes[RULE_LEN];
+    encodeRule(&rules[i], bytes);
+    for (int b = 0; b < RULE_LEN; b++){
+      EEPROM.write(address++, bytes[b]);
+      sum += bytes[b];
+    }
+  }
+
+  EEPROM.write(address, sum);
+  EEPROM.end();
+
+  dirty = false;
+  GLOG_INFO(LOG_RULES_SAVED, count);
+}
+
+RulesResult GDoorRules::loadProgram(const char* hex){
+  int hexLength = strlen(hex);
+  if (hexLength % (RULE_LEN * 2) != 0){
+    return RULES_MALFORMED;
+  }
+
+  if (hexLength > RULES_PROGRAM_HEX_LEN){
+    return RULES_TOO_MANY;
+  }
+
+  // Decode & validate everything before touching the live table
+  Rule program[RULES_MAX];
+  int programCount = hexLength / (RULE_LEN * 2);
+  for (int i = 0; i < programCount; i++){
+    uint8_t bytes[RULE_LEN];
+    if (!GDoorRequestAuth::decodeHex(&hex[i * RULE_LEN * 2], bytes, RULE_LEN)){
+      return RULES_MALFORMED;
+    }
+
+    decodeRule(bytes, &program[i]);
+    RulesResult result = validate(&program[i], io->channelCount);
+    if (result != RULES_OK){
+      GLOG_WARN(LOG_RULES_REJECTED, i, result);
+      return result;
+    }
+  }
+
+  memcpy(rules, program, sizeof(Rule) * programCount);
+  count = programCount;
+  dirty = true;
+  GLOG_INFO(LOG_RULES_LOADED, count);
+
+  armAll(clock->monotonicMillis());
+  return RULES_OK;
+}
+
+int GDoorRules::toJson(char* target){
+  // The program is echoed back as loaded, with the seconds until each rule's deadline
+  int index = sprintf(target, "{\"program\":\"");
+  for (int i = 0; i < count; i++){
+    uint8_t bytes[RULE_LEN];
+    encodeRule(&rules[i], bytes);
+    for (int b = 0; b < RULE_LEN; b++){
+      index += sprintf(&target[index], "%02x", bytes[b]);
+    }
+  }
+
+  index += sprintf(&target[index], "\",\"armed\":[");
+  uint64_t now = clock->monotonicMillis();
+  for (int i = 0; i < count; i++){
+    long remaining = (deadlines[i] == RULE_DISARMED) ? -1 : (long)((deadlines[i] > now ? deadlines[i] - now : 0) / 1000);
+    index += sprintf(&target[index], "%s%ld", (i > 0) ? "," : "", remaining);
+  }
+
+  index += sprintf(&target[index], "]}");
+  return index;
+}
+
+int GDoorRules::ruleCount(){
+  return count;
+}
+
+void GDoorRules::onDoorState(int channel, DoorState state, uint64_t now){
+  bool changed = false;
+  for (int i = 0; i < count; i++){
+    if (rules[i].opcode != RULE_OP_AUTO_CLOSE || rules[i].channel != channel){
+      continue;
+    }
+
+    deadlines[i] = (state == DOOR_STATE_OPEN) ? now + ((uint64_t)rules[i].param * 1000) : RULE_DISARMED;
+    changed = true;
+  }
+
+  if (changed){
+    updateNextDeadline();
+  }
+}
+
+void GDoorRules::notePresence(uint64_t now){
+  // Deferred rules already carry their retry deadline - nothing to re-arm
+  lastPresence = now;
+}
+
+// Private methods
+
+bool GDoorRules::readTable(int address, bool* corrupt){
+  // EEPROM already begun - false if there's no table here
+  int storedCount = EEPROM.read(address + 3);
+  bool valid = EEPROM.read(address) == 'G' && EEPROM.read(address + 1) == 'R' && EEPROM.read(address + 2) == RULES_SCHEMA;
+  if (!valid || storedCount > RULES_MAX){
+    return false;
+  }
+
+  // Validate the checksum before trusting any of it
+  int checksumAddress = address + RULES_HEADER_LEN + (storedCount * RULE_LEN);
+  uint8_t sum = 0;
+  for (int i = address; i < checksumAddress; i++){
+    sum += EEPROM.read(i);
+  }
+
+  if (sum != EEPROM.read(checksumAddress)){
+    *corrupt = true;
+    return false;
+  }
+
+  address += RULES_HEADER_LEN;
+  count = 0;
+  for (int i = 0; i < storedCount; i++){
+    uint8_t bytes[RULE_LEN];
+    for (int b = 0; b < RULE_LEN; b++){
+      bytes[b] = EEPROM.read(address++);
+    }
+
+    // Rules for a channel this build doesn't drive are dropped
+    decodeRule(bytes, &rules[count]);
+    if (validate(&rules[count], io->channelCount) == RULES_OK){
+      count += 1;
+    }
+  }
+
+  return true;
+}
+
+void GDoorRules::evaluate(uint64_t now){
+  if (awaitingClock && clock->isSynced()){
+    awaitingClock = false;
+    for (int i = 0; i < count; i++){
+      if (rules[i].opcode == RULE_OP_SCHEDULE){
+        armSchedule(i, now, 0);
+      }
+    }
+
+    updateNextDeadline();
+  }
+
+  if (now < nextDeadline){
+    return;
+  }
+
+  for (int i = 0; i < count; i++){
+    if (deadlines[i] != RULE_DISARMED && deadlines[i] <= now){
+      fire(i, now);
+    }
+  }
+
+  updateNextDeadline();
+}
+
+void GDoorRules::fire(int index, uint64_t now){
+  Rule* rule = &rules[index];
+  deadlines[index] = RULE_DISARMED;
+
+  // Someone's home - try again once the window has passed
+  uint64_t presenceWindow = (uint64_t)rule->presenceMinutes * 60000;
+  if ((rule->flags & RULE_UNLESS_PRESENT) && lastPresence != 0 && now - lastPresence < presenceWindow){
+    deadlines[index] = lastPresence + presenceWindow;
+    GLOG_INFO(LOG_RULES_DEFERRED, index, (uint32_t)((deadlines[index] - now) / 1000));
+    return;
+  }
+
+  DoorState state = io->doorState(rule->channel);
+  bool conditionsMet = !((rule->flags & RULE_IF_OPEN) && state != DOOR_STATE_OPEN) && !((rule->flags & RULE_IF_CLOSED) && state != DOOR_STATE_CLOSED);
+
+  // Auto-close only ever closes - a door that shut in the meantime is left alone
+  if (rule->opcode == RULE_OP_AUTO_CLOSE){
+    conditionsMet = conditionsMet && state == DOOR_STATE_OPEN;
+  }
+
+  if (conditionsMet){
+    GLOG_INFO(LOG_RULES_FIRED, index, rule->channel);
+    gdoorTrace.record(TRACE_RULE_FIRED, index, rule->channel);
+    io->actuateDoor(rule->channel);
+  }
+
+  if (rule->opcode == RULE_OP_SCHEDULE){
+    armSchedule(index, now, RULE_RESCHEDULE_GUARD_SECS);
+  }
+}
+
+void GDoorRules::armAll(uint64_t now){
+  awaitingClock = false;
+  for (int i = 0; i < RULES_MAX; i++){
+    deadlines[i] = RULE_DISARMED;
+  }
+
+  for (int i = 0; i < count; i++){
+    if (rules[i].opcode == RULE_OP_AUTO_CLOSE && io->doorState(rules[i].channel) == DOOR_STATE_OPEN){
+      // Already open when the rule arrived - counts from now
+      deadlines[i] = now + ((uint64_t)rules[i].param * 1000);
+    }
+
+    else if (rules[i].opcode == RULE_OP_SCHEDULE){
+      armSchedule(i, now, 0);
+    }
+  }
+
+  updateNextDeadline();
+}
+
+void GDoorRules::armSchedule(int index, uint64_t now, uint32_t guardSecs){
+  if (!clock->isSynced()){
+    awaitingClock = true;
+    return;
+  }
+
+  // Next occurrence of the second of the day - the guard stops a slightly early firing from repeating
+  uint64_t epoch = clock->epochMillis();
+  uint32_t secondOfDay = (epoch / 1000) % RULE_DAY_SECS;
+  uint32_t delaySecs = (rules[index].param + RULE_DAY_SECS - secondOfDay) % RULE_DAY_SECS;
+  if (delaySecs <= guardSecs){
+    delaySecs += RULE_DAY_SECS;
+  }
+
+  deadlines[index] = now + ((uint64_t)delaySecs * 1000) - (epoch % 1000);
+}
+
+void GDoorRules::updateNextDeadline(){
+  nextDeadline = RULE_NEVER;
+  for (int i = 0; i < count; i++){
+    if (deadlines[i] != RULE_DISARMED && deadlines[i] < nextDeadline){
+      nextDeadline = deadlines[i];
+    }
+  }
+}
+
+RulesResult GDoorRules::validate(const Rule* rule, int channelCount){
+  if (rule->channel >= channelCount){
+    return RULES_BAD_CHANNEL;
+  }
+
+  switch (rule->opcode){
+    case RULE_OP_AUTO_CLOSE:
+      return (rule->param >= RULE_MIN_OPEN_SECS && rule->param <= RULE_DAY_SECS) ? RULES_OK : RULES_OUT_OF_RANGE;
+
+    case RULE_OP_SCHEDULE:
+      return (rule->param < RULE_DAY_SECS) ? RULES_OK : RULES_OUT_OF_RANGE;
+
+    default:
+      return RULES_BAD_OPCODE;
+  }
+}
+
+void GDoorRules::decodeRule(const uint8_t* bytes, Rule* rule){
+  rule->opcode = bytes[0];
+  rule->channel = bytes[1];
+  rule->flags = bytes[2];
+  rule->presenceMinutes = bytes[3];
+  rule->param = (uint32_t)bytes[4] | ((uint32_t)bytes[5] << 8) | ((uint32_t)bytes[6] << 16) | ((uint32_t)bytes[7] << 24);
+}
+
+void GDoorRules::encodeRule(const Rule* rule, uint8_t* bytes){
+  bytes[0] = rule->opcode;
+  bytes[1] = rule->channel;
+  bytes[2] = rule->flags;
+  bytes[3] = rule->presenceMinutes;
+  for (int b = 0; b < 4; b++){
+    bytes[4 + b] = (rule->param >> (8 * b)) & 0xFF;
+  }
+}
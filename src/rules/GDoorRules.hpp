@@ -0,0 +1,117 @@
+/*
+*	On-device rule engine - auto-close & scheduled actuation, 
+*   run from a compiled rule table kept in EEPROM
+*	Header file	
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#ifndef GDoorRules_h
+#define GDoorRules_h
+
+// Includes
+#include <Arduino.h>
+#include <EEPROM.h>
+#include "../constants/Constants.h"
+#include "../constants/EepromLayout.h"
+#include "../logging/GDoorLog.hpp"
+#include "../clock/GDoorClock.hpp"
+#include "../digital-io/GDoorIO.hpp"
+#include "../diagnostics/TraceRecorder.hpp"
+#include "../security/RequestAuth.hpp"
+
+// EEPROM region - see EepromLayout.h
+#define RULES_SCHEMA 1
+#define RULES_HEADER_LEN 4
+#define RULE_LEN 8
+#define RULES_MAX 8                         // Header + 64 + checksum = 69 bytes
+#define RULES_PROGRAM_HEX_LEN (RULES_MAX * RULE_LEN * 2)
+#define RULES_JSON_LEN (RULES_PROGRAM_HEX_LEN + (RULES_MAX * 12) + 32)
+
+static_assert(RULES_HEADER_LEN + (RULES_MAX * RULE_LEN) + 1 <= RULES_EEPROM_LEN, "Rule table outgrew its EEPROM region");
+
+#define RULE_DAY_SECS 86400UL
+#define RULE_MIN_OPEN_SECS 10
+#define RULE_RESCHEDULE_GUARD_SECS 60       // A schedule never re-fires within this of firing
+#define RULE_DISARMED 0
+#define RULE_NEVER 0xFFFFFFFFFFFFFFFFULL
+
+// Append only - stored in EEPROM & compiled by tools/compile_rules.py
+typedef enum ruleOpcode {
+  RULE_OP_NONE,
+  RULE_OP_AUTO_CLOSE,                       // param: seconds open before closing
+  RULE_OP_SCHEDULE                          // param: second of the day (UTC) to actuate at
+} RuleOpcode;
+
+// Condition flags
+#define RULE_IF_OPEN 0x01
+#define RULE_IF_CLOSED 0x02
+#define RULE_UNLESS_PRESENT 0x04            // Deferred while there's LAN control activity
+
+typedef struct rule {
+  uint8_t opcode;
+  uint8_t channel;
+  uint8_t flags;
+  uint8_t presenceMinutes;                  // Window for RULE_UNLESS_PRESENT
+  uint32_t param;
+} Rule;
+
+typedef enum rulesResult {
+  RULES_OK,
+  RULES_MALFORMED,
+  RULES_TOO_MANY,
+  RULES_BAD_OPCODE,
+  RULES_BAD_CHANNEL,
+  RULES_OUT_OF_RANGE
+} RulesResult;
+
+class GDoorRules {
+  public:
+    GDoorRules();
+
+    void begin(GDoorIO* doorIO, GDoorClock* deviceClock);
+    void load();
+    void persist();
+
+    // Replaces the table from the compiled hex - all or nothing on validation
+    RulesResult loadProgram(const char* hex);
+    int toJson(char* target);
+    int ruleCount();
+
+    // Events - each re-arms only the rules it affects
+    void onDoorState(int channel, DoorState state, uint64_t now);
+    void notePresence(uint64_t now);
+
+    // Every loop pass - a compare unless a rule is due
+    inline void tick(uint64_t now){
+      if (now >= nextDeadline || awaitingClock){
+        evaluate(now);
+      }
+    }
+
+  private:
+    GDoorIO* io;
+    GDoorClock* clock;
+    Rule rules[RULES_MAX];
+    uint64_t deadlines[RULES_MAX];          // Monotonic millis, RULE_DISARMED when idle
+    int count;
+    uint64_t nextDeadline;
+    uint64_t lastPresence;
+    bool awaitingClock;                     // Schedules wait for the first SNTP sync
+    bool dirty;
+
+    void evaluate(uint64_t now);
+    void fire(int index, uint64_t now);
+    void armAll(uint64_t now);
+    void armSchedule(int index, uint64_t now, uint32_t guardSecs);
+    void updateNextDeadline();
+    bool readTable(int address, bool* corrupt);
+
+    static RulesResult validate(const Rule* rule, int channelCount);
+    static void decodeRule(const uint8_t* bytes, Rule* rule);
+    static void encodeRule(const Rule* rule, uint8_t* bytes);
+};
+
+#endif
@@ -0,0 +1,362 @@
+/*
+*	Signed request verification for the UID routes - 
+*   HMAC-SHA256 with the per device secret
+*	Source file	
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+// Includes
+#include "RequestAuth.hpp"
+
+/*
+ *                        Signing Scheme
+ *
+ *  The UID in the path only routes the request, it no longer grants 
+ *  anything. Signed requests carry three headers:
+ *
+ *    X-GDoor-Nonce       16 hex chars, random per request
+ *    X-GDoor-Timestamp   Unix seconds
+ *    X-GDoor-Signature   hex HMAC-SHA256 of 
+ *                        "METHOD\npath\nquery\nnonce\ntimestamp"
+ *
+ *  keyed with the 32 byte device secret provisioned with the WiFi 
+ *  credentials. path stops at the '?'. query is the canonical form of 
+ *  every argument the handler can read - URL query and form fields, 
+ *  a raw POST body shows up as the argument "plain":
+ *
+ *    - names and values as decoded by the server
+ *    - sorted by name (byte order), repeated names keep request order
+ *    - each byte outside A-Z a-z 0-9 - _ . ~ written as %XX (upper case)
+ *    - joined as name=value with '&', empty when there are no arguments
+ *
+ *  e.g. /<uid>/Settings?pulseLength=400&debounceSamples=3 signs 
+ *  "debounceSamples=3&pulseLength=400". tools/sign_request.py is the 
+ *  reference signer.
+ *
+ *  Timestamps more than 5 mins from the device clock are rejected, and 
+ *  nonces are remembered until their timestamp leaves the window, so 
+ *  every nonce that could still verify is in the cache. Nothing live 
+ *  is ever evicted - a cache full of live nonces answers AUTH_BUSY 
+ *  until the oldest one expires, rather than refusing clients whose 
+ *  clocks lag the others.
+ *
+ *  The secret never comes from anything a LAN client can read. New 
+ *  devices get it with the WiFi credentials at setup. Devices set up 
+ *  before it existed get it from the cloud: a "deviceSecret" field in 
+ *  the boot info or health check response, only taken when the server 
+ *  certificate was verified and only while the device has no secret. 
+ *  Until then they answer AUTH_LEGACY and pass unsigned requests as 
+ *  before - once a secret is stored every request has to be signed.
+ *
+ *  The owner replaces it with a signed /<uid>/RotateSecret?secret=<64 hex> 
+ *  carrying the new secret XORed with
+ *
+ *    HMAC-SHA256(current secret, "rotate\n" + nonce)
+ *
+ *  so it never crosses the LAN in the clear, and a replayed request 
+ *  is refused by the nonce cache before it's unwrapped 
+ *  (tools/sign_request.py --rotate).
+ *
+*/
+
+GDoorRequestAuth::GDoorRequestAuth(){
+  clock = NULL;
+  enforcing = false;
+  memset(nonces, 0, sizeof(nonces));
+  memset(nonceTimestamps, 0, sizeof(nonceTimestamps));
+}
+
+void GDoorRequestAuth::begin(GDoorUser* user, GDoorClock* deviceClock){
+  clock = deviceClock;
+  enforcing = user->hasDeviceSecret;
+
+  uint8_t key[AUTH_KEY_LEN];
+  int keyLength = deviceKey(user, key);
+  br_hmac_key_init(&keyContext, &br_sha256_vtable, key, keyLength);
+  memset(key, 0, sizeof(key));
+}
+
+bool GDoorRequestAuth::isEnforcing(){
+  return enforcing;
+}
+
+bool GDoorRequestAuth::provision(GDoorUser* user, const char* response){
+  // First secret only - from then on the owner rotates it with a signed request
+  const char* field = strstr(response, AUTH_PROVISION_FIELD);
+  if (enforcing || field == NULL){
+    return false;
+  }
+
+  const char* hex = field + strlen(AUTH_PROVISION_FIELD);
+  uint8_t secret[AUTH_KEY_LEN];
+  // decodeHex stops at the terminator, so the closing quote is only read after 64 hex chars
+  if (!decodeHex(hex, secret, AUTH_KEY_LEN) || hex[AUTH_KEY_LEN * 2] != '"'){
+    return false;
+  }
+
+  bool stored = storeSecret(user, secret);
+  memset(secret, 0, sizeof(secret));
+  return stored;
+}
+
+bool GDoorRequestAuth::rotate(GDoorUser* user, const char* nonce, const char* wrappedSecret){
+  // Only for requests verify() passed as AUTH_OK - the nonce is already spent
+  uint8_t secret[AUTH_KEY_LEN];
+  if (!enforcing || strlen(nonce) != AUTH_NONCE_HEX_LEN || strlen(wrappedSecret) != AUTH_KEY_LEN * 2
+      || !decodeHex(wrappedSecret, secret, AUTH_KEY_LEN)){
+    return false;
+  }
+
+  uint8_t pad[AUTH_MAC_LEN];
+  br_hmac_context context;
+  br_hmac_init(&context, &keyContext, AUTH_MAC_LEN);
+  br_hmac_update(&context, AUTH_ROTATE_LABEL, strlen(AUTH_ROTATE_LABEL));
+  br_hmac_update(&context, nonce, AUTH_NONCE_HEX_LEN);
+  br_hmac_out(&context, pad);
+
+  for (int i = 0; i < AUTH_KEY_LEN; i++){
+    secret[i] ^= pad[i];
+  }
+
+  bool stored = storeSecret(user, secret);
+  memset(secret, 0, sizeof(secret));
+  memset(pad, 0, sizeof(pad));
+  return stored;
+}
+
+AuthResult GDoorRequestAuth::verify(const char* method, const char* path, const char* query, const char* nonce, const char* timestamp, const char* signature){
+  // No secret to check a signature against
+  if (!enforcing){
+    return AUTH_LEGACY;
+  }
+
+  if (nonce[0] == 0 || timestamp[0] == 0 || signature[0] == 0){
+    return AUTH_MISSING_HEADERS;
+  }
+
+  // No query means the arguments didn't fit the canonical buffer
+  uint32_t requestSecs;
+  uint8_t nonceBytes[AUTH_NONCE_LEN];
+  if (query == NULL || strlen(nonce) != AUTH_NONCE_HEX_LEN || strlen(signature) != AUTH_SIGNATURE_HEX_LEN || !parseTimestamp(timestamp, &requestSecs)
+      || !decodeHex(nonce, nonceBytes, AUTH_NONCE_LEN)){
+    return AUTH_MALFORMED;
+  }
+
+  // Freshness can't be judged without wall time
+  if (!clock->isSynced()){
+    return AUTH_CLOCK_UNSYNCED;
+  }
+
+  uint32_t nowSecs = clock->epochMillis() / 1000;
+  uint32_t skew = (nowSecs > requestSecs) ? nowSecs - requestSecs : requestSecs - nowSecs;
+  if (skew > AUTH_MAX_SKEW_SECS){
+    return AUTH_STALE;
+  }
+
+  // Signature first - unauthenticated requests never touch the nonce cache
+  if (!verifySignature(method, path, query, nonce, timestamp, signature)){
+    return AUTH_BAD_SIGNATURE;
+  }
+
+  if (isReplay(nonceBytes)){
+    return AUTH_REPLAY;
+  }
+
+  if (!rememberNonce(nonceBytes, requestSecs, nowSecs)){
+    return AUTH_BUSY;
+  }
+
+  return AUTH_OK;
+}
+
+bool GDoorRequestAuth::verifySignature(const char* method, const char* path, const char* query, const char* nonce, const char* timestamp, const char* signature){
+  uint8_t presented[AUTH_MAC_LEN];
+  if (!decodeHex(signature, presented, AUTH_MAC_LEN)){
+    return false;
+  }
+
+  uint8_t expected[AUTH_MAC_LEN];
+  br_hmac_context context;
+  br_hmac_init(&context, &keyContext, AUTH_MAC_LEN);
+  br_hmac_update(&context, method, strlen(method));
+  br_hmac_update(&context, "\n", 1);
+  br_hmac_update(&context, path, strlen(path));
+  br_hmac_update(&context, "\n", 1);
+  br_hmac_update(&context, query, strlen(query));
+  br_hmac_update(&context, "\n", 1);
+  br_hmac_update(&context, nonce, AUTH_NONCE_HEX_LEN);
+  br_hmac_update(&context, "\n", 1);
+  br_hmac_update(&context, timestamp, strlen(timestamp));
+  br_hmac_out(&context, expected);
+
+  return constantTimeEquals(expected, presented, AUTH_MAC_LEN);
+}
+
+bool GDoorRequestAuth::appendQueryParam(char* target, int* length, int capacity, const char* name, const char* value){
+  static const char hexDigits[] = "0123456789ABCDEF";
+  const char* parts[2] = { name, value };
+
+  // Sized first, so a parameter that doesn't fit leaves the query as it was
+  int needed = (*length > 0) ? 2 : 1;
+  for (int part = 0; part < 2; part++){
+    for (const char* c = parts[part]; *c != 0; c++){
+      needed += isUnreserved(*c) ? 1 : 3;
+    }
+  }
+
+  if (*length + needed >= capacity){
+    return false;
+  }
+
+  int written = *length;
+  if (written > 0){
+    target[written++] = '&';
+  }
+
+  for (int part = 0; part < 2; part++){
+    if (part == 1){
+      target[written++] = '=';
+    }
+
+    for (const char* c = parts[part]; *c != 0; c++){
+      uint8_t byte = (uint8_t)*c;
+      if (isUnreserved(byte)){
+        target[written++] = byte;
+        continue;
+      }
+
+      target[written++] = '%';
+      target[written++] = hexDigits[byte >> 4];
+      target[written++] = hexDigits[byte & 0x0F];
+    }
+  }
+
+  target[written] = 0;
+  *length = written;
+  return true;
+}
+
+// Replay cache
+
+bool GDoorRequestAuth::isReplay(const uint8_t* nonce){
+  // Expired slots can stay - their timestamps fail the skew check before this
+  for (int i = 0; i < AUTH_NONCE_CACHE_LEN; i++){
+    if (nonceTimestamps[i] != 0 && memcmp(nonces[i], nonce, AUTH_NONCE_LEN) == 0){
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool GDoorRequestAuth::rememberNonce(const uint8_t* nonce, uint32_t timestamp, uint32_t nowSecs){
+  for (int i = 0; i < AUTH_NONCE_CACHE_LEN; i++){
+    // Free, or can't pass the skew check any more
+    if (nonceTimestamps[i] == 0 || nowSecs > nonceTimestamps[i] + AUTH_MAX_SKEW_SECS){
+      memcpy(nonces[i], nonce, AUTH_NONCE_LEN);
+      nonceTimestamps[i] = timestamp;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Utility methods
+
+bool GDoorRequestAuth::parseTimestamp(const char* timestamp, uint32_t* target){
+  uint32_t value = 0;
+  int length = strlen(timestamp);
+  if (length == 0 || length > 10){
+    return false;
+  }
+
+  for (int i = 0; i < length; i++){
+    if (timestamp[i] < '0' || timestamp[i] > '9'){
+      return false;
+    }
+
+    value = (value * 10) + (timestamp[i] - '0');
+  }
+
+  *target = value;
+  return true;
+}
+
+bool GDoorRequestAuth::storeSecret(GDoorUser* user, const uint8_t* secret){
+  char hex[AUTH_KEY_LEN * 2 + 1];
+  for (int i = 0; i < AUTH_KEY_LEN; i++){
+    sprintf(&hex[i * 2], "%02x", secret[i]);
+  }
+
+  bool stored = user->setDeviceSecret(hex);
+  memset(hex, 0, sizeof(hex));
+  if (!stored){
+    return false;
+  }
+
+  user->persistUserDataToDisk();
+  begin(user, clock);
+  return true;
+}
+
+int GDoorRequestAuth::deviceKey(GDoorUser* user, uint8_t* key){
+  // No secret, no key - nothing guessable (like the UID) ever stands in for it
+  if (!user->hasDeviceSecret){
+    memset(key, 0, AUTH_KEY_LEN);
+    return 0;
+  }
+
+  decodeHex(user->deviceSecret, key, AUTH_KEY_LEN);
+  return AUTH_KEY_LEN;
+}
+
+bool GDoorRequestAuth::isUnreserved(uint8_t c){
+  // RFC 3986 unreserved set - everything else is percent encoded
+  return isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~';
+}
+
+bool GDoorRequestAuth::constantTimeEquals(const uint8_t* a, const uint8_t* b, int length){
+  // Don't leak how many bytes matched
+  uint8_t diff = 0;
+  for (int i = 0; i < length; i++){
+    diff |= a[i] ^ b[i];
+  }
+
+  return diff == 0;
+}
+
+bool GDoorRequestAuth::decodeHex(const char* hex, uint8_t* target, int length){
+  for (int i = 0; i < length * 2; i++){
+    char c = hex[i];
+    uint8_t nibble;
+    if (c >= '0' && c <= '9'){
+      nibble = c - '0';
+    }
+
+    else if (c >= 'a' && c <= 'f'){
+      nibble = c - 'a' + 10;
+    }
+
+    else if (c >= 'A' && c <= 'F'){
+      nibble = c - 'A' + 10;
+    }
+
+    else{
+      return false;
+    }
+
+    if (i % 2 == 0){
+      target[i / 2] = nibble << 4;
+    }
+
+    else{
+      target[i / 2] |= nibble;
+    }
+  }
+
+  return true;
+}
@@ -0,0 +1,86 @@
+/*
+*	Signed request verification for the UID routes - 
+*   HMAC-SHA256 with the per device secret
+*	Header file	
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#ifndef RequestAuth_h
+#define RequestAuth_h
+
+// Includes
+#include <Arduino.h>
+#include <bearssl/bearssl.h>
+#include "../logging/GDoorLog.hpp"
+#include "../clock/GDoorClock.hpp"
+#include "../user/GDoorUser.hpp"
+
+#define AUTH_KEY_LEN 32                   // Decoded device secret
+#define AUTH_MAC_LEN 32                   // Full SHA256 output
+#define AUTH_NONCE_LEN 8
+#define AUTH_NONCE_HEX_LEN (AUTH_NONCE_LEN * 2)
+#define AUTH_SIGNATURE_HEX_LEN (AUTH_MAC_LEN * 2)
+#define AUTH_MAX_SKEW_SECS 300            // Accepted distance from device wall time
+#define AUTH_NONCE_CACHE_LEN 64           // Accepted requests per skew window before AUTH_BUSY
+#define AUTH_QUERY_MAX_LEN 512            // Canonical query string, encoded
+
+// Request headers carrying the signature
+#define AUTH_HEADER_NONCE "X-GDoor-Nonce"
+#define AUTH_HEADER_TIMESTAMP "X-GDoor-Timestamp"
+#define AUTH_HEADER_SIGNATURE "X-GDoor-Signature"
+
+// Secret handed out in the cloud's boot info / health check response
+#define AUTH_PROVISION_FIELD "\"deviceSecret\":\""
+#define AUTH_ROTATE_LABEL "rotate\n"         // Prefix of the message keying a rotation pad
+
+typedef enum authResult {
+  AUTH_OK,
+  AUTH_LEGACY,                    // No secret provisioned yet - nothing to check against, requests pass
+  AUTH_MISSING_HEADERS,
+  AUTH_MALFORMED,
+  AUTH_CLOCK_UNSYNCED,
+  AUTH_STALE,
+  AUTH_REPLAY,
+  AUTH_BAD_SIGNATURE,
+  AUTH_BUSY                       // Nonce cache full of live nonces - retry shortly
+} AuthResult;
+
+class GDoorRequestAuth {
+  public:
+    GDoorRequestAuth();
+
+    void begin(GDoorUser* user, GDoorClock* clock);
+    bool isEnforcing();
+    bool provision(GDoorUser* user, const char* response);
+    bool rotate(GDoorUser* user, const char* nonce, const char* wrappedSecret);
+    AuthResult verify(const char* method, const char* path, const char* query, const char* nonce, const char* timestamp, const char* signature);
+    bool verifySignature(const char* method, const char* path, const char* query, const char* nonce, const char* timestamp, const char* signature);
+
+    // Canonical query - call in argument name order, false once capacity is exceeded
+    static bool appendQueryParam(char* target, int* length, int capacity, const char* name, const char* value);
+
+    // Shared with the LAN control channel
+    static int deviceKey(GDoorUser* user, uint8_t* key);
+    static bool constantTimeEquals(const uint8_t* a, const uint8_t* b, int length);
+    static bool decodeHex(const char* hex, uint8_t* target, int length);
+
+  private:
+    GDoorClock* clock;
+    bool enforcing;
+    br_hmac_key_context keyContext;       // Key schedule done once at boot
+
+    // Recently accepted nonces - a slot frees up once its timestamp leaves the window
+    uint8_t nonces[AUTH_NONCE_CACHE_LEN][AUTH_NONCE_LEN];
+    uint32_t nonceTimestamps[AUTH_NONCE_CACHE_LEN];
+
+    bool isReplay(const uint8_t* nonce);
+    bool rememberNonce(const uint8_t* nonce, uint32_t timestamp, uint32_t nowSecs);
+    bool parseTimestamp(const char* timestamp, uint32_t* target);
+    bool storeSecret(GDoorUser* user, const uint8_t* secret);
+    static bool isUnreserved(uint8_t c);
+};
+
+#endif
@@ -0,0 +1,227 @@
+/*
+*	Runtime settings registry - typed, range checked values 
+*   persisted in their own EEPROM region
+*	Source file	
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+// Includes
+#include "GDoorSettings.hpp"
+#include "../constants/Constants.h"
+#include "../networking/UploadSchedule.hpp"
+
+/*
+ *                        Settings Table
+ *
+ *  Every tunable that used to need a reflash. Live settings take 
+ *  effect as soon as they're set, the networking ones are only read 
+ *  at boot. Values outside the range are rejected, never clamped.
+ *
+ *  Updates come from the health ping response, e.g.
+ *    {"settings":{"healthCheckInterval":600000,"pulseLength":1200}}
+ *  or the signed /<uid>/Settings endpoint (?key=value&...).
+ *
+ *  EEPROM layout from SETTINGS_EEPROM_ADDR (see EepromLayout.h):
+ *    'G' 'S' schema count, count x u32 (little endian), checksum
+ *  Settings missing from an older layout keep their defaults.
+ *
+*/
+
+const SettingDefinition GDoorSettings::definitions[SETTING_COUNT] = {
+  // key                    default   min     max         apply
+  { "healthCheckInterval",  900000,   60000,  86400000,   SETTING_APPLY_LIVE },
+  { "pulseLength",          1500,     200,    5000,       SETTING_APPLY_LIVE },
+  { "debounceSamples",      10,       1,      50,         SETTING_APPLY_LIVE },
+  { "debounceInterval",     100,      10,     1000,       SETTING_APPLY_LIVE },
+  { "espStaticOctet",       250,      2,      254,        SETTING_APPLY_REBOOT },
+  { "portNumber",           6969,     1024,   65535,      SETTING_APPLY_REBOOT },
+  { "uploadSpread",         UPLOAD_SPREAD_DEFAULT, 0, UPLOAD_SPREAD_MAX, SETTING_APPLY_LIVE },
+  { "doorChannels",         1,        1,      MAX_DOOR_CHANNELS, SETTING_APPLY_REBOOT }      // Rows of GDoorIO's channel table wired
+};
+
+GDoorSettings::GDoorSettings(){
+  for (int i = 0; i < SETTING_COUNT; i++){
+    values[i] = definitions[i].defaultValue;
+  }
+
+  dirty = false;
+  rebootPending = false;
+}
+
+void GDoorSettings::load(){
+  EEPROM.begin(EEPROM_LAYOUT_SIZE);
+
+  int address = SETTINGS_EEPROM_ADDR;
+  int storedCount = EEPROM.read(address + 3);
+  bool valid = EEPROM.read(address) == 'G' && EEPROM.read(address + 1) == 'S' && EEPROM.read(address + 2) == SETTINGS_SCHEMA;
+  int checksumAddress = address + SETTINGS_HEADER_LEN + (storedCount * 4);
+  if (!valid || checksumAddress >= SETTINGS_EEPROM_ADDR + SETTINGS_EEPROM_LEN){
+    EEPROM.end();
+    GLOG_INFO(LOG_SETTINGS_DEFAULTS);
+    return;
+  }
+
+  // Validate the checksum before trusting any of it
+  uint8_t sum = 0;
+  for (int i = address; i < checksumAddress; i++){
+    sum += EEPROM.read(i);
+  }
+
+  if (sum != EEPROM.read(checksumAddress)){
+    EEPROM.end();
+    GLOG_WARN(LOG_SETTINGS_CORRUPT);
+    return;
+  }
+
+  address += SETTINGS_HEADER_LEN;
+  for (int i = 0; i < storedCount; i++){
+    uint32_t value = 0;
+    for (int b = 0; b < 4; b++){
+      value |= (uint32_t)EEPROM.read(address++) << (8 * b);
+    }
+
+    // Out of range values (a newer firmware's limits) fall back to the default
+    if (i < SETTING_COUNT && value >= definitions[i].minValue && value <= definitions[i].maxValue){
+      values[i] = value;
+    }
+  }
+
+  EEPROM.end();
+  GLOG_INFO(LOG_SETTINGS_LOADED, storedCount);
+}
+
+void GDoorSettings::persist(){
+  if (!dirty){
+    return;
+  }
+
+  EEPROM.begin(EEPROM_LAYOUT_SIZE);
+  int address = SETTINGS_EEPROM_ADDR;
+  EEPROM.write(address++, 'G');
+  EEPROM.write(address++, 'S');
+  EEPROM.write(address++, SETTINGS_SCHEMA);
+  EEPROM.write(address++, SETTING_COUNT);
+
+  for (int i = 0; i < SETTING_COUNT; i++){
+    for (int b = 0; b < 4; b++){
+      EEPROM.write(address++, (values[i] >> (8 * b)) & 0xFF);
+    }
+  }
+
+  EEPROM.write(address, checksum());
+  EEPROM.end();
+
+  dirty = false;
+  GLOG_INFO(LOG_SETTINGS_SAVED);
+}
+
+uint32_t GDoorSettings::get(SettingId id){
+  return values[id];
+}
+
+SettingResult GDoorSettings::set(SettingId id, uint32_t value){
+  const SettingDefinition* definition = &definitions[id];
+  if (value < definition->minValue || value > definition->maxValue){
+    GLOG_WARN(LOG_SETTINGS_REJECTED, value, id);
+    return SETTING_OUT_OF_RANGE;
+  }
+
+  if (values[id] == value){
+    return SETTING_UNCHANGED;
+  }
+
+  values[id] = value;
+  dirty = true;
+  GLOG_INFO(LOG_SETTINGS_CHANGED, id, value);
+
+  if (definition->apply == SETTING_APPLY_REBOOT){
+    rebootPending = true;
+    GLOG_INFO(LOG_SETTINGS_REBOOT, id);
+  }
+
+  return SETTING_OK;
+}
+
+SettingResult GDoorSettings::setByKey(const char* key, uint32_t value){
+  for (int i = 0; i < SETTING_COUNT; i++){
+    if (strcmp(key, definitions[i].key) == 0){
+      return set((SettingId)i, value);
+    }
+  }
+
+  return SETTING_UNKNOWN_KEY;
+}
+
+SettingResult GDoorSettings::validate(const char* key, uint32_t value){
+  for (int i = 0; i < SETTING_COUNT; i++){
+    if (strcmp(key, definitions[i].key) == 0){
+      bool inRange = value >= definitions[i].minValue && value <= definitions[i].maxValue;
+      return inRange ? SETTING_OK : SETTING_OUT_OF_RANGE;
+    }
+  }
+
+  return SETTING_UNKNOWN_KEY;
+}
+
+int GDoorSettings::applyJson(const char* json){
+  // Flat scan for "key":value (quoted or bare) - the response is tiny
+  int changed = 0;
+  char pattern[32];
+  for (int i = 0; i < SETTING_COUNT; i++){
+    sprintf(pattern, "\"%s\":", definitions[i].key);
+    const char* entry = strstr(json, pattern);
+    if (entry == NULL){
+      continue;
+    }
+
+    const char* digits = entry + strlen(pattern);
+    if (*digits == '"'){
+      digits += 1;
+    }
+
+    if (*digits < '0' || *digits > '9'){
+      continue;
+    }
+
+    if (set((SettingId)i, strtoul(digits, NULL, 10)) == SETTING_OK){
+      changed += 1;
+    }
+  }
+
+  return changed;
+}
+
+int GDoorSettings::toJson(char* target){
+  int index = sprintf(target, "{");
+  for (int i = 0; i < SETTING_COUNT; i++){
+    index += sprintf(&target[index], "%s\"%s\":%u", (i > 0) ? "," : "", definitions[i].key, values[i]);
+  }
+
+  index += sprintf(&target[index], ",\"rebootPending\":%s}", rebootPending ? "true" : "false");
+  return index;
+}
+
+bool GDoorSettings::isDirty(){
+  return dirty;
+}
+
+bool GDoorSettings::isRebootPending(){
+  return rebootPending;
+}
+
+// Utility methods
+
+uint8_t GDoorSettings::checksum(){
+  // Same sum load() checks - header included
+  uint8_t sum = 'G' + 'S' + SETTINGS_SCHEMA + SETTING_COUNT;
+  for (int i = 0; i < SETTING_COUNT; i++){
+    for (int b = 0; b < 4; b++){
+      sum += (values[i] >> (8 * b)) & 0xFF;
+    }
+  }
+
+  return sum;
+}
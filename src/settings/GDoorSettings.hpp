@@ -0,0 +1,90 @@
+/*
+*	Runtime settings registry - typed, range checked values 
+*   persisted in their own EEPROM region
+*	Header file	
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#ifndef GDoorSettings_h
+#define GDoorSettings_h
+
+// Includes
+#include <Arduino.h>
+#include <EEPROM.h>
+#include "../constants/EepromLayout.h"
+#include "../logging/GDoorLog.hpp"
+
+// EEPROM region - see EepromLayout.h
+#define SETTINGS_SCHEMA 1
+#define SETTINGS_HEADER_LEN 4
+#define SETTINGS_JSON_LEN 256
+
+// Append only - the index is the stored position
+typedef enum settingId {
+  SETTING_HEALTH_CHECK_INTERVAL,
+  SETTING_PULSE_LENGTH,
+  SETTING_DEBOUNCE_SAMPLES,
+  SETTING_DEBOUNCE_INTERVAL,
+  SETTING_STATIC_OCTET,
+  SETTING_PORT_NUMBER,
+  SETTING_UPLOAD_SPREAD,
+  SETTING_DOOR_CHANNELS,
+  SETTING_COUNT
+} SettingId;
+
+// Header, the values & the checksum - a new setting that doesn't fit stops the build
+static_assert(SETTINGS_HEADER_LEN + (SETTING_COUNT * 4) + 1 <= SETTINGS_EEPROM_LEN, "Settings outgrew their EEPROM region");
+
+typedef enum settingApply {
+  SETTING_APPLY_LIVE,
+  SETTING_APPLY_REBOOT
+} SettingApply;
+
+typedef enum settingResult {
+  SETTING_OK,
+  SETTING_UNCHANGED,
+  SETTING_UNKNOWN_KEY,
+  SETTING_OUT_OF_RANGE
+} SettingResult;
+
+typedef struct settingDefinition {
+  const char* key;                  // Name in the JSON & endpoint args
+  uint32_t defaultValue;
+  uint32_t minValue;
+  uint32_t maxValue;
+  SettingApply apply;
+} SettingDefinition;
+
+class GDoorSettings {
+  public:
+    GDoorSettings();
+
+    void load();
+    void persist();
+
+    uint32_t get(SettingId id);
+    SettingResult set(SettingId id, uint32_t value);
+    SettingResult setByKey(const char* key, uint32_t value);
+    SettingResult validate(const char* key, uint32_t value);
+
+    // Updates from the health ping response - returns the number of settings changed
+    int applyJson(const char* json);
+    int toJson(char* target);
+
+    bool isDirty();
+    bool isRebootPending();
+
+    static const SettingDefinition definitions[SETTING_COUNT];
+
+  private:
+    uint32_t values[SETTING_COUNT];
+    bool dirty;                       // Changed since the last persist
+    bool rebootPending;               // A reboot-applied setting changed
+
+    uint8_t checksum();
+};
+
+#endif
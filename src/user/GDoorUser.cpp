@@ -9,14 +9,14 @@
 #include "GDoorUser.hpp"
 
 GDoorUser::GDoorUser(){
-	Serial.println("Instantiating user object");
+	GLOG_DEBUG(LOG_USER_INSTANTIATED);
 
-	// The constructure should set the instance vars - in future this will load from memory **
-	// uid = "k4ozP54JHab6NrK8UU8HbskopPH3";
-	// ssid = "Pez_is_awesome";     // "FutureLab 2";  					// 
-	// password = "50Million2021!"; // "CapeTownS001"; 				   // 
+	for (int i = 0; i < MAX_DOOR_CHANNELS; i++){
+		doorStates[i] = DOOR_STATE_CLOSED;
+	}
 
-	currentDoorState = DOOR_STATE_CLOSED; 
+	deviceSecret[0] = 0;
+	hasDeviceSecret = false;
 }
 
 /*
@@ -30,8 +30,8 @@ GDoorUser::GDoorUser(){
 
 bool GDoorUser::loadUserData(){
 	// Initialize EEPROM
-	Serial.println("GDOOR USER: Reading user data from disk");
-	EEPROM.begin(512);
+	GLOG_INFO(LOG_USER_READING);
+	EEPROM.begin(EEPROM_LAYOUT_SIZE);
 
 	bool dataExists = 0;	
 	byte startCR = EEPROM.read(0);
@@ -39,7 +39,7 @@ bool GDoorUser::loadUserData(){
 
 	if (startCR == CR && startLF == LF) {
 		// Data store exists
-		Serial.println("GDOOR USER: Successfully found data in memory. Loading data.");
+		GLOG_INFO(LOG_USER_DATA_FOUND);
 
 		// Read in new data
 		readUserDataFromDisk();
@@ -47,10 +47,7 @@ bool GDoorUser::loadUserData(){
 	}
 
 	else{
-		Serial.println("GDOOR USER: Persisted data does not exist.");
-		Serial.print("GDOOR USER: Read memory address data => ");
-		Serial.print(startCR);
-		Serial.println(startLF);
+		GLOG_WARN(LOG_USER_NO_DATA, startCR, startLF);
 		dataExists = 0;
 	}
 
@@ -69,6 +66,10 @@ bool GDoorUser::loadUserData(){
  *  Element 2: uid <len = 28>
  *  Element 3: ssid <len = variable>
  *	Element 4: password <len = variable>
+ *	Element 5: gateway IP <len = 4>
+ *	Element 6: subnet mask <len = 4>
+ *	Element 7: device secret <len = 64, hex> (optional - 
+ *	           older layouts end at element 6)
  *	Data delimiter: CRLF
  *
  */
@@ -77,49 +78,35 @@ bool GDoorUser::loadUserData(){
  	// EEPROM shiuld be pre-initialized
  	int memAddress = 2;	// Data starts at address 2
 
- 	// Read UID
- 	readDataIntoCharPointer(&memAddress, uid);
- 	Serial.print("GDOOR USER: Read UID => ");
- 	Serial.println(uid);
- 	Serial.print("GDOOR USER: Length of UID = ");
- 	Serial.println(strlen(uid));
-
- 	// SSID
- 	readDataIntoCharPointer(&memAddress, ssid);
- 	Serial.print("GDOOR USER: Reading SSID => ");
- 	Serial.println(ssid);
- 	Serial.print("GDOOR USER: Length of SSID = ");
- 	Serial.println(strlen(ssid));
-
- 	// Password
- 	readDataIntoCharPointer(&memAddress, password);
- 	Serial.print("GDOOR USER: Reading Password => ");
- 	Serial.println(password);
- 	Serial.print("GDOOR USER: Length of Password = ");
- 	Serial.println(strlen(password));
+ 	// Read UID, SSID & password - only the lengths are logged, never the contents
+ 	readDataIntoCharPointer(&memAddress, uid, sizeof(uid));
+ 	readDataIntoCharPointer(&memAddress, ssid, sizeof(ssid));
+ 	readDataIntoCharPointer(&memAddress, password, sizeof(password));
+ 	GLOG_INFO(LOG_USER_READ_LENGTHS, strlen(uid), strlen(ssid), strlen(password));
 
  	// GatewayIP
-	readDataIntoIntPointer(&memAddress, gatewayIPArr);
- 	Serial.print("GDOOR USER: Reading Gateway IP => ");
- 	printIPIntArray(gatewayIPArr);
- 	Serial.print("GDOOR USER: Length of Gateway IP = ");
- 	Serial.println(sizeof(gatewayIPArr));
+	readDataIntoIntPointer(&memAddress, gatewayIPArr, 4);
+ 	GLOG_INFO(LOG_USER_READ_GATEWAY, gatewayIPArr[0], gatewayIPArr[1], gatewayIPArr[2], gatewayIPArr[3]);
 
  	// Subnet Mask
- 	readDataIntoIntPointer(&memAddress, subnetMaskIpArr);
- 	Serial.print("GDOOR USER: Reading Subnet Mask => ");
- 	printIPIntArray(subnetMaskIpArr);
- 	Serial.print("GDOOR USER: Length of Subnet Mask = ");
- 	Serial.println(sizeof(subnetMaskIpArr));
-
- 	Serial.print("GDOOR USER: Read ");
-	Serial.print(memAddress);
-	Serial.println(" bytes from disk");
+ 	readDataIntoIntPointer(&memAddress, subnetMaskIpArr, 4);
+ 	GLOG_INFO(LOG_USER_READ_SUBNET, subnetMaskIpArr[0], subnetMaskIpArr[1], subnetMaskIpArr[2], subnetMaskIpArr[3]);
+
+ 	// Device secret - anything but 64 hex chars means it was never provisioned
+ 	readDataIntoCharPointer(&memAddress, deviceSecret, sizeof(deviceSecret));
+ 	hasDeviceSecret = isValidSecret(deviceSecret);
+ 	if (!hasDeviceSecret){
+ 		deviceSecret[0] = 0;
+ 		GLOG_WARN(LOG_USER_NO_SECRET);
+ 	}
+
+ 	GLOG_INFO(LOG_USER_READ_BYTES, memAddress);
  }
 
- void GDoorUser::readDataIntoCharPointer(int* addrPointer, char* target){
+ void GDoorUser::readDataIntoCharPointer(int* addrPointer, char* target, int maxLength){
 
  	int loopLen = 512 - *addrPointer;
+ 	target[maxLength - 1] = 0;		// Bounded even if no delimiter is found
 	// Serial.print("GDOOR USER: Reading from address = ");
 	// Serial.println(*addrPointer);
 
@@ -139,22 +126,25 @@ bool GDoorUser::loadUserData(){
  				// Serial.print("GDOOR USER: Found LF delimiter. Address = ");
  				// Serial.println(*addrPointer);
 
- 				// Add string terminator
- 				target[i+1] = 0;		// ASCII = Null terminator
+ 				// Add string terminator (truncating anything that didn't fit)
+ 				target[(i < maxLength) ? i : maxLength - 1] = 0;		// ASCII = Null terminator
  				*addrPointer += 1;
  				break;
  			} else{
  				// Read error
- 				Serial.println("GDOOR USER: Read error - isolated delimitor");
+ 				GLOG_WARN(LOG_USER_READ_ERROR, *addrPointer);
  			}
  		}
 
- 		target[i] = data;		
+ 		if (i < maxLength){
+ 			target[i] = data;
+ 		}
+
  		*addrPointer += 1;
  	}
  }
 
- void GDoorUser::readDataIntoIntPointer(int* addrPointer, int* target){
+ void GDoorUser::readDataIntoIntPointer(int* addrPointer, int* target, int maxLength){
 
  	int loopLen = 512 - *addrPointer;
 	// Serial.print("GDOOR USER: Reading from address = ");
@@ -176,17 +166,18 @@ bool GDoorUser::loadUserData(){
  				// Serial.print("GDOOR USER: Found LF delimiter. Address = ");
  				// Serial.println(*addrPointer);
 
- 				// Add string terminator
- 				target[i+1] = 0;		// ASCII = Null terminator
  				*addrPointer += 1;
  				break;
  			} else{
  				// Read error
- 				Serial.println("GDOOR USER: Read error - isolated delimitor");
+ 				GLOG_WARN(LOG_USER_READ_ERROR, *addrPointer);
  			}
  		}
 
- 		target[i] = data;		
+ 		if (i < maxLength){
+ 			target[i] = data;
+ 		}
+
  		*addrPointer += 1;
  	}
  }
@@ -205,14 +196,22 @@ bool GDoorUser::loadUserData(){
  *  Element 2: uid <len = 28>
  *  Element 3: ssid <len = variable>
  *	Element 4: password <len = variable>
+ *	Element 5: gateway IP <len = 4>
+ *	Element 6: subnet mask <len = 4>
+ *	Element 7: device secret <len = 64, hex> (optional - 
+ *	           older layouts end at element 6)
  *	Data delimiter: CRLF
  *  
  */
 
+// CRLF marker, then each field with its CRLF - uid, ssid, password, two IPs & the secret
+static_assert(2 + (sizeof(GDoorUser::uid) + 1) + (sizeof(GDoorUser::ssid) + 1) + (sizeof(GDoorUser::password) + 1)
+	+ ((4 + 2) * 2) + (sizeof(GDoorUser::deviceSecret) + 1) <= USER_DATA_EEPROM_LEN, "User data outgrew its EEPROM region");
+
 void GDoorUser::persistUserDataToDisk() {
 	// Initialize the EEPROM
-	Serial.println("GDOOR USER: Writing user data to disk");
-	EEPROM.begin(512);
+	GLOG_INFO(LOG_USER_WRITING);
+	EEPROM.begin(EEPROM_LAYOUT_SIZE);
 
 	// Add CRLF
 	EEPROM.write(0, CR);
@@ -223,30 +222,28 @@ void GDoorUser::persistUserDataToDisk() {
 	int* memAddrPointer = &memAddress;
 
 	// Write the uid
-	Serial.print("GDOOR USER: Writing UID to disk = ");
 	writeCharArrayToDisk(uid, memAddrPointer);
 	
 	// SSID
-	Serial.print("GDOOR USER: Writing SSID to disk = ");
 	writeCharArrayToDisk(ssid, memAddrPointer);
 	
 	// Password
-	Serial.print("GDOOR USER: Writing Password to disk = ");
 	writeCharArrayToDisk(password, memAddrPointer);
 
 	// Gateway IP
-	Serial.print("GDOOR USER: Writing gateway IP to disk = ");
 	writeIntArrayToDisk(gatewayIPArr, memAddrPointer, 4);
 
 	// Subnet Mask
-	Serial.print("GDOOR USER: Writing subnet mask to disk = ");
 	writeIntArrayToDisk(subnetMaskIpArr, memAddrPointer, 4);
 
+	// Device secret
+	if (hasDeviceSecret){
+		writeCharArrayToDisk(deviceSecret, memAddrPointer);
+	}
+
 	// Commit the data
 	EEPROM.end();
-	Serial.print("GDOOR USER: Wrote ");
-	Serial.print(memAddress);
-	Serial.println(" bytes to disk");
+	GLOG_INFO(LOG_USER_WROTE_BYTES, memAddress);
 }
 
 void GDoorUser::writeCharArrayToDisk(const char* data, int* addrPointer){
@@ -254,7 +251,6 @@ void GDoorUser::writeCharArrayToDisk(const char* data, int* addrPointer){
 	for (int i = 0; i < strlen(data); ++i) {
 		EEPROM.write(*addrPointer, data[i]);
 		*addrPointer += 1;
-		Serial.print(data[i]);
 	}
 
 	// Add CRLF
@@ -263,9 +259,7 @@ void GDoorUser::writeCharArrayToDisk(const char* data, int* addrPointer){
 	EEPROM.write(*addrPointer, LF);
 	*addrPointer += 1;
 
-	Serial.println("");
-	Serial.print("GDOOR USER: Current memory address pointer = ");
-	Serial.println(*addrPointer);
+	GLOG_DEBUG(LOG_USER_WROTE_FIELD, strlen(data), *addrPointer);
 }
 
 void GDoorUser::writeIntArrayToDisk(int* data, int* addrPointer, int arrayLength){
@@ -273,7 +267,6 @@ void GDoorUser::writeIntArrayToDisk(int* data, int* addrPointer, int arrayLength
 	for (int i = 0; i < arrayLength; ++i) {
 		EEPROM.write(*addrPointer, data[i]);
 		*addrPointer += 1;
-		Serial.print(data[i]);
 	}
 
 	// Add CRLF
@@ -282,9 +275,32 @@ void GDoorUser::writeIntArrayToDisk(int* data, int* addrPointer, int arrayLength
 	EEPROM.write(*addrPointer, LF);
 	*addrPointer += 1;
 
-	Serial.println("");
-	Serial.print("GDOOR USER: Current memory address pointer = ");
-	Serial.println(*addrPointer);
+	GLOG_DEBUG(LOG_USER_WROTE_FIELD, arrayLength, *addrPointer);
+}
+
+bool GDoorUser::setDeviceSecret(const char* secret){
+	// Memory only - persistUserDataToDisk() stores it
+	if (!isValidSecret(secret)){
+		return false;
+	}
+
+	strcpy(deviceSecret, secret);
+	hasDeviceSecret = true;
+	return true;
+}
+
+bool GDoorUser::isValidSecret(const char* secret){
+	if (strlen(secret) != DEVICE_SECRET_HEX_LEN){
+		return false;
+	}
+
+	for (int i = 0; i < DEVICE_SECRET_HEX_LEN; i++){
+		if (!isxdigit(secret[i])){
+			return false;
+		}
+	}
+
+	return true;
 }
 
 // Debug analysis
@@ -299,18 +315,6 @@ void GDoorUser::createIPStrings(){
 }
 
 
-void GDoorUser::printIPIntArray(int* data){
-	// loop through the data and print
-	for (int i = 0; i < sizeof(data); i++) {
-		// Print
-		Serial.print(*data);
-		Serial.print(".");
-		data += 1;
-	}
-
-	Serial.println("");
-}
-
 
 
 
@@ -13,6 +13,10 @@
 #include <EEPROM.h>
 #include <ESP8266WiFi.h>
 #include "../constants/Constants.h"
+#include "../constants/EepromLayout.h"
+#include "../logging/GDoorLog.hpp"
+
+#define DEVICE_SECRET_HEX_LEN 64			// 32 byte key
 
 class GDoorUser{
 	// User properties
@@ -26,7 +30,11 @@ class GDoorUser{
 		char uid[29];
 		char ssid[40];
 		char password[40];
-		DoorState currentDoorState;
+		DoorState doorStates[MAX_DOOR_CHANNELS];
+
+		// Per device HMAC key for signed requests (hex) - set when provisioned
+		char deviceSecret[DEVICE_SECRET_HEX_LEN + 1];
+		bool hasDeviceSecret;
 
 		// Networking props
 		IPAddress currentIPAddress; 
@@ -40,16 +48,17 @@ class GDoorUser{
 		GDoorUser();
 		bool loadUserData();
 		void persistUserDataToDisk();
+		bool setDeviceSecret(const char* secret);
 		void createIPStrings();
 
 	private:
 		// Private methods
 		void readUserDataFromDisk();
-		void readDataIntoCharPointer(int* addrPointer, char* target);
-		void readDataIntoIntPointer(int* addrPointer, int* target);
+		void readDataIntoCharPointer(int* addrPointer, char* target, int maxLength);
+		void readDataIntoIntPointer(int* addrPointer, int* target, int maxLength);
+		bool isValidSecret(const char* secret);
 		void writeCharArrayToDisk(const char* data, int* addrPointer);
 		void writeIntArrayToDisk(int* data, int* addrPointer, int arrayLength);
-		void printIPIntArray(int* data);
 };
 
 
@@ -0,0 +1,80 @@
+/*
+*	Static / DHCP fallback decision for the WiFi interface
+*	Source file	
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#include "AddressingPolicy.hpp"
+
+/*
+ *				Fallback Policy
+ *
+ *	Only a router that answers and hands back the wrong address has 
+ *  refused the static address. A timeout without association says 
+ *  nothing about the address - the AP is down, rebooting or out of 
+ *  range - so it never counts towards the fallback, and DHCP is 
+ *  never chosen (or cached in the lease) because of it.
+ *
+ */
+
+GDoorAddressingPolicy::GDoorAddressingPolicy(){
+	refusedAttempts = 0;
+	budgetStartMillis = 0;
+	budgetLengthMillis = 0;
+}
+
+void GDoorAddressingPolicy::reset(){
+	refusedAttempts = 0;
+}
+
+AddressingStep GDoorAddressingPolicy::onStaticAttempt(bool associated, bool correctAddress){
+	if (!associated){
+		return ADDRESSING_STEP_RETRY_STATIC;
+	}
+
+	if (correctAddress){
+		refusedAttempts = 0;
+		return ADDRESSING_STEP_CONNECTED;
+	}
+
+	refusedAttempts += 1;
+	if (refusedAttempts >= WIFI_STATIC_ATTEMPTS){
+		return ADDRESSING_STEP_FALL_BACK;
+	}
+
+	return ADDRESSING_STEP_RETRY_STATIC;
+}
+
+int GDoorAddressingPolicy::refusals(){
+	return refusedAttempts;
+}
+
+/*
+ *				Connection Budget
+ *
+ *	Neither an unreachable AP nor a DHCP server that never answers 
+ *  ends the wait on its own. Each connectWithFallback() call gets a 
+ *  budget instead, and every attempt is cut to what's left of it, 
+ *  so the caller gets control back before its supervisor deadline. 
+ *  Refusals are kept across calls - a budget that runs out between 
+ *  two refusals still falls back on the next call.
+ *
+ */
+
+void GDoorAddressingPolicy::startBudget(uint32_t nowMillis, uint32_t budgetMillis){
+	budgetStartMillis = nowMillis;
+	budgetLengthMillis = budgetMillis;
+}
+
+uint32_t GDoorAddressingPolicy::attemptTimeout(uint32_t nowMillis, uint32_t attemptMillis){
+	uint32_t spentMillis = nowMillis - budgetStartMillis;
+	if (spentMillis >= budgetLengthMillis){
+		return 0;
+	}
+
+	uint32_t remainingMillis = budgetLengthMillis - spentMillis;
+	return (remainingMillis < attemptMillis) ? remainingMillis : attemptMillis;
+}
@@ -0,0 +1,42 @@
+/*
+*	Static / DHCP fallback decision for the WiFi interface
+*	Header file
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#ifndef ADDRESSINGPOLICY_H
+#define ADDRESSINGPOLICY_H
+
+#include <stdint.h>
+
+#define WIFI_STATIC_ATTEMPTS 2					// Refused static addresses before falling back to DHCP
+
+// What to do after a static attempt
+typedef enum addressingStep {
+	ADDRESSING_STEP_CONNECTED,					// Associated on the static address
+	ADDRESSING_STEP_RETRY_STATIC,				// Keep the static config and try again
+	ADDRESSING_STEP_FALL_BACK					// Router refused the static address - switch to DHCP
+} AddressingStep;
+
+// No radio calls in here, so the decision can be exercised off-device
+class GDoorAddressingPolicy{
+	public:
+		GDoorAddressingPolicy();
+		void reset();
+		AddressingStep onStaticAttempt(bool associated, bool correctAddress);
+		int refusals();
+
+		// Time budget for one connectWithFallback() call - 0 from attemptTimeout() once it's spent
+		void startBudget(uint32_t nowMillis, uint32_t budgetMillis);
+		uint32_t attemptTimeout(uint32_t nowMillis, uint32_t attemptMillis);
+
+	private:
+		int refusedAttempts;
+		uint32_t budgetStartMillis;
+		uint32_t budgetLengthMillis;
+};
+
+#endif
@@ -15,7 +15,7 @@
 
 void GDoorWifi::startWifiCredAcquisition(const char wifiPin){
 	// Wrapper method to start 
-	Serial.println("Initiating WiFi set up");
+	GLOG_INFO(LOG_WIFI_CRED_ACQUISITION);
 
 	// For now, just start infinite loop and flash wifi light on and off
 	while(1){
@@ -27,128 +27,265 @@ void GDoorWifi::startWifiCredAcquisition(const char wifiPin){
 }
 
 IPAddress GDoorWifi::initialWiFiConnection(const char* ssid, const char* password, const int* gatewayIPArr, const int* subnetIPArr, const int staticOctet, const char ledPin){
+	// Blocking variant of the staged connection below
+	beginWiFiConnection(ssid, password, gatewayIPArr, subnetIPArr, staticOctet, ledPin);
+	return completeWiFiConnection();
+}
+
+/*
+ *				Staged Connection
+ *
+ *	The SDK associates with the AP and negotiates the lease in the 
+ *  background once WiFi.begin() has been called. Splitting the 
+ *  connection in two lets the boot sequence do useful work (door 
+ *  sampling, server setup) while the radio is busy.
+ *
+ */
+
+void GDoorWifi::beginWiFiConnection(const char* ssid, const char* password, const int* gatewayIPArr, const int* subnetIPArr, const int staticOctet, const char ledPin){
 	// Assign the local vars
 	currentSsid = ssid;
 	currentPassword = password;
-	currentGatewayIPArr = gatewayIPArr;
-	currentSubnetIPArr = subnetIPArr;
 	currentStaticOctet = staticOctet;
 	wifiLED = ledPin;
+	addressingMode = ADDRESSING_STATIC;
+	addressingPolicy.reset();
+	addressed = false;
+	targetGateway = IPAddress(gatewayIPArr[0], gatewayIPArr[1], gatewayIPArr[2], gatewayIPArr[3]);
+	targetSubnet = IPAddress(subnetIPArr[0], subnetIPArr[1], subnetIPArr[2], subnetIPArr[3]);
+
+	// A reset after falling back to DHCP goes straight to DHCP
+	loadLease();
+	startWifiConnection();
+}
 
-	// Connect and ensure static IP is achieved
-	return connectToWifiWithStaticIP(currentSsid, currentPassword, currentGatewayIPArr, currentSubnetIPArr, currentStaticOctet);
+IPAddress GDoorWifi::completeWiFiConnection(){
+	return connectWithFallback(WIFI_BOOT_CONNECT_BUDGET);
 }
 
-IPAddress GDoorWifi::connectToWifiWithStaticIP(const char* ssid, const char* password, const int* gatewayIPArr, const int* subnetIPArr, const int staticOctet){
-	// Wrapper method to attempt wifi connections untill the static IP works
-	IPAddress assignedLanIPAddress;
-	
-	// Attempt an initial connection
-	assignedLanIPAddress = connectToWifi(ssid, password, gatewayIPArr, subnetIPArr, staticOctet);
-	bool correctStaticIP = (assignedLanIPAddress[0] == gatewayIPArr[0]) && (assignedLanIPAddress[1] == gatewayIPArr[1]) && (assignedLanIPAddress[2] == gatewayIPArr[2]) && (assignedLanIPAddress[3] == staticOctet);
-	delay(1000);
+bool GDoorWifi::isUsingDHCP(){
+	return addressingMode == ADDRESSING_DHCP;
+}
+
+bool GDoorWifi::hasAddress(){
+	return addressed;
+}
+
+/*
+ *				Addressing
+ *
+ *	The sensor wants gateway.x.x.<staticOctet> so the port forward 
+ *  on the router keeps pointing at it. Routers where that address 
+ *  is taken or outside their range used to keep it retrying forever. 
+ *  Now a router that associates but leaves the sensor on the wrong 
+ *  address WIFI_STATIC_ATTEMPTS times gets DHCP instead, and the 
+ *  sensor reports whatever it hands out. An AP that can't be reached 
+ *  at all keeps the static config - see AddressingPolicy.cpp - so a 
+ *  router reboot never pushes the sensor off its forwarded address.
+ *
+ *	The address in use and the gateway DHCP reported are kept in 
+ *  RTC memory. A reset (not a power cut) reuses them: DHCP mode 
+ *  skips the static attempts, and static mode uses the discovered 
+ *  gateway if the router's address has changed.
+ *
+ *	Each call gets a time budget (see AddressingPolicy.cpp). Once 
+ *  it's spent an unset address is returned and the SDK is left 
+ *  trying with the current config - the loop's reconnect check 
+ *  picks the connection up again on a later pass.
+ *
+ */
+
+IPAddress GDoorWifi::connectWithFallback(unsigned long budget){
+	addressingPolicy.startBudget(millis(), budget);
+	addressed = false;
+	if (addressingMode == ADDRESSING_STATIC){
+		while (true){
+			unsigned long timeout = addressingPolicy.attemptTimeout(millis(), WIFI_CONNECT_TIMEOUT);
+			if (timeout == 0){
+				GLOG_WARN(LOG_WIFI_CONNECT_GAVE_UP, budget, addressingMode);
+				return IPAddress();
+			}
+
+			bool associated = waitForWifiConnection(timeout);
+			AddressingStep step = addressingPolicy.onStaticAttempt(associated, associated && isCorrectStaticIP(WiFi.localIP()));
+			if (step == ADDRESSING_STEP_CONNECTED){
+				GLOG_INFO(LOG_WIFI_STATIC_OK);
+				storeLease(WiFi.localIP());
+				addressed = true;
+				return WiFi.localIP();
+			}
+
+			if (step == ADDRESSING_STEP_FALL_BACK){
+				break;
+			}
 
-	while (!correctStaticIP) {
-		// Disconnect 
-		Serial.print("WIFI INTERFACE: Re-attempting connection, incorrectly assigned static IP => ");
-		Serial.println(assignedLanIPAddress);
-		digitalWrite(wifiLED, LOW);
+			if (associated){
+				// Wrong address - disconnect & try again
+				IPAddress assignedLanIPAddress = WiFi.localIP();
+				GLOG_WARN(LOG_WIFI_STATIC_RETRY, assignedLanIPAddress[0], assignedLanIPAddress[1], assignedLanIPAddress[2], assignedLanIPAddress[3]);
+				digitalWrite(wifiLED, LOW);
+				WiFi.disconnect();
+				startWifiConnection();
+			}
+
+			// Unreachable AP - the SDK keeps trying to associate with the static config
+			yield();
+		}
+
+		GLOG_WARN(LOG_WIFI_DHCP_FALLBACK, addressingPolicy.refusals());
+		addressingMode = ADDRESSING_DHCP;
 		WiFi.disconnect();
-		delay(1000);
+		startWifiConnection();
+	}
+
+	// DHCP can't be refused - only an unreachable AP keeps this waiting
+	while (true){
+		unsigned long timeout = addressingPolicy.attemptTimeout(millis(), WIFI_CONNECT_TIMEOUT);
+		if (timeout == 0){
+			GLOG_WARN(LOG_WIFI_CONNECT_GAVE_UP, budget, addressingMode);
+			return IPAddress();
+		}
 
-		// Attempt to connect to wifi
-		assignedLanIPAddress = connectToWifi(ssid, password, gatewayIPArr, subnetIPArr, staticOctet);
+		if (waitForWifiConnection(timeout)){
+			break;
+		}
 
-		// Check the allocate static IP
-		correctStaticIP = (assignedLanIPAddress[0] == gatewayIPArr[0]) && (assignedLanIPAddress[1] == gatewayIPArr[1]) && (assignedLanIPAddress[2] == gatewayIPArr[2]) && (assignedLanIPAddress[3] == staticOctet);
+		yield();
 	}
 
-	Serial.println("WIFI INTERFACE: Successfully connected to correct static IP");
-	return assignedLanIPAddress;
+	// Gateway discovery - the next static attempt targets the router that's actually there
+	targetGateway = WiFi.gatewayIP();
+	targetSubnet = WiFi.subnetMask();
+	storeLease(WiFi.localIP());
+	addressed = true;
+	return WiFi.localIP();
 }
 
-IPAddress GDoorWifi::connectToWifi(const char* ssid, const char* password, const int* gatewayIPArr, const int* subnetIPArr, const int staticOctet){
-	// Attempt to create static IP
+void GDoorWifi::startWifiConnection(){
 	WiFi.mode(WIFI_STA);
 
-	// Attempt to create static IP
-	WiFi.begin(ssid, password);
-	setupStaticSensorIP(gatewayIPArr, subnetIPArr, staticOctet);
+	// Address config before begin() so the first lease request already uses it
+	if (addressingMode == ADDRESSING_STATIC){
+		setupStaticSensorIP();
+	}
+
+	else{
+		// All zeros re-enables the DHCP client
+		WiFi.config(IPAddress(0, 0, 0, 0), IPAddress(0, 0, 0, 0), IPAddress(0, 0, 0, 0));
+	}
+
+	WiFi.begin(currentSsid, currentPassword);
+}
 
+bool GDoorWifi::waitForWifiConnection(unsigned long timeout){
 	// Wait for a connection
-	Serial.print("WIFI INTERFACE: Attempting to connect to WiFi => ");
-	Serial.println(ssid);
+	GLOG_INFO(LOG_WIFI_CONNECTING);
+	unsigned long startMillis = millis();
 	while (WiFi.status() != WL_CONNECTED){
+		if (millis() - startMillis >= timeout){
+			GLOG_WARN(LOG_WIFI_CONNECT_TIMEOUT, timeout, addressingMode);
+			return false;
+		}
+
 		delay(500);
-		Serial.print(".");
 		toggleLED();
 	}
 
-	Serial.println("");
-	Serial.print("WIFI INTERFACE: Connected to ");
-	Serial.println(ssid);
+	GLOG_INFO(LOG_WIFI_CONNECTED, millis() - startMillis);
 
 	// State all info
-	delay(1000);
 	IPAddress ipAddress = WiFi.localIP();
-	Serial.print("WIFI INTERFACE: Assigned IP address = ");
-	Serial.println(ipAddress);
-	Serial.print("WIFI INTERFACE: Gateway IP = ");
-	Serial.println(WiFi.gatewayIP());
-	Serial.print("WIFI INTERFACE: Subnet mask = ");
-	Serial.println(WiFi.subnetMask());
+	IPAddress gatewayIP = WiFi.gatewayIP();
+	IPAddress subnetMask = WiFi.subnetMask();
+	GLOG_INFO(LOG_WIFI_ASSIGNED_IP, ipAddress[0], ipAddress[1], ipAddress[2], ipAddress[3]);
+	GLOG_INFO(LOG_WIFI_GATEWAY_IP, gatewayIP[0], gatewayIP[1], gatewayIP[2], gatewayIP[3]);
+	GLOG_INFO(LOG_WIFI_SUBNET_MASK, subnetMask[0], subnetMask[1], subnetMask[2], subnetMask[3]);
 
 	// Indicate connected state on LED
 	digitalWrite(wifiLED, HIGH);
-	return ipAddress;
+	return true;
 }
 
-void GDoorWifi::setupStaticSensorIP(const int* gatewayIPArr, const int* subnetIPArr, const int staticOctet){
+void GDoorWifi::setupStaticSensorIP(){
 	// Create stati IP - 192.168.1.105
-	IPAddress ip(gatewayIPArr[0], gatewayIPArr[1], gatewayIPArr[2], staticOctet);					// Virtual server: 192.168.8.105
-	IPAddress subnet(subnetIPArr[0], subnetIPArr[1], subnetIPArr[2], subnetIPArr[3]);
-	IPAddress gateway(gatewayIPArr[0], gatewayIPArr[1], gatewayIPArr[2], gatewayIPArr[3]);				// Router IP - gateway(192, 168, 8, 1); 	
+	IPAddress ip(targetGateway[0], targetGateway[1], targetGateway[2], currentStaticOctet);
 
-	Serial.print("WIFI INTERFACE: Configuring static IP address => ");
-	Serial.println(ip);
-	WiFi.config(ip, gateway, subnet, gateway);
+	GLOG_INFO(LOG_WIFI_CONFIG_STATIC, ip[0], ip[1], ip[2], ip[3]);
+	WiFi.config(ip, targetGateway, targetSubnet, targetGateway);
 }
 
 IPAddress GDoorWifi::setWiFiReconnectingState(){
-	// Start a ticker at interval 500ms
-	Serial.println("WIFI INTERFACE: WiFi connection dropped, attempting to reconnect");
+	// The SDK reconnects on its own - wait a bounded time so the loop keeps running
+	GLOG_WARN(LOG_WIFI_DROPPED);
+	unsigned long startMillis = millis();
 	while (WiFi.status() != WL_CONNECTED){
+		if (millis() - startMillis >= WIFI_RECONNECT_TIMEOUT){
+			GLOG_WARN(LOG_WIFI_RECON_TIMEOUT, millis() - startMillis);
+			return IPAddress();
+		}
+
 		delay(500);
-		Serial.print(".");
 		toggleLED();
 	}
 
 	// Reconnected
-	Serial.println("WIFI INTERFACE: Successfully reconnected");
+	GLOG_INFO(LOG_WIFI_RECONNECTED, millis() - startMillis);
 	digitalWrite(wifiLED, HIGH);
 
-	// Print and return the assigned local IP on reconnection
-	delay(1000);
 	IPAddress ipAddress = WiFi.localIP();
-	IPAddress gatewayIP = WiFi.gatewayIP();
-	Serial.print("WIFI INTERFACE: Assigned LAN IP address = ");
-	Serial.println(ipAddress);
+	GLOG_INFO(LOG_WIFI_ASSIGNED_IP, ipAddress[0], ipAddress[1], ipAddress[2], ipAddress[3]);
 
-	// Check if statuc IP is correctly assigned
-	bool correctStaticIP = (ipAddress[0] == gatewayIP[0]) && (ipAddress[1] == gatewayIP[1]) && (ipAddress[2] == gatewayIP[2]) && (ipAddress[3] == currentStaticOctet);
-	if (!correctStaticIP){
+	// Check the static IP survived - same bounded fallback as at boot
+	if (addressingMode == ADDRESSING_STATIC && !isCorrectStaticIP(ipAddress)){
 		WiFi.disconnect();
-		ipAddress = connectToWifiWithStaticIP(currentSsid, currentPassword, currentGatewayIPArr, currentGatewayIPArr, currentStaticOctet);
+		startWifiConnection();
+		return connectWithFallback(WIFI_RECON_CONNECT_BUDGET);
 	}
 
+	storeLease(ipAddress);
+	addressed = true;
 	return ipAddress;
 }
 
-void GDoorWifi::toggleLED(){
-	int state = digitalRead(wifiLED);
-	digitalWrite(wifiLED, !state);
+bool GDoorWifi::isCorrectStaticIP(IPAddress ipAddress){
+	return (ipAddress[0] == targetGateway[0]) && (ipAddress[1] == targetGateway[1]) && (ipAddress[2] == targetGateway[2]) && (ipAddress[3] == currentStaticOctet);
 }
 
+// Lease cache
+
+void GDoorWifi::loadLease(){
+	WifiLease lease;
+	if (!ESP.rtcUserMemoryRead(RTC_SLOT_WIFI_LEASE, (uint32_t*)&lease, sizeof(lease))){
+		return;
+	}
+
+	if (lease.magic != WIFI_LEASE_MAGIC || lease.checksum != leaseChecksum(&lease)){
+		return;
+	}
 
+	addressingMode = (AddressingMode)lease.mode;
+	targetGateway = IPAddress(lease.gateway);
+	targetSubnet = IPAddress(lease.subnet);
+	GLOG_INFO(LOG_WIFI_LEASE_RESTORED, lease.mode, targetGateway[0], targetGateway[1], targetGateway[2]);
+}
 
+void GDoorWifi::storeLease(IPAddress ipAddress){
+	WifiLease lease;
+	lease.magic = WIFI_LEASE_MAGIC;
+	lease.mode = addressingMode;
+	lease.address = (uint32_t)ipAddress;
+	lease.gateway = (uint32_t)targetGateway;
+	lease.subnet = (uint32_t)targetSubnet;
+	lease.checksum = leaseChecksum(&lease);
+	ESP.rtcUserMemoryWrite(RTC_SLOT_WIFI_LEASE, (uint32_t*)&lease, sizeof(lease));
+	GLOG_INFO(LOG_WIFI_LEASE_CACHED, ipAddress[0], ipAddress[1], ipAddress[2], ipAddress[3]);
+}
 
+uint32_t GDoorWifi::leaseChecksum(const WifiLease* lease){
+	return lease->magic ^ lease->mode ^ lease->address ^ lease->gateway ^ lease->subnet ^ 0xA5A5A5A5;
+}
+
+void GDoorWifi::toggleLED(){
+	int state = digitalRead(wifiLED);
+	digitalWrite(wifiLED, !state);
+}
@@ -13,8 +13,31 @@
 
 #include <ESP8266WiFi.h>
 #include <Arduino.h>
+#include "../constants/Constants.h"
+#include "../logging/GDoorLog.hpp"
+#include "AddressingPolicy.hpp"
 
-// Static IP 
+// Addressing bounds
+#define WIFI_CONNECT_TIMEOUT 15000				// Millis per connection attempt
+#define WIFI_RECONNECT_TIMEOUT 10000			// Max millis the loop is held per reconnect check
+#define WIFI_BOOT_CONNECT_BUDGET 240000			// Max millis setup waits for an address - under the boot deadline
+#define WIFI_RECON_CONNECT_BUDGET 90000			// Same after a reconnect - under the WiFi recon deadline
+#define WIFI_LEASE_MAGIC 0x47444C31				// "GDL1"
+
+typedef enum addressingMode {
+	ADDRESSING_STATIC,
+	ADDRESSING_DHCP
+} AddressingMode;
+
+// Last good address - kept in RTC memory across resets
+typedef struct wifiLease {
+	uint32_t magic;
+	uint32_t mode;
+	uint32_t address;
+	uint32_t gateway;
+	uint32_t subnet;
+	uint32_t checksum;
+} WifiLease;
 
 class GDoorWifi{
 	public:
@@ -22,22 +45,37 @@ class GDoorWifi{
 		IPAddress initialWiFiConnection(const char* ssid, const char* password, const int* gatewayIPArr, const int* subnetIPArr, const int staticOctet, const char ledPin);
 		IPAddress setWiFiReconnectingState();
 
+		// Staged connection - lets the caller work while the radio associates
+		void beginWiFiConnection(const char* ssid, const char* password, const int* gatewayIPArr, const int* subnetIPArr, const int staticOctet, const char ledPin);
+		IPAddress completeWiFiConnection();
+
+		bool isUsingDHCP();
+		bool hasAddress();						// False after a connection ran out of budget - the loop retries
+
 	private:
 		// Private constants
 		int wifiLED;
 		const char* currentSsid;
 		const char* currentPassword;
-		const int* currentGatewayIPArr;
-		const int* currentSubnetIPArr;
 		int currentStaticOctet;
+		AddressingMode addressingMode;
+		GDoorAddressingPolicy addressingPolicy;
+		bool addressed;
+		IPAddress targetGateway;				// Stored gateway, or the one DHCP last reported
+		IPAddress targetSubnet;
 
-		IPAddress connectToWifiWithStaticIP(const char* ssid, const char* password, const int* gatewayIPArr, const int* subnetIPArr, const int staticOctet);
-		void setupStaticSensorIP(const int* gatewayIPArr, const int* subnetIPArr, const int staticOctet);
-		IPAddress connectToWifi(const char* ssid, const char* password, const int* gatewayIPArr, const int* subnetIPArr, const int staticOctet);
+		IPAddress connectWithFallback(unsigned long budget);
+		void setupStaticSensorIP();
+		void startWifiConnection();
+		bool waitForWifiConnection(unsigned long timeout);
+		bool isCorrectStaticIP(IPAddress ipAddress);
+		void loadLease();
+		void storeLease(IPAddress ipAddress);
+		uint32_t leaseChecksum(const WifiLease* lease);
 		void toggleLED();
 };
 
 
 
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,45 @@
+/*
+*	Minimal test runner for the host tests
+*	Source file
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#include "TestHarness.hpp"
+
+#define MAX_TESTS 64
+
+static const char* testNames[MAX_TESTS];
+static TestFunction testFunctions[MAX_TESTS];
+static int testCount = 0;
+static int failures = 0;
+
+TestRegistration::TestRegistration(const char* name, TestFunction function){
+  if (testCount < MAX_TESTS){
+    testNames[testCount] = name;
+    testFunctions[testCount] = function;
+    testCount += 1;
+  }
+}
+
+void testFailed(const char* file, int line, const char* expression){
+  printf("  FAILED %s:%d: %s\n", file, line, expression);
+  failures += 1;
+}
+
+int main(int argc, char** argv){
+  int failedTests = 0;
+  for (int i = 0; i < testCount; i++){
+    int before = failures;
+    testFunctions[i]();
+    if (failures != before){
+      printf("FAIL %s\n", testNames[i]);
+      failedTests += 1;
+    }
+  }
+
+  printf("%s: %d/%d passed\n", argv[0], testCount - failedTests, testCount);
+  return failedTests == 0 ? 0 : 1;
+}
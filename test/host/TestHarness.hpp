@@ -0,0 +1,39 @@
+/*
+*	Minimal test runner for the host tests
+*	Header file
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#ifndef TESTHARNESS_H
+#define TESTHARNESS_H
+
+#include <stdio.h>
+#include <string.h>
+
+typedef void (*TestFunction)();
+
+struct TestRegistration {
+  TestRegistration(const char* name, TestFunction function);
+};
+
+void testFailed(const char* file, int line, const char* expression);
+
+// TEST(name){ ... } - registered before main() runs
+#define TEST(name) \
+  static void name(); \
+  static TestRegistration name##Registration(#name, name); \
+  static void name()
+
+#define CHECK(condition) \
+  do { if (!(condition)) testFailed(__FILE__, __LINE__, #condition); } while (0)
+
+#define CHECK_EQ(expected, actual) \
+  do { if (!((expected) == (actual))) testFailed(__FILE__, __LINE__, #expected " == " #actual); } while (0)
+
+#define CHECK_STR(expected, actual) \
+  do { if (strcmp((expected), (actual)) != 0) testFailed(__FILE__, __LINE__, #actual " == \"" expected "\""); } while (0)
+
+#endif
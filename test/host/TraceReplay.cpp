@@ -0,0 +1,103 @@
+/*
+*	Host replay of a recorded trace's door path through 
+*   the firmware's GDoorIO
+*	Source file
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#include "TraceReplay.hpp"
+#include "digital-io/GDoorIO.hpp"
+
+/*
+ *  Sensor edges set the pin, channel config records go through 
+ *  setDebounce(), and the sampler runs every REPLAY_STEP_MS as the 
+ *  loop would. Everything else in the capture is ignored. What the 
+ *  firmware records while it runs is the output, so it can go 
+ *  straight back into decode_trace.py.
+ *
+ *  Each channel starts in the state its first edge leaves, with the 
+ *  sample grid lined up on that edge, as edges are only ever 
+ *  recorded at sample time.
+ *
+*/
+
+static TraceRecord readRecord(const uint8_t* data){
+  TraceRecord record;
+  record.millis = data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+  record.type = data[4];
+  record.arg = data[5];
+  record.value = data[6] | (data[7] << 8);
+  return record;
+}
+
+int replayTrace(const uint8_t* recorded, int recordCount, uint8_t* output, int maxOutput){
+  if (recordCount == 0){
+    return 0;
+  }
+
+  GDoorIO io;
+  io.channelCount = 1;
+  bool primed[MAX_DOOR_CHANNELS] = { false };
+  for (int i = 0; i < recordCount; i++){
+    TraceRecord record = readRecord(&recorded[i * TRACE_RECORD_WIRE_LEN]);
+    if ((record.type != TRACE_GPIO_EDGE && record.type != TRACE_CHANNEL_CONFIG) || record.arg >= MAX_DOOR_CHANNELS){
+      continue;
+    }
+
+    if (record.arg >= io.channelCount){
+      io.channelCount = record.arg + 1;
+    }
+
+    // Config ahead of a channel's first edge is what it was sampled with
+    if (record.type == TRACE_CHANNEL_CONFIG && !primed[record.arg]){
+      io.setDebounce(record.arg, record.value >> 10, record.value & 0x3FF);
+    }
+
+    if (record.type == TRACE_GPIO_EDGE && !primed[record.arg]){
+      DoorChannel* channel = &io.channels[record.arg];
+      channel->lastLevel = !record.value;
+      channel->state = (channel->lastLevel == HIGH) ? DOOR_STATE_OPEN : DOOR_STATE_CLOSED;
+      channel->lowSamples = (channel->lastLevel == HIGH) ? 0 : channel->debounceSamples;
+      channel->lastSampleMillis = record.millis - channel->debounceInterval;
+      hostPinLevels[channel->sensorPin] = channel->lastLevel;
+      primed[record.arg] = true;
+    }
+  }
+
+  // Run past the last record long enough for a pending close to land
+  uint32_t start = readRecord(recorded).millis;
+  uint32_t end = readRecord(&recorded[(recordCount - 1) * TRACE_RECORD_WIRE_LEN]).millis + 50 * 1000;
+  int next = 0;
+  int written = 0;
+  for (hostMillis = start; hostMillis <= end && written < maxOutput; hostMillis += REPLAY_STEP_MS){
+    gdoorTrace = GDoorTrace();
+
+    while (next < recordCount){
+      TraceRecord record = readRecord(&recorded[next * TRACE_RECORD_WIRE_LEN]);
+      if (record.millis > hostMillis){
+        break;
+      }
+
+      next += 1;
+      if (record.arg >= io.channelCount){
+        continue;
+      }
+
+      if (record.type == TRACE_GPIO_EDGE){
+        hostPinLevels[io.channels[record.arg].sensorPin] = record.value ? HIGH : LOW;
+      }
+
+      else if (record.type == TRACE_CHANNEL_CONFIG){
+        io.setDebounce(record.arg, record.value >> 10, record.value & 0x3FF);
+      }
+    }
+
+    io.sampleDoorStates();
+    written += gdoorTrace.dumpRecords(0, &output[written * TRACE_RECORD_WIRE_LEN], maxOutput - written);
+  }
+
+  return written;
+}
@@ -0,0 +1,21 @@
+/*
+*	Host replay of a recorded trace's door path through 
+*   the firmware's GDoorIO
+*	Header file
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#ifndef TRACEREPLAY_H
+#define TRACEREPLAY_H
+
+#include "diagnostics/TraceRecorder.hpp"
+
+#define REPLAY_STEP_MS 1              // Loop pass cadence on the host
+
+// Records in wire format - returns the number of records written to output
+int replayTrace(const uint8_t* recorded, int recordCount, uint8_t* output, int maxOutput);
+
+#endif
@@ -0,0 +1,323 @@
+/*
+*	Hot path benchmarks on the host - the firmware's
+*   GDoorBenchmark suite built against the shims
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "diagnostics/Benchmark.hpp"
+#include "diagnostics/HealthSnapshot.hpp"
+#include "diagnostics/MemoryProfiler.hpp"
+#include "diagnostics/Supervisor.hpp"
+#include "networking/BinaryUplink.hpp"
+#include "networking/LocalControl.hpp"
+#include "networking/UploadQueue.hpp"
+#include "networking/UplinkJson.hpp"
+#include "networking/WebServer.hpp"
+#include "rules/GDoorRules.hpp"
+#include "settings/GDoorSettings.hpp"
+
+/*
+ *  Same benchmarks, names & inputs as runHotPathBenchmarks() in
+ *  gdoor_esp.ino, plus the door sampling pass at each channel 
+ *  count and the paths the device suite can't reach without a 
+ *  client on the network (route lookup, a whole request, a LAN 
+ *  control datagram). The shims count cycles from the host
+ *  clock at 80 MHz, so nsPerOp is real host time - the numbers are
+ *  a desktop CPU's, not the ESP8266's. What carries over is the
+ *  ratio between runs, so keep a baseline and compare:
+ *
+ *    make bench > before.log
+ *    (change something)
+ *    make bench > after.log
+ *    python3 ../../tools/compare_bench.py before.log after.log --tolerance 0.25
+ *
+ *  (a desktop shared with other work is noisier than the device, 
+ *  hence the looser tolerance).
+ *  Host iterations are HOST_ITERATIONS x the device's, the runs
+ *  being too short to time otherwise.
+ *
+*/
+
+#define HOST_ITERATIONS 20
+#define BENCH_UID "T3stUid000000000000000000001"
+#define BENCH_SECRET "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f"
+#define BENCH_VERSION "1.0.0"
+#define BENCH_RULES "01000000580200000100040f0807000002000100603501000200051e784a0100020001006054000002000100100e000002000100302a000001000000201c0000"
+#define LOCAL_CONTROL_DATAGRAMS ((2000 * HOST_ITERATIONS) + 1)
+
+// Results to stdout rather than the capturing Serial shim
+class StdoutStream : public Stream {
+  public:
+    size_t write(const uint8_t* data, size_t length){
+      return fwrite(data, 1, length, stdout);
+    }
+};
+
+static GDoorUser user;
+static GDoorIO doorIO;
+static GDoorClock deviceClock;
+static GDoorSupervisor supervisor;
+static GDoorMemoryProfiler memoryProfiler;
+static GDoorHealthSnapshot healthSnapshot;
+static GDoorRequestAuth requestAuth;
+static GDoorUser legacyUser;
+static GDoorRequestAuth legacyAuth;
+static GDoorWebServer webServer;
+static GDoorLocalControl localControl;
+static GDoorSettings settings;
+static UploadQueue uploadQueue;
+
+// Signed STATUS requests, one per call - the replay check refuses a repeat
+static uint8_t localDatagrams[LOCAL_CONTROL_DATAGRAMS][LOCAL_CONTROL_REQUEST_LEN];
+static int localDatagramIndex = 0;
+
+static void run(GDoorBenchmark& bench, const char* name, BenchmarkFunction function, void* context, int deviceIterations){
+  bench.run(name, function, context, deviceIterations * HOST_ITERATIONS);
+}
+
+static void noContent(GDoorWebServer* web, void* context, int channel){
+  web->send(204, "text/plain", "");
+}
+
+static void benchSampleDoorStates(void* context){
+  // Force every channel due so the pin read & debounce run
+  for (int channel = 0; channel < doorIO.channelCount; channel++){
+    doorIO.channels[channel].lastSampleMillis = 0;
+  }
+
+  doorIO.sampleDoorStates();
+}
+
+static void benchCreateHttpJson(void* context){
+  char timestamps[TIMESTAMP_ENTRIES_LEN] = "\"capturedAt\":\"0\",\"sentAt\":\"0\"";
+  char payload[150];
+  createHttpJson("00", 0, user.uid, timestamps, payload);
+}
+
+static void benchCreateTimestampEntries(void* context){
+  char timestamps[TIMESTAMP_ENTRIES_LEN];
+  createTimestampEntries(1522963577000ULL, 1522963577250ULL, timestamps);
+}
+
+static void benchCreateBootInfoJson(void* context){
+  char timestamps[TIMESTAMP_ENTRIES_LEN] = "\"capturedAt\":\"0\",\"sentAt\":\"0\"";
+  char payload[BOOT_INFO_JSON_LEN];
+  createBootInfoJson("6969", user.uid, BENCH_VERSION, "192.168.1.250", "192.168.1.250", false, user.doorStates, doorIO.channelCount, 0, supervisor.lastReset(), timestamps, payload);
+}
+
+static void benchEncodeDoorStateBinary(void* context){
+  uint8_t payload[BINARY_UPLINK_MAX_LEN];
+  encodeDoorStateBinary(1, user.uid, DOOR_STATE_OPEN, 0, 1522963577000ULL, 1522963577250ULL, payload);
+}
+
+static void benchEncodeBootInfoBinary(void* context){
+  uint8_t payload[BINARY_UPLINK_MAX_LEN];
+  encodeBootInfoBinary(user.uid, "6969", BENCH_VERSION, "192.168.1.250", "192.168.1.250", false, user.doorStates, doorIO.channelCount, 0, supervisor.lastReset(), 1522963577000ULL, 1522963577250ULL, payload);
+}
+
+static void benchCreateIPStrings(void* context){
+  user.createIPStrings();
+}
+
+static void benchEnterStage(void* context){
+  supervisor.setStage(SUPERVISOR_STAGE_BOOT);
+  memoryProfiler.enter(SUPERVISOR_STAGE_BOOT);
+}
+
+static void benchHealthSnapshotCached(void* context){
+  char body[HEALTH_SNAPSHOT_JSON_LEN];
+  healthSnapshot.toJson(86400000ULL, body);
+}
+
+static void benchHealthSnapshotRender(void* context){
+  static int rssi = -60;
+  char body[HEALTH_SNAPSHOT_JSON_LEN];
+  rssi = (rssi == -60) ? -61 : -60;
+  healthSnapshot.setRssi(rssi);
+  healthSnapshot.toJson(86400000ULL, body);
+}
+
+static void benchRulesTick(void* context){
+  ((GDoorRules*)context)->tick(deviceClock.monotonicMillis());
+}
+
+static void benchRulesOnDoorState(void* context){
+  ((GDoorRules*)context)->onDoorState(0, DOOR_STATE_OPEN, deviceClock.monotonicMillis());
+}
+
+static void benchLoadUserData(void* context){
+  user.loadUserData();
+}
+
+static void benchPersistUserData(void* context){
+  // Unchanged data - no flash erase on the device
+  user.persistUserDataToDisk();
+}
+
+static void benchVerifySignature(void* context){
+  requestAuth.verifySignature("GET", "/" BENCH_UID "/0/ActuateDoor", "", "0123456789abcdef", "1522963577",
+    "00112233445566778899aabbccddeeff00112233445566778899aabbccddeeff");
+}
+
+static void benchFindRoute(void* context){
+  // Last route registered - the longest walk of the table
+  int channel = -1;
+  webServer.findRoute("/" BENCH_UID "/RotateSecret", &channel);
+}
+
+static void benchDispatchRequest(void* context){
+  // Route, method & legacy (no secret) auth, then the handler's reply
+  webServer.request()->setRequest(HTTP_GET, "/" BENCH_UID "/RotateSecret");
+  webServer.handle();
+}
+
+static void benchLocalControlStatus(void* context){
+  // Parse, tag check, replay check & the signed reply
+  memcpy(hostUdpInbound, localDatagrams[localDatagramIndex], LOCAL_CONTROL_REQUEST_LEN);
+  hostUdpInboundLength = LOCAL_CONTROL_REQUEST_LEN;
+  localDatagramIndex = (localDatagramIndex + 1) % LOCAL_CONTROL_DATAGRAMS;
+  localControl.handle();
+}
+
+static void benchUploadQueuePushPop(void* context){
+  UploadEvent event;
+  uploadQueue.push(UPLOAD_DOOR_STATE, DOOR_STATE_OPEN, 1522963577000ULL, 0);
+  uploadQueue.pop(&event, 1522963577000ULL);
+}
+
+static void benchSettingsApplyJson(void* context){
+  // A health response carrying one change - applied, then nothing left to persist
+  settings.applyJson("{\"healthCheckInterval\":900000}");
+}
+
+static void put32(uint8_t* target, uint32_t value){
+  for (int i = 0; i < 4; i++){
+    target[i] = (value >> (8 * i)) & 0xFF;
+  }
+}
+
+// HELLO for the nonce, then a STATUS per benchmark call signed the way the app does
+static void prepareLocalControl(){
+  const uint32_t clientId = 0xBE4C0001;
+  uint8_t hello[LOCAL_CONTROL_REQUEST_LEN] = { 'G', 'D', LOCAL_CONTROL_VERSION, LOCAL_CMD_HELLO };
+  put32(&hello[12], clientId);
+  memcpy(hostUdpInbound, hello, sizeof(hello));
+  hostUdpInboundLength = sizeof(hello);
+  localControl.handle();
+  uint32_t counter = (uint32_t)hostUdpSent[4] | ((uint32_t)hostUdpSent[5] << 8) | ((uint32_t)hostUdpSent[6] << 16) | ((uint32_t)hostUdpSent[7] << 24);
+
+  uint8_t key[AUTH_KEY_LEN];
+  int keyLength = GDoorRequestAuth::deviceKey(&user, key);
+  br_hmac_key_context keyContext;
+  br_hmac_key_init(&keyContext, &br_sha256_vtable, key, keyLength);
+  for (int i = 0; i < LOCAL_CONTROL_DATAGRAMS; i++){
+    uint8_t* datagram = localDatagrams[i];
+    counter += 1;
+    datagram[0] = 'G';
+    datagram[1] = 'D';
+    datagram[2] = LOCAL_CONTROL_VERSION;
+    datagram[3] = LOCAL_CMD_STATUS;
+    put32(&datagram[4], counter);
+    memcpy(&datagram[8], &hostUdpSent[8], 4);
+    put32(&datagram[12], clientId);
+    datagram[LOCAL_CONTROL_HEADER_LEN] = 0;
+
+    br_hmac_context context;
+    br_hmac_init(&context, &keyContext, LOCAL_CONTROL_TAG_LEN);
+    br_hmac_update(&context, datagram, LOCAL_CONTROL_HEADER_LEN + 1);
+    br_hmac_out(&context, &datagram[LOCAL_CONTROL_HEADER_LEN + 1]);
+  }
+}
+
+static void setUp(){
+  hostCycleClock = true;
+  hostMillis = 1000;
+  EEPROM.erase();
+  strcpy(user.uid, BENCH_UID);
+  strcpy(user.ssid, "ssid");
+  strcpy(user.password, "password");
+  user.setDeviceSecret(BENCH_SECRET);
+  user.persistUserDataToDisk();
+
+  doorIO.setChannelCount(MAX_DOOR_CHANNELS);
+  deviceClock.begin();
+  supervisor.begin(&doorIO);
+  memoryProfiler.begin();
+  healthSnapshot.begin(BENCH_VERSION, doorIO.channelCount);
+  healthSnapshot.setConnection(1522963577000ULL, 4210);
+  settings.load();
+
+  // The web server gets a legacy (no secret) device so requests reach the handler unsigned
+  requestAuth.begin(&user, &deviceClock);
+  strcpy(legacyUser.uid, BENCH_UID);
+  legacyAuth.begin(&legacyUser, &deviceClock);
+  // Registered in serverSetup()'s order
+  const char* routes[] = { "ActuateDoor", "HealthCheck", "ForceDoorStatusCheck", "ForceHealthCheck", "LogDump",
+    "Settings", "Diagnostics", "TraceDump", "Rules", "RotateSecret" };
+  for (int i = 0; i < (int)(sizeof(routes) / sizeof(routes[0])); i++){
+    webServer.on(routes[i], noContent, NULL, i == 0 || i == 2);
+  }
+
+  webServer.begin(user.uid, 6969, doorIO.channelCount, &legacyAuth);
+  localControl.begin(&user, &doorIO, BENCH_VERSION);
+  prepareLocalControl();
+}
+
+int main(int argc, char** argv){
+  setUp();
+
+  StdoutStream output;
+  GDoorBenchmark bench(output);
+  bench.begin("host", BENCH_VERSION);
+  run(bench, "sampleDoorStates", benchSampleDoorStates, NULL, 2000);
+
+  // The same pass at each doorChannels setting - what another wired channel adds per loop
+  for (int count = 1; count <= MAX_DOOR_CHANNELS; count++){
+    char name[32];
+    snprintf(name, sizeof(name), "sampleDoorStates%dch", count);
+    doorIO.setChannelCount(count);
+    run(bench, name, benchSampleDoorStates, NULL, 2000);
+  }
+
+  doorIO.setChannelCount(MAX_DOOR_CHANNELS);
+  run(bench, "createHttpJson", benchCreateHttpJson, NULL, 2000);
+  run(bench, "createTimestampEntries", benchCreateTimestampEntries, NULL, 2000);
+  run(bench, "createBootInfoJson", benchCreateBootInfoJson, NULL, 500);
+  run(bench, "encodeDoorStateBinary", benchEncodeDoorStateBinary, NULL, 2000);
+  run(bench, "encodeBootInfoBinary", benchEncodeBootInfoBinary, NULL, 500);
+  run(bench, "createIPStrings", benchCreateIPStrings, NULL, 2000);
+  run(bench, "enterStage", benchEnterStage, NULL, 2000);
+  run(bench, "healthSnapshotCached", benchHealthSnapshotCached, NULL, 2000);
+  run(bench, "healthSnapshotRender", benchHealthSnapshotRender, NULL, 2000);
+
+  GDoorRules benchRules;
+  benchRules.begin(&doorIO, &deviceClock);
+  benchRules.loadProgram(BENCH_RULES);
+  run(bench, "rulesTick", benchRulesTick, &benchRules, 2000);
+  run(bench, "rulesOnDoorState", benchRulesOnDoorState, &benchRules, 2000);
+  run(bench, "loadUserData", benchLoadUserData, NULL, 50);
+  run(bench, "persistUserDataToDisk", benchPersistUserData, NULL, 4);
+  run(bench, "verifySignature", benchVerifySignature, NULL, 500);
+
+  // Host only
+  run(bench, "findRoute", benchFindRoute, NULL, 2000);
+  run(bench, "dispatchRequest", benchDispatchRequest, NULL, 2000);
+  run(bench, "localControlStatus", benchLocalControlStatus, NULL, 2000);
+  bool requestsServed = webServer.request()->replyCode == 204 && hostUdpSent[LOCAL_CONTROL_HEADER_LEN + 2] == LOCAL_RESULT_OK;
+  run(bench, "uploadQueuePushPop", benchUploadQueuePushPop, NULL, 2000);
+  run(bench, "settingsApplyJson", benchSettingsApplyJson, NULL, 2000);
+  bench.end();
+
+  // Timing the refusal path instead would look like a speed up
+  if (!requestsServed){
+    fprintf(stderr, "bench_hotpath: requests were refused - the timings above don't measure the served path\n");
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,569 @@
+/*
+*	Fleet load simulator - thousands of sensors' upload
+*   traffic against a stand-in for the cloud functions
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <vector>
+#include "networking/UploadQueue.hpp"
+#include "networking/UploadSchedule.hpp"
+
+/*
+ *  Each sensor runs the firmware's UploadSchedule & UploadQueue on
+ *  its own virtual clock, stepped the way loop() steps them: door
+ *  edges & due health pings are queued, one upload leaves per pass
+ *  and blocks the sensor for the round trip. The uplink itself
+ *  (HttpInterface) isn't built - each upload is recorded against
+ *  the endpoint it would POST to instead.
+ *
+ *  Scenario: a regional power cut ends at t = 0 so the whole fleet
+ *  boots at once, health pings run on the settings interval, doors
+ *  move at random and an ISP outage drops every sensor's WiFi for
+ *  a while. Uploads attempted during the outage fail and go back on
+ *  the queue with the schedule's backoff, as on the device - or are
+ *  lost, with --unjittered.
+ *
+ *  Sensors don't interact, so they're split across worker processes
+ *  (the shims keep global state) and the request streams merged. The
+ *  cloud is then modelled as a fluid queue draining --capacity
+ *  requests per second: each request's latency is its time held on
+ *  the sensor plus the backlog wait & service time when it arrived.
+ *
+ *  Scope: only the scheduling & queueing is the firmware's code.
+ *  setup() / loop() are re-enacted here, and GDoorUser, WifiInterface
+ *  & HttpInterface aren't run at all - association time, the round
+ *  trip and the outage are the options below.
+ *
+ *  make fleet && build/fleet_sim --sensors 20000
+ *  build/fleet_sim --spread 50000       a tighter boot & recon window
+ *  build/fleet_sim --unjittered         the pre-schedule timing
+ *
+*/
+
+#define SIM_UPLOAD_TYPES 4
+#define SIM_RECONNECT_WAIT 10000          // WIFI_RECONNECT_TIMEOUT - loop stall per check while down
+#define SIM_LOOP_PASS 1                   // Millis per loop pass with nothing to send
+
+static const char* endpoints[SIM_UPLOAD_TYPES] = { "sensorBootData", "doorStatusUpdate", "sensorHealthUpdate", "wifiReconNotification" };
+
+typedef struct simOptions {
+  int sensors;
+  int workers;
+  double hours;
+  double capacity;                        // Requests per second the backend drains
+  unsigned long serviceMillis;            // Round trip with no backlog
+  unsigned long healthInterval;
+  double doorRate;                        // Door movements per sensor per hour
+  unsigned long outageStart;
+  unsigned long outageLength;
+  unsigned long spread;                   // The uploadSpread setting
+  bool unjittered;
+  unsigned int seed;
+  const char* seriesPath;
+} SimOptions;
+
+typedef struct simRequest {
+  uint32_t sentAt;                        // Millis since the power came back
+  uint32_t capturedAt;
+  uint8_t type;
+} SimRequest;
+
+typedef struct simTotals {
+  unsigned long queueFull;
+  unsigned long retried;
+  unsigned long superseded;               // Failed health pings - the next one replaces them
+  unsigned long lost;                     // Out of attempts, or failed with --unjittered
+} SimTotals;
+
+/*
+ *                        Sensor
+*/
+
+typedef struct simSensor {
+  char uid[29];
+  uint32_t rng;
+  UploadQueue queue;
+  GDoorUploadSchedule schedule;
+  uint64_t legacyNextHealth;              // --unjittered: a full interval after connecting
+  uint64_t holds[UPLOAD_QUEUE_CAPACITY];
+  int holdCount;
+  DoorState door;
+} SimSensor;
+
+static uint32_t nextRandom(uint32_t* state){
+  // xorshift32 - one stream per sensor, so results don't depend on the worker split
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x;
+}
+
+static unsigned long uniform(uint32_t* state, unsigned long low, unsigned long high){
+  return low + (nextRandom(state) % (high - low + 1));
+}
+
+static uint64_t exponential(uint32_t* state, double meanMillis){
+  double unit = (nextRandom(state) + 1.0) / 4294967297.0;
+  return (uint64_t)(-log(unit) * meanMillis) + 1;
+}
+
+static void addHold(SimSensor* sensor, uint64_t notBefore, uint64_t now){
+  // Holds that have passed belong to events already sent - every one left is still queued, so it fits
+  int kept = 0;
+  for (int i = 0; i < sensor->holdCount; i++){
+    if (sensor->holds[i] > now){
+      sensor->holds[kept++] = sensor->holds[i];
+    }
+  }
+
+  sensor->holdCount = kept;
+  if (sensor->holdCount < UPLOAD_QUEUE_CAPACITY){
+    sensor->holds[sensor->holdCount++] = notBefore;
+  }
+}
+
+static void queueUpload(SimSensor* sensor, SimTotals* totals, UploadType type, uint64_t capturedAt, uint64_t notBefore){
+  if (!sensor->queue.push(type, sensor->door, capturedAt, 0, notBefore)){
+    totals->queueFull += 1;
+    return;
+  }
+
+  if (notBefore > capturedAt){
+    addHold(sensor, notBefore, capturedAt);
+  }
+}
+
+static void retryUpload(SimSensor* sensor, const SimOptions* options, SimTotals* totals, const UploadEvent* event, uint64_t now){
+  if (event->type == UPLOAD_HEALTH_CHECK){
+    totals->superseded += 1;
+    return;
+  }
+
+  if (options->unjittered || !GDoorUploadSchedule::shouldRetry(event->type, -1, event->attempts)){
+    totals->lost += 1;
+    return;
+  }
+
+  uint64_t notBefore = GDoorUploadSchedule::retryAt(event->attempts, now, nextRandom(&sensor->rng));
+  if (!sensor->queue.retry(event, notBefore)){
+    totals->queueFull += 1;
+    return;
+  }
+
+  totals->retried += 1;
+  addHold(sensor, notBefore, now);
+}
+
+static void connect(SimSensor* sensor, const SimOptions* options, SimTotals* totals, UploadType note, uint64_t now){
+  sensor->schedule.connected(now);
+  sensor->legacyNextHealth = now + options->healthInterval;
+  uint64_t hold = options->unjittered ? 0 : sensor->schedule.holdUntil(note, nextRandom(&sensor->rng));
+  queueUpload(sensor, totals, note, now, hold);
+}
+
+static bool healthCheckDue(SimSensor* sensor, const SimOptions* options, uint64_t now){
+  if (!options->unjittered){
+    return sensor->schedule.healthCheckDue(now);
+  }
+
+  if (now < sensor->legacyNextHealth){
+    return false;
+  }
+
+  sensor->legacyNextHealth = now + options->healthInterval;
+  return true;
+}
+
+static uint64_t nextWake(SimSensor* sensor, const SimOptions* options, uint64_t now, uint64_t nextDoor){
+  uint64_t wake = nextDoor;
+  uint64_t health = options->unjittered ? sensor->legacyNextHealth : sensor->schedule.nextHealthCheck();
+  wake = std::min(wake, health);
+
+  // Held uploads - the queue only says whether something is due now
+  int kept = 0;
+  for (int i = 0; i < sensor->holdCount; i++){
+    if (sensor->holds[i] > now){
+      sensor->holds[kept++] = sensor->holds[i];
+      wake = std::min(wake, sensor->holds[i]);
+    }
+  }
+
+  sensor->holdCount = kept;
+  return std::max(wake, now + SIM_LOOP_PASS);
+}
+
+static void runSensor(int index, const SimOptions* options, std::vector<SimRequest>* requests, SimTotals* totals){
+  SimSensor* sensor = new SimSensor();
+  sensor->rng = (options->seed * 2654435761UL) ^ ((uint32_t)index * 40503UL + 0x9E3779B9UL);
+  if (sensor->rng == 0){
+    sensor->rng = 1;
+  }
+
+  static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz0123456789";
+  for (int i = 0; i < 28; i++){
+    sensor->uid[i] = alphabet[nextRandom(&sensor->rng) % 36];
+  }
+
+  sensor->uid[28] = 0;
+  sensor->holdCount = 0;
+  sensor->door = (DoorState)(nextRandom(&sensor->rng) & 1);
+  sensor->schedule.begin(sensor->uid);
+  sensor->schedule.setInterval(options->healthInterval, 0);
+  sensor->schedule.setSpread(options->spread);
+
+  const uint64_t end = (uint64_t)(options->hours * 3600000.0);
+  const uint64_t outageEnd = options->outageStart + options->outageLength;
+  const double doorMean = options->doorRate > 0 ? 3600000.0 / options->doorRate : 1e18;
+
+  // Boot - setup() up to the WiFi wait, then association
+  uint64_t now = uniform(&sensor->rng, 800, 1500) + uniform(&sensor->rng, 2000, 8000);
+  connect(sensor, options, totals, UPLOAD_BOOT_INFO, now);
+  uint64_t nextDoor = now + exponential(&sensor->rng, doorMean);
+  uint64_t reconnectAt = outageEnd + uniform(&sensor->rng, 500, 5000);
+  bool linkUp = true;
+
+  while (now < end){
+    if (linkUp && options->outageLength > 0 && now >= options->outageStart && now < outageEnd){
+      linkUp = false;
+    }
+
+    if (nextDoor <= now){
+      sensor->door = sensor->door == DOOR_STATE_OPEN ? DOOR_STATE_CLOSED : DOOR_STATE_OPEN;
+      queueUpload(sensor, totals, UPLOAD_DOOR_STATE, nextDoor, 0);
+      nextDoor += exponential(&sensor->rng, doorMean);
+    }
+
+    if (healthCheckDue(sensor, options, now)){
+      queueUpload(sensor, totals, UPLOAD_HEALTH_CHECK, now, 0);
+    }
+
+    UploadEvent event;
+    bool sent = sensor->queue.pop(&event, now);
+    if (sent && !linkUp){
+      // processUploadQueue() - a transport error, re-queued with backoff
+      retryUpload(sensor, options, totals, &event, now);
+    }
+
+    else if (sent){
+      SimRequest request = { (uint32_t)now, (uint32_t)event.capturedAt, (uint8_t)event.type };
+      requests->push_back(request);
+      now += options->serviceMillis;
+    }
+
+    if (!linkUp){
+      // handleWifiReconProcedure() - holds the loop until the link is back or the wait runs out
+      if (reconnectAt <= now + SIM_RECONNECT_WAIT){
+        now = std::max(now, reconnectAt);
+        linkUp = true;
+        connect(sensor, options, totals, UPLOAD_WIFI_RECON, now);
+      }
+
+      else {
+        now += SIM_RECONNECT_WAIT;
+      }
+
+      continue;
+    }
+
+    if (sent){
+      now += SIM_LOOP_PASS;
+      continue;
+    }
+
+    // Nothing due - skip ahead to the next thing that is, stopping when the link drops
+    uint64_t wake = nextWake(sensor, options, now, nextDoor);
+    if (options->outageLength > 0 && now < options->outageStart && wake > options->outageStart){
+      wake = options->outageStart;
+    }
+
+    now = wake;
+  }
+
+  delete sensor;
+}
+
+/*
+ *                        Workers
+*/
+
+static bool runWorkers(const SimOptions* options, std::vector<SimRequest>* requests, SimTotals* totals){
+  std::vector<FILE*> results;
+  std::vector<pid_t> workers;
+  for (int worker = 0; worker < options->workers; worker++){
+    FILE* result = tmpfile();
+    if (result == NULL){
+      perror("fleet_sim: tmpfile");
+      return false;
+    }
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0){
+      perror("fleet_sim: fork");
+      return false;
+    }
+
+    if (pid == 0){
+      // Every workers'th sensor - totals first, then the requests in send order per sensor
+      std::vector<SimRequest> own;
+      SimTotals ownTotals = { 0, 0, 0, 0 };
+      for (int sensor = worker; sensor < options->sensors; sensor += options->workers){
+        runSensor(sensor, options, &own, &ownTotals);
+      }
+
+      size_t count = own.size();
+      fwrite(&ownTotals, sizeof(ownTotals), 1, result);
+      fwrite(&count, sizeof(count), 1, result);
+      if (count > 0){
+        fwrite(&own[0], sizeof(SimRequest), count, result);
+      }
+
+      fflush(result);
+      _exit(ferror(result) ? 1 : 0);
+    }
+
+    results.push_back(result);
+    workers.push_back(pid);
+  }
+
+  bool ok = true;
+  for (size_t i = 0; i < workers.size(); i++){
+    int status = 0;
+    waitpid(workers[i], &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0){
+      fprintf(stderr, "fleet_sim: worker %d failed\n", (int)i);
+      ok = false;
+      continue;
+    }
+
+    // The file offset is shared with the worker - rewind to read what it wrote
+    SimTotals workerTotals;
+    size_t count = 0;
+    rewind(results[i]);
+    if (fread(&workerTotals, sizeof(workerTotals), 1, results[i]) != 1 || fread(&count, sizeof(count), 1, results[i]) != 1){
+      fprintf(stderr, "fleet_sim: worker %d result unreadable\n", (int)i);
+      ok = false;
+      continue;
+    }
+
+    size_t start = requests->size();
+    requests->resize(start + count);
+    if (count > 0 && fread(&(*requests)[start], sizeof(SimRequest), count, results[i]) != count){
+      fprintf(stderr, "fleet_sim: worker %d result truncated\n", (int)i);
+      ok = false;
+    }
+
+    totals->queueFull += workerTotals.queueFull;
+    totals->retried += workerTotals.retried;
+    totals->superseded += workerTotals.superseded;
+    totals->lost += workerTotals.lost;
+    fclose(results[i]);
+  }
+
+  return ok;
+}
+
+/*
+ *                        Mock Cloud
+ *
+ *  The four cloud functions share one pool draining capacity 
+ *  requests per second. Arrivals are binned per milli & the backlog 
+ *  carried forward, so a burst shows up as wait time for every 
+ *  request that lands behind it.
+ *
+*/
+
+static uint32_t percentile(std::vector<uint32_t>* samples, double fraction){
+  if (samples->empty()){
+    return 0;
+  }
+
+  size_t index = std::min(samples->size() - 1, (size_t)(fraction * samples->size()));
+  std::nth_element(samples->begin(), samples->begin() + index, samples->end());
+  return (*samples)[index];
+}
+
+static void report(const SimOptions* options, std::vector<SimRequest>* requests, const SimTotals* totals, double wallSeconds){
+  const uint32_t span = (uint32_t)(options->hours * 3600000.0);
+  const uint32_t seconds = span / 1000 + 1;
+
+  std::vector<uint32_t> arrivals(span + 1, 0);
+  std::vector<uint32_t> perSecond((size_t)seconds * SIM_UPLOAD_TYPES, 0);
+  for (size_t i = 0; i < requests->size(); i++){
+    const SimRequest* request = &(*requests)[i];
+    uint32_t at = std::min(request->sentAt, span);
+    arrivals[at] += 1;
+    perSecond[(size_t)(at / 1000) * SIM_UPLOAD_TYPES + request->type] += 1;
+  }
+
+  // Backlog in requests after each milli, drained at capacity / 1000 per milli
+  const double drainPerMilli = options->capacity / 1000.0;
+  std::vector<float> waitMillis(span + 1, 0);
+  double backlog = 0;
+  double peakBacklog = 0;
+  for (uint32_t at = 0; at <= span; at++){
+    backlog = std::max(0.0, backlog + arrivals[at] - drainPerMilli);
+    peakBacklog = std::max(peakBacklog, backlog);
+    waitMillis[at] = (float)(backlog / drainPerMilli);
+  }
+
+  std::vector<uint32_t> latency[SIM_UPLOAD_TYPES + 1];
+  for (size_t i = 0; i < requests->size(); i++){
+    const SimRequest* request = &(*requests)[i];
+    uint32_t held = request->sentAt - request->capturedAt;
+    uint32_t sample = held + options->serviceMillis + (uint32_t)waitMillis[std::min(request->sentAt, span)];
+    latency[request->type].push_back(sample);
+    latency[SIM_UPLOAD_TYPES].push_back(sample);
+  }
+
+  if (options->unjittered){
+    printf("fleet_sim: %d sensors, %.1f h, unjittered timing, %d workers, %.2f s\n", options->sensors, options->hours, options->workers, wallSeconds);
+  }
+
+  else {
+    printf("fleet_sim: %d sensors, %.1f h, scheduled timing (%lu ms spread), %d workers, %.2f s\n", options->sensors, options->hours,
+      options->spread, options->workers, wallSeconds);
+  }
+
+  printf("cloud: %.0f req/s capacity, %lu ms service, outage %lu s at %lu s\n\n", options->capacity, options->serviceMillis,
+    options->outageLength / 1000, options->outageStart / 1000);
+  printf("%-22s %9s %8s %8s %8s %9s %9s %9s\n", "endpoint", "requests", "mean/s", "peak/s", "peak at", "p50 ms", "p99 ms", "max ms");
+
+  for (int type = 0; type <= SIM_UPLOAD_TYPES; type++){
+    uint32_t peak = 0;
+    uint32_t peakAt = 0;
+    for (uint32_t second = 0; second < seconds; second++){
+      uint32_t count = 0;
+      for (int t = 0; t < SIM_UPLOAD_TYPES; t++){
+        if (t == type || type == SIM_UPLOAD_TYPES){
+          count += perSecond[(size_t)second * SIM_UPLOAD_TYPES + t];
+        }
+      }
+
+      if (count > peak){
+        peak = count;
+        peakAt = second;
+      }
+    }
+
+    std::vector<uint32_t>* samples = &latency[type];
+    uint32_t worst = samples->empty() ? 0 : *std::max_element(samples->begin(), samples->end());
+    printf("%-22s %9lu %8.2f %8u %7us %9u %9u %9u\n", type == SIM_UPLOAD_TYPES ? "all" : endpoints[type], (unsigned long)samples->size(),
+      samples->size() * 1000.0 / span, peak, peakAt, percentile(samples, 0.5), percentile(samples, 0.99), worst);
+  }
+
+  printf("\npeak backlog %.0f requests (%.0f ms wait)\n", peakBacklog, peakBacklog / drainPerMilli);
+  printf("outage: %lu retries, %lu health pings superseded, %lu uploads lost, %lu dropped on a full queue\n",
+    totals->retried, totals->superseded, totals->lost, totals->queueFull);
+
+  if (options->seriesPath == NULL){
+    return;
+  }
+
+  FILE* series = fopen(options->seriesPath, "w");
+  if (series == NULL){
+    perror("fleet_sim: series");
+    return;
+  }
+
+  fprintf(series, "second,%s,%s,%s,%s,waitMillis\n", endpoints[0], endpoints[1], endpoints[2], endpoints[3]);
+  for (uint32_t second = 0; second < seconds; second++){
+    const uint32_t* counts = &perSecond[(size_t)second * SIM_UPLOAD_TYPES];
+    fprintf(series, "%u,%u,%u,%u,%u,%.0f\n", second, counts[0], counts[1], counts[2], counts[3], waitMillis[std::min(second * 1000 + 999, span)]);
+  }
+
+  fclose(series);
+}
+
+/*
+ *                        Main
+*/
+
+static void usage(){
+  fprintf(stderr,
+    "usage: fleet_sim [--sensors N] [--hours H] [--workers N] [--capacity REQ_PER_S] [--service MS]\n"
+    "                 [--health-interval MS] [--door-rate PER_HOUR] [--outage START_S LENGTH_S]\n"
+    "                 [--spread MS] [--unjittered] [--seed N] [--series out.csv]\n");
+  exit(2);
+}
+
+int main(int argc, char** argv){
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  SimOptions options;
+  options.sensors = 5000;
+  options.workers = cores > 0 ? (int)cores : 1;
+  options.hours = 2.0;
+  options.capacity = 100;
+  options.serviceMillis = 300;
+  options.healthInterval = 900000;        // Settings default
+  options.doorRate = 2;
+  options.outageStart = 3600000;
+  options.outageLength = 300000;
+  options.spread = UPLOAD_SPREAD_DEFAULT;
+  options.unjittered = false;
+  options.seed = 1;
+  options.seriesPath = NULL;
+
+  for (int i = 1; i < argc; i++){
+    const char* arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (strcmp(arg, "--unjittered") == 0){
+      options.unjittered = true;
+    }
+
+    else if (strcmp(arg, "--outage") == 0 && i + 2 < argc){
+      options.outageStart = strtoul(argv[i + 1], NULL, 10) * 1000;
+      options.outageLength = strtoul(argv[i + 2], NULL, 10) * 1000;
+      i += 2;
+    }
+
+    else if (!hasValue){
+      usage();
+    }
+
+    else if (strcmp(arg, "--sensors") == 0){ options.sensors = atoi(argv[++i]); }
+    else if (strcmp(arg, "--hours") == 0){ options.hours = atof(argv[++i]); }
+    else if (strcmp(arg, "--workers") == 0){ options.workers = atoi(argv[++i]); }
+    else if (strcmp(arg, "--capacity") == 0){ options.capacity = atof(argv[++i]); }
+    else if (strcmp(arg, "--service") == 0){ options.serviceMillis = strtoul(argv[++i], NULL, 10); }
+    else if (strcmp(arg, "--health-interval") == 0){ options.healthInterval = strtoul(argv[++i], NULL, 10); }
+    else if (strcmp(arg, "--door-rate") == 0){ options.doorRate = atof(argv[++i]); }
+    else if (strcmp(arg, "--spread") == 0){ options.spread = strtoul(argv[++i], NULL, 10); }
+    else if (strcmp(arg, "--seed") == 0){ options.seed = strtoul(argv[++i], NULL, 10); }
+    else if (strcmp(arg, "--series") == 0){ options.seriesPath = argv[++i]; }
+    else { usage(); }
+  }
+
+  // Millis are kept in 32 bits - plenty for a simulated day
+  if (options.sensors < 1 || options.workers < 1 || options.capacity <= 0 || options.healthInterval == 0 || options.hours <= 0 || options.hours > 24 * 7){
+    usage();
+  }
+
+  options.workers = std::min(options.workers, options.sensors);
+
+  struct timespec started, finished;
+  clock_gettime(CLOCK_MONOTONIC, &started);
+  std::vector<SimRequest> requests;
+  SimTotals totals = { 0, 0, 0, 0 };
+  if (!runWorkers(&options, &requests, &totals)){
+    return 1;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &finished);
+  double wallSeconds = (finished.tv_sec - started.tv_sec) + (finished.tv_nsec - started.tv_nsec) / 1e9;
+  report(&options, &requests, &totals, wallSeconds);
+  return 0;
+}
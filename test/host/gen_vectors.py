@@ -0,0 +1,175 @@
+#!/usr/bin/env python3
+"""
+Generate C test vectors from the host-side tools, so the host tests check
+the firmware against the same code clients use.
+
+Usage: gen_vectors.py sign > build/SignVectors.h
+       gen_vectors.py routes > build/RouteVectors.h
+       gen_vectors.py log > build/LogVectors.h
+       gen_vectors.py rules > build/RuleVectors.h
+       gen_vectors.py uplink > build/UplinkVectors.h
+"""
+
+import os
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "..", "tools"))
+
+import compile_rules  # noqa: E402
+import decode_log  # noqa: E402
+import decode_trace  # noqa: E402
+import decode_uplink  # noqa: E402
+import sign_request  # noqa: E402
+from urllib.parse import parse_qsl, urlsplit  # noqa: E402
+
+SECRET = "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f"
+ROTATED_SECRET = "f0e1d2c3b4a5968778695a4b3c2d1e0f00112233445566778899aabbccddeeff"
+UID = "T3stUid000000000000000000001"
+
+# Negative first, so every %d in the catalogue sees one
+LOG_ARGS = [0xFFFFFF85, 0xFFFFFFFF, 42, 0x1234ABCD]
+
+# Rule sources the tests load by name - the last fills the table
+RULE_CASES = [
+    "autoclose 0 after 10m",
+    "autoclose 1 after 90s unless-present 15",
+    "autoclose 0 after 24h",
+    "schedule 0 at 22:00 if-open",
+    "schedule 1 at 06:30:15 if-closed unless-present 255",
+    "schedule 0 at 23:59:59",
+    "autoclose 0 after 10s; schedule 0 at 00:00 if-closed",
+    "; ".join("autoclose %d after %dm" % (index % 2, index + 1) for index in range(compile_rules.RULES_MAX)),
+]
+
+# Uploads as decode_uplink.decode() returns them - no uid means the session id stands in for it
+SESSION_ID = 4242
+CAPTURED_AT = 1522963577000
+UPLINK_CASES = [
+    {"type": "bootInfo", "uid": UID, "capturedAt": CAPTURED_AT, "sentAt": CAPTURED_AT + 250, "addressing": "static",
+     "serverPort": 6969, "firmwareVersion": "1.0.0", "targetStaticIP": "192.168.1.250", "assignedLocalIP": "192.168.1.250",
+     "doorStates": ["00", "01"], "connectedMillis": 4210,
+     "reset": {"reason": 4, "excCause": 0, "epc1": 0, "fault": 1, "stage": 5, "stageMillis": 30001, "freeStack": 1904, "trail": 259}},
+    {"type": "bootInfo", "uid": UID, "capturedAt": 0, "sentAt": CAPTURED_AT, "addressing": "dhcp",
+     "serverPort": 8080, "firmwareVersion": "1.0.1-rc2", "targetStaticIP": "10.0.0.250", "assignedLocalIP": "10.0.0.37",
+     "doorStates": ["01"], "connectedMillis": 1500,
+     "reset": {"reason": 0, "excCause": 0, "epc1": 0, "fault": 0, "stage": 0, "stageMillis": 0, "freeStack": 0, "trail": 0}},
+    {"type": "doorState", "sessionId": SESSION_ID, "capturedAt": CAPTURED_AT, "sentAt": CAPTURED_AT + 40, "channel": 1, "statusUpdate": "01"},
+    {"type": "doorState", "uid": UID, "capturedAt": 0, "sentAt": 0, "channel": 0, "statusUpdate": "00"},
+    {"type": "health", "sessionId": SESSION_ID, "capturedAt": CAPTURED_AT, "sentAt": CAPTURED_AT, "millis": 86400000123,
+     "freeHeap": 30512, "minFreeHeap": 28016, "maxFreeBlock": 29872, "heapFragmentation": 3, "freeContStack": 2416},
+    {"type": "recon", "sessionId": SESSION_ID, "capturedAt": CAPTURED_AT, "sentAt": CAPTURED_AT + 9000, "addressing": "dhcp",
+     "assignedLocalIP": "192.168.1.87"},
+    {"type": "recon", "uid": UID, "capturedAt": CAPTURED_AT, "sentAt": CAPTURED_AT, "addressing": "static",
+     "assignedLocalIP": "192.168.1.250"},
+]
+
+SIGN_CASES = [
+    ("GET", "/%s/0/ActuateDoor" % UID),
+    ("GET", "/%s/Settings?pulseLength=400&debounceSamples=3" % UID),
+    ("POST", "/%s/Rules?program=0100020000003c00" % UID),
+    ("GET", "/%s/Settings?b=2&a=x%%20y%%26z%%3D&a=1&empty=" % UID),
+    ("GET", "/%s/RotateSecret" % UID),
+]
+
+
+def c_string(text):
+    return '"%s"' % text.replace("\\", "\\\\").replace('"', '\\"')
+
+
+def sign_vectors():
+    print("// Generated by gen_vectors.py from tools/sign_request.py - do not edit")
+    key = bytes.fromhex(SECRET)
+    print("static const SignVector signVectors[] = {")
+    for index, (method, url) in enumerate(SIGN_CASES):
+        nonce = "%016x" % (0x0123456789abcdef + index)
+        timestamp = 1522963577 + index
+        if url.endswith("/RotateSecret"):
+            url += "?secret=" + sign_request.wrap_secret(key, bytes.fromhex(ROTATED_SECRET), nonce)
+        signature = sign_request.sign(key, method, url, nonce, timestamp)
+        parts = urlsplit(url)
+        pairs = sorted(parse_qsl(parts.query, keep_blank_values=True), key=lambda pair: pair[0].encode())
+        names = ", ".join(c_string(name) for name, _ in pairs) or "NULL"
+        values = ", ".join(c_string(value) for _, value in pairs) or "NULL"
+        print("  { %s, %s, %s, %d, { %s }, { %s }, %s, %d, \"%d\", %s }," % (
+            c_string(method), c_string(parts.path), c_string(sign_request.canonical_query(pairs)),
+            len(pairs), names, values, c_string(nonce), timestamp, timestamp, c_string(signature)))
+    print("};")
+    print("static const char* const rotatedSecret = %s;" % c_string(ROTATED_SECRET))
+
+
+def route_vectors():
+    print("// Generated by gen_vectors.py from tools/decode_trace.py - do not edit")
+    print("static const RouteVector routeVectors[] = {")
+    for name in decode_trace.ENDPOINTS:
+        print("  { %s, %d }," % (c_string("/%s/%s" % (UID, name) if name else "/"), decode_trace.route_hash(name)))
+    print("};")
+    print("static const int decodedTraceTypes = %d;" % len(decode_trace.TYPES))
+
+
+def log_vectors():
+    print("// Generated by gen_vectors.py from tools/decode_log.py - do not edit")
+    print("static const uint32_t logVectorArgs[LOG_RECORD_ARGS] = { %s };" % ", ".join("0x%08X" % arg for arg in LOG_ARGS))
+    print("static const char* const logVectors[] = {")
+    for _, fmt in decode_log.load_catalogue(decode_log.DEFAULT_CATALOGUE):
+        print("  %s," % c_string(decode_log.format_message(fmt, LOG_ARGS)))
+    print("};")
+
+
+def rule_vectors():
+    print("// Generated by gen_vectors.py from tools/compile_rules.py - do not edit")
+    print("static const RuleVector ruleVectors[] = {")
+    for source in RULE_CASES:
+        program = compile_rules.compile_rules(source)
+        print("  { %s, %s, %d }," % (c_string(source), c_string(program), len(program) // (compile_rules.RULE_LEN * 2)))
+    print("};")
+
+
+def uplink_json(message):
+    # The JSON upload of a decoded message, as the firmware's builders write it - the backend resolves the session
+    fields = dict(message, uid=message.get("uid", UID))
+    fields["timestamps"] = '"capturedAt":"%d","sentAt":"%d"' % (message["capturedAt"], message["sentAt"])
+    if message["type"] == "bootInfo":
+        fields.update(message["reset"])
+        fields["doorState"] = message["doorStates"][0]
+        fields["doorStates"] = ",".join('"%s"' % state for state in message["doorStates"])
+        return ('{"serverPort":"%(serverPort)d","uid":"%(uid)s","firmwareVersion":"%(firmwareVersion)s",'
+                '"targetStaticIP":"%(targetStaticIP)s","assignedLocalIP":"%(assignedLocalIP)s","addressing":"%(addressing)s",'
+                '"doorState":"%(doorState)s","doorStates":[%(doorStates)s],"connectedMillis":"%(connectedMillis)d",'
+                '"reset":{"reason":%(reason)d,"excCause":%(excCause)d,"epc1":%(epc1)d,"fault":%(fault)d,"stage":%(stage)d,'
+                '"stageMillis":%(stageMillis)d,"freeStack":%(freeStack)d,"trail":%(trail)d},%(timestamps)s}') % fields
+    if message["type"] == "doorState":
+        return '{"uid":"%(uid)s","statusUpdate":"%(statusUpdate)s","channel":"%(channel)d",%(timestamps)s}' % fields
+    if message["type"] == "health":
+        return ('{"uid":"%(uid)s","millis":"%(millis)d","freeHeap":%(freeHeap)d,"minFreeHeap":%(minFreeHeap)d,'
+                '"maxFreeBlock":%(maxFreeBlock)d,"heapFragmentation":%(heapFragmentation)d,"freeContStack":%(freeContStack)d,'
+                '%(timestamps)s}') % fields
+    return '{"uid":"%(uid)s","assignedLocalIP":"%(assignedLocalIP)s","addressing":"%(addressing)s",%(timestamps)s}' % fields
+
+
+def uplink_vectors():
+    print("// Generated by gen_vectors.py from tools/decode_uplink.py - do not edit")
+    print("static const UplinkVector uplinkVectors[] = {")
+    for case in UPLINK_CASES:
+        # Round trip on this side first - the test then holds the firmware to these bytes
+        payload = decode_uplink.encode(case)
+        decoded = decode_uplink.decode(payload)
+        if decoded != dict(case, schema=decode_uplink.SCHEMA_VERSIONS[-1]):
+            sys.exit("decode_uplink.py doesn't read back what it wrote: %s" % decoded)
+
+        states = [int(state) for state in case.get("doorStates", [])] + [0, 0]
+        reset = case.get("reset", {})
+        reset_fields = ", ".join("%d" % reset.get(name, 0) for name in ("reason", "excCause", "epc1", "fault", "stage", "stageMillis", "freeStack", "trail"))
+        memory_fields = ", ".join("%d" % case.get(name, 0) for name in ("freeHeap", "minFreeHeap", "maxFreeBlock", "heapFragmentation", "freeContStack"))
+        print("  { %s, %d, %du, %dULL, %dULL, %s, %d, %d, %d, { %d, %d }, %s, %s, %s, %s, %du, { %s }, %dULL, { %s }," % (
+            c_string(decoded["type"]), next(code for code, name in decode_uplink.MESSAGE_NAMES.items() if name == case["type"]),
+            case.get("sessionId", 0), case["capturedAt"], case["sentAt"], "true" if case.get("addressing") == "dhcp" else "false",
+            case.get("channel", 0), int(case.get("statusUpdate", "0")), len(case.get("doorStates", [])), states[0], states[1],
+            c_string(str(case.get("serverPort", ""))), c_string(case.get("firmwareVersion", "")), c_string(case.get("targetStaticIP", "")),
+            c_string(case.get("assignedLocalIP", "")), case.get("connectedMillis", 0), reset_fields, case.get("millis", 0), memory_fields))
+        print("    %s," % c_string(payload.hex()))
+        print("    %s }," % c_string(uplink_json(decoded)))
+    print("};")
+
+
+if __name__ == "__main__":
+    {"sign": sign_vectors, "routes": route_vectors, "log": log_vectors, "rules": rule_vectors, "uplink": uplink_vectors}[sys.argv[1]]()
@@ -0,0 +1,58 @@
+/*
+*	Replays a /<uid>/TraceDump capture through this checkout's 
+*   door sampling and prints the trace it produces
+*
+*	Usage: replay_trace [capture.hex] > replayed.hex
+*	       decode_trace.py --compare capture.hex replayed.hex
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include "TraceReplay.hpp"
+
+#define REPLAY_MAX_RECORDS 65536
+
+static uint8_t recorded[REPLAY_MAX_RECORDS * TRACE_RECORD_WIRE_LEN];
+static uint8_t replayed[REPLAY_MAX_RECORDS * TRACE_RECORD_WIRE_LEN];
+
+static int hexValue(int c){
+  return isdigit(c) ? c - '0' : tolower(c) - 'a' + 10;
+}
+
+int main(int argc, char** argv){
+  FILE* input = (argc > 1) ? fopen(argv[1], "r") : stdin;
+  if (input == NULL){
+    fprintf(stderr, "can't open %s\n", argv[1]);
+    return 1;
+  }
+
+  // Whitespace is ignored, same as decode_trace.py
+  int length = 0;
+  int high = -1;
+  int c;
+  while ((c = fgetc(input)) != EOF && length < (int)sizeof(recorded)){
+    if (!isxdigit(c)){
+      continue;
+    }
+
+    if (high < 0){
+      high = hexValue(c);
+      continue;
+    }
+
+    recorded[length++] = (high << 4) | hexValue(c);
+    high = -1;
+  }
+
+  int records = replayTrace(recorded, length / TRACE_RECORD_WIRE_LEN, replayed, REPLAY_MAX_RECORDS);
+  for (int i = 0; i < records * TRACE_RECORD_WIRE_LEN; i++){
+    printf("%02x%s", replayed[i], (i % TRACE_RECORD_WIRE_LEN == TRACE_RECORD_WIRE_LEN - 1) ? "\n" : "");
+  }
+
+  return 0;
+}
@@ -0,0 +1,151 @@
+/*
+*	Host shim - the slice of the ESP8266 Arduino core the 
+*   firmware's pure logic uses, backed by state tests control
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <time.h>
+#include <sys/time.h>
+#include <string>
+
+typedef uint8_t byte;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+#define PROGMEM
+#define PGM_P const char*
+#define PSTR(s) (s)
+#define F(s) (s)
+#define strcpy_P strcpy
+#define strlen_P strlen
+#define snprintf_P snprintf
+#define memcpy_P memcpy
+#define pgm_read_ptr(p) (*(p))
+#define pgm_read_byte(p) (*(const uint8_t*)(p))
+#define ICACHE_RAM_ATTR
+#define IRAM_ATTR
+
+#define HOST_PIN_COUNT 17
+
+// Host controls - tests set these directly
+extern uint32_t hostMillis;                     // What millis() returns, delay() advances it
+extern int hostPinLevels[HOST_PIN_COUNT];        // digitalRead() / digitalWrite()
+extern uint32_t hostFreeHeap;
+extern uint32_t hostFreeContStack;
+extern uint32_t hostMaxFreeBlock;
+extern uint32_t hostHeapFragmentation;
+extern uint32_t hostCycles;                     // What ESP.getCycleCount() returns
+extern bool hostCycleClock;                     // Count real time at 80 MHz instead - the benchmarks
+
+uint32_t millis();                              // 32 bits like the device, so wraps match
+uint32_t micros();
+void delay(unsigned long ms);
+void yield();
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t level);
+int digitalRead(uint8_t pin);
+
+// Just enough of String for the values the web server hands out
+class String {
+  public:
+    String(const char* text = ""){ value = text; }
+    const char* c_str() const { return value.c_str(); }
+    unsigned int length() const { return value.size(); }
+
+  private:
+    std::string value;
+};
+
+class Print {
+  public:
+    virtual ~Print(){}
+    virtual size_t write(const uint8_t* data, size_t length) = 0;
+
+    size_t printf(const char* format, ...){
+      char text[256];
+      va_list args;
+      va_start(args, format);
+      int length = vsnprintf(text, sizeof(text), format, args);
+      va_end(args);
+      return write((const uint8_t*)text, (length < (int)sizeof(text)) ? length : sizeof(text) - 1);
+    }
+};
+
+class Stream : public Print {
+  public:
+    virtual int availableForWrite(){ return 4096; }
+};
+
+// Captures everything written - tests read it back from output
+class HardwareSerial : public Stream {
+  public:
+    char output[8192];
+    size_t outputLength;
+
+    HardwareSerial(){ clear(); }
+    void begin(unsigned long){}
+    void clear(){ outputLength = 0; output[0] = 0; }
+    size_t write(const uint8_t* data, size_t length);
+};
+
+extern HardwareSerial Serial;
+
+class IPAddress {
+  public:
+    IPAddress(){ address = 0; }
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d){ address = a | (b << 8) | (c << 16) | ((uint32_t)d << 24); }
+    IPAddress(uint32_t value){ address = value; }
+    operator uint32_t() const { return address; }
+    uint8_t operator[](int index) const { return (address >> (8 * index)) & 0xFF; }
+    bool operator==(const IPAddress& other) const { return address == other.address; }
+    bool operator!=(const IPAddress& other) const { return address != other.address; }
+    bool fromString(const char* text);
+
+  private:
+    uint32_t address;
+};
+
+struct rst_info;
+
+// RTC user memory - 128 blocks of 4 bytes, kept until the test clears it
+class EspClass {
+  public:
+    uint32_t rtcMemory[128];
+
+    uint32_t getFreeHeap(){ return hostFreeHeap; }
+    uint32_t getChipId(){ return 0x00C0FFEE; }
+    uint32_t random(){ return (uint32_t)rand(); }
+    void restart(){}
+    struct rst_info* getResetInfoPtr();
+    uint32_t getFreeContStack(){ return hostFreeContStack; }
+    void resetFreeContStack(){}
+    uint32_t getMaxFreeBlockSize(){ return hostMaxFreeBlock; }
+    uint32_t getHeapFragmentation(){ return hostHeapFragmentation; }
+    uint32_t getCycleCount();
+    uint8_t getCpuFreqMHz(){ return 80; }
+    bool rtcUserMemoryRead(uint32_t offset, uint32_t* data, size_t size);
+    bool rtcUserMemoryWrite(uint32_t offset, uint32_t* data, size_t size);
+};
+
+extern EspClass ESP;
+
+void configTime(int timezone, int daylightOffset, const char* server1, const char* server2 = NULL, const char* server3 = NULL);
+
+#endif
@@ -0,0 +1,34 @@
+/*
+*	Host shim - EEPROM emulation over a plain byte array
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#ifndef HOST_EEPROM_H
+#define HOST_EEPROM_H
+
+#include <Arduino.h>
+
+#define HOST_EEPROM_SIZE 512
+
+class EEPROMClass {
+  public:
+    uint8_t data[HOST_EEPROM_SIZE];
+    int commits;                                // end() / commit() calls, i.e. flash writes
+
+    EEPROMClass(){ erase(); }
+    void begin(size_t size){}
+    uint8_t read(int address){ return data[address]; }
+    void write(int address, uint8_t value){ data[address] = value; }
+    bool commit(){ commits += 1; return true; }
+    bool end(){ return commit(); }
+
+    // Fresh flash reads back as 0xFF
+    void erase(){ memset(data, 0xFF, sizeof(data)); commits = 0; }
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
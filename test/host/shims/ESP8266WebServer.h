@@ -0,0 +1,60 @@
+/*
+*	Host shim - one request at a time, set up by the test 
+*   through setRequest() & answered into the reply fields
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#ifndef HOST_ESP8266WEBSERVER_H
+#define HOST_ESP8266WEBSERVER_H
+
+#include <Arduino.h>
+#include <functional>
+
+#define HOST_WEB_MAX_ARGS 20
+#define HOST_WEB_MAX_HEADERS 3
+
+typedef enum { HTTP_ANY, HTTP_GET, HTTP_HEAD, HTTP_POST, HTTP_PUT, HTTP_PATCH, HTTP_DELETE, HTTP_OPTIONS } HTTPMethod;
+
+class ESP8266WebServer {
+  public:
+    typedef std::function<void(void)> THandlerFunction;
+
+    ESP8266WebServer(int port = 80){ headerCount = 0; clearRequest(); }
+    void begin(uint16_t port){}
+    void collectHeaders(const char* headerKeys[], const size_t headerKeysCount);
+    void onNotFound(THandlerFunction handler){ notFound = handler; }
+    void handleClient();
+
+    const String& uri() const { return requestUri; }
+    HTTPMethod method() const { return requestMethod; }
+    int args(){ return argCount; }
+    String argName(int index){ return String(argNames[index].c_str()); }
+    String arg(int index){ return String(argValues[index].c_str()); }
+    String header(const char* name);
+    void send(int code, const char* contentType, const char* body);
+
+    // Host controls - the next handleClient() serves this request
+    void clearRequest();
+    void setRequest(HTTPMethod method, const char* uri);
+    void addArg(const char* name, const char* value);
+    void setHeader(const char* name, const char* value);
+    int replyCode;                      // 0 until send() is called
+    std::string replyBody;
+
+  private:
+    THandlerFunction notFound;
+    String requestUri;
+    HTTPMethod requestMethod;
+    int argCount;
+    std::string argNames[HOST_WEB_MAX_ARGS];
+    std::string argValues[HOST_WEB_MAX_ARGS];
+    const char* headerNames[HOST_WEB_MAX_HEADERS];
+    std::string headerValues[HOST_WEB_MAX_HEADERS];
+    int headerCount;
+    bool pending;
+};
+
+#endif
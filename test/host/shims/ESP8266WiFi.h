@@ -0,0 +1,22 @@
+/*
+*	Host shim - the station address, IPAddress comes 
+*   from Arduino.h
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#ifndef HOST_ESP8266WIFI_H
+#define HOST_ESP8266WIFI_H
+
+#include <Arduino.h>
+
+class ESP8266WiFiClass {
+  public:
+    IPAddress localIP(){ return IPAddress(192, 168, 1, 250); }
+};
+
+extern ESP8266WiFiClass WiFi;
+
+#endif
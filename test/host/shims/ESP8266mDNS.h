@@ -0,0 +1,25 @@
+/*
+*	Host shim - mDNS responder that always starts
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#ifndef HOST_ESP8266MDNS_H
+#define HOST_ESP8266MDNS_H
+
+#include <Arduino.h>
+
+class MDNSResponder {
+  public:
+    bool begin(const char* hostname){ return true; }
+    void addService(const char* service, const char* protocol, uint16_t port){}
+    void addServiceTxt(const char* service, const char* protocol, const char* key, const char* value){}
+    void update(){}
+    void notifyAPChange(){}
+};
+
+extern MDNSResponder MDNS;
+
+#endif
@@ -0,0 +1,141 @@
+/*
+*	Host shim - SHA-256 (FIPS 180-4) & HMAC for the BearSSL calls
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#include <string.h>
+#include "bearssl/bearssl.h"
+
+const br_hash_class br_sha256_vtable = { 32 };
+
+static const uint32_t sha256K[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static uint32_t rotr(uint32_t value, int bits){
+  return (value >> bits) | (value << (32 - bits));
+}
+
+static void sha256Block(HostSha256* context, const uint8_t* block){
+  uint32_t w[64];
+  for (int i = 0; i < 16; i++){
+    w[i] = ((uint32_t)block[i * 4] << 24) | ((uint32_t)block[i * 4 + 1] << 16) | ((uint32_t)block[i * 4 + 2] << 8) | block[i * 4 + 3];
+  }
+
+  for (int i = 16; i < 64; i++){
+    uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+
+  uint32_t a = context->state[0], b = context->state[1], c = context->state[2], d = context->state[3];
+  uint32_t e = context->state[4], f = context->state[5], g = context->state[6], h = context->state[7];
+  for (int i = 0; i < 64; i++){
+    uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + sha256K[i] + w[i];
+    uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+    h = g; g = f; f = e; e = d + t1;
+    d = c; c = b; b = a; a = t1 + t2;
+  }
+
+  context->state[0] += a; context->state[1] += b; context->state[2] += c; context->state[3] += d;
+  context->state[4] += e; context->state[5] += f; context->state[6] += g; context->state[7] += h;
+}
+
+void hostSha256Init(HostSha256* context){
+  static const uint32_t initial[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+  memcpy(context->state, initial, sizeof(initial));
+  context->length = 0;
+}
+
+void hostSha256Update(HostSha256* context, const void* data, size_t length){
+  const uint8_t* bytes = (const uint8_t*)data;
+  for (size_t i = 0; i < length; i++){
+    context->block[context->length % 64] = bytes[i];
+    context->length += 1;
+    if (context->length % 64 == 0){
+      sha256Block(context, context->block);
+    }
+  }
+}
+
+void hostSha256Out(const HostSha256* context, uint8_t* digest){
+  // Pads a copy so the context can keep going, like BearSSL
+  HostSha256 padded = *context;
+  uint64_t bits = padded.length * 8;
+  uint8_t pad = 0x80;
+  hostSha256Update(&padded, &pad, 1);
+
+  pad = 0;
+  while (padded.length % 64 != 56){
+    hostSha256Update(&padded, &pad, 1);
+  }
+
+  uint8_t lengthBytes[8];
+  for (int i = 0; i < 8; i++){
+    lengthBytes[i] = (bits >> (56 - 8 * i)) & 0xFF;
+  }
+  hostSha256Update(&padded, lengthBytes, 8);
+
+  for (int i = 0; i < 8; i++){
+    digest[i * 4] = padded.state[i] >> 24;
+    digest[i * 4 + 1] = padded.state[i] >> 16;
+    digest[i * 4 + 2] = padded.state[i] >> 8;
+    digest[i * 4 + 3] = padded.state[i];
+  }
+}
+
+void br_hmac_key_init(br_hmac_key_context* keyContext, const br_hash_class* digest, const void* key, size_t keyLength){
+  uint8_t block[64];
+  memset(block, 0, sizeof(block));
+  if (keyLength > 64){
+    HostSha256 hashed;
+    hostSha256Init(&hashed);
+    hostSha256Update(&hashed, key, keyLength);
+    hostSha256Out(&hashed, block);
+  }
+
+  else{
+    memcpy(block, key, keyLength);
+  }
+
+  for (int i = 0; i < 64; i++){
+    keyContext->innerPad[i] = block[i] ^ 0x36;
+    keyContext->outerPad[i] = block[i] ^ 0x5C;
+  }
+}
+
+void br_hmac_init(br_hmac_context* context, const br_hmac_key_context* keyContext, size_t outLength){
+  hostSha256Init(&context->inner);
+  hostSha256Update(&context->inner, keyContext->innerPad, 64);
+  memcpy(context->outerPad, keyContext->outerPad, 64);
+  context->outLength = (outLength == 0 || outLength > 32) ? 32 : outLength;
+}
+
+void br_hmac_update(br_hmac_context* context, const void* data, size_t length){
+  hostSha256Update(&context->inner, data, length);
+}
+
+size_t br_hmac_out(const br_hmac_context* context, void* out){
+  uint8_t innerDigest[32];
+  hostSha256Out(&context->inner, innerDigest);
+
+  HostSha256 outer;
+  uint8_t digest[32];
+  hostSha256Init(&outer);
+  hostSha256Update(&outer, context->outerPad, 64);
+  hostSha256Update(&outer, innerDigest, 32);
+  hostSha256Out(&outer, digest);
+
+  memcpy(out, digest, context->outLength);
+  return context->outLength;
+}
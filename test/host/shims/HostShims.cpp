@@ -0,0 +1,367 @@
+/*
+*	Host shim - state behind Arduino.h, EEPROM.h, coredecls.h, 
+*   sys/time.h, Ticker.h, user_interface.h & the networking shims
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <coredecls.h>
+#include <Ticker.h>
+#include <user_interface.h>
+#include <cont.h>
+#include <ESP8266WiFi.h>
+#include <ESP8266mDNS.h>
+#include <WiFiUdp.h>
+#include <ESP8266WebServer.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+uint32_t hostMillis = 0;
+int hostPinLevels[HOST_PIN_COUNT];
+uint32_t hostFreeHeap = 40000;
+uint32_t hostFreeContStack = 2048;
+uint32_t hostMaxFreeBlock = 32000;
+uint32_t hostHeapFragmentation = 5;
+uint32_t hostCycles = 0;
+bool hostCycleClock = false;
+struct rst_info hostResetInfo;
+int hostRestarts = 0;
+Ticker* hostPeriodicTickers[HOST_TICKER_SLOTS];
+cont_t* g_pcont = NULL;
+uint64_t hostWallTime = 0;
+HostTimeSyncCallback hostTimeSyncCallback = NULL;
+
+HardwareSerial Serial;
+EspClass ESP;
+EEPROMClass EEPROM;
+
+uint32_t millis(){
+  return hostMillis;
+}
+
+uint32_t micros(){
+  return hostMillis * 1000;
+}
+
+void delay(unsigned long ms){
+  hostMillis += ms;
+}
+
+void yield(){
+}
+
+void pinMode(uint8_t pin, uint8_t mode){
+}
+
+void digitalWrite(uint8_t pin, uint8_t level){
+  if (pin < HOST_PIN_COUNT){
+    hostPinLevels[pin] = level;
+  }
+}
+
+int digitalRead(uint8_t pin){
+  return (pin < HOST_PIN_COUNT) ? hostPinLevels[pin] : LOW;
+}
+
+size_t HardwareSerial::write(const uint8_t* data, size_t length){
+  if (outputLength + length >= sizeof(output)){
+    length = sizeof(output) - outputLength - 1;
+  }
+
+  memcpy(&output[outputLength], data, length);
+  outputLength += length;
+  output[outputLength] = 0;
+  return length;
+}
+
+bool IPAddress::fromString(const char* text){
+  // Dotted quad, parsed a character at a time like the core's - left alone when it doesn't parse
+  uint32_t parsed = 0;
+  int octet = -1;
+  int dots = 0;
+  for (const char* c = text; ; c++){
+    if (*c >= '0' && *c <= '9'){
+      octet = ((octet < 0) ? 0 : octet * 10) + (*c - '0');
+      if (octet > 255){
+        return false;
+      }
+    }
+
+    else if ((*c == '.' && dots < 3) || (*c == 0 && dots == 3)){
+      if (octet < 0){
+        return false;
+      }
+
+      parsed |= (uint32_t)octet << (8 * dots);
+      if (*c == 0){
+        break;
+      }
+
+      dots += 1;
+      octet = -1;
+    }
+
+    else{
+      return false;
+    }
+  }
+
+  address = parsed;
+  return true;
+}
+
+uint32_t EspClass::getCycleCount(){
+  if (!hostCycleClock){
+    return hostCycles;
+  }
+
+  // Wraps every ~53 s like the device's counter - the benchmark only takes differences
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint32_t)(((uint64_t)now.tv_sec * 80000000ULL) + ((uint64_t)now.tv_nsec * 80 / 1000));
+}
+
+struct rst_info* EspClass::getResetInfoPtr(){
+  return &hostResetInfo;
+}
+
+void system_restart(void){
+  hostRestarts += 1;
+}
+
+void hostRunTickers(){
+  for (int i = 0; i < HOST_TICKER_SLOTS; i++){
+    if (hostPeriodicTickers[i] != NULL){
+      hostPeriodicTickers[i]->fire();
+    }
+  }
+}
+
+bool EspClass::rtcUserMemoryRead(uint32_t offset, uint32_t* data, size_t size){
+  if (offset * 4 + size > sizeof(rtcMemory)){
+    return false;
+  }
+
+  memcpy(data, &rtcMemory[offset], size);
+  return true;
+}
+
+bool EspClass::rtcUserMemoryWrite(uint32_t offset, uint32_t* data, size_t size){
+  if (offset * 4 + size > sizeof(rtcMemory)){
+    return false;
+  }
+
+  memcpy(&rtcMemory[offset], data, size);
+  return true;
+}
+
+void configTime(int timezone, int daylightOffset, const char* server1, const char* server2, const char* server3){
+}
+
+void settimeofday_cb(HostTimeSyncCallback callback){
+  hostTimeSyncCallback = callback;
+}
+
+int hostGettimeofday(struct timeval* now, void* timezone){
+  now->tv_sec = hostWallTime / 1000;
+  now->tv_usec = (hostWallTime % 1000) * 1000;
+  return 0;
+}
+
+// ESP8266WiFi.h, ESP8266mDNS.h & WiFiUdp.h
+
+ESP8266WiFiClass WiFi;
+MDNSResponder MDNS;
+uint8_t hostUdpInbound[HOST_UDP_MAX_DATAGRAM];
+int hostUdpInboundLength = 0;
+uint8_t hostUdpSent[HOST_UDP_MAX_DATAGRAM];
+int hostUdpSentLength = 0;
+int hostUdpSentCount = 0;
+
+bool hostUdpLoopback = false;
+uint16_t hostUdpLoopbackPort = 0;
+
+WiFiUDP::WiFiUDP(){
+  pendingLength = 0;
+  socketFd = -1;
+  senderAddress = 0;
+  senderPort = 0;
+  targetAddress = 0;
+  targetPort = 0;
+  multicast = false;
+  receivedLength = 0;
+}
+
+WiFiUDP::~WiFiUDP(){
+  if (socketFd >= 0){
+    close(socketFd);
+  }
+}
+
+uint8_t WiFiUDP::begin(uint16_t port){
+  if (!hostUdpLoopback){
+    return 1;
+  }
+
+  // The firmware's port may be taken on the test host - any free one will do
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socketFd = socket(AF_INET, SOCK_DGRAM, 0);
+  socklen_t addressLength = sizeof(address);
+  if (socketFd < 0 || bind(socketFd, (struct sockaddr*)&address, sizeof(address)) != 0 || getsockname(socketFd, (struct sockaddr*)&address, &addressLength) != 0){
+    return 0;
+  }
+
+  hostUdpLoopbackPort = ntohs(address.sin_port);
+  return 1;
+}
+
+int WiFiUDP::parsePacket(){
+  if (socketFd < 0){
+    return hostUdpInboundLength;
+  }
+
+  struct sockaddr_in sender;
+  socklen_t senderLength = sizeof(sender);
+  receivedLength = (int)recvfrom(socketFd, received, sizeof(received), MSG_DONTWAIT, (struct sockaddr*)&sender, &senderLength);
+  if (receivedLength < 0){
+    receivedLength = 0;
+    return 0;
+  }
+
+  senderAddress = sender.sin_addr.s_addr;
+  senderPort = ntohs(sender.sin_port);
+  return receivedLength;
+}
+
+int WiFiUDP::read(uint8_t* buffer, size_t length){
+  uint8_t* source = socketFd < 0 ? hostUdpInbound : received;
+  int* available = socketFd < 0 ? &hostUdpInboundLength : &receivedLength;
+  int copied = (int)length < *available ? (int)length : *available;
+  memcpy(buffer, source, copied);
+  *available = 0;
+  return copied;
+}
+
+IPAddress WiFiUDP::remoteIP(){
+  return socketFd < 0 ? IPAddress(192, 168, 1, 20) : IPAddress(senderAddress);
+}
+
+uint16_t WiFiUDP::remotePort(){
+  return socketFd < 0 ? 50000 : senderPort;
+}
+
+int WiFiUDP::beginPacket(IPAddress ip, uint16_t port){
+  pendingLength = 0;
+  targetAddress = (uint32_t)ip;
+  targetPort = port;
+  multicast = false;
+  return 1;
+}
+
+int WiFiUDP::beginPacketMulticast(IPAddress ip, uint16_t port, IPAddress interfaceAddress){
+  pendingLength = 0;
+  multicast = true;
+  return 1;
+}
+
+size_t WiFiUDP::write(const uint8_t* data, size_t length){
+  if (pendingLength + (int)length > HOST_UDP_MAX_DATAGRAM){
+    length = HOST_UDP_MAX_DATAGRAM - pendingLength;
+  }
+
+  memcpy(&hostUdpSent[pendingLength], data, length);
+  pendingLength += length;
+  return length;
+}
+
+int WiFiUDP::endPacket(){
+  hostUdpSentLength = pendingLength;
+  hostUdpSentCount += 1;
+  if (socketFd < 0 || multicast){
+    return 1;
+  }
+
+  struct sockaddr_in target;
+  memset(&target, 0, sizeof(target));
+  target.sin_family = AF_INET;
+  target.sin_addr.s_addr = targetAddress;
+  target.sin_port = htons(targetPort);
+  return sendto(socketFd, hostUdpSent, pendingLength, 0, (struct sockaddr*)&target, sizeof(target)) == pendingLength ? 1 : 0;
+}
+
+// ESP8266WebServer.h
+
+void ESP8266WebServer::collectHeaders(const char* headerKeys[], const size_t headerKeysCount){
+  headerCount = headerKeysCount < HOST_WEB_MAX_HEADERS ? headerKeysCount : HOST_WEB_MAX_HEADERS;
+  for (int i = 0; i < headerCount; i++){
+    headerNames[i] = headerKeys[i];
+    headerValues[i] = "";
+  }
+}
+
+void ESP8266WebServer::handleClient(){
+  if (pending && notFound){
+    pending = false;
+    notFound();
+  }
+}
+
+String ESP8266WebServer::header(const char* name){
+  for (int i = 0; i < headerCount; i++){
+    if (strcmp(headerNames[i], name) == 0){
+      return String(headerValues[i].c_str());
+    }
+  }
+
+  return String("");
+}
+
+void ESP8266WebServer::send(int code, const char* contentType, const char* body){
+  replyCode = code;
+  replyBody = body;
+}
+
+void ESP8266WebServer::clearRequest(){
+  requestUri = String("/");
+  requestMethod = HTTP_GET;
+  argCount = 0;
+  for (int i = 0; i < headerCount && i < HOST_WEB_MAX_HEADERS; i++){
+    headerValues[i] = "";
+  }
+
+  replyCode = 0;
+  replyBody = "";
+  pending = false;
+}
+
+void ESP8266WebServer::setRequest(HTTPMethod method, const char* uri){
+  clearRequest();
+  requestMethod = method;
+  requestUri = String(uri);
+  pending = true;
+}
+
+void ESP8266WebServer::addArg(const char* name, const char* value){
+  if (argCount < HOST_WEB_MAX_ARGS){
+    argNames[argCount] = name;
+    argValues[argCount] = value;
+    argCount += 1;
+  }
+}
+
+void ESP8266WebServer::setHeader(const char* name, const char* value){
+  for (int i = 0; i < headerCount; i++){
+    if (strcmp(headerNames[i], name) == 0){
+      headerValues[i] = value;
+    }
+  }
+}
@@ -0,0 +1,81 @@
+/*
+*	Host shim - one shot timers that fire when the test says so,
+*   periodic ones on hostRunTickers()
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#ifndef HOST_TICKER_H
+#define HOST_TICKER_H
+
+#include <Arduino.h>
+
+#define HOST_TICKER_SLOTS 4
+
+class Ticker;
+
+// Attached periodic tickers - hostRunTickers() fires them all, like the SDK does when the loop yields
+extern Ticker* hostPeriodicTickers[HOST_TICKER_SLOTS];
+void hostRunTickers();
+
+class Ticker {
+  public:
+    Ticker(){ callback = NULL; argument = NULL; interval = 0; periodic = false; }
+    ~Ticker(){ detach(); }
+
+    template<typename T>
+    void once_ms(uint32_t milliseconds, void (*function)(T), T arg){
+      callback = (void (*)(void*))function;
+      argument = (void*)arg;
+      interval = milliseconds;
+    }
+
+    template<typename T>
+    void attach_ms(uint32_t milliseconds, void (*function)(T), T arg){
+      once_ms(milliseconds, function, arg);
+      periodic = true;
+      for (int i = 0; i < HOST_TICKER_SLOTS; i++){
+        if (hostPeriodicTickers[i] == NULL || hostPeriodicTickers[i] == this){
+          hostPeriodicTickers[i] = this;
+          return;
+        }
+      }
+    }
+
+    void detach(){
+      callback = NULL;
+      if (periodic){
+        for (int i = 0; i < HOST_TICKER_SLOTS; i++){
+          if (hostPeriodicTickers[i] == this){
+            hostPeriodicTickers[i] = NULL;
+          }
+        }
+      }
+
+      periodic = false;
+    }
+
+    bool active(){ return callback != NULL; }
+    uint32_t armedInterval(){ return interval; }
+
+    void fire(){
+      void (*function)(void*) = callback;
+      if (!periodic){
+        callback = NULL;
+      }
+
+      if (function != NULL){
+        function(argument);
+      }
+    }
+
+  private:
+    void (*callback)(void*);
+    void* argument;
+    uint32_t interval;
+    bool periodic;
+};
+
+#endif
@@ -0,0 +1,56 @@
+/*
+*	Host shim - one datagram in, the last one out, 
+*   both held in host controls tests read & write - 
+*   or a real socket on 127.0.0.1 in loopback mode
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#ifndef HOST_WIFIUDP_H
+#define HOST_WIFIUDP_H
+
+#include <Arduino.h>
+
+#define HOST_UDP_MAX_DATAGRAM 64
+
+// Host controls - a test queues hostUdpInbound, the socket's next write lands in hostUdpSent
+extern uint8_t hostUdpInbound[HOST_UDP_MAX_DATAGRAM];
+extern int hostUdpInboundLength;                // 0 when nothing is waiting
+extern uint8_t hostUdpSent[HOST_UDP_MAX_DATAGRAM];
+extern int hostUdpSentLength;
+extern int hostUdpSentCount;
+
+// Loopback mode - begin() binds 127.0.0.1 on an ephemeral port (hostUdpLoopbackPort) & datagrams go 
+// through the kernel. Multicast writes are still only captured
+extern bool hostUdpLoopback;
+extern uint16_t hostUdpLoopbackPort;
+
+class WiFiUDP {
+  public:
+    WiFiUDP();
+    ~WiFiUDP();
+    uint8_t begin(uint16_t port);
+    int parsePacket();
+    int read(uint8_t* buffer, size_t length);
+    IPAddress remoteIP();
+    uint16_t remotePort();
+    int beginPacket(IPAddress ip, uint16_t port);
+    int beginPacketMulticast(IPAddress ip, uint16_t port, IPAddress interfaceAddress);
+    size_t write(const uint8_t* data, size_t length);
+    int endPacket();
+
+  private:
+    int pendingLength;
+    int socketFd;                             // Loopback mode only
+    uint32_t senderAddress;
+    uint16_t senderPort;
+    uint32_t targetAddress;
+    uint16_t targetPort;
+    bool multicast;
+    uint8_t received[HOST_UDP_MAX_DATAGRAM];
+    int receivedLength;
+};
+
+#endif
@@ -0,0 +1,48 @@
+/*
+*	Host shim - the BearSSL HMAC-SHA256 calls the firmware 
+*   makes, on a plain SHA-256 implementation
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#ifndef HOST_BEARSSL_H
+#define HOST_BEARSSL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct br_hash_class_ {
+  size_t desc;
+} br_hash_class;
+
+extern const br_hash_class br_sha256_vtable;
+
+typedef struct hostSha256 {
+  uint32_t state[8];
+  uint8_t block[64];
+  uint64_t length;
+} HostSha256;
+
+typedef struct {
+  uint8_t innerPad[64];
+  uint8_t outerPad[64];
+} br_hmac_key_context;
+
+typedef struct {
+  HostSha256 inner;
+  uint8_t outerPad[64];
+  size_t outLength;
+} br_hmac_context;
+
+void hostSha256Init(HostSha256* context);
+void hostSha256Update(HostSha256* context, const void* data, size_t length);
+void hostSha256Out(const HostSha256* context, uint8_t* digest);
+
+void br_hmac_key_init(br_hmac_key_context* keyContext, const br_hash_class* digest, const void* key, size_t keyLength);
+void br_hmac_init(br_hmac_context* context, const br_hmac_key_context* keyContext, size_t outLength);
+void br_hmac_update(br_hmac_context* context, const void* data, size_t length);
+size_t br_hmac_out(const br_hmac_context* context, void* out);
+
+#endif
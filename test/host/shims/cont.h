@@ -0,0 +1,30 @@
+/*
+*	Host shim - the loop's continuation, as the supervisor 
+*   reads it for the stack snapshot
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#ifndef HOST_CONT_H
+#define HOST_CONT_H
+
+#define CONT_STACK_SIZE 4096
+
+// Same layout as the core's cont.h - tests point sp_yield into stack[]
+typedef struct cont_ {
+  void (*pc_ret)(void);
+  unsigned* sp_ret;
+  void (*pc_yield)(void);
+  unsigned* sp_yield;
+  unsigned* stack_end;
+  unsigned unused1;
+  unsigned unused2;
+  unsigned stack_guard1;
+  unsigned stack[CONT_STACK_SIZE / 4];
+  unsigned stack_guard2;
+  unsigned* struct_start;
+} cont_t;
+
+#endif
@@ -0,0 +1,19 @@
+/*
+*	Host shim - SNTP sync callback hook
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#ifndef HOST_COREDECLS_H
+#define HOST_COREDECLS_H
+
+typedef void (*HostTimeSyncCallback)();
+
+// The registered callback - tests call it after moving hostWallTime
+extern HostTimeSyncCallback hostTimeSyncCallback;
+
+void settimeofday_cb(HostTimeSyncCallback callback);
+
+#endif
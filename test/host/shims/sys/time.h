@@ -0,0 +1,21 @@
+/*
+*	Host shim - routes the firmware's gettimeofday() to a wall 
+*   clock the tests control
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#ifndef HOST_SYS_TIME_H
+#define HOST_SYS_TIME_H
+
+#include_next <sys/time.h>
+#include <stdint.h>
+
+extern uint64_t hostWallTime;                   // Epoch millis
+
+int hostGettimeofday(struct timeval* now, void* timezone);
+#define gettimeofday hostGettimeofday
+
+#endif
@@ -0,0 +1,31 @@
+/*
+*	Host shim - SDK reset info & restart
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#ifndef HOST_USER_INTERFACE_H
+#define HOST_USER_INTERFACE_H
+
+#include <stdint.h>
+
+struct rst_info {
+  uint32_t reason;
+  uint32_t exccause;
+  uint32_t epc1;
+  uint32_t epc2;
+  uint32_t epc3;
+  uint32_t excvaddr;
+  uint32_t depc;
+};
+
+// What ESP.getResetInfoPtr() reports & how many times system_restart() was called
+extern struct rst_info hostResetInfo;
+extern int hostRestarts;
+
+// C linkage like the SDK - the firmware includes this inside extern "C"
+extern "C" void system_restart(void);
+
+#endif
@@ -0,0 +1,151 @@
+/*
+*	Host tests - static / DHCP fallback decision
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#include "TestHarness.hpp"
+#include "wifi-interface/AddressingPolicy.hpp"
+
+/*
+ *  Simulated router - each connection attempt either times out (AP 
+ *  down), associates on the requested static address, or associates 
+ *  and leaves the sensor on some other address. The driver follows 
+ *  GDoorWifi::connectWithFallback and reports the mode it settles in.
+ *
+*/
+
+typedef enum routerResponse {
+  ROUTER_DOWN,
+  ROUTER_GRANTS_STATIC,
+  ROUTER_REFUSES_STATIC
+} RouterResponse;
+
+typedef struct connectOutcome {
+  bool fellBack;
+  int attempts;
+} ConnectOutcome;
+
+static ConnectOutcome connect(GDoorAddressingPolicy* policy, const RouterResponse* script, int scriptLength){
+  ConnectOutcome outcome = { false, 0 };
+  policy->reset();
+  while (outcome.attempts < scriptLength){
+    RouterResponse response = script[outcome.attempts];
+    outcome.attempts += 1;
+
+    bool associated = response != ROUTER_DOWN;
+    AddressingStep step = policy->onStaticAttempt(associated, response == ROUTER_GRANTS_STATIC);
+    if (step == ADDRESSING_STEP_CONNECTED){
+      return outcome;
+    }
+
+    if (step == ADDRESSING_STEP_FALL_BACK){
+      outcome.fellBack = true;
+      return outcome;
+    }
+  }
+
+  return outcome;
+}
+
+TEST(routerRebootKeepsStaticAddress){
+  // AP down for 20 attempts (5 minutes at 15s each), then back with our address
+  RouterResponse script[21];
+  for (int i = 0; i < 20; i++){
+    script[i] = ROUTER_DOWN;
+  }
+  script[20] = ROUTER_GRANTS_STATIC;
+
+  GDoorAddressingPolicy policy;
+  ConnectOutcome outcome = connect(&policy, script, 21);
+  CHECK(!outcome.fellBack);
+  CHECK_EQ(21, outcome.attempts);
+  CHECK_EQ(0, policy.refusals());
+}
+
+TEST(unreachableAPNeverFallsBack){
+  GDoorAddressingPolicy policy;
+  for (int i = 0; i < 1000; i++){
+    CHECK(policy.onStaticAttempt(false, false) == ADDRESSING_STEP_RETRY_STATIC);
+  }
+
+  CHECK_EQ(0, policy.refusals());
+}
+
+TEST(refusedStaticFallsBackAfterAttempts){
+  RouterResponse script[] = { ROUTER_REFUSES_STATIC, ROUTER_REFUSES_STATIC, ROUTER_GRANTS_STATIC };
+  GDoorAddressingPolicy policy;
+  ConnectOutcome outcome = connect(&policy, script, 3);
+  CHECK(outcome.fellBack);
+  CHECK_EQ(WIFI_STATIC_ATTEMPTS, outcome.attempts);
+}
+
+TEST(outagesBetweenRefusalsDontCount){
+  RouterResponse script[] = { ROUTER_REFUSES_STATIC, ROUTER_DOWN, ROUTER_DOWN, ROUTER_DOWN, ROUTER_REFUSES_STATIC };
+  GDoorAddressingPolicy policy;
+  ConnectOutcome outcome = connect(&policy, script, 5);
+  CHECK(outcome.fellBack);
+  CHECK_EQ(5, outcome.attempts);
+  CHECK_EQ(WIFI_STATIC_ATTEMPTS, policy.refusals());
+}
+
+TEST(singleRefusalThenGrantStaysStatic){
+  RouterResponse script[] = { ROUTER_REFUSES_STATIC, ROUTER_GRANTS_STATIC };
+  GDoorAddressingPolicy policy;
+  ConnectOutcome outcome = connect(&policy, script, 2);
+  CHECK(!outcome.fellBack);
+  CHECK_EQ(2, outcome.attempts);
+  CHECK_EQ(0, policy.refusals());
+}
+
+TEST(resetClearsRefusals){
+  GDoorAddressingPolicy policy;
+  CHECK(policy.onStaticAttempt(true, false) == ADDRESSING_STEP_RETRY_STATIC);
+  policy.reset();
+  CHECK(policy.onStaticAttempt(true, false) == ADDRESSING_STEP_RETRY_STATIC);
+}
+
+TEST(attemptsCutToTheBudget){
+  GDoorAddressingPolicy policy;
+  policy.startBudget(1000, 40000);
+  CHECK_EQ(15000u, policy.attemptTimeout(1000, 15000));
+  CHECK_EQ(15000u, policy.attemptTimeout(16000, 15000));
+  CHECK_EQ(10000u, policy.attemptTimeout(31000, 15000));
+  CHECK_EQ(0u, policy.attemptTimeout(41000, 15000));
+  CHECK_EQ(0u, policy.attemptTimeout(90000, 15000));
+
+  // Across the millis() wrap
+  policy.startBudget(0xFFFFF000, 40000);
+  CHECK_EQ(15000u, policy.attemptTimeout(0x00001000, 15000));
+  CHECK_EQ(0u, policy.attemptTimeout(0xFFFFF000 + 40000, 15000));
+}
+
+TEST(unreachableAPEndsWithTheBudget){
+  // As connectWithFallback - every attempt waits its full timeout without associating
+  GDoorAddressingPolicy policy;
+  uint32_t now = 5000;
+  int attempts = 0;
+  policy.startBudget(now, 90000);
+  for (uint32_t timeout = policy.attemptTimeout(now, 15000); timeout > 0; timeout = policy.attemptTimeout(now, 15000)){
+    CHECK(policy.onStaticAttempt(false, false) == ADDRESSING_STEP_RETRY_STATIC);
+    now += timeout;
+    attempts += 1;
+  }
+
+  CHECK_EQ(6, attempts);
+  CHECK_EQ(5000u + 90000u, now);
+}
+
+TEST(refusalsCarryIntoTheNextBudget){
+  // The first call's budget runs out after one refusal - the next call falls back on its first
+  GDoorAddressingPolicy policy;
+  policy.startBudget(0, 15000);
+  CHECK(policy.onStaticAttempt(true, false) == ADDRESSING_STEP_RETRY_STATIC);
+  CHECK_EQ(0u, policy.attemptTimeout(15000, 15000));
+
+  policy.startBudget(20000, 15000);
+  CHECK(policy.attemptTimeout(20000, 15000) > 0);
+  CHECK(policy.onStaticAttempt(true, false) == ADDRESSING_STEP_FALL_BACK);
+}
@@ -0,0 +1,66 @@
+/*
+*	Host tests - benchmark arithmetic & the JSON lines 
+*   tools/compare_bench.py reads
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#include "TestHarness.hpp"
+#include "diagnostics/Benchmark.hpp"
+
+// Stands in for a hot path - costs a fixed number of cycles, the first call more
+typedef struct fakeWork {
+  int calls;
+  uint32_t firstCallCycles;
+  uint32_t cycles;
+  uint32_t leakPerCall;
+} FakeWork;
+
+static void work(void* context){
+  FakeWork* fake = (FakeWork*)context;
+  hostCycles += (fake->calls == 0) ? fake->firstCallCycles : fake->cycles;
+  hostFreeHeap -= (fake->calls == 0) ? 512 : fake->leakPerCall;
+  fake->calls += 1;
+}
+
+static void setUp(){
+  Serial.clear();
+  hostFreeHeap = 40000;
+}
+
+TEST(reportsCyclesAndNanosPerCall){
+  setUp();
+  FakeWork fake = { 0, 100, 100, 0 };
+  GDoorBenchmark bench(Serial);
+  bench.begin("hotpath", "1.0.0");
+  bench.run("fake", work, &fake, 200);
+  bench.size("payload", 96);
+  bench.end();
+
+  // 100 cycles at 80MHz is 1250ns
+  CHECK_STR("{\"suite\":\"hotpath\",\"fw\":\"1.0.0\",\"cpuMHz\":80}\n"
+    "{\"bench\":\"fake\",\"iterations\":200,\"cyclesPerOp\":100,\"nsPerOp\":1250,\"heapDelta\":0}\n"
+    "{\"size\":\"payload\",\"bytes\":96}\n"
+    "{\"suiteEnd\":\"hotpath\",\"benchmarks\":1}\n", Serial.output);
+}
+
+TEST(warmUpCallNotCounted){
+  // Flash cache misses & a one off allocation on the first call stay out of the numbers
+  setUp();
+  FakeWork fake = { 0, 50000, 120, 0 };
+  GDoorBenchmark bench(Serial);
+  bench.run("warm", work, &fake, 64);
+  CHECK_EQ(65, fake.calls);
+  CHECK_STR("{\"bench\":\"warm\",\"iterations\":64,\"cyclesPerOp\":120,\"nsPerOp\":1500,\"heapDelta\":0}\n", Serial.output);
+}
+
+TEST(partialBatchAndLeakReported){
+  setUp();
+  FakeWork fake = { 0, 10, 10, 8 };
+  GDoorBenchmark bench(Serial);
+  bench.run("leaky", work, &fake, BENCHMARK_BATCH + 36);
+  CHECK_EQ(BENCHMARK_BATCH + 37, fake.calls);
+  CHECK_STR("{\"bench\":\"leaky\",\"iterations\":100,\"cyclesPerOp\":10,\"nsPerOp\":125,\"heapDelta\":800}\n", Serial.output);
+}
@@ -0,0 +1,156 @@
+/*
+*	Host tests - the binary uploads against tools/decode_uplink.py
+*   and the JSON uploads carrying the same fields
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#include <time.h>
+#include "TestHarness.hpp"
+#include "networking/BinaryUplink.hpp"
+#include "networking/UplinkJson.hpp"
+
+#define TEST_UID "T3stUid000000000000000000001"
+#define TIMED_ENCODES 20000
+
+// One upload - the firmware's inputs, then what decode_uplink.py expects of it
+typedef struct uplinkVector {
+  const char* type;
+  int messageType;                  // BINARY_MSG_*
+  uint32_t sessionId;               // 0 before the boot info response - the UID is sent
+  uint64_t capturedAt;
+  uint64_t sentAt;
+  bool dhcpAddressing;
+  int channel;                      // Door state
+  int state;
+  int channelCount;                 // Boot info
+  int doorStates[MAX_DOOR_CHANNELS];
+  const char* portNum;
+  const char* firmwareVersion;
+  const char* targetStaticIP;
+  const char* assignedLocalIP;      // Boot info & recon
+  uint32_t connectedMillis;
+  ResetReport reset;
+  uint64_t uptimeMillis;            // Health
+  MemorySnapshot memory;
+  const char* binary;               // decode_uplink.encode() as hex - decode() reads the case back from it
+  const char* json;                 // The decoded fields as the JSON upload
+} UplinkVector;
+
+#include "UplinkVectors.h"
+
+#define VECTOR_COUNT (int)(sizeof(uplinkVectors) / sizeof(uplinkVectors[0]))
+
+static int encodeBinary(const UplinkVector* vector, uint8_t* target){
+  DoorState doorStates[MAX_DOOR_CHANNELS];
+  switch (vector->messageType){
+    case BINARY_MSG_BOOT_INFO:
+      for (int i = 0; i < MAX_DOOR_CHANNELS; i++){
+        doorStates[i] = (DoorState)vector->doorStates[i];
+      }
+
+      return encodeBootInfoBinary(TEST_UID, vector->portNum, vector->firmwareVersion, vector->targetStaticIP, vector->assignedLocalIP, vector->dhcpAddressing,
+        doorStates, vector->channelCount, vector->connectedMillis, &vector->reset, vector->capturedAt, vector->sentAt, target);
+    case BINARY_MSG_DOOR_STATE:
+      return encodeDoorStateBinary(vector->sessionId, TEST_UID, (DoorState)vector->state, vector->channel, vector->capturedAt, vector->sentAt, target);
+    case BINARY_MSG_HEALTH:
+      return encodeHealthBinary(vector->sessionId, TEST_UID, vector->uptimeMillis, &vector->memory, vector->capturedAt, vector->sentAt, target);
+    default:
+      return encodeReconBinary(vector->sessionId, TEST_UID, vector->assignedLocalIP, vector->dhcpAddressing, vector->capturedAt, vector->sentAt, target);
+  }
+}
+
+// As HttpInterface.cpp builds it - timestamps included, so the timing covers the whole payload
+static int encodeJson(const UplinkVector* vector, char* target){
+  char timestamps[TIMESTAMP_ENTRIES_LEN];
+  createTimestampEntries(vector->capturedAt, vector->sentAt, timestamps);
+  DoorState doorStates[MAX_DOOR_CHANNELS];
+  switch (vector->messageType){
+    case BINARY_MSG_BOOT_INFO:
+      for (int i = 0; i < MAX_DOOR_CHANNELS; i++){
+        doorStates[i] = (DoorState)vector->doorStates[i];
+      }
+
+      return createBootInfoJson(vector->portNum, TEST_UID, vector->firmwareVersion, vector->targetStaticIP, vector->assignedLocalIP, vector->dhcpAddressing,
+        doorStates, vector->channelCount, vector->connectedMillis, &vector->reset, timestamps, target);
+    case BINARY_MSG_DOOR_STATE:
+      return createHttpJson((vector->state == DOOR_STATE_OPEN) ? "00" : "01", vector->channel, TEST_UID, timestamps, target);
+    case BINARY_MSG_HEALTH:
+      return createHealthJson(vector->uptimeMillis, &vector->memory, TEST_UID, timestamps, target);
+    default:
+      return createReconJson(TEST_UID, vector->assignedLocalIP, vector->dhcpAddressing, timestamps, target);
+  }
+}
+
+static void toHex(const uint8_t* data, int length, char* target){
+  for (int i = 0; i < length; i++){
+    sprintf(&target[i * 2], "%02x", data[i]);
+  }
+
+  target[length * 2] = 0;
+}
+
+// CHECK_STR wants a literal - this prints both sides instead
+static void checkSame(const char* type, const char* expected, const char* actual){
+  if (strcmp(expected, actual) != 0){
+    printf("  %s\n    expected %s\n    got      %s\n", type, expected, actual);
+    CHECK(false);
+  }
+}
+
+static double nanosSince(const struct timespec* started){
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ((now.tv_sec - started->tv_sec) * 1e9) + (now.tv_nsec - started->tv_nsec);
+}
+
+TEST(encodersMatchTheDecoder){
+  uint8_t payload[BINARY_UPLINK_MAX_LEN];
+  char hex[(BINARY_UPLINK_MAX_LEN * 2) + 1];
+  for (int i = 0; i < VECTOR_COUNT; i++){
+    int length = encodeBinary(&uplinkVectors[i], payload);
+    CHECK(length <= BINARY_UPLINK_MAX_LEN);
+    toHex(payload, length, hex);
+    checkSame(uplinkVectors[i].type, uplinkVectors[i].binary, hex);
+  }
+}
+
+TEST(jsonCarriesTheDecodedFields){
+  char json[BOOT_INFO_JSON_LEN];
+  for (int i = 0; i < VECTOR_COUNT; i++){
+    int length = encodeJson(&uplinkVectors[i], json);
+    CHECK_EQ((int)strlen(uplinkVectors[i].json), length);
+    checkSame(uplinkVectors[i].type, uplinkVectors[i].json, json);
+  }
+}
+
+TEST(binaryIsSmallerAndQuicker){
+  uint8_t payload[BINARY_UPLINK_MAX_LEN];
+  char json[BOOT_INFO_JSON_LEN];
+  for (int i = 0; i < VECTOR_COUNT; i++){
+    const UplinkVector* vector = &uplinkVectors[i];
+    int binaryLength = encodeBinary(vector, payload);
+    int jsonLength = encodeJson(vector, json);
+    CHECK(binaryLength < jsonLength);
+
+    // Each timed over many encodes - the binary has no number formatting, so there's a wide margin
+    struct timespec started;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    for (int n = 0; n < TIMED_ENCODES; n++){
+      encodeBinary(vector, payload);
+    }
+
+    double binaryNanos = nanosSince(&started) / TIMED_ENCODES;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    for (int n = 0; n < TIMED_ENCODES; n++){
+      encodeJson(vector, json);
+    }
+
+    double jsonNanos = nanosSince(&started) / TIMED_ENCODES;
+    CHECK(binaryNanos < jsonNanos);
+    printf("  %-9s %s  binary %3d bytes %6.0f ns, json %3d bytes %6.0f ns\n", vector->type, vector->sessionId ? "session" : "uid    ",
+      binaryLength, binaryNanos, jsonLength, jsonNanos);
+  }
+}
@@ -0,0 +1,146 @@
+/*
+*	Host tests - monotonic millis across the 32 bit wrap, 
+*   SNTP sync & drift correction
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#include "TestHarness.hpp"
+#include "clock/GDoorClock.hpp"
+
+#define TEST_EPOCH_MILLIS 1522963577000ULL
+
+// Completes an SNTP sync with the wall clock at epochMillis
+static void syncAt(uint64_t epochMillis){
+  hostWallTime = epochMillis;
+  hostTimeSyncCallback();
+}
+
+TEST(monotonicCarriesAcrossTheWrap){
+  GDoorClock clock;
+  hostMillis = 0xFFFFFF00UL;
+  clock.begin();
+  uint64_t before = clock.monotonicMillis();
+
+  hostMillis = 0x100;
+  uint64_t after = clock.monotonicMillis();
+  CHECK_EQ(0x1FFULL + 1, after - before);
+  CHECK_EQ((1ULL << 32) | 0x100, after);
+
+  // A second wrap keeps counting
+  hostMillis = 0xFFFFFFF0UL;
+  clock.update();
+  hostMillis = 5;
+  CHECK_EQ((2ULL << 32) | 5, clock.monotonicMillis());
+}
+
+TEST(unsyncedClockReportsZero){
+  GDoorClock clock;
+  hostMillis = 1000;
+  clock.begin();
+  CHECK(!clock.isSynced());
+  CHECK_EQ(0, clock.epochMillis());
+  CHECK_EQ(0, clock.toEpochMillis(500));
+}
+
+TEST(stampsFromBeforeTheSyncConvert){
+  GDoorClock clock;
+  hostMillis = 1000;
+  clock.begin();
+  uint64_t captured = clock.monotonicMillis();
+
+  hostMillis = 4000;
+  syncAt(TEST_EPOCH_MILLIS);
+  CHECK(clock.isSynced());
+  CHECK_EQ(TEST_EPOCH_MILLIS, clock.epochMillis());
+  CHECK_EQ(TEST_EPOCH_MILLIS - 3000, clock.toEpochMillis(captured));
+
+  hostMillis = 5000;
+  CHECK_EQ(TEST_EPOCH_MILLIS + 1000, clock.epochMillis());
+}
+
+TEST(driftMeasuredBetweenSyncsIsCorrected){
+  // The crystal runs 500 ppm slow - real time gains 300 ms every 600 s of millis()
+  GDoorClock clock;
+  hostMillis = 1000;
+  clock.begin();
+  syncAt(TEST_EPOCH_MILLIS);
+
+  hostMillis += 600000;
+  syncAt(TEST_EPOCH_MILLIS + 600300);
+  CHECK_EQ(TEST_EPOCH_MILLIS + 600300, clock.epochMillis());
+
+  hostMillis += 600000;
+  CHECK_EQ(TEST_EPOCH_MILLIS + 1200600, clock.epochMillis());
+}
+
+TEST(driftIgnoredOnShortWindowsAndClamped){
+  GDoorClock clock;
+  hostMillis = 1000;
+  clock.begin();
+  syncAt(TEST_EPOCH_MILLIS);
+
+  // Too soon to estimate - offset moves, no correction going forward
+  hostMillis += 60000;
+  syncAt(TEST_EPOCH_MILLIS + 60100);
+  hostMillis += 600000;
+  CHECK_EQ(TEST_EPOCH_MILLIS + 660100, clock.epochMillis());
+
+  // 2000 ppm is outside the crystal spec - held to CLOCK_MAX_DRIFT_PPM
+  syncAt(TEST_EPOCH_MILLIS + 661300);
+  hostMillis += 600000;
+  CHECK_EQ(TEST_EPOCH_MILLIS + 661300 + 600000 + 600000 * CLOCK_MAX_DRIFT_PPM / 1000000, clock.epochMillis());
+}
+
+TEST(syncSpanningTheWrap){
+  GDoorClock clock;
+  hostMillis = 0xFFFFFFFFUL - 1000;
+  clock.begin();
+  syncAt(TEST_EPOCH_MILLIS);
+
+  hostMillis = 1000;
+  CHECK_EQ(TEST_EPOCH_MILLIS + 2001, clock.epochMillis());
+}
+
+TEST(formatsFullRange){
+  char text[CLOCK_MILLIS_STR_LEN];
+  CHECK_EQ(1, GDoorClock::formatMillis(0, text));
+  CHECK_STR("0", text);
+  CHECK_EQ(13, GDoorClock::formatMillis(TEST_EPOCH_MILLIS, text));
+  CHECK_STR("1522963577000", text);
+  CHECK_EQ(20, GDoorClock::formatMillis(0xFFFFFFFFFFFFFFFFULL, text));
+  CHECK_STR("18446744073709551615", text);
+}
+
+TEST(fallbackTimeSources){
+  uint32_t secs = 0;
+  CHECK(GDoorClock::parseHttpDate("Thu, 05 Apr 2018 21:26:17 GMT", &secs));
+  CHECK_EQ((uint32_t)(TEST_EPOCH_MILLIS / 1000), secs);
+  CHECK(GDoorClock::parseHttpDate("Sun, 06 Nov 1994 08:49:37 GMT", &secs));
+  CHECK_EQ((uint32_t)784111777, secs);
+  CHECK(GDoorClock::parseHttpDate("Tue, 29 Feb 2000 00:00:00 GMT", &secs));
+  CHECK_EQ((uint32_t)951782400, secs);
+  CHECK(GDoorClock::parseHttpDate("Wed, 31 Dec 2025 23:59:59 GMT", &secs));
+  CHECK_EQ((uint32_t)1767225599, secs);
+
+  // __DATE__ pads single digit days with a space
+  CHECK(GDoorClock::parseBuildStamp("Apr  5 2018", "21:26:17", &secs));
+  CHECK_EQ((uint32_t)(TEST_EPOCH_MILLIS / 1000), secs);
+  CHECK(GDoorClock::parseBuildStamp(__DATE__, __TIME__, &secs));
+  CHECK(secs > (uint32_t)(TEST_EPOCH_MILLIS / 1000));
+}
+
+TEST(fallbackTimeRejectsGarbage){
+  uint32_t secs = 7;
+  CHECK(!GDoorClock::parseHttpDate("", &secs));
+  CHECK(!GDoorClock::parseHttpDate("05 Apr 2018 21:26:17 GMT", &secs));
+  CHECK(!GDoorClock::parseHttpDate("Thu, 05 Foo 2018 21:26:17 GMT", &secs));
+  CHECK(!GDoorClock::parseHttpDate("Thu, 05 anF 2018 21:26:17 GMT", &secs));
+  CHECK(!GDoorClock::parseHttpDate("Thu, 05 Apr 2018 24:00:00 GMT", &secs));
+  CHECK(!GDoorClock::parseHttpDate("Thu, 05 Apr 2018 21:26:17 PST", &secs));
+  CHECK(!GDoorClock::parseHttpDate("Thu, 05 Apr 1969 21:26:17 GMT", &secs));
+  CHECK(!GDoorClock::parseBuildStamp("Apr  5", "21:26:17", &secs));
+  CHECK_EQ((uint32_t)7, secs);
+}
@@ -0,0 +1,203 @@
+/*
+*	Host tests - door sampling, debounce & relay pulses
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#include "TestHarness.hpp"
+#include "digital-io/GDoorIO.hpp"
+
+#define SENSOR_PIN 14
+#define RELAY_PIN 4
+
+// One sample per call - moves the clock a full interval first
+static int sample(GDoorIO* io, int level){
+  hostPinLevels[SENSOR_PIN] = level;
+  hostMillis += io->channels[0].debounceInterval;
+  return io->sampleDoorStates();
+}
+
+static void openDoor(GDoorIO* io){
+  hostMillis = 1000;
+  sample(io, HIGH);
+}
+
+TEST(highSampleOpensImmediately){
+  GDoorIO io;
+  openDoor(&io);
+  CHECK_EQ(DOOR_STATE_OPEN, io.doorState(0));
+}
+
+TEST(closesAfterFullDebounceWindow){
+  GDoorIO io;
+  openDoor(&io);
+  for (int i = 0; i < 9; i++){
+    CHECK_EQ(0, sample(&io, LOW));
+  }
+
+  CHECK_EQ(DOOR_STATE_OPEN, io.doorState(0));
+  CHECK_EQ(1, sample(&io, LOW));
+  CHECK_EQ(DOOR_STATE_CLOSED, io.doorState(0));
+}
+
+TEST(bounceRestartsTheWindow){
+  GDoorIO io;
+  openDoor(&io);
+  for (int i = 0; i < 9; i++){
+    sample(&io, LOW);
+  }
+
+  sample(&io, HIGH);
+  for (int i = 0; i < 9; i++){
+    sample(&io, LOW);
+  }
+
+  CHECK_EQ(DOOR_STATE_OPEN, io.doorState(0));
+  sample(&io, LOW);
+  CHECK_EQ(DOOR_STATE_CLOSED, io.doorState(0));
+}
+
+TEST(samplesOnlyWhenIntervalDue){
+  GDoorIO io;
+  openDoor(&io);
+  hostPinLevels[SENSOR_PIN] = LOW;
+  for (int i = 0; i < 50; i++){
+    hostMillis += 1;
+    io.sampleDoorStates();
+  }
+
+  // 50ms at a 100ms interval - no more than one sample taken
+  CHECK(io.channels[0].lowSamples <= 1);
+}
+
+TEST(loweringDebounceMidWindowStillTrips){
+  GDoorIO io;
+  openDoor(&io);
+  for (int i = 0; i < 8; i++){
+    sample(&io, LOW);
+  }
+
+  // Settings pushed live while the count is past the new window
+  io.setDebounce(0, 5, 100);
+  CHECK_EQ(5, io.channels[0].lowSamples);
+  CHECK_EQ(1, sample(&io, LOW));
+  CHECK_EQ(DOOR_STATE_CLOSED, io.doorState(0));
+}
+
+TEST(countPastWindowTripsWithoutSetter){
+  GDoorIO io;
+  openDoor(&io);
+  for (int i = 0; i < 8; i++){
+    sample(&io, LOW);
+  }
+
+  io.channels[0].debounceSamples = 3;
+  sample(&io, LOW);
+  CHECK_EQ(DOOR_STATE_CLOSED, io.doorState(0));
+}
+
+TEST(relayPulseReleasedByTimer){
+  GDoorIO io;
+  io.actuateDoor(0);
+  CHECK_EQ(HIGH, hostPinLevels[RELAY_PIN]);
+  CHECK(io.channels[0].pulseActive);
+  CHECK_EQ((uint32_t)1500, io.channels[0].pulseTimer.armedInterval());
+
+  // Second actuation while the pulse is running is ignored
+  io.actuateDoor(0);
+  io.channels[0].pulseTimer.fire();
+  CHECK_EQ(LOW, hostPinLevels[RELAY_PIN]);
+  CHECK(!io.channels[0].pulseActive);
+}
+
+TEST(overduePulseReleasedByBackstop){
+  GDoorIO io;
+  hostMillis = 5000;
+  io.actuateDoor(0);
+  hostMillis += 1500 + 1000;
+  CHECK_EQ(0, io.releaseOverduePulses(1000));
+  hostMillis += 1;
+  CHECK_EQ(1, io.releaseOverduePulses(1000));
+  CHECK_EQ(LOW, hostPinLevels[RELAY_PIN]);
+  CHECK(!io.channels[0].pulseTimer.active());
+}
+
+TEST(unknownChannelIgnored){
+  GDoorIO io;
+  io.actuateDoor(1);
+  io.actuateDoor(-1);
+  CHECK(!io.channels[0].pulseActive);
+  CHECK(!io.channels[1].pulseActive);
+}
+
+/*
+ *  Second channel - pins 12 (sensor) & 13 (relay) when enabled
+ *
+*/
+
+#define SECOND_SENSOR_PIN 12
+#define SECOND_RELAY_PIN 13
+
+TEST(channelsDebounceIndependently){
+  GDoorIO io;
+  io.setChannelCount(2);
+  hostMillis = 1000;
+  hostPinLevels[SENSOR_PIN] = HIGH;
+  hostPinLevels[SECOND_SENSOR_PIN] = LOW;
+  CHECK_EQ(1, io.sampleDoorStates() & 1);
+
+  // Channel 0 opened at once, channel 1 needs its full window to read closed again
+  io.setDebounce(1, 3, 100);
+  hostPinLevels[SECOND_SENSOR_PIN] = HIGH;
+  hostMillis += 100;
+  CHECK_EQ(2, io.sampleDoorStates());
+  CHECK_EQ(DOOR_STATE_OPEN, io.doorState(1));
+
+  hostPinLevels[SECOND_SENSOR_PIN] = LOW;
+  int changed = 0;
+  for (int i = 0; i < 3; i++){
+    hostMillis += 100;
+    changed |= io.sampleDoorStates();
+  }
+
+  CHECK_EQ(2, changed);
+  CHECK_EQ(DOOR_STATE_CLOSED, io.doorState(1));
+  CHECK_EQ(DOOR_STATE_OPEN, io.doorState(0));
+}
+
+TEST(channelsPulseTheirOwnRelay){
+  GDoorIO io;
+  io.setChannelCount(2);
+  hostPinLevels[RELAY_PIN] = LOW;
+  hostPinLevels[SECOND_RELAY_PIN] = LOW;
+  io.channels[1].pulseLength = 400;
+
+  io.actuateDoor(1);
+  CHECK_EQ(LOW, hostPinLevels[RELAY_PIN]);
+  CHECK_EQ(HIGH, hostPinLevels[SECOND_RELAY_PIN]);
+  CHECK_EQ((uint32_t)400, io.channels[1].pulseTimer.armedInterval());
+
+  // Both can run at once
+  io.actuateDoor(0);
+  CHECK_EQ(HIGH, hostPinLevels[RELAY_PIN]);
+  io.channels[1].pulseTimer.fire();
+  CHECK_EQ(LOW, hostPinLevels[SECOND_RELAY_PIN]);
+  CHECK_EQ(HIGH, hostPinLevels[RELAY_PIN]);
+  CHECK(io.channels[0].pulseActive);
+}
+
+TEST(channelCountRefusedPastTheTable){
+  GDoorIO io;
+  CHECK(!io.setChannelCount(0));
+  CHECK(!io.setChannelCount(MAX_DOOR_CHANNELS + 1));
+  CHECK_EQ(1, io.channelCount);
+
+  // Unwired channels can't be driven
+  io.actuateDoor(1);
+  CHECK(!io.channels[1].pulseActive);
+  CHECK(io.setChannelCount(2));
+  io.actuateDoor(1);
+  CHECK(io.channels[1].pulseActive);
+}
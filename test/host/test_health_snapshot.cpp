@@ -0,0 +1,50 @@
+/*
+*	Host tests - health snapshot rendering & cache
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#include "TestHarness.hpp"
+#include "diagnostics/HealthSnapshot.hpp"
+
+static void setUp(GDoorHealthSnapshot* snapshot){
+  snapshot->begin("1.0.0", 2);
+  snapshot->setDoorState(0, DOOR_STATE_OPEN);
+  snapshot->setDoorState(1, DOOR_STATE_CLOSED);
+  snapshot->setConnection(1522963577000ULL, 4210);
+  snapshot->setRssi(-61);
+  snapshot->setQueueDepth(0);
+}
+
+TEST(rendersEveryField){
+  GDoorHealthSnapshot snapshot;
+  setUp(&snapshot);
+  snapshot.setFreeHeap(30512);
+
+  char json[HEALTH_SNAPSHOT_JSON_LEN + CLOCK_MILLIS_STR_LEN + 16];
+  int length = snapshot.toJson(86400000, json);
+  CHECK_STR("{\"uptime\":\"86400000\",\"fw\":\"1.0.0\",\"doorStates\":[\"00\",\"01\"],"
+    "\"connectedAt\":\"1522963577000\",\"connectedUptime\":\"4210\",\"rssi\":-61,\"freeHeap\":30464,\"queueDepth\":0}", json);
+  CHECK_EQ((int)strlen(json), length);
+}
+
+TEST(heapJitterKeepsTheCachedBody){
+  GDoorHealthSnapshot snapshot;
+  setUp(&snapshot);
+  snapshot.setFreeHeap(30464);
+
+  char before[HEALTH_SNAPSHOT_JSON_LEN + CLOCK_MILLIS_STR_LEN + 16];
+  char after[sizeof(before)];
+  snapshot.toJson(1000, before);
+
+  // Anywhere in the same 256 byte step reads the same
+  snapshot.setFreeHeap(30464 + HEALTH_SNAPSHOT_HEAP_QUANTUM - 1);
+  snapshot.toJson(1000, after);
+  CHECK(strcmp(before, after) == 0);
+
+  snapshot.setFreeHeap(30464 - 1);
+  snapshot.toJson(1000, after);
+  CHECK(strstr(after, "\"freeHeap\":30208,") != NULL);
+}
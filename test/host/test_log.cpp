@@ -0,0 +1,44 @@
+/*
+*	Host tests - every catalogue message formatted on the 
+*   device matches tools/decode_log.py
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#include "TestHarness.hpp"
+#include "logging/GDoorLog.hpp"
+
+#include "LogVectors.h"
+
+#define VECTOR_COUNT (int)(sizeof(logVectors) / sizeof(logVectors[0]))
+
+TEST(catalogueMatchesTheDecoder){
+  CHECK_EQ(LOG_MESSAGE_COUNT, VECTOR_COUNT);
+
+  hostMillis = 1000;
+  char expected[256];
+  for (int id = 0; id < VECTOR_COUNT && id < LOG_MESSAGE_COUNT; id++){
+    Serial.clear();
+    gdoorLog.write(LOG_LEVEL_INFO, id, logVectorArgs[0], logVectorArgs[1], logVectorArgs[2], logVectorArgs[3]);
+    gdoorLog.drain(Serial, 1);
+
+    snprintf(expected, sizeof(expected), "1000 I %s\r\n", logVectors[id]);
+    if (strcmp(expected, Serial.output) != 0){
+      printf("  message %d: device \"%s\", decoder \"%s\"\n", id, Serial.output, expected);
+      CHECK(strcmp(expected, Serial.output) == 0);
+    }
+  }
+}
+
+TEST(negativeArgsDecodeSigned){
+  // LOG_HTTP_RESPONSE carries HTTPClient's negative transport errors as %d
+  hostMillis = 2000;
+  Serial.clear();
+  gdoorLog.write(LOG_LEVEL_WARN, LOG_HTTP_RESPONSE, (uint32_t)-1, 0);
+  gdoorLog.drain(Serial, 1);
+
+  CHECK_STR("2000 W HTTP INTERFACE: Received response to HTTP POST -1 (0 bytes)\r\n", Serial.output);
+  CHECK_STR("HTTP INTERFACE: Received response to HTTP POST -123 (4294967295 bytes)", logVectors[LOG_HTTP_RESPONSE]);
+}
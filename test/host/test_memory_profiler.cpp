@@ -0,0 +1,85 @@
+/*
+*	Host tests - per site heap attribution, the low water 
+*   mark & the report size
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#include "TestHarness.hpp"
+#include "diagnostics/MemoryProfiler.hpp"
+
+static void setUp(GDoorMemoryProfiler* profiler){
+  hostFreeHeap = 40000;
+  profiler->begin();
+}
+
+TEST(heapChargedToTheSiteThatKeptIt){
+  GDoorMemoryProfiler profiler;
+  setUp(&profiler);
+  profiler.enter(SUPERVISOR_STAGE_CLOCK);
+  hostFreeHeap -= 1000;
+  profiler.enter(SUPERVISOR_STAGE_UPLOAD);
+  hostFreeHeap += 400;
+  profiler.enter(SUPERVISOR_STAGE_CLOCK);
+  hostFreeHeap -= 200;
+  profiler.enter(SUPERVISOR_STAGE_LOG_DRAIN);
+
+  char json[MEMORY_REPORT_JSON_LEN];
+  profiler.toJson(json);
+  CHECK(strstr(json, "\"boot\":{\"calls\":1,\"retained\":0,\"worst\":0}") != NULL);
+  CHECK(strstr(json, "\"clock\":{\"calls\":2,\"retained\":1200,\"worst\":1000}") != NULL);
+  CHECK(strstr(json, "\"upload\":{\"calls\":1,\"retained\":-400,\"worst\":0}") != NULL);
+  CHECK(strstr(json, "\"logDrain\":{\"calls\":0,") != NULL);
+}
+
+TEST(lowWaterMarkKeptBetweenSnapshots){
+  GDoorMemoryProfiler profiler;
+  setUp(&profiler);
+  profiler.enter(SUPERVISOR_STAGE_UPLOAD);
+  hostFreeHeap = 18000;
+  profiler.enter(SUPERVISOR_STAGE_LOG_DRAIN);
+  hostFreeHeap = 39000;
+  profiler.enter(SUPERVISOR_STAGE_CLOCK);
+
+  MemorySnapshot snapshot;
+  profiler.snapshot(&snapshot);
+  CHECK_EQ((uint32_t)39000, snapshot.freeHeap);
+  CHECK_EQ((uint32_t)18000, snapshot.minFreeHeap);
+  CHECK_EQ(hostMaxFreeBlock, snapshot.maxFreeBlock);
+  CHECK_EQ(hostHeapFragmentation, snapshot.fragmentation);
+
+  // A dip since the last site change still counts
+  hostFreeHeap = 12000;
+  profiler.snapshot(&snapshot);
+  CHECK_EQ((uint32_t)12000, snapshot.minFreeHeap);
+}
+
+TEST(reportFitsAtTheWidestValues){
+  // Every counter at its longest rendering - 10 digit heap figures, 11 character retains
+  GDoorMemoryProfiler profiler;
+  hostFreeHeap = 0x80000001;
+  profiler.begin();
+  for (int site = 0; site < MEMORY_SITE_COUNT; site++){
+    hostFreeHeap = 0;
+    profiler.enter((site + 1) % MEMORY_SITE_COUNT);
+    hostFreeHeap = 0x80000001;
+    profiler.enter(site);
+  }
+
+  hostFreeHeap = 4294967295UL;
+  hostMaxFreeBlock = 4294967295UL;
+  hostHeapFragmentation = 4294967295UL;
+  hostFreeContStack = 4294967295UL;
+
+  char json[MEMORY_REPORT_JSON_LEN + 64];
+  int length = profiler.toJson(json);
+  CHECK_EQ(length, (int)strlen(json));
+  CHECK(length < MEMORY_REPORT_JSON_LEN);
+  CHECK(strstr(json, "\"retained\":-2147483647") != NULL);
+
+  hostMaxFreeBlock = 32000;
+  hostHeapFragmentation = 5;
+  hostFreeContStack = 2048;
+}
@@ -0,0 +1,291 @@
+/*
+*	Host tests - signed request verification, replay cache, 
+*   provisioning & rotation
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#include "TestHarness.hpp"
+#include "security/RequestAuth.hpp"
+
+typedef struct signVector {
+  const char* method;
+  const char* path;
+  const char* query;
+  int argCount;
+  const char* names[4];
+  const char* values[4];
+  const char* nonce;
+  uint32_t timestampSecs;
+  const char* timestamp;
+  const char* signature;
+} SignVector;
+
+#include "SignVectors.h"
+
+#define TEST_UID "T3stUid000000000000000000001"
+#define TEST_SECRET "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f"
+#define TEST_EPOCH_SECS 1522963577UL
+
+/*
+ *  Fixture - a device whose clock synced at TEST_EPOCH_SECS, 
+ *  enforcing unless built without a secret
+ *
+*/
+
+typedef struct fixture {
+  GDoorUser user;
+  GDoorClock clock;
+  GDoorRequestAuth auth;
+} Fixture;
+
+static void setUp(Fixture* fixture, bool withSecret){
+  hostMillis = 1000;
+  EEPROM.erase();
+  strcpy(fixture->user.uid, TEST_UID);
+  strcpy(fixture->user.ssid, "ssid");
+  strcpy(fixture->user.password, "password");
+  if (withSecret){
+    fixture->user.setDeviceSecret(TEST_SECRET);
+  }
+
+  fixture->clock.begin();
+  hostWallTime = (uint64_t)TEST_EPOCH_SECS * 1000;
+  hostTimeSyncCallback();
+  fixture->auth.begin(&fixture->user, &fixture->clock);
+}
+
+static void advanceSecs(uint32_t secs){
+  hostMillis += secs * 1000;
+  hostWallTime += (uint64_t)secs * 1000;
+}
+
+static void sign(const char* secret, const char* method, const char* path, const char* query, const char* nonce, const char* timestamp, char* signature){
+  uint8_t key[AUTH_KEY_LEN];
+  GDoorRequestAuth::decodeHex(secret, key, AUTH_KEY_LEN);
+
+  br_hmac_key_context keyContext;
+  br_hmac_context context;
+  uint8_t mac[AUTH_MAC_LEN];
+  br_hmac_key_init(&keyContext, &br_sha256_vtable, key, AUTH_KEY_LEN);
+  br_hmac_init(&context, &keyContext, AUTH_MAC_LEN);
+  const char* lines[5] = { method, path, query, nonce, timestamp };
+  for (int i = 0; i < 5; i++){
+    if (i > 0){
+      br_hmac_update(&context, "\n", 1);
+    }
+    br_hmac_update(&context, lines[i], strlen(lines[i]));
+  }
+  br_hmac_out(&context, mac);
+
+  for (int i = 0; i < AUTH_MAC_LEN; i++){
+    sprintf(&signature[i * 2], "%02x", mac[i]);
+  }
+}
+
+// Signed with secret at the device's current time plus offsetSecs
+static AuthResult requestWith(Fixture* fixture, const char* secret, const char* query, uint32_t nonceValue, int32_t offsetSecs){
+  char nonce[AUTH_NONCE_HEX_LEN + 1];
+  char timestamp[12];
+  char signature[AUTH_SIGNATURE_HEX_LEN + 1];
+  sprintf(nonce, "%016x", nonceValue);
+  sprintf(timestamp, "%u", (uint32_t)(hostWallTime / 1000) + offsetSecs);
+  sign(secret, "GET", "/" TEST_UID "/Settings", query, nonce, timestamp, signature);
+  return fixture->auth.verify("GET", "/" TEST_UID "/Settings", query, nonce, timestamp, signature);
+}
+
+static AuthResult request(Fixture* fixture, const char* query, uint32_t nonceValue, int32_t offsetSecs){
+  return requestWith(fixture, TEST_SECRET, query, nonceValue, offsetSecs);
+}
+
+/*
+ *  Signatures - cross checked against tools/sign_request.py
+ *
+*/
+
+TEST(canonicalQueryMatchesSigningTool){
+  for (unsigned v = 0; v < sizeof(signVectors) / sizeof(signVectors[0]); v++){
+    char query[AUTH_QUERY_MAX_LEN];
+    int length = 0;
+    query[0] = 0;
+    for (int i = 0; i < signVectors[v].argCount; i++){
+      CHECK(GDoorRequestAuth::appendQueryParam(query, &length, sizeof(query), signVectors[v].names[i], signVectors[v].values[i]));
+    }
+
+    CHECK(strcmp(signVectors[v].query, query) == 0);
+    CHECK_EQ((int)strlen(query), length);
+  }
+}
+
+TEST(signaturesMatchSigningTool){
+  for (unsigned v = 0; v < sizeof(signVectors) / sizeof(signVectors[0]); v++){
+    const SignVector* vector = &signVectors[v];
+    Fixture fixture;
+    setUp(&fixture, true);
+    hostWallTime = (uint64_t)vector->timestampSecs * 1000;
+
+    CHECK(fixture.auth.verifySignature(vector->method, vector->path, vector->query, vector->nonce, vector->timestamp, vector->signature));
+    CHECK(!fixture.auth.verifySignature(vector->method, vector->path, "tampered=1", vector->nonce, vector->timestamp, vector->signature));
+    CHECK_EQ(AUTH_OK, fixture.auth.verify(vector->method, vector->path, vector->query, vector->nonce, vector->timestamp, vector->signature));
+  }
+}
+
+TEST(rewrittenArgumentsFailVerification){
+  Fixture fixture;
+  setUp(&fixture, true);
+  char signature[AUTH_SIGNATURE_HEX_LEN + 1];
+  char timestamp[12];
+  sprintf(timestamp, "%u", (uint32_t)TEST_EPOCH_SECS);
+  sign(TEST_SECRET, "GET", "/" TEST_UID "/Settings", "pulseLength=400", "0000000000000001", timestamp, signature);
+
+  CHECK_EQ(AUTH_BAD_SIGNATURE, fixture.auth.verify("GET", "/" TEST_UID "/Settings", "pulseLength=4000", "0000000000000001", timestamp, signature));
+  CHECK_EQ(AUTH_OK, fixture.auth.verify("GET", "/" TEST_UID "/Settings", "pulseLength=400", "0000000000000001", timestamp, signature));
+}
+
+TEST(queryOverflowIsRejected){
+  char query[16];
+  int length = 0;
+  CHECK(GDoorRequestAuth::appendQueryParam(query, &length, sizeof(query), "a", "12345"));
+  CHECK(!GDoorRequestAuth::appendQueryParam(query, &length, sizeof(query), "b", "1234567"));
+  CHECK_STR("a=12345", query);
+
+  Fixture fixture;
+  setUp(&fixture, true);
+  CHECK_EQ(AUTH_MALFORMED, fixture.auth.verify("GET", "/x", NULL, "0000000000000001", "1522963577", TEST_SECRET));
+}
+
+/*
+ *  Freshness & replay
+ *
+*/
+
+TEST(skewWindow){
+  Fixture fixture;
+  setUp(&fixture, true);
+  CHECK_EQ(AUTH_OK, request(&fixture, "", 1, -AUTH_MAX_SKEW_SECS));
+  CHECK_EQ(AUTH_OK, request(&fixture, "", 2, AUTH_MAX_SKEW_SECS));
+  CHECK_EQ(AUTH_STALE, request(&fixture, "", 3, -AUTH_MAX_SKEW_SECS - 1));
+  CHECK_EQ(AUTH_STALE, request(&fixture, "", 4, AUTH_MAX_SKEW_SECS + 1));
+}
+
+TEST(unsyncedClockRejects){
+  Fixture fixture;
+  setUp(&fixture, true);
+  GDoorClock unsynced;
+  GDoorRequestAuth auth;
+  auth.begin(&fixture.user, &unsynced);
+  CHECK_EQ(AUTH_CLOCK_UNSYNCED, auth.verify("GET", "/x", "", "0000000000000001", "1522963577", TEST_SECRET));
+}
+
+TEST(replayedNonceRejected){
+  Fixture fixture;
+  setUp(&fixture, true);
+  CHECK_EQ(AUTH_OK, request(&fixture, "", 42, 0));
+  CHECK_EQ(AUTH_REPLAY, request(&fixture, "", 42, 0));
+  advanceSecs(AUTH_MAX_SKEW_SECS);
+  CHECK_EQ(AUTH_REPLAY, request(&fixture, "", 42, -AUTH_MAX_SKEW_SECS));
+}
+
+TEST(laggingClientNotLockedOut){
+  // One client's traffic used to push the eviction floor past a second client's clock
+  Fixture fixture;
+  setUp(&fixture, true);
+  for (uint32_t i = 0; i < AUTH_NONCE_CACHE_LEN / 2; i++){
+    CHECK_EQ(AUTH_OK, request(&fixture, "", 1000 + i, 0));
+    advanceSecs(5);
+  }
+
+  CHECK_EQ(AUTH_OK, request(&fixture, "", 2000, -200));
+}
+
+TEST(fullCacheIsBusyNotLocked){
+  Fixture fixture;
+  setUp(&fixture, true);
+  for (uint32_t i = 0; i < AUTH_NONCE_CACHE_LEN; i++){
+    CHECK_EQ(AUTH_OK, request(&fixture, "", 1000 + i, 0));
+  }
+
+  CHECK_EQ(AUTH_BUSY, request(&fixture, "", 5000, 0));
+
+  // Slots free up once their timestamps leave the window - every nonce is still covered
+  advanceSecs(AUTH_MAX_SKEW_SECS + 1);
+  CHECK_EQ(AUTH_OK, request(&fixture, "", 5000, 0));
+  CHECK_EQ(AUTH_REPLAY, request(&fixture, "", 5000, 0));
+}
+
+/*
+ *  Legacy devices, cloud provisioning & rotation
+ *
+*/
+
+TEST(legacyPassesUntilProvisioned){
+  Fixture fixture;
+  setUp(&fixture, false);
+  CHECK(!fixture.auth.isEnforcing());
+  CHECK_EQ(AUTH_LEGACY, fixture.auth.verify("GET", "/x", "", "", "", ""));
+  CHECK_EQ(AUTH_LEGACY, request(&fixture, "", 1, 0));
+
+  // Nothing a LAN client knows can install a secret
+  uint8_t key[AUTH_KEY_LEN];
+  CHECK_EQ(0, GDoorRequestAuth::deviceKey(&fixture.user, key));
+  CHECK(!fixture.auth.rotate(&fixture.user, "0123456789abcdef", TEST_SECRET));
+  CHECK(!fixture.user.hasDeviceSecret);
+}
+
+TEST(cloudProvisionsSecret){
+  Fixture fixture;
+  setUp(&fixture, false);
+  CHECK(fixture.auth.provision(&fixture.user, "{\"sessionId\":7,\"deviceSecret\":\"" TEST_SECRET "\"}"));
+  CHECK(fixture.auth.isEnforcing());
+  CHECK_EQ(AUTH_MISSING_HEADERS, fixture.auth.verify("GET", "/x", "", "", "", ""));
+  CHECK_EQ(AUTH_OK, request(&fixture, "", 1, 0));
+
+  // Survives a reboot
+  GDoorUser reloaded;
+  CHECK(reloaded.loadUserData());
+  CHECK(reloaded.hasDeviceSecret);
+  CHECK_STR(TEST_SECRET, reloaded.deviceSecret);
+  CHECK_STR(TEST_UID, reloaded.uid);
+
+  // First secret only - later responses can't replace it
+  CHECK(!fixture.auth.provision(&fixture.user, "{\"deviceSecret\":\"ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff\"}"));
+  CHECK_STR(TEST_SECRET, fixture.user.deviceSecret);
+}
+
+TEST(provisioningRefusals){
+  Fixture fixture;
+  setUp(&fixture, false);
+  CHECK(!fixture.auth.provision(&fixture.user, ""));
+  CHECK(!fixture.auth.provision(&fixture.user, "{\"sessionId\":7}"));
+  CHECK(!fixture.auth.provision(&fixture.user, "{\"deviceSecret\":\"not hex\"}"));
+  CHECK(!fixture.auth.provision(&fixture.user, "{\"deviceSecret\":\"000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e\"}"));
+  CHECK(!fixture.auth.provision(&fixture.user, "{\"deviceSecret\":\"" TEST_SECRET "00\"}"));
+  CHECK(!fixture.auth.provision(&fixture.user, "{\"deviceSecret\":\"" TEST_SECRET));
+  CHECK(!fixture.auth.isEnforcing());
+  CHECK(!fixture.user.hasDeviceSecret);
+}
+
+TEST(rotationUnwrapsSigningToolSecret){
+  const SignVector* vector = &signVectors[sizeof(signVectors) / sizeof(signVectors[0]) - 1];
+  CHECK_STR("secret", vector->names[0]);
+
+  Fixture fixture;
+  setUp(&fixture, true);
+  hostWallTime = (uint64_t)vector->timestampSecs * 1000;
+  CHECK_EQ(AUTH_OK, fixture.auth.verify(vector->method, vector->path, vector->query, vector->nonce, vector->timestamp, vector->signature));
+  CHECK(fixture.auth.rotate(&fixture.user, vector->nonce, vector->values[0]));
+  CHECK(strcmp(rotatedSecret, fixture.user.deviceSecret) == 0);
+
+  // The old secret stops working, the new one is persisted
+  CHECK_EQ(AUTH_BAD_SIGNATURE, request(&fixture, "", 1, 0));
+  CHECK_EQ(AUTH_OK, requestWith(&fixture, rotatedSecret, "", 2, 0));
+  GDoorUser reloaded;
+  CHECK(reloaded.loadUserData());
+  CHECK(strcmp(rotatedSecret, reloaded.deviceSecret) == 0);
+
+  // The captured request can't be replayed - its signature was made with the old secret
+  CHECK_EQ(AUTH_BAD_SIGNATURE, fixture.auth.verify(vector->method, vector->path, vector->query, vector->nonce, vector->timestamp, vector->signature));
+  CHECK(!fixture.auth.rotate(&fixture.user, vector->nonce, "4b1d"));
+}
@@ -0,0 +1,260 @@
+/*
+*	Host tests - the rule engine runs what tools/compile_rules.py
+*   emits: encoding, validation, deadlines & persistence
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#include "TestHarness.hpp"
+#include "rules/GDoorRules.hpp"
+
+typedef struct ruleVector {
+  const char* source;             // compile_rules.py input
+  const char* program;            // Its output
+  int count;
+} RuleVector;
+
+#include "RuleVectors.h"
+
+#define VECTOR_COUNT (int)(sizeof(ruleVectors) / sizeof(ruleVectors[0]))
+#define MIDNIGHT_MILLIS 1522886400000ULL  // 2018-04-05 00:00:00 UTC
+
+static GDoorIO io;
+static GDoorClock deviceClock;
+
+static const char* compiled(const char* source){
+  for (int i = 0; i < VECTOR_COUNT; i++){
+    if (strcmp(ruleVectors[i].source, source) == 0){
+      return ruleVectors[i].program;
+    }
+  }
+
+  printf("  no vector for \"%s\" - add it to gen_vectors.py\n", source);
+  return "";
+}
+
+static void setUp(GDoorRules* rules){
+  io = GDoorIO();
+  io.channelCount = 2;
+  deviceClock = GDoorClock();
+  deviceClock.begin();
+  hostMillis = 1000;
+  EEPROM.erase();
+  rules->begin(&io, &deviceClock);
+}
+
+static void syncAt(uint64_t epochMillis){
+  hostWallTime = epochMillis;
+  hostTimeSyncCallback();
+}
+
+static void setDoor(GDoorRules* rules, int channel, DoorState state){
+  io.channels[channel].state = state;
+  rules->onDoorState(channel, state, deviceClock.monotonicMillis());
+}
+
+// Whether the relay was pulsed since the last call - releases it for the next
+static bool pulsed(int channel){
+  bool active = io.channels[channel].pulseActive;
+  io.channels[channel].pulseActive = false;
+  hostPinLevels[io.channels[channel].relayPin] = LOW;
+  return active;
+}
+
+static void tickAt(GDoorRules* rules, uint32_t millis){
+  hostMillis = millis;
+  rules->tick(deviceClock.monotonicMillis());
+}
+
+TEST(compiledProgramsLoadAndEcho){
+  char json[RULES_JSON_LEN];
+  char expected[RULES_JSON_LEN];
+  for (int i = 0; i < VECTOR_COUNT; i++){
+    GDoorRules rules;
+    setUp(&rules);
+    if (rules.loadProgram(ruleVectors[i].program) != RULES_OK){
+      printf("  rejected \"%s\"\n", ruleVectors[i].source);
+      CHECK(false);
+      continue;
+    }
+
+    CHECK_EQ(ruleVectors[i].count, rules.ruleCount());
+    rules.toJson(json);
+    snprintf(expected, sizeof(expected), "{\"program\":\"%s\",", ruleVectors[i].program);
+    CHECK(strncmp(expected, json, strlen(expected)) == 0);
+  }
+}
+
+TEST(autoCloseFiresAfterCompiledDelay){
+  GDoorRules rules;
+  setUp(&rules);
+  CHECK_EQ(RULES_OK, rules.loadProgram(compiled("autoclose 0 after 10m")));
+  setDoor(&rules, 0, DOOR_STATE_OPEN);
+
+  tickAt(&rules, 1000 + 599999);
+  CHECK(!pulsed(0));
+  tickAt(&rules, 1000 + 600000);
+  CHECK(pulsed(0));
+
+  // Once per opening
+  tickAt(&rules, 1000 + 1200000);
+  CHECK(!pulsed(0));
+}
+
+TEST(closingDisarmsAutoClose){
+  GDoorRules rules;
+  setUp(&rules);
+  rules.loadProgram(compiled("autoclose 0 after 10m"));
+  setDoor(&rules, 0, DOOR_STATE_OPEN);
+  hostMillis = 300000;
+  setDoor(&rules, 0, DOOR_STATE_CLOSED);
+
+  tickAt(&rules, 1000 + 600000);
+  CHECK(!pulsed(0));
+}
+
+TEST(autoCloseDeferredWhilePresent){
+  GDoorRules rules;
+  setUp(&rules);
+  rules.loadProgram(compiled("autoclose 1 after 90s unless-present 15"));
+  setDoor(&rules, 1, DOOR_STATE_OPEN);
+  hostMillis = 60000;
+  rules.notePresence(deviceClock.monotonicMillis());
+
+  tickAt(&rules, 1000 + 90000);
+  CHECK(!pulsed(1));
+
+  // Retried once the 15 minute window from the last command has passed
+  tickAt(&rules, 60000 + 900000 - 1);
+  CHECK(!pulsed(1));
+  tickAt(&rules, 60000 + 900000);
+  CHECK(pulsed(1));
+  CHECK(!pulsed(0));
+}
+
+TEST(scheduleWaitsForClockThenFiresAtTimeOfDay){
+  GDoorRules rules;
+  setUp(&rules);
+  rules.loadProgram(compiled("schedule 0 at 22:00 if-open"));
+  setDoor(&rules, 0, DOOR_STATE_OPEN);
+
+  tickAt(&rules, 5000);
+  CHECK(!pulsed(0));
+
+  // 21:00:00.500 - an hour less the half second to go
+  hostMillis = 10000;
+  syncAt(MIDNIGHT_MILLIS + (21 * 3600 * 1000UL) + 500);
+  tickAt(&rules, 10000);
+  tickAt(&rules, 10000 + 3599499);
+  CHECK(!pulsed(0));
+  tickAt(&rules, 10000 + 3599500);
+  CHECK(pulsed(0));
+
+  // Re-armed for the same time tomorrow
+  char json[RULES_JSON_LEN];
+  rules.toJson(json);
+  CHECK(strstr(json, "\"armed\":[86400]") != NULL);
+}
+
+TEST(scheduleConditionsChecked){
+  GDoorRules rules;
+  setUp(&rules);
+  syncAt(MIDNIGHT_MILLIS + 1000);
+  rules.loadProgram(compiled("autoclose 0 after 10s; schedule 0 at 00:00 if-closed"));
+
+  // Midnight tomorrow finds the door open - no pulse, the auto-close does the work
+  setDoor(&rules, 0, DOOR_STATE_OPEN);
+  tickAt(&rules, 1000 + 10000);
+  CHECK(pulsed(0));
+  tickAt(&rules, 1000 + 86399000);
+  CHECK(!pulsed(0));
+}
+
+TEST(deviceRejectsWhatTheCompilerRefuses){
+  GDoorRules rules;
+  setUp(&rules);
+  rules.loadProgram(compiled("autoclose 0 after 10m"));
+
+  CHECK_EQ(RULES_OUT_OF_RANGE, rules.loadProgram("0100000009000000"));          // Under 10s
+  CHECK_EQ(RULES_OUT_OF_RANGE, rules.loadProgram("0100000081510100"));          // Over 24h
+  CHECK_EQ(RULES_OUT_OF_RANGE, rules.loadProgram("0200000080510100"));          // 24:00
+  CHECK_EQ(RULES_BAD_CHANNEL, rules.loadProgram("0102000058020000"));
+  CHECK_EQ(RULES_BAD_OPCODE, rules.loadProgram("0300000058020000"));
+  CHECK_EQ(RULES_MALFORMED, rules.loadProgram("01000000580200"));
+  CHECK_EQ(RULES_MALFORMED, rules.loadProgram("01000000580200zz"));
+
+  char tooMany[RULES_PROGRAM_HEX_LEN + (RULE_LEN * 2) + 1];
+  snprintf(tooMany, sizeof(tooMany), "%s%s", ruleVectors[VECTOR_COUNT - 1].program, compiled("autoclose 0 after 10m"));
+  CHECK_EQ(RULES_TOO_MANY, rules.loadProgram(tooMany));
+
+  // A rejected program leaves the live table alone
+  CHECK_EQ(1, rules.ruleCount());
+}
+
+TEST(persistedTableSurvivesReset){
+  GDoorRules rules;
+  setUp(&rules);
+  const char* program = ruleVectors[VECTOR_COUNT - 1].program;
+  rules.loadProgram(program);
+  rules.persist();
+
+  GDoorRules restored;
+  restored.begin(&io, &deviceClock);
+  restored.load();
+  CHECK_EQ(RULES_MAX, restored.ruleCount());
+
+  char json[RULES_JSON_LEN];
+  restored.toJson(json);
+  CHECK(strncmp(program, &json[strlen("{\"program\":\"")], strlen(program)) == 0);
+
+  // Fewer channels on this build - their rules are dropped
+  io.channelCount = 1;
+  GDoorRules singleChannel;
+  singleChannel.begin(&io, &deviceClock);
+  singleChannel.load();
+  CHECK_EQ(RULES_MAX / 2, singleChannel.ruleCount());
+}
+
+TEST(corruptTableIgnored){
+  GDoorRules rules;
+  setUp(&rules);
+  rules.loadProgram(compiled("schedule 0 at 23:59:59"));
+  rules.persist();
+
+  int paramAddress = RULES_EEPROM_ADDR + RULES_HEADER_LEN + 4;
+  EEPROM.write(paramAddress, EEPROM.read(paramAddress) ^ 0x01);
+  GDoorRules restored;
+  restored.begin(&io, &deviceClock);
+  restored.load();
+  CHECK_EQ(0, restored.ruleCount());
+}
+
+TEST(legacyTableMovedOutOfTheSettingsRegion){
+  // Saved at RULES_LEGACY_EEPROM_ADDR by firmware from before EepromLayout.h
+  GDoorRules rules;
+  setUp(&rules);
+  rules.loadProgram(ruleVectors[VECTOR_COUNT - 1].program);
+  rules.persist();
+  for (int i = 0; i < RULES_HEADER_LEN + (RULES_MAX * RULE_LEN) + 1; i++){
+    EEPROM.write(RULES_LEGACY_EEPROM_ADDR + i, EEPROM.read(RULES_EEPROM_ADDR + i));
+    EEPROM.write(RULES_EEPROM_ADDR + i, 0xFF);
+  }
+
+  GDoorRules migrated;
+  migrated.begin(&io, &deviceClock);
+  migrated.load();
+  CHECK_EQ(RULES_MAX, migrated.ruleCount());
+  CHECK_EQ('G', EEPROM.read(RULES_EEPROM_ADDR));
+
+  // The settings can now grow over the old spot
+  for (int i = RULES_LEGACY_EEPROM_ADDR; i < EEPROM_LAYOUT_SIZE; i++){
+    EEPROM.write(i, 0);
+  }
+
+  GDoorRules restored;
+  restored.begin(&io, &deviceClock);
+  restored.load();
+  CHECK_EQ(RULES_MAX, restored.ruleCount());
+}
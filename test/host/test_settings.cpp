@@ -0,0 +1,195 @@
+/*
+*	Host tests - settings persistence, checksum, schema & 
+*   range checks
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#include "TestHarness.hpp"
+#include "settings/GDoorSettings.hpp"
+#include "rules/GDoorRules.hpp"
+
+static void setUp(){
+  EEPROM.erase();
+}
+
+// Hand built record in the stored layout - count values, checksum over everything before it
+static void storeRaw(uint8_t schema, const uint32_t* values, int count){
+  int address = SETTINGS_EEPROM_ADDR;
+  uint8_t sum = 0;
+  uint8_t header[SETTINGS_HEADER_LEN] = { 'G', 'S', schema, (uint8_t)count };
+  for (int i = 0; i < SETTINGS_HEADER_LEN; i++){
+    EEPROM.write(address++, header[i]);
+    sum += header[i];
+  }
+
+  for (int i = 0; i < count; i++){
+    for (int b = 0; b < 4; b++){
+      uint8_t byte = (values[i] >> (8 * b)) & 0xFF;
+      EEPROM.write(address++, byte);
+      sum += byte;
+    }
+  }
+
+  EEPROM.write(address, sum);
+}
+
+static bool allDefaults(GDoorSettings* settings){
+  for (int i = 0; i < SETTING_COUNT; i++){
+    if (settings->get((SettingId)i) != GDoorSettings::definitions[i].defaultValue){
+      return false;
+    }
+  }
+
+  return true;
+}
+
+TEST(freshFlashLoadsDefaults){
+  setUp();
+  GDoorSettings settings;
+  settings.load();
+  CHECK(allDefaults(&settings));
+  CHECK_EQ((uint32_t)900000, settings.get(SETTING_HEALTH_CHECK_INTERVAL));
+}
+
+TEST(persistRoundTrips){
+  setUp();
+  GDoorSettings settings;
+  CHECK_EQ(SETTING_OK, settings.set(SETTING_PULSE_LENGTH, 1200));
+  CHECK_EQ(SETTING_OK, settings.set(SETTING_PORT_NUMBER, 8080));
+  settings.persist();
+  CHECK(!settings.isDirty());
+
+  GDoorSettings loaded;
+  loaded.load();
+  CHECK_EQ((uint32_t)1200, loaded.get(SETTING_PULSE_LENGTH));
+  CHECK_EQ((uint32_t)8080, loaded.get(SETTING_PORT_NUMBER));
+  CHECK_EQ((uint32_t)10, loaded.get(SETTING_DEBOUNCE_SAMPLES));
+
+  // Only writes inside its own region of the shared layout
+  int outside = 0;
+  for (int i = 0; i < EEPROM_LAYOUT_SIZE; i++){
+    if ((i < SETTINGS_EEPROM_ADDR || i >= SETTINGS_EEPROM_ADDR + SETTINGS_EEPROM_LEN) && EEPROM.read(i) != 0xFF){
+      outside += 1;
+    }
+  }
+
+  CHECK_EQ(0, outside);
+}
+
+TEST(persistOnlyWritesWhenChanged){
+  setUp();
+  GDoorSettings settings;
+  settings.persist();
+  CHECK_EQ(0, EEPROM.commits);
+
+  CHECK_EQ(SETTING_UNCHANGED, settings.set(SETTING_PULSE_LENGTH, 1500));
+  settings.persist();
+  CHECK_EQ(0, EEPROM.commits);
+
+  settings.set(SETTING_PULSE_LENGTH, 1600);
+  settings.persist();
+  settings.persist();
+  CHECK_EQ(1, EEPROM.commits);
+}
+
+TEST(corruptRecordIgnored){
+  setUp();
+  GDoorSettings settings;
+  settings.set(SETTING_PULSE_LENGTH, 1200);
+  settings.persist();
+
+  // One flipped bit in a value
+  int valueAddress = SETTINGS_EEPROM_ADDR + SETTINGS_HEADER_LEN + SETTING_PULSE_LENGTH * 4;
+  EEPROM.write(valueAddress, EEPROM.read(valueAddress) ^ 0x01);
+  GDoorSettings loaded;
+  loaded.load();
+  CHECK(allDefaults(&loaded));
+}
+
+TEST(otherSchemaIgnored){
+  setUp();
+  uint32_t values[SETTING_COUNT] = { 600000, 1200, 5, 50, 100, 8080 };
+  storeRaw(SETTINGS_SCHEMA + 1, values, SETTING_COUNT);
+  GDoorSettings settings;
+  settings.load();
+  CHECK(allDefaults(&settings));
+
+  storeRaw(SETTINGS_SCHEMA, values, SETTING_COUNT);
+  settings.load();
+  CHECK_EQ((uint32_t)600000, settings.get(SETTING_HEALTH_CHECK_INTERVAL));
+  CHECK_EQ((uint32_t)8080, settings.get(SETTING_PORT_NUMBER));
+}
+
+TEST(olderLayoutKeepsNewSettingsAtDefault){
+  setUp();
+  uint32_t values[4] = { 600000, 1200, 5, 50 };
+  storeRaw(SETTINGS_SCHEMA, values, 4);
+  GDoorSettings settings;
+  settings.load();
+  CHECK_EQ((uint32_t)50, settings.get(SETTING_DEBOUNCE_INTERVAL));
+  CHECK_EQ((uint32_t)250, settings.get(SETTING_STATIC_OCTET));
+  CHECK_EQ((uint32_t)6969, settings.get(SETTING_PORT_NUMBER));
+}
+
+TEST(storedValueOutOfRangeFallsBack){
+  // A newer firmware's wider limits - only that setting reverts
+  setUp();
+  uint32_t values[SETTING_COUNT] = { 600000, 9000, 5, 50, 100, 8080 };
+  storeRaw(SETTINGS_SCHEMA, values, SETTING_COUNT);
+  GDoorSettings settings;
+  settings.load();
+  CHECK_EQ((uint32_t)1500, settings.get(SETTING_PULSE_LENGTH));
+  CHECK_EQ((uint32_t)600000, settings.get(SETTING_HEALTH_CHECK_INTERVAL));
+}
+
+TEST(rangeChecksRejectNeverClamp){
+  GDoorSettings settings;
+  CHECK_EQ(SETTING_OUT_OF_RANGE, settings.set(SETTING_PULSE_LENGTH, 199));
+  CHECK_EQ(SETTING_OUT_OF_RANGE, settings.set(SETTING_PULSE_LENGTH, 5001));
+  CHECK_EQ((uint32_t)1500, settings.get(SETTING_PULSE_LENGTH));
+  CHECK(!settings.isDirty());
+
+  CHECK_EQ(SETTING_OK, settings.validate("debounceSamples", 50));
+  CHECK_EQ(SETTING_OUT_OF_RANGE, settings.validate("debounceSamples", 51));
+  CHECK_EQ(SETTING_UNKNOWN_KEY, settings.validate("nope", 1));
+  CHECK_EQ(SETTING_UNKNOWN_KEY, settings.setByKey("nope", 1));
+}
+
+TEST(rebootSettingsFlagPending){
+  GDoorSettings settings;
+  settings.set(SETTING_PULSE_LENGTH, 1200);
+  CHECK(!settings.isRebootPending());
+  settings.setByKey("espStaticOctet", 100);
+  CHECK(settings.isRebootPending());
+}
+
+TEST(healthResponseUpdates){
+  GDoorSettings settings;
+  int changed = settings.applyJson("{\"ok\":true,\"settings\":{\"healthCheckInterval\":\"600000\",\"pulseLength\":1200,\"debounceSamples\":99,\"portNumber\":x}}");
+  CHECK_EQ(2, changed);
+  CHECK_EQ((uint32_t)600000, settings.get(SETTING_HEALTH_CHECK_INTERVAL));
+  CHECK_EQ((uint32_t)1200, settings.get(SETTING_PULSE_LENGTH));
+  CHECK_EQ((uint32_t)10, settings.get(SETTING_DEBOUNCE_SAMPLES));
+  CHECK_EQ(0, settings.applyJson("{\"ok\":true}"));
+
+  char json[SETTINGS_JSON_LEN];
+  settings.toJson(json);
+  CHECK_STR("{\"healthCheckInterval\":600000,\"pulseLength\":1200,\"debounceSamples\":10,\"debounceInterval\":100,"
+    "\"espStaticOctet\":250,\"portNumber\":6969,\"uploadSpread\":100000,\"doorChannels\":1,\"rebootPending\":false}", json);
+}
+
+TEST(doorChannelsBoundByTheChannelTable){
+  setUp();
+  GDoorSettings settings;
+  CHECK_EQ(SETTING_OUT_OF_RANGE, settings.setByKey("doorChannels", 0));
+  CHECK_EQ(SETTING_OUT_OF_RANGE, settings.setByKey("doorChannels", MAX_DOOR_CHANNELS + 1));
+  CHECK(!settings.isRebootPending());
+
+  // The pins are set up once, at boot
+  CHECK_EQ(SETTING_OK, settings.setByKey("doorChannels", MAX_DOOR_CHANNELS));
+  CHECK(settings.isRebootPending());
+  CHECK_EQ((uint32_t)MAX_DOOR_CHANNELS, settings.get(SETTING_DOOR_CHANNELS));
+}
@@ -0,0 +1,161 @@
+/*
+*	Host tests - stage deadlines, the RTC fault record &
+*   the relay backstop
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#include "TestHarness.hpp"
+#include "diagnostics/Supervisor.hpp"
+
+static GDoorIO io;
+static cont_t loopCont;
+extern cont_t* g_pcont;
+
+static void setUp(){
+  memset(&loopCont, 0, sizeof(loopCont));
+  loopCont.stack_end = loopCont.stack + (CONT_STACK_SIZE / 4);
+  g_pcont = &loopCont;
+  memset(ESP.rtcMemory, 0, sizeof(ESP.rtcMemory));
+  memset(&hostResetInfo, 0, sizeof(hostResetInfo));
+  hostRestarts = 0;
+  hostMillis = 1000;
+  io = GDoorIO();
+}
+
+// A tick every second until the clock reaches millis
+static void runUntil(uint32_t millis){
+  while (hostMillis < millis){
+    hostMillis += SUPERVISOR_TICK_MS;
+    if (hostMillis > millis){
+      hostMillis = millis;
+    }
+
+    hostRunTickers();
+  }
+}
+
+TEST(stageWithinDeadlineKeepsRunning){
+  setUp();
+  GDoorSupervisor supervisor;
+  supervisor.begin(&io);
+  supervisor.setStage(SUPERVISOR_STAGE_UPLOAD);
+  runUntil(1000 + 30000);
+  CHECK_EQ(0, hostRestarts);
+
+  // Slow WiFi recovery gets its own, longer deadline
+  supervisor.setStage(SUPERVISOR_STAGE_WIFI_RECON);
+  runUntil(hostMillis + 100000);
+  CHECK_EQ(0, hostRestarts);
+}
+
+TEST(overrunResetsOnceAndIsReportedNextBoot){
+  setUp();
+  GDoorSupervisor supervisor;
+  supervisor.begin(&io);
+  supervisor.setStage(SUPERVISOR_STAGE_CLOCK);
+  supervisor.setStage(SUPERVISOR_STAGE_UPLOAD);
+  runUntil(1000 + 30001);
+  CHECK_EQ(1, hostRestarts);
+
+  // The restart isn't instant - later ticks leave the record alone
+  runUntil(hostMillis + 5000);
+  CHECK_EQ(1, hostRestarts);
+
+  hostResetInfo.reason = 4;
+  GDoorSupervisor next;
+  next.begin(&io);
+  const ResetReport* report = next.lastReset();
+  CHECK_EQ((uint32_t)4, report->resetReason);
+  CHECK_EQ((uint32_t)SUPERVISOR_FAULT_DEADLINE, report->fault);
+  CHECK_EQ((uint32_t)SUPERVISOR_STAGE_UPLOAD, report->stage);
+  CHECK_EQ((uint32_t)30001, report->stageMillis);
+  CHECK_EQ((uint32_t)hostFreeContStack, report->freeContStack);
+  CHECK_EQ((uint32_t)((SUPERVISOR_STAGE_BOOT << 16) | (SUPERVISOR_STAGE_CLOCK << 8) | SUPERVISOR_STAGE_UPLOAD), report->stageTrail & 0xFFFFFF);
+}
+
+TEST(overrunKeepsTheLoopStackFromItsLastYield){
+  setUp();
+  GDoorSupervisor supervisor;
+  supervisor.begin(&io);
+
+  // Suspended in a hung wait - return addresses up the stack from the yield point
+  loopCont.sp_yield = loopCont.stack_end - 20;
+  for (int i = 0; i < 20; i++){
+    loopCont.sp_yield[i] = 0x40201000 + (i * 4);
+  }
+
+  supervisor.setStage(SUPERVISOR_STAGE_UPLOAD);
+  runUntil(1000 + 30001);
+  CHECK_EQ(1, hostRestarts);
+
+  GDoorSupervisor next;
+  next.begin(&io);
+  const SupervisorStack* stack = next.lastStack();
+  CHECK(stack != NULL);
+  if (stack != NULL){
+    CHECK_EQ((uint32_t)SUPERVISOR_STACK_WORDS, stack->wordCount);
+    CHECK_EQ((uint32_t)0x40201000, stack->words[0]);
+    CHECK_EQ((uint32_t)(0x40201000 + ((SUPERVISOR_STACK_WORDS - 1) * 4)), stack->words[SUPERVISOR_STACK_WORDS - 1]);
+  }
+
+  // Yielded near the top - only the words that are there
+  setUp();
+  loopCont.sp_yield = loopCont.stack_end - 2;
+  GDoorSupervisor shallow;
+  shallow.begin(&io);
+  shallow.setStage(SUPERVISOR_STAGE_SERVER);
+  runUntil(1000 + 10001);
+  GDoorSupervisor afterShallow;
+  afterShallow.begin(&io);
+  CHECK(afterShallow.lastStack() != NULL && afterShallow.lastStack()->wordCount == 2);
+}
+
+TEST(cleanRunRecordsNoFault){
+  setUp();
+  GDoorSupervisor supervisor;
+  supervisor.begin(&io);
+  supervisor.setStage(SUPERVISOR_STAGE_DOOR_SAMPLE);
+  supervisor.setStage(SUPERVISOR_STAGE_DOOR_SAMPLE);
+  runUntil(3000);
+
+  // e.g. a brown out - the last tick still says where the loop was
+  GDoorSupervisor next;
+  next.begin(&io);
+  CHECK_EQ((uint32_t)SUPERVISOR_FAULT_NONE, next.lastReset()->fault);
+  CHECK_EQ((uint32_t)SUPERVISOR_STAGE_DOOR_SAMPLE, next.lastReset()->stage);
+  CHECK_EQ((uint32_t)((SUPERVISOR_STAGE_BOOT << 8) | SUPERVISOR_STAGE_DOOR_SAMPLE), next.lastReset()->stageTrail & 0xFFFF);
+  CHECK(next.lastStack() == NULL);
+}
+
+TEST(corruptRecordIgnored){
+  setUp();
+  GDoorSupervisor supervisor;
+  supervisor.begin(&io);
+  supervisor.setStage(SUPERVISOR_STAGE_SERVER);
+  runUntil(1000 + 10001);
+  CHECK_EQ(1, hostRestarts);
+
+  ESP.rtcMemory[RTC_SLOT_SUPERVISOR + 2] ^= 1;
+  GDoorSupervisor next;
+  next.begin(&io);
+  CHECK_EQ((uint32_t)SUPERVISOR_FAULT_NONE, next.lastReset()->fault);
+  CHECK_EQ((uint32_t)0, next.lastReset()->stageMillis);
+}
+
+TEST(stuckRelayReleased){
+  setUp();
+  GDoorSupervisor supervisor;
+  supervisor.begin(&io);
+  io.actuateDoor(0);
+  CHECK_EQ(HIGH, hostPinLevels[io.channels[0].relayPin]);
+
+  // The pulse timer never fired - released a grace period past the pulse length
+  runUntil(1000 + io.channels[0].pulseLength + SUPERVISOR_RELAY_GRACE);
+  CHECK_EQ(HIGH, hostPinLevels[io.channels[0].relayPin]);
+  runUntil(hostMillis + SUPERVISOR_TICK_MS);
+  CHECK_EQ(LOW, hostPinLevels[io.channels[0].relayPin]);
+  CHECK(!io.channels[0].pulseActive);
+}
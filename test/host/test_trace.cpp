@@ -0,0 +1,155 @@
+/*
+*	Host tests - trace ring, wire format & door path replay
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#include "TestHarness.hpp"
+#include "TraceReplay.hpp"
+#include "digital-io/GDoorIO.hpp"
+
+typedef struct routeVector {
+  const char* uri;
+  uint16_t hash;
+} RouteVector;
+
+#include "RouteVectors.h"
+
+#define SENSOR_PIN 14
+#define MAX_RECORDS 512
+
+static uint8_t captured[MAX_RECORDS * TRACE_RECORD_WIRE_LEN];
+static uint8_t replayed[MAX_RECORDS * TRACE_RECORD_WIRE_LEN];
+
+/*
+ *  Captures what the firmware records while its sensor pin follows 
+ *  levels[], one level per 100ms, sampled every 1ms like the loop
+ *
+*/
+
+static int capture(GDoorIO* io, const int* levels, int levelCount, uint32_t startMillis){
+  int written = 0;
+  for (hostMillis = startMillis; hostMillis < startMillis + (uint32_t)(levelCount + 20) * 100; hostMillis++){
+    gdoorTrace = GDoorTrace();
+    int step = (hostMillis - startMillis) / 100;
+    hostPinLevels[SENSOR_PIN] = levels[step < levelCount ? step : levelCount - 1];
+    io->sampleDoorStates();
+    written += gdoorTrace.dumpRecords(0, &captured[written * TRACE_RECORD_WIRE_LEN], MAX_RECORDS - written);
+  }
+
+  return written;
+}
+
+static TraceRecord recordAt(const uint8_t* data, int index){
+  const uint8_t* out = &data[index * TRACE_RECORD_WIRE_LEN];
+  TraceRecord record;
+  record.millis = out[0] | (out[1] << 8) | (out[2] << 16) | ((uint32_t)out[3] << 24);
+  record.type = out[4];
+  record.arg = out[5];
+  record.value = out[6] | (out[7] << 8);
+  return record;
+}
+
+static int findRecord(const uint8_t* data, int count, uint8_t type, uint16_t value){
+  for (int i = 0; i < count; i++){
+    TraceRecord record = recordAt(data, i);
+    if (record.type == type && record.value == value){
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+TEST(ringKeepsNewestRecords){
+  gdoorTrace = GDoorTrace();
+  for (int i = 0; i < TRACE_RING_CAPACITY + 10; i++){
+    hostMillis = i;
+    gdoorTrace.record(TRACE_ACTUATE, 0, i);
+  }
+
+  CHECK_EQ(TRACE_RING_CAPACITY, gdoorTrace.bufferedRecords());
+  uint8_t out[TRACE_RECORD_WIRE_LEN];
+  CHECK_EQ(1, gdoorTrace.dumpRecords(0, out, 1));
+  CHECK_EQ(10, (int)recordAt(out, 0).value);
+  CHECK_EQ((uint32_t)10, recordAt(out, 0).millis);
+}
+
+TEST(wireFormatIsLittleEndian){
+  gdoorTrace = GDoorTrace();
+  hostMillis = 0x11223344;
+  gdoorTrace.record(TRACE_UPLOAD_RESPONSE, 2, (uint16_t)-1);
+  uint8_t out[TRACE_RECORD_WIRE_LEN];
+  gdoorTrace.dumpRecords(0, out, 1);
+  const uint8_t expected[TRACE_RECORD_WIRE_LEN] = { 0x44, 0x33, 0x22, 0x11, TRACE_UPLOAD_RESPONSE, 2, 0xFF, 0xFF };
+  CHECK(memcmp(expected, out, sizeof(expected)) == 0);
+}
+
+TEST(routeHashMatchesDecoder){
+  for (unsigned i = 0; i < sizeof(routeVectors) / sizeof(routeVectors[0]); i++){
+    CHECK_EQ(routeVectors[i].hash, GDoorTrace::routeHash(routeVectors[i].uri));
+  }
+}
+
+TEST(decoderKnowsEveryTraceType){
+  // A type appended without a name in decode_trace.py shows up as a bare number
+  CHECK_EQ(TRACE_BOOT_STAGE + 1, decodedTraceTypes);
+}
+
+TEST(replayReproducesCapture){
+  const int levels[] = { LOW, LOW, HIGH, HIGH, HIGH, LOW, HIGH, LOW, LOW, LOW, LOW, LOW, LOW, LOW, LOW, LOW, LOW, LOW, LOW, HIGH };
+  GDoorIO device;
+  hostMillis = 500;
+  device.setDebounce(0, 10, 100);
+  int count = capture(&device, levels, sizeof(levels) / sizeof(levels[0]), 1000);
+  CHECK(count > 0);
+
+  // The config record from setDebounce() above is part of the capture too
+  memmove(&captured[TRACE_RECORD_WIRE_LEN], captured, count * TRACE_RECORD_WIRE_LEN);
+  const uint8_t config[TRACE_RECORD_WIRE_LEN] = { 0xF4, 0x01, 0, 0, TRACE_CHANNEL_CONFIG, 0, 100, 10 << 2 };
+  memcpy(captured, config, sizeof(config));
+  count += 1;
+
+  int replayedCount = replayTrace(captured, count, replayed, MAX_RECORDS);
+  CHECK_EQ(count, replayedCount);
+  CHECK(memcmp(captured, replayed, count * TRACE_RECORD_WIRE_LEN) == 0);
+}
+
+TEST(replayIsDeterministic){
+  const int levels[] = { HIGH, LOW, HIGH, LOW, LOW, LOW, LOW, LOW, LOW, LOW, LOW, LOW, LOW, LOW, LOW };
+  GDoorIO device;
+  int count = capture(&device, levels, sizeof(levels) / sizeof(levels[0]), 2000);
+
+  static uint8_t again[MAX_RECORDS * TRACE_RECORD_WIRE_LEN];
+  int first = replayTrace(captured, count, replayed, MAX_RECORDS);
+  int second = replayTrace(captured, count, again, MAX_RECORDS);
+  CHECK_EQ(first, second);
+  CHECK(memcmp(replayed, again, first * TRACE_RECORD_WIRE_LEN) == 0);
+}
+
+TEST(replayMeasuresDebounceLatency){
+  // Open at 1000, close edge at 3000 - closed a full window (10 x 100ms) of LOW samples later
+  const uint8_t recording[] = {
+    0xE8, 0x03, 0, 0, TRACE_GPIO_EDGE, 0, HIGH, 0,
+    0xB8, 0x0B, 0, 0, TRACE_GPIO_EDGE, 0, LOW, 0
+  };
+  int count = replayTrace(recording, 2, replayed, MAX_RECORDS);
+  int closed = findRecord(replayed, count, TRACE_DOOR_STATE, DOOR_STATE_CLOSED);
+  int opened = findRecord(replayed, count, TRACE_DOOR_STATE, DOOR_STATE_OPEN);
+  CHECK(opened >= 0 && closed >= 0);
+  CHECK_EQ((uint32_t)1000, recordAt(replayed, opened).millis);
+  CHECK_EQ((uint32_t)3000 + 9 * 100, recordAt(replayed, closed).millis);
+
+  // Same input with a 3 sample window recorded ahead of it
+  const uint8_t shorter[] = {
+    0x00, 0x00, 0, 0, TRACE_CHANNEL_CONFIG, 0, 100, 3 << 2,
+    0xE8, 0x03, 0, 0, TRACE_GPIO_EDGE, 0, HIGH, 0,
+    0xB8, 0x0B, 0, 0, TRACE_GPIO_EDGE, 0, LOW, 0
+  };
+  count = replayTrace(shorter, 3, replayed, MAX_RECORDS);
+  closed = findRecord(replayed, count, TRACE_DOOR_STATE, DOOR_STATE_CLOSED);
+  CHECK(closed >= 0);
+  CHECK_EQ((uint32_t)3000 + 2 * 100, recordAt(replayed, closed).millis);
+}
@@ -0,0 +1,118 @@
+/*
+*	Host tests - upload queue order, holds & capacity
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#include "TestHarness.hpp"
+#include "networking/UploadQueue.hpp"
+
+static int popType(UploadQueue* queue, uint64_t now){
+  UploadEvent event;
+  return queue->pop(&event, now) ? event.type : -1;
+}
+
+TEST(emptyQueuePopsNothing){
+  UploadQueue queue;
+  CHECK_EQ(0, queue.depth());
+  CHECK_EQ(-1, popType(&queue, 0));
+}
+
+TEST(firstInFirstOut){
+  UploadQueue queue;
+  queue.push(UPLOAD_BOOT_INFO, DOOR_STATE_CLOSED, 100);
+  queue.push(UPLOAD_DOOR_STATE, DOOR_STATE_OPEN, 200, 1);
+  queue.push(UPLOAD_HEALTH_CHECK, DOOR_STATE_OPEN, 300);
+  CHECK_EQ(3, queue.depth());
+
+  UploadEvent event;
+  CHECK(queue.pop(&event, 1000));
+  CHECK_EQ(UPLOAD_BOOT_INFO, event.type);
+  CHECK(queue.pop(&event, 1000));
+  CHECK_EQ(UPLOAD_DOOR_STATE, event.type);
+  CHECK_EQ(DOOR_STATE_OPEN, event.doorState);
+  CHECK_EQ(1, event.channel);
+  CHECK_EQ(200, event.capturedAt);
+  CHECK_EQ(UPLOAD_HEALTH_CHECK, popType(&queue, 1000));
+  CHECK_EQ(0, queue.depth());
+}
+
+TEST(fullQueueRefusesAndKeepsWhatItHas){
+  UploadQueue queue;
+  for (int i = 0; i < UPLOAD_QUEUE_CAPACITY; i++){
+    CHECK(queue.push(UPLOAD_DOOR_STATE, DOOR_STATE_OPEN, i, 0));
+  }
+
+  CHECK(!queue.push(UPLOAD_HEALTH_CHECK, DOOR_STATE_OPEN, 99));
+  CHECK_EQ(UPLOAD_QUEUE_CAPACITY, queue.depth());
+
+  UploadEvent event;
+  for (int i = 0; i < UPLOAD_QUEUE_CAPACITY; i++){
+    CHECK(queue.pop(&event, 1000));
+    CHECK_EQ((uint64_t)i, event.capturedAt);
+  }
+}
+
+TEST(heldEventsKeepTheirPlace){
+  // Boot note held, door updates behind it go first, the rest keep their order
+  UploadQueue queue;
+  queue.push(UPLOAD_BOOT_INFO, DOOR_STATE_CLOSED, 100, 0, 2000);
+  queue.push(UPLOAD_DOOR_STATE, DOOR_STATE_OPEN, 200);
+  queue.push(UPLOAD_WIFI_RECON, DOOR_STATE_OPEN, 300, 0, 5000);
+  queue.push(UPLOAD_DOOR_STATE, DOOR_STATE_CLOSED, 400);
+
+  UploadEvent event;
+  CHECK(queue.pop(&event, 1000));
+  CHECK_EQ(200, event.capturedAt);
+  CHECK(queue.pop(&event, 1000));
+  CHECK_EQ(400, event.capturedAt);
+  CHECK_EQ(-1, popType(&queue, 1999));
+
+  CHECK_EQ(UPLOAD_BOOT_INFO, popType(&queue, 2000));
+  CHECK_EQ(-1, popType(&queue, 4999));
+  CHECK_EQ(UPLOAD_WIFI_RECON, popType(&queue, 5000));
+  CHECK_EQ(0, queue.depth());
+}
+
+TEST(ringWrapsAround){
+  UploadQueue queue;
+  UploadEvent event;
+  for (int round = 0; round < 3 * UPLOAD_QUEUE_CAPACITY; round++){
+    CHECK(queue.push(UPLOAD_DOOR_STATE, DOOR_STATE_OPEN, round));
+    CHECK(queue.push(UPLOAD_HEALTH_CHECK, DOOR_STATE_OPEN, round, 0, round + 10));
+    CHECK(queue.pop(&event, round));
+    CHECK_EQ(UPLOAD_DOOR_STATE, event.type);
+    CHECK(queue.pop(&event, round + 10));
+    CHECK_EQ(UPLOAD_HEALTH_CHECK, event.type);
+    CHECK_EQ((uint64_t)round, event.capturedAt);
+  }
+
+  CHECK_EQ(0, queue.depth());
+}
+
+TEST(retryKeepsCaptureTimeAndCountsAttempts){
+  UploadQueue queue;
+  queue.push(UPLOAD_DOOR_STATE, DOOR_STATE_OPEN, 200, 1);
+  queue.push(UPLOAD_DOOR_STATE, DOOR_STATE_CLOSED, 300, 1);
+
+  UploadEvent event;
+  CHECK(queue.pop(&event, 1000));
+  CHECK_EQ(0, event.attempts);
+  CHECK(queue.retry(&event, 5000));
+
+  // The next update isn't held up behind the backoff
+  CHECK(queue.pop(&event, 1000));
+  CHECK_EQ(300, event.capturedAt);
+  CHECK_EQ(-1, popType(&queue, 4999));
+
+  CHECK(queue.pop(&event, 5000));
+  CHECK_EQ(200, event.capturedAt);
+  CHECK_EQ(DOOR_STATE_OPEN, event.doorState);
+  CHECK_EQ(1, event.channel);
+  CHECK_EQ(1, event.attempts);
+  CHECK(queue.retry(&event, 6000));
+  CHECK(queue.pop(&event, 6000));
+  CHECK_EQ(2, event.attempts);
+}
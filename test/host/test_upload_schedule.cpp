@@ -0,0 +1,150 @@
+/*
+*	Host tests - health ping phase & upload holds
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#include "TestHarness.hpp"
+#include "networking/UploadSchedule.hpp"
+
+static const unsigned long interval = 900000;
+
+static void setUp(GDoorUploadSchedule* schedule, const char* uid){
+  schedule->begin(uid);
+  schedule->setInterval(interval, 0);
+}
+
+TEST(noHealthCheckBeforeConnecting){
+  GDoorUploadSchedule schedule;
+  setUp(&schedule, "T3stUid000000000000000000001");
+  CHECK(!schedule.healthCheckDue(0));
+  CHECK(!schedule.healthCheckDue(10 * interval));
+}
+
+TEST(firstPingLandsAtThePhaseThenEveryInterval){
+  GDoorUploadSchedule schedule;
+  setUp(&schedule, "T3stUid000000000000000000001");
+  schedule.connected(5000);
+
+  uint64_t first = schedule.nextHealthCheck();
+  CHECK(first >= 5000 && first < 5000 + interval);
+  CHECK(!schedule.healthCheckDue(first - 1));
+  CHECK(schedule.healthCheckDue(first));
+  CHECK(!schedule.healthCheckDue(first));
+  CHECK_EQ(first + interval, schedule.nextHealthCheck());
+}
+
+TEST(phaseIsStablePerDeviceAndSpreadAcrossTheFleet){
+  GDoorUploadSchedule a;
+  GDoorUploadSchedule b;
+  GDoorUploadSchedule again;
+  setUp(&a, "T3stUid000000000000000000001");
+  setUp(&b, "T3stUid000000000000000000002");
+  setUp(&again, "T3stUid000000000000000000001");
+  a.connected(0);
+  b.connected(0);
+  again.connected(0);
+
+  CHECK_EQ(a.nextHealthCheck(), again.nextHealthCheck());
+  CHECK(a.nextHealthCheck() != b.nextHealthCheck());
+}
+
+TEST(reconnectRestartsThePhase){
+  GDoorUploadSchedule schedule;
+  setUp(&schedule, "T3stUid000000000000000000001");
+  schedule.connected(0);
+  uint64_t phase = schedule.nextHealthCheck();
+
+  schedule.connected(7 * interval);
+  CHECK_EQ(7 * interval, schedule.connectedAt());
+  CHECK_EQ(7 * interval + phase, schedule.nextHealthCheck());
+}
+
+TEST(shorterIntervalTakesEffectStraightAway){
+  GDoorUploadSchedule schedule;
+  setUp(&schedule, "T3stUid000000000000000000001");
+  schedule.connected(0);
+  CHECK(schedule.healthCheckDue(schedule.nextHealthCheck()));
+  uint64_t now = schedule.nextHealthCheck() - interval + 1000;
+
+  schedule.setInterval(60000, now);
+  CHECK(schedule.nextHealthCheck() >= now && schedule.nextHealthCheck() < now + 60000);
+
+  // Lengthening waits for the ping already scheduled
+  uint64_t scheduled = schedule.nextHealthCheck();
+  schedule.setInterval(interval, now);
+  CHECK_EQ(scheduled, schedule.nextHealthCheck());
+}
+
+TEST(holdsOnlyBootAndReconNotes){
+  GDoorUploadSchedule schedule;
+  setUp(&schedule, "T3stUid000000000000000000001");
+  schedule.connected(1000);
+
+  CHECK_EQ(1000 + 1234, schedule.holdUntil(UPLOAD_BOOT_INFO, 1234));
+  CHECK_EQ(1000 + (UPLOAD_SPREAD_DEFAULT - 1), schedule.holdUntil(UPLOAD_BOOT_INFO, UPLOAD_SPREAD_DEFAULT * 7 - 1));
+  CHECK_EQ(1000 + 9999, schedule.holdUntil(UPLOAD_WIFI_RECON, 9999));
+  CHECK_EQ(0, schedule.holdUntil(UPLOAD_DOOR_STATE, 1234));
+  CHECK_EQ(0, schedule.holdUntil(UPLOAD_HEALTH_CHECK, 1234));
+}
+
+TEST(spreadFollowsTheSetting){
+  GDoorUploadSchedule schedule;
+  setUp(&schedule, "T3stUid000000000000000000001");
+  schedule.connected(1000);
+
+  schedule.setSpread(30000);
+  CHECK_EQ(1000 + 29999, schedule.holdUntil(UPLOAD_WIFI_RECON, 30000 * 3 - 1));
+
+  // 0 turns the spreading off
+  schedule.setSpread(0);
+  CHECK_EQ(0, schedule.holdUntil(UPLOAD_BOOT_INFO, 1234));
+}
+
+TEST(retriesOnlyWhatMayClearUp){
+  CHECK(GDoorUploadSchedule::shouldRetry(UPLOAD_DOOR_STATE, -1, 0));
+  CHECK(GDoorUploadSchedule::shouldRetry(UPLOAD_BOOT_INFO, 503, 3));
+  CHECK(GDoorUploadSchedule::shouldRetry(UPLOAD_WIFI_RECON, 429, 0));
+  CHECK(GDoorUploadSchedule::shouldRetry(UPLOAD_DOOR_STATE, 408, 0));
+  CHECK(!GDoorUploadSchedule::shouldRetry(UPLOAD_DOOR_STATE, 400, 0));
+  CHECK(!GDoorUploadSchedule::shouldRetry(UPLOAD_DOOR_STATE, 0, 0));              // Never left the device
+  CHECK(!GDoorUploadSchedule::shouldRetry(UPLOAD_HEALTH_CHECK, -1, 0));
+  CHECK(!GDoorUploadSchedule::shouldRetry(UPLOAD_DOOR_STATE, -1, UPLOAD_RETRY_ATTEMPTS));
+}
+
+TEST(backoffDoublesUpToTheCap){
+  // The lower half of each backoff is fixed, the upper half random
+  CHECK_EQ(5000 + UPLOAD_RETRY_BASE / 2, GDoorUploadSchedule::retryAt(0, 5000, 0));
+  CHECK_EQ(5000 + UPLOAD_RETRY_BASE, GDoorUploadSchedule::retryAt(0, 5000, UPLOAD_RETRY_BASE / 2));
+  CHECK_EQ(5000 + UPLOAD_RETRY_BASE * 2, GDoorUploadSchedule::retryAt(1, 5000, UPLOAD_RETRY_BASE));
+  CHECK_EQ(5000 + UPLOAD_RETRY_BASE * 4, GDoorUploadSchedule::retryAt(2, 5000, UPLOAD_RETRY_BASE * 2));
+  CHECK_EQ(5000 + UPLOAD_RETRY_CAP / 2, GDoorUploadSchedule::retryAt(10, 5000, 0));
+  CHECK_EQ(5000 + UPLOAD_RETRY_CAP / 2, GDoorUploadSchedule::retryAt(UPLOAD_RETRY_ATTEMPTS, 5000, 0));
+
+  // Every attempt spans over 7 minutes even on the shortest backoffs - 10 on average
+  uint64_t at = 0;
+  for (uint8_t attempts = 0; attempts < UPLOAD_RETRY_ATTEMPTS - 1; attempts++){
+    at = GDoorUploadSchedule::retryAt(attempts, at, 0);
+  }
+
+  CHECK(at >= 450000);
+}
+
+TEST(heldUploadDoesNotDelayOneQueuedBehindIt){
+  GDoorUploadSchedule schedule;
+  UploadQueue queue;
+  setUp(&schedule, "T3stUid000000000000000000001");
+  schedule.connected(1000);
+
+  queue.push(UPLOAD_BOOT_INFO, DOOR_STATE_CLOSED, 1000, 0, schedule.holdUntil(UPLOAD_BOOT_INFO, 1500));
+  queue.push(UPLOAD_DOOR_STATE, DOOR_STATE_OPEN, 1200, 0, schedule.holdUntil(UPLOAD_DOOR_STATE, 1500));
+
+  UploadEvent event;
+  CHECK(queue.pop(&event, 1300));
+  CHECK_EQ(UPLOAD_DOOR_STATE, event.type);
+  CHECK(!queue.pop(&event, 2499));
+  CHECK(queue.pop(&event, 2500));
+  CHECK_EQ(UPLOAD_BOOT_INFO, event.type);
+}
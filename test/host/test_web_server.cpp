@@ -0,0 +1,133 @@
+/*
+*	Host tests - route matching, the channel segment & 
+*   what reaches the handlers
+*
+*	Author: Josh Perry
+*	Copyright 2018
+*
+*/
+
+#include "TestHarness.hpp"
+#include "networking/WebServer.hpp"
+
+#define TEST_UID "T3stUid000000000000000000001"
+
+/*
+ *  Fixture - a legacy (no secret) device with two channels, so 
+ *  unsigned requests reach the handlers
+ *
+*/
+
+typedef struct fixture {
+  GDoorUser user;
+  GDoorClock clock;
+  GDoorRequestAuth auth;
+  GDoorWebServer web;
+  int calls;
+  int channel;
+} Fixture;
+
+static void recordCall(GDoorWebServer* web, void* context, int channel){
+  Fixture* fixture = (Fixture*)context;
+  fixture->calls += 1;
+  fixture->channel = channel;
+  web->send(200, "text/plain", "ok");
+}
+
+static void setUp(Fixture* fixture){
+  hostMillis = 1000;
+  EEPROM.erase();
+  strcpy(fixture->user.uid, TEST_UID);
+  fixture->clock.begin();
+  fixture->auth.begin(&fixture->user, &fixture->clock);
+  fixture->calls = 0;
+  fixture->channel = -2;
+
+  fixture->web.on("HealthCheck", recordCall, fixture);
+  fixture->web.on("ActuateDoor", recordCall, fixture, true);
+  fixture->web.begin(TEST_UID, 80, 2, &fixture->auth);
+}
+
+// Serves one request - returns the status code
+static int serve(Fixture* fixture, HTTPMethod method, const char* path){
+  char uri[128];
+  snprintf(uri, sizeof(uri), path, TEST_UID);
+  fixture->web.request()->setRequest(method, uri);
+  fixture->web.handle();
+  return fixture->web.request()->replyCode;
+}
+
+static int get(Fixture* fixture, const char* path){
+  return serve(fixture, HTTP_GET, path);
+}
+
+TEST(rootAndPlainRoutes){
+  Fixture fixture;
+  setUp(&fixture);
+  CHECK_EQ(200, get(&fixture, "/"));
+  CHECK_EQ(0, fixture.calls);
+
+  CHECK_EQ(200, get(&fixture, "/%s/HealthCheck"));
+  CHECK_EQ(1, fixture.calls);
+  CHECK_EQ(-1, fixture.channel);
+  CHECK_EQ(AUTH_LEGACY, fixture.web.authResult());
+}
+
+TEST(channelScopedRoutes){
+  Fixture fixture;
+  setUp(&fixture);
+  CHECK_EQ(200, get(&fixture, "/%s/1/ActuateDoor"));
+  CHECK_EQ(1, fixture.channel);
+  CHECK_EQ(200, get(&fixture, "/%s/ActuateDoor"));
+  CHECK_EQ(-1, fixture.channel);
+
+  CHECK_EQ(404, get(&fixture, "/%s/2/ActuateDoor"));
+  CHECK_EQ(404, get(&fixture, "/%s/0/HealthCheck"));
+  CHECK_EQ(404, get(&fixture, "/%s/0ActuateDoor"));
+  CHECK_EQ(2, fixture.calls);
+}
+
+TEST(channelDigitsCapped){
+  Fixture fixture;
+  setUp(&fixture);
+  CHECK_EQ(200, get(&fixture, "/%s/01/ActuateDoor"));
+  CHECK_EQ(1, fixture.channel);
+
+  // Used to be parsed into an int until it overflowed
+  CHECK_EQ(404, get(&fixture, "/%s/001/ActuateDoor"));
+  CHECK_EQ(404, get(&fixture, "/%s/4294967297/ActuateDoor"));
+  CHECK_EQ(404, get(&fixture, "/%s/99999999999999999999999999/ActuateDoor"));
+  CHECK_EQ(1, fixture.calls);
+}
+
+TEST(otherDevicesUidNotFound){
+  Fixture fixture;
+  setUp(&fixture);
+  CHECK_EQ(404, get(&fixture, "/T3stUid000000000000000000002/HealthCheck"));
+  CHECK_EQ(404, get(&fixture, "/%sX/HealthCheck"));
+  CHECK_EQ(0, fixture.calls);
+}
+
+TEST(unknownMethodsRefused){
+  // Used to be signed & served as GET
+  Fixture fixture;
+  setUp(&fixture);
+  CHECK_EQ(405, serve(&fixture, HTTP_HEAD, "/%s/HealthCheck"));
+  CHECK_EQ(405, serve(&fixture, HTTP_OPTIONS, "/%s/HealthCheck"));
+  CHECK_EQ(405, serve(&fixture, HTTP_PATCH, "/%s/0/ActuateDoor"));
+  CHECK_EQ(0, fixture.calls);
+
+  CHECK_EQ(200, serve(&fixture, HTTP_POST, "/%s/HealthCheck"));
+  CHECK_EQ(1, fixture.calls);
+}
+
+TEST(unsignedRefusedOnceProvisioned){
+  Fixture fixture;
+  setUp(&fixture);
+  CHECK_EQ(200, get(&fixture, "/%s/HealthCheck"));
+  CHECK(fixture.auth.provision(&fixture.user, "{\"deviceSecret\":\"000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f\"}"));
+
+  CHECK_EQ(401, get(&fixture, "/%s/HealthCheck"));
+  CHECK_EQ(AUTH_MISSING_HEADERS, fixture.web.authResult());
+  CHECK_EQ(1, fixture.calls);
+}
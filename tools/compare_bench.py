@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+"""
+Compare GDoor hot path benchmark results against a baseline.
+
+Both files are serial captures (or trimmed copies) from a firmware built
+with GDOOR_BENCHMARK defined, or the output of make bench in test/host -
+only the {"bench": ...} JSON lines are read. Time per call is compared in
+ns rather than cycles: the host suite's calls take too few 80 MHz cycles
+for the cycle count to show a change, and on the device the two scale
+together. Compare a host run with a host run, a device with a device.
+Exits non-zero if any benchmark got slower than the tolerance allows or
+started leaking heap, so it can gate a release.
+
+Usage: compare_bench.py baseline.log current.log [--tolerance 0.10]
+"""
+
+import argparse
+import json
+import sys
+
+
+def load_results(path):
+    results = {}
+    with open(path, errors="replace") as f:
+        for line in f:
+            line = line.strip()
+            if not line.startswith('{"bench"'):
+                continue
+            try:
+                entry = json.loads(line)
+            except ValueError:
+                continue
+            results[entry["bench"]] = entry
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--tolerance", type=float, default=0.10, help="allowed slowdown as a fraction (default 0.10)")
+    options = parser.parse_args()
+
+    baseline = load_results(options.baseline)
+    current = load_results(options.current)
+    failed = False
+
+    print("%-28s %12s %12s %8s" % ("benchmark", "base ns/op", "cur ns/op", "change"))
+    for name in sorted(set(baseline) | set(current)):
+        if name not in current:
+            print("%-28s %12d %12s %8s" % (name, baseline[name]["nsPerOp"], "-", "missing"))
+            continue
+        if name not in baseline:
+            print("%-28s %12s %12d %8s" % (name, "-", current[name]["nsPerOp"], "new"))
+            continue
+
+        base = baseline[name]["nsPerOp"]
+        cur = current[name]["nsPerOp"]
+        change = (cur - base) / base if base else 0.0
+        status = ""
+        if change > options.tolerance:
+            status = "  REGRESSION"
+            failed = True
+        if current[name]["heapDelta"] > 0 and baseline[name]["heapDelta"] <= 0:
+            status += "  LEAK"
+            failed = True
+        print("%-28s %12d %12d %+7.1f%%%s" % (name, base, cur, change * 100, status))
+
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+"""
+Compile GDoor automation rules into the device's rule table.
+
+One rule per line (or separated by ';'), '#' starts a comment:
+
+  autoclose <channel> after <n>[s|m|h] [unless-present <minutes>]
+  schedule <channel> at HH:MM[:SS] [if-open|if-closed] [unless-present <minutes>]
+
+Schedule times are UTC - the device has no time zone. A schedule pulses
+the relay, so "close at night" is `schedule 0 at 22:00 if-open`.
+unless-present defers the rule while the LAN control channel has seen an
+authenticated command within the window (someone's phone is home).
+
+The output is the hex program for the signed /<uid>/Rules?program=<hex>
+endpoint. --decode turns a program (e.g. from a GET of the same endpoint)
+back into rules.
+
+Usage: compile_rules.py [rules.txt]
+       compile_rules.py --decode <hex>
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+# Mirrors src/rules/GDoorRules.hpp
+RULE_LEN = 8
+RULES_MAX = 8
+OP_AUTO_CLOSE = 1
+OP_SCHEDULE = 2
+IF_OPEN = 0x01
+IF_CLOSED = 0x02
+UNLESS_PRESENT = 0x04
+DAY_SECS = 86400
+MIN_OPEN_SECS = 10
+
+UNITS = {"s": 1, "m": 60, "h": 3600}
+
+
+def parse_duration(text):
+    match = re.fullmatch(r"(\d+)([smh]?)", text)
+    if not match:
+        raise ValueError("bad duration %r" % text)
+    return int(match.group(1)) * UNITS[match.group(2) or "s"]
+
+
+def parse_time(text):
+    parts = [int(part) for part in text.split(":")]
+    if len(parts) not in (2, 3) or parts[0] > 23 or parts[1] > 59 or (len(parts) == 3 and parts[2] > 59):
+        raise ValueError("bad time %r" % text)
+    return parts[0] * 3600 + parts[1] * 60 + (parts[2] if len(parts) == 3 else 0)
+
+
+def compile_rule(line):
+    words = line.split()
+    opcode = {"autoclose": OP_AUTO_CLOSE, "schedule": OP_SCHEDULE}.get(words[0])
+    if opcode is None or len(words) < 4:
+        raise ValueError("unknown rule %r" % line)
+
+    channel = int(words[1])
+    flags = 0
+    presence = 0
+    if opcode == OP_AUTO_CLOSE:
+        if words[2] != "after":
+            raise ValueError("expected 'after' in %r" % line)
+        param = parse_duration(words[3])
+        if not MIN_OPEN_SECS <= param <= DAY_SECS:
+            raise ValueError("auto-close must be between %ds and 24h" % MIN_OPEN_SECS)
+    else:
+        if words[2] != "at":
+            raise ValueError("expected 'at' in %r" % line)
+        param = parse_time(words[3])
+
+    rest = words[4:]
+    while rest:
+        word = rest.pop(0)
+        if word == "if-open":
+            flags |= IF_OPEN
+        elif word == "if-closed":
+            flags |= IF_CLOSED
+        elif word == "unless-present" and rest:
+            flags |= UNLESS_PRESENT
+            presence = int(rest.pop(0))
+            if not 1 <= presence <= 255:
+                raise ValueError("presence window must be 1-255 minutes")
+        else:
+            raise ValueError("unexpected %r in %r" % (word, line))
+
+    return struct.pack("<BBBBI", opcode, channel, flags, presence, param)
+
+
+def compile_rules(text):
+    program = b""
+    for line in re.split(r"[;\n]", text):
+        line = line.split("#")[0].strip()
+        if line:
+            program += compile_rule(line)
+    if len(program) > RULES_MAX * RULE_LEN:
+        raise ValueError("at most %d rules" % RULES_MAX)
+    return program.hex()
+
+
+def decode(program):
+    data = bytes.fromhex(program)
+    for offset in range(0, len(data) - RULE_LEN + 1, RULE_LEN):
+        opcode, channel, flags, presence, param = struct.unpack_from("<BBBBI", data, offset)
+        if opcode == OP_AUTO_CLOSE:
+            text = "autoclose %d after %ds" % (channel, param)
+        elif opcode == OP_SCHEDULE:
+            text = "schedule %d at %02d:%02d:%02d" % (channel, param // 3600, (param // 60) % 60, param % 60)
+        else:
+            text = "unknown opcode %d" % opcode
+        if flags & IF_OPEN:
+            text += " if-open"
+        if flags & IF_CLOSED:
+            text += " if-closed"
+        if flags & UNLESS_PRESENT:
+            text += " unless-present %d" % presence
+        yield text
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("rules", nargs="?", help="rules file (default: stdin)")
+    parser.add_argument("--decode", metavar="HEX")
+    options = parser.parse_args()
+
+    if options.decode is not None:
+        for line in decode(options.decode):
+            print(line)
+        return
+
+    text = open(options.rules).read() if options.rules else sys.stdin.read()
+    try:
+        print(compile_rules(text))
+    except ValueError as error:
+        sys.exit("compile_rules: %s" % error)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+"""
+Decode a GDoor binary log dump back into text.
+
+The dump is the hex text served by the /<uid>/LogDump endpoint (whitespace
+is ignored). Message IDs are resolved against src/logging/LogMessages.h,
+so decode with the catalogue from the same firmware version.
+
+Usage: decode_log.py [dump.hex] [--catalogue path/to/LogMessages.h]
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+RECORD_LEN = 24
+LEVELS = "DIWE"
+DEFAULT_CATALOGUE = os.path.join(os.path.dirname(__file__), "..", "src", "logging", "LogMessages.h")
+
+
+def load_catalogue(path):
+    with open(path) as f:
+        source = f.read()
+    entries = re.findall(r'X\(\s*(\w+)\s*,\s*"((?:[^"\\]|\\.)*)"\s*\)', source)
+    return [(name, fmt.encode().decode("unicode_escape")) for name, fmt in entries]
+
+
+# printf conversions - group 1 is the conversion character, None for %%
+CONVERSION = re.compile(r"%(?:%|[-+ #0-9.]*(?:hh|h|ll|l)?([diouxXc]))")
+
+
+def format_message(fmt, args):
+    # Args are stored as uint32 - %d & %i read them back as the int they were logged from
+    values = []
+    for match in CONVERSION.finditer(fmt):
+        conversion = match.group(1)
+        if conversion is None:
+            continue
+        value = args[len(values)] if len(values) < len(args) else 0
+        if conversion in "di" and value & 0x80000000:
+            value -= 0x100000000
+        values.append(value)
+    return fmt % tuple(values)
+
+
+def decode(data, catalogue):
+    for offset in range(0, len(data) - RECORD_LEN + 1, RECORD_LEN):
+        millis, msg_id, level, _reserved, *args = struct.unpack_from("<IHBB4I", data, offset)
+        if msg_id < len(catalogue):
+            text = format_message(catalogue[msg_id][1], args)
+        else:
+            text = "Unknown log message %d" % msg_id
+        yield "%lu %s %s" % (millis, LEVELS[level & 0x03], text)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("dump", nargs="?", help="hex dump file (default: stdin)")
+    parser.add_argument("--catalogue", default=DEFAULT_CATALOGUE)
+    options = parser.parse_args()
+
+    text = open(options.dump).read() if options.dump else sys.stdin.read()
+    data = bytes.fromhex("".join(text.split()))
+    for line in decode(data, load_catalogue(options.catalogue)):
+        print(line)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,227 @@
+#!/usr/bin/env python3
+"""
+Decode a GDoor input trace and measure latency from it.
+
+The trace is the hex text served by the /<uid>/TraceDump endpoint
+(whitespace is ignored): sensor pin edges, WiFi status changes, HTTP and
+LAN requests and upload results, each with the device millis it happened at.
+Prints the timeline and a summary:
+
+  edge->state      raw sensor edge to the debounced door state change
+  state->uploaded  door state change to the cloud acknowledging it
+  upload           round trip per upload type, as timed by the uplink
+  local            LAN datagram to reply - an upper bound: the loop pass
+                   it may have waited through plus the handling time
+  boot.<stage>     millis since reset at each boot stage - boot.firstReport
+                   is boot-to-first-report. The ring keeps the last 128
+                   records, so dump within a few minutes of the boot
+
+With --compare, two traces of the same scenario (e.g. captured from the
+old and new firmware on a bench rig driven by the same door cycles) are
+summarised side by side, exiting non-zero if a latency got worse than the
+tolerance allows, so it can gate a release like compare_bench.py.
+
+The door path replays deterministically on the host: test/host/replay_trace
+drives the firmware's GDoorIO with a capture's sensor edges and debounce
+config and writes the trace that firmware produces. Replaying the same
+capture against two checkouts compares their edge->state latency on
+identical input:
+
+  make -C test/host replay
+  test/host/build/replay_trace capture.hex > replayed.hex
+  decode_trace.py --compare capture.hex replayed.hex
+
+HTTP, WiFi and upload records are outcomes (route, auth result, status,
+latency), not payloads, so they're summarised but not replayed.
+
+Usage: decode_trace.py [dump.hex] [--summary]
+       decode_trace.py --compare baseline.hex current.hex [--tolerance 0.10]
+"""
+
+import argparse
+import struct
+import sys
+
+RECORD_LEN = 8
+
+# Mirrors TraceType in src/diagnostics/TraceRecorder.hpp
+TYPES = ["boot", "gpioEdge", "doorState", "wifiStatus", "httpRequest", "localCommand", "actuate", "uploadResponse", "uploadLatency", "ruleFired", "channelConfig", "localLatency", "bootStage"]
+UPLOADS = ["bootInfo", "doorState", "healthCheck", "wifiRecon"]
+AUTH_RESULTS = ["ok", "legacy", "missingHeaders", "malformed", "clockUnsynced", "stale", "replay", "badSignature", "busy"]
+WIFI_STATUS = {0: "idle", 1: "noSsid", 2: "scanDone", 3: "connected", 4: "connectFailed", 5: "connectionLost", 6: "wrongPassword", 7: "disconnected"}
+LOCAL_COMMANDS = {0x01: "hello", 0x02: "status", 0x03: "actuate"}
+LOCAL_RESULTS = ["ok", "badTag", "replay", "unknownCommand", "unknownChannel", "noSecret"]
+ENDPOINTS = ["", "ActuateDoor", "HealthCheck", "ForceDoorStatusCheck", "ForceHealthCheck", "LogDump", "Settings", "Diagnostics", "TraceDump", "Rules", "InjectHang", "Enrol", "RotateSecret"]
+
+# Mirrors BootStage in gdoor_esp.ino
+BOOT_STAGES = ["gpio", "userData", "wifiBegin", "server", "doorSampled", "wifiConnected", "firstReport", "uplinkReady"]
+
+DOOR_STATE_UPLOAD = 1
+
+
+def route_hash(segment):
+    # Same fold as GDoorTrace::routeHash
+    value = 2166136261
+    for byte in segment.encode():
+        value = ((value ^ byte) * 16777619) & 0xFFFFFFFF
+    return (value >> 16) ^ (value & 0xFFFF)
+
+
+ROUTES = dict((route_hash(name), name or "/") for name in ENDPOINTS)
+
+
+def decode(data):
+    records = []
+    for offset in range(0, len(data) - RECORD_LEN + 1, RECORD_LEN):
+        records.append(struct.unpack_from("<IBBH", data, offset))
+    return records
+
+
+def name(table, index):
+    if isinstance(table, dict):
+        return table.get(index, str(index))
+    return table[index] if index < len(table) else str(index)
+
+
+def describe(record):
+    millis, kind, arg, value = record
+    if kind == 0:
+        text = "reset reason %d" % arg
+    elif kind in (1, 2):
+        text = "channel %d -> %s" % (arg, ("low", "high")[value] if kind == 1 else ("open", "closed")[value & 1])
+    elif kind == 3:
+        text = name(WIFI_STATUS, arg)
+    elif kind == 4:
+        text = "%s (%s)" % (ROUTES.get(value, "route %04x" % value), name(AUTH_RESULTS, arg))
+    elif kind == 5:
+        text = "%s channel %d (%s)" % (name(LOCAL_COMMANDS, arg & 0x7F), value >> 8, name(LOCAL_RESULTS, value & 0xFF))
+    elif kind == 6:
+        text = "channel %d" % arg
+    elif kind == 7:
+        text = "%s status %d" % (name(UPLOADS, arg), struct.unpack("<h", struct.pack("<H", value))[0])
+    elif kind == 8:
+        text = "%s %d ms" % (name(UPLOADS, arg), value)
+    elif kind == 9:
+        text = "rule %d channel %d" % (arg, value)
+    elif kind == 10:
+        text = "channel %d debounce %d x %d ms" % (arg, value >> 10, value & 0x3FF)
+    elif kind == 11:
+        text = "%s <= %d ms" % (name(LOCAL_COMMANDS, arg), value)
+    elif kind == 12:
+        text = name(BOOT_STAGES, arg)
+    else:
+        text = "arg %d value %d" % (arg, value)
+    return "%10d %-15s %s" % (millis, name(TYPES, kind), text)
+
+
+def summarise(records):
+    metrics = {}
+
+    def add(metric, sample):
+        metrics.setdefault(metric, []).append(sample)
+
+    pending_edge = {}
+    pending_state = []
+    counts = {}
+    for millis, kind, arg, value in records:
+        counts[name(TYPES, kind)] = counts.get(name(TYPES, kind), 0) + 1
+        if kind == 1:
+            pending_edge.setdefault(arg, millis)
+        elif kind == 2:
+            if arg in pending_edge:
+                add("edge->state", millis - pending_edge.pop(arg))
+            pending_state.append(millis)
+        elif kind == 7 and arg == DOOR_STATE_UPLOAD and pending_state:
+            # Uploads leave in queue order, so the oldest state change is the one acknowledged
+            add("state->uploaded", millis - pending_state.pop(0))
+        elif kind == 8:
+            add("upload." + name(UPLOADS, arg), value)
+        elif kind == 11:
+            add("local." + name(LOCAL_COMMANDS, arg), value)
+        elif kind == 12:
+            add("boot." + name(BOOT_STAGES, arg), millis)
+
+    span = (records[-1][0] - records[0][0]) if records else 0
+    return metrics, counts, span
+
+
+def percentile(samples, fraction):
+    ordered = sorted(samples)
+    return ordered[min(len(ordered) - 1, int(fraction * len(ordered)))]
+
+
+def print_boot(records):
+    # Stages in the order they were reached, each with the time since the one before
+    stages = [(millis, arg) for millis, kind, arg, value in records if kind == 12]
+    if not stages:
+        return
+    previous = 0
+    print("boot (ms since reset)")
+    for millis, arg in sorted(stages):
+        print("  %-16s %8d  +%d" % (name(BOOT_STAGES, arg), millis, millis - previous))
+        previous = millis
+    print("")
+
+
+def print_summary(records):
+    metrics, counts, span = summarise(records)
+    print_boot(records)
+    print("%d records over %.1f s" % (len(records), span / 1000.0))
+    for kind in sorted(counts):
+        print("  %-16s %6d  (%.2f/min)" % (kind, counts[kind], counts[kind] * 60000.0 / span if span else 0))
+    print("%-20s %6s %8s %8s %8s" % ("latency (ms)", "count", "p50", "p90", "max"))
+    for metric in sorted(metrics):
+        samples = metrics[metric]
+        print("%-20s %6d %8d %8d %8d" % (metric, len(samples), percentile(samples, 0.5), percentile(samples, 0.9), max(samples)))
+
+
+def load(path):
+    text = open(path).read() if path else sys.stdin.read()
+    return decode(bytes.fromhex("".join(text.split())))
+
+
+def compare(baseline_path, current_path, tolerance):
+    baseline = summarise(load(baseline_path))[0]
+    current = summarise(load(current_path))[0]
+    failed = False
+
+    print("%-20s %10s %10s %8s" % ("latency p90 (ms)", "base", "current", "change"))
+    for metric in sorted(set(baseline) | set(current)):
+        if metric not in current or metric not in baseline:
+            print("%-20s %10s %10s %8s" % (metric, "-" if metric not in baseline else percentile(baseline[metric], 0.9),
+                                           "-" if metric not in current else percentile(current[metric], 0.9), "missing"))
+            continue
+
+        base = percentile(baseline[metric], 0.9)
+        cur = percentile(current[metric], 0.9)
+        change = (cur - base) / float(base) if base else 0.0
+        status = ""
+        if change > tolerance:
+            status = "  REGRESSION"
+            failed = True
+        print("%-20s %10d %10d %+7.1f%%%s" % (metric, base, cur, change * 100, status))
+
+    return failed
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("dump", nargs="?", help="hex dump file (default: stdin)")
+    parser.add_argument("--summary", action="store_true", help="only print the summary")
+    parser.add_argument("--compare", nargs=2, metavar=("BASELINE", "CURRENT"))
+    parser.add_argument("--tolerance", type=float, default=0.10, help="allowed slowdown as a fraction (default 0.10)")
+    options = parser.parse_args()
+
+    if options.compare:
+        sys.exit(1 if compare(options.compare[0], options.compare[1], options.tolerance) else 0)
+
+    records = load(options.dump)
+    if not options.summary:
+        for record in records:
+            print(describe(record))
+        print("")
+    print_summary(records)
+
+
+if __name__ == "__main__":
+    main()
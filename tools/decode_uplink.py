@@ -0,0 +1,189 @@
+#!/usr/bin/env python3
+"""
+Decode GDoor binary uplink payloads (application/octet-stream uploads).
+
+The layout is documented in src/networking/BinaryUplink.cpp. decode() is
+the importable entry point for the backend - it returns the same fields
+the JSON uploads carry, with the session id resolved by the caller.
+encode() is its inverse, for test vectors - the host tests check the
+firmware's encoders byte for byte against it.
+
+Usage: decode_uplink.py <hex payload> [<hex payload> ...]
+"""
+
+import json
+import struct
+import sys
+
+MAGIC = ord("G")
+SCHEMA_VERSIONS = (1, 2, 3)       # 2 added the reset report to boot info, 3 the memory profile to health
+FLAG_UID = 0x01
+FLAG_DHCP = 0x02
+
+MSG_BOOT_INFO = 0x01
+MSG_DOOR_STATE = 0x02
+MSG_HEALTH = 0x03
+MSG_RECON = 0x04
+
+MESSAGE_NAMES = {
+    MSG_BOOT_INFO: "bootInfo",
+    MSG_DOOR_STATE: "doorState",
+    MSG_HEALTH: "health",
+    MSG_RECON: "recon",
+}
+
+
+class DecodeError(ValueError):
+    pass
+
+
+class Reader:
+    def __init__(self, data):
+        self.data = data
+        self.offset = 0
+
+    def take(self, fmt):
+        try:
+            values = struct.unpack_from("<" + fmt, self.data, self.offset)
+        except struct.error:
+            raise DecodeError("payload truncated at byte %d" % self.offset)
+        self.offset += struct.calcsize("<" + fmt)
+        return values if len(values) > 1 else values[0]
+
+    def string(self):
+        length = self.take("B")
+        value = self.data[self.offset:self.offset + length]
+        if len(value) != length:
+            raise DecodeError("string truncated at byte %d" % self.offset)
+        self.offset += length
+        return value.decode("ascii", errors="replace")
+
+    def ip(self):
+        return ".".join(str(octet) for octet in self.take("4B"))
+
+
+def decode(payload):
+    reader = Reader(bytes(payload))
+    magic, schema, msg_type, flags = reader.take("4B")
+    if magic != MAGIC:
+        raise DecodeError("bad magic 0x%02x" % magic)
+    if schema not in SCHEMA_VERSIONS:
+        raise DecodeError("unsupported schema version %d" % schema)
+    if msg_type not in MESSAGE_NAMES:
+        raise DecodeError("unknown message type 0x%02x" % msg_type)
+
+    message = {"type": MESSAGE_NAMES[msg_type], "schema": schema}
+    if flags & FLAG_UID:
+        message["uid"] = reader.string()
+    else:
+        message["sessionId"] = reader.take("I")
+    message["capturedAt"], message["sentAt"] = reader.take("QQ")
+    if msg_type in (MSG_BOOT_INFO, MSG_RECON):
+        message["addressing"] = "dhcp" if flags & FLAG_DHCP else "static"
+
+    if msg_type == MSG_BOOT_INFO:
+        message["serverPort"] = reader.take("H")
+        message["firmwareVersion"] = reader.string()
+        message["targetStaticIP"] = reader.ip()
+        message["assignedLocalIP"] = reader.ip()
+        channels = reader.take("B")
+        # Door states use the firmware's own strings - "00" open, "01" closed
+        message["doorStates"] = ["%02d" % reader.take("B") for _ in range(channels)]
+        message["connectedMillis"] = reader.take("I")
+        if schema >= 2:
+            reason, fault, stage, exc_cause = reader.take("4B")
+            epc1, stage_millis, free_stack, trail = reader.take("4I")
+            message["reset"] = {"reason": reason, "excCause": exc_cause, "epc1": epc1, "fault": fault,
+                                "stage": stage, "stageMillis": stage_millis, "freeStack": free_stack, "trail": trail}
+    elif msg_type == MSG_DOOR_STATE:
+        message["channel"] = reader.take("B")
+        message["statusUpdate"] = "%02d" % reader.take("B")
+    elif msg_type == MSG_HEALTH:
+        message["millis"] = reader.take("Q")
+        if schema >= 3:
+            message["freeHeap"], message["minFreeHeap"], message["maxFreeBlock"] = reader.take("3I")
+            message["heapFragmentation"] = reader.take("B")
+            message["freeContStack"] = reader.take("I")
+    elif msg_type == MSG_RECON:
+        message["assignedLocalIP"] = reader.ip()
+
+    return message
+
+
+class Writer:
+    def __init__(self):
+        self.data = bytearray()
+
+    def put(self, fmt, *values):
+        self.data += struct.pack("<" + fmt, *values)
+
+    def string(self, value):
+        raw = value.encode("ascii")
+        self.put("B", len(raw))
+        self.data += raw
+
+    def ip(self, value):
+        self.put("4B", *(int(octet) for octet in value.split(".")))
+
+
+def encode(message):
+    # Takes what decode() returns - a uid instead of a sessionId sets the UID flag
+    msg_type = next(code for code, name in MESSAGE_NAMES.items() if name == message["type"])
+    schema = message.get("schema", SCHEMA_VERSIONS[-1])
+    flags = FLAG_UID if "uid" in message else 0
+    if message.get("addressing") == "dhcp":
+        flags |= FLAG_DHCP
+
+    writer = Writer()
+    writer.put("4B", MAGIC, schema, msg_type, flags)
+    if flags & FLAG_UID:
+        writer.string(message["uid"])
+    else:
+        writer.put("I", message["sessionId"])
+    writer.put("QQ", message["capturedAt"], message["sentAt"])
+
+    if msg_type == MSG_BOOT_INFO:
+        writer.put("H", message["serverPort"])
+        writer.string(message["firmwareVersion"])
+        writer.ip(message["targetStaticIP"])
+        writer.ip(message["assignedLocalIP"])
+        writer.put("B", len(message["doorStates"]))
+        for state in message["doorStates"]:
+            writer.put("B", int(state))
+        writer.put("I", message["connectedMillis"])
+        if schema >= 2:
+            reset = message["reset"]
+            writer.put("4B", reset["reason"], reset["fault"], reset["stage"], reset["excCause"])
+            writer.put("4I", reset["epc1"], reset["stageMillis"], reset["freeStack"], reset["trail"])
+    elif msg_type == MSG_DOOR_STATE:
+        writer.put("BB", message["channel"], int(message["statusUpdate"]))
+    elif msg_type == MSG_HEALTH:
+        writer.put("Q", message["millis"])
+        if schema >= 3:
+            writer.put("3I", message["freeHeap"], message["minFreeHeap"], message["maxFreeBlock"])
+            writer.put("B", message["heapFragmentation"])
+            writer.put("I", message["freeContStack"])
+    elif msg_type == MSG_RECON:
+        writer.ip(message["assignedLocalIP"])
+
+    return bytes(writer.data)
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__.strip(), file=sys.stderr)
+        sys.exit(2)
+
+    failed = False
+    for hex_payload in sys.argv[1:]:
+        try:
+            print(json.dumps(decode(bytes.fromhex(hex_payload))))
+        except (DecodeError, ValueError) as error:
+            print("error: %s" % error, file=sys.stderr)
+            failed = True
+
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()
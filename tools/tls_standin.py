@@ -0,0 +1,252 @@
+#!/usr/bin/env python3
+"""
+Local TLS stand-in for the GDoor cloud functions.
+
+Serves the upload endpoints (/sensorBootData, /doorStatusUpdate, ...) over
+HTTPS and counts what the uplink costs: connections, full handshakes,
+resumed handshakes, requests per connection and how long each took. The
+server closes every connection after --close-every requests, the way the
+real front end drops idle keep-alive connections, so the resumption path
+gets exercised too.
+
+Against a device - build with
+
+  -DGDOOR_CLOUD_HOST='"<this host's IP>"' -DGDOOR_CLOUD_PORT=8443
+  -DGDOOR_CLOUD_ROOT_CA=<the PEM this prints, as a string literal>
+
+and compare the summary (printed on Ctrl-C) with the LOG_HTTP_UPLOAD_TIMING
+lines in the device log.
+
+On the host - --client N drives the stand-in with N uploads from two
+clients and prints both summaries:
+
+  persistent  what HttpInterface.cpp does - one keep-alive connection,
+              reconnects offer the cached session
+  naive       a new connection & full handshake per upload
+
+Both use TLS 1.2 (the ESP8266 core's BearSSL tops out there), so session
+resumption works the way it does on the device. The host numbers are the
+protocol's cost on a desktop CPU, not the ESP8266's - what carries over
+is the handshake count per upload.
+
+Usage: tls_standin.py [--port 8443] [--close-every 20] [--cert C --key K]
+       tls_standin.py --client 100 [--close-every 20]
+"""
+
+import argparse
+import json
+import os
+import shutil
+import socket
+import ssl
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+ENDPOINTS = ["/sensorBootData", "/doorStatusUpdate", "/sensorHealthUpdate", "/wifiReconNotification"]
+
+
+class Stats:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.connections = 0
+        self.full = 0
+        self.resumed = 0
+        self.requests = 0
+        self.handshake_ms = []
+        self.request_ms = []
+
+    def summary(self, label):
+        def spread(values):
+            if not values:
+                return "-"
+            ordered = sorted(values)
+            return "mean %.2f ms, p99 %.2f ms, max %.2f ms" % (
+                sum(ordered) / len(ordered), ordered[min(len(ordered) - 1, int(len(ordered) * 0.99))], ordered[-1])
+
+        per_upload = (self.full + self.resumed) / self.requests if self.requests else 0.0
+        return "\n".join([
+            "%s: %d uploads over %d connections" % (label, self.requests, self.connections),
+            "  handshakes  %d full, %d resumed (%.3f per upload)" % (self.full, self.resumed, per_upload),
+            "  handshake   %s" % spread(self.handshake_ms),
+            "  upload      %s" % spread(self.request_ms),
+        ])
+
+
+def self_signed(directory):
+    # RSA like the cloud's chain, so a full handshake costs what it does there
+    if shutil.which("openssl") is None:
+        sys.exit("openssl not found - pass --cert and --key")
+    cert = os.path.join(directory, "standin.pem")
+    key = os.path.join(directory, "standin.key")
+    subprocess.run(["openssl", "req", "-x509", "-newkey", "rsa:2048", "-nodes", "-days", "30", "-subj", "/CN=localhost",
+                    "-addext", "subjectAltName=DNS:localhost,IP:127.0.0.1", "-keyout", key, "-out", cert],
+                   check=True, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    return cert, key
+
+
+def server_context(cert, key):
+    context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+    context.maximum_version = ssl.TLSVersion.TLSv1_2
+    context.load_cert_chain(cert, key)
+    return context
+
+
+def read_message(stream):
+    # Start line, headers (names lower cased) & a Content-Length body - None once the peer has closed
+    start_line = stream.readline()
+    if not start_line:
+        return None
+    headers = {}
+    while True:
+        line = stream.readline().strip()
+        if not line:
+            break
+        name, _, value = line.decode("latin-1").partition(":")
+        headers[name.strip().lower()] = value.strip()
+    body = stream.read(int(headers.get("content-length", "0")))
+    return start_line.decode("latin-1").split(), headers, body
+
+
+def serve_connection(raw, context, stats, close_every):
+    start = time.perf_counter()
+    try:
+        conn = context.wrap_socket(raw, server_side=True)
+    except (ssl.SSLError, OSError):
+        raw.close()
+        return
+    handshake_ms = (time.perf_counter() - start) * 1000
+
+    with stats.lock:
+        stats.connections += 1
+        stats.handshake_ms.append(handshake_ms)
+        if conn.session_reused:
+            stats.resumed += 1
+        else:
+            stats.full += 1
+
+    stream = conn.makefile("rb")
+    served = 0
+    try:
+        while True:
+            request = read_message(stream)
+            if request is None:
+                break
+            method, path = request[0][:2]
+            served += 1
+            closing = served >= close_every
+            status = "200 OK" if method == "POST" and path in ENDPOINTS else "404 Not Found"
+            body = json.dumps({"sessionId": 4242} if path == "/sensorBootData" else {}).encode()
+            conn.sendall(("HTTP/1.1 %s\r\nDate: %s\r\nContent-Type: application/json\r\nContent-Length: %d\r\nConnection: %s\r\n\r\n" % (
+                status, time.strftime("%a, %d %b %Y %H:%M:%S GMT", time.gmtime()), len(body),
+                "close" if closing else "keep-alive")).encode() + body)
+            with stats.lock:
+                stats.requests += 1
+            if closing:
+                break
+    except (ssl.SSLError, OSError):
+        pass
+    finally:
+        stream.close()
+        conn.close()
+
+
+def run_server(listener, context, stats, close_every, stop):
+    listener.settimeout(0.2)
+    while not stop.is_set():
+        try:
+            raw, _ = listener.accept()
+        except socket.timeout:
+            continue
+        threading.Thread(target=serve_connection, args=(raw, context, stats, close_every), daemon=True).start()
+
+
+def drive(port, cert, uploads, persistent):
+    # The client side of HttpInterface.cpp's postToCloud()
+    context = ssl.SSLContext(ssl.PROTOCOL_TLS_CLIENT)
+    context.maximum_version = ssl.TLSVersion.TLSv1_2
+    context.load_verify_locations(cert)
+    stats = Stats()
+    conn = None
+    session = None
+    payload = json.dumps({"uid": "T3stUid000000000000000000001", "doorState": "00"}).encode()
+
+    for index in range(uploads):
+        start = time.perf_counter()
+        if conn is None:
+            raw = socket.create_connection(("127.0.0.1", port))
+            conn = context.wrap_socket(raw, server_hostname="localhost", session=session if persistent else None)
+            stream = conn.makefile("rb")
+            stats.connections += 1
+            stats.handshake_ms.append((time.perf_counter() - start) * 1000)
+            if conn.session_reused:
+                stats.resumed += 1
+            else:
+                stats.full += 1
+            session = conn.session
+
+        conn.sendall(("POST %s HTTP/1.1\r\nHost: localhost\r\nContent-Type: text/plain\r\nContent-Length: %d\r\n\r\n" % (
+            ENDPOINTS[index % len(ENDPOINTS)], len(payload))).encode() + payload)
+        response = read_message(stream)
+        stats.requests += 1
+        stats.request_ms.append((time.perf_counter() - start) * 1000)
+
+        if not persistent or response is None or response[1].get("connection", "").lower() == "close":
+            stream.close()
+            conn.close()
+            conn = None
+
+    if conn is not None:
+        stream.close()
+        conn.close()
+    return stats
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", type=int, default=8443)
+    parser.add_argument("--bind", default="0.0.0.0")
+    parser.add_argument("--close-every", type=int, default=20, help="requests per connection before the server closes it")
+    parser.add_argument("--cert", help="PEM certificate (default: a fresh self-signed one)")
+    parser.add_argument("--key", help="PEM private key for --cert")
+    parser.add_argument("--client", type=int, metavar="N", help="drive the stand-in from this host with N uploads and exit")
+    options = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as directory:
+        cert, key = (options.cert, options.key) if options.cert else self_signed(directory)
+        context = server_context(cert, key)
+        stop = threading.Event()
+
+        if options.client:
+            for label, persistent in (("persistent", True), ("naive", False)):
+                server_stats = Stats()
+                listener = socket.create_server(("127.0.0.1", 0))
+                port = listener.getsockname()[1]
+                thread = threading.Thread(target=run_server, args=(listener, context, server_stats, options.close_every, stop))
+                thread.start()
+                client_stats = drive(port, cert, options.client, persistent)
+                stop.set()
+                thread.join()
+                listener.close()
+                stop.clear()
+                print(client_stats.summary(label))
+                if (server_stats.full, server_stats.resumed) != (client_stats.full, client_stats.resumed):
+                    print("  server saw %d full, %d resumed" % (server_stats.full, server_stats.resumed))
+            return
+
+        with open(cert) as f:
+            print("GDOOR_CLOUD_ROOT_CA:\n%s" % f.read())
+        stats = Stats()
+        listener = socket.create_server((options.bind, options.port))
+        print("Listening on %s:%d - Ctrl-C for the summary" % (options.bind, options.port))
+        try:
+            run_server(listener, context, stats, options.close_every, stop)
+        except KeyboardInterrupt:
+            pass
+        print(stats.summary("device"))
+
+
+if __name__ == "__main__":
+    main()